@@ -50,6 +50,18 @@ enum iSocketType {
 iAddress *  newBroadcast_Address(uint16_t port);
 iAddress *  newSockAddr_Address (const void *sockAddr, size_t sockAddrSize, enum iSocketType socketType);
 
+#if !defined (iPlatformWindows)
+/**
+ * Creates a local (Unix domain) socket address. No lookup is needed.
+ *
+ * @param path        Filesystem path of the socket. A path beginning with '@' is a name
+ *                    in the abstract namespace (Linux only); no file is created for it.
+ * @param socketType  tcp_SocketType for a stream socket, udp_SocketType for datagrams.
+ */
+iAddress *  newLocal_Address    (const char *path, enum iSocketType socketType);
+iBool       isLocal_Address     (const iAddress *);
+#endif
+
 void        init_Address        (iAddress *);
 void        deinit_Address      (iAddress *);
 
@@ -105,4 +117,47 @@ iDeclareAudienceGetter(Address, lookupFinished)
 
 iObjectList *   networkInterfaces_Address(void); // list of iAddress objects
 
+/*-------------------------------------------------------------------------------------*/
+
+/* Lookups are made in a pool of resolver threads. Results are cached both when a host is
+   found and when it is not, and a lookup of a name that is already being looked up waits
+   for the same result. When the result is cached, lookupCStr_Address() finishes the lookup
+   (and notifies the lookupFinished audience) before returning. */
+
+iDeclareType(AddressCacheStats)
+
+struct Impl_AddressCacheStats {
+    size_t   entries;
+    uint64_t hits;      /* lookups finished with a cached result */
+    uint64_t misses;    /* lookups made by a resolver thread */
+    uint64_t joined;    /* lookups that waited for an identical lookup in progress */
+};
+
+/**
+ * Sets the maximum number of resolver threads (default: 4). Threads are added while
+ * lookups are waiting, and idle threads exit after a while. Waits for the lookups
+ * already queued to finish.
+ */
+void    setResolverThreads_Address  (int maxThreads);
+
+/**
+ * Sets how long lookup results are cached (default: 60 seconds for found hosts and 5
+ * seconds for hosts not found) and the maximum number of cached results (default: 256).
+ * When the cache is full, the least recently used results are removed. A zero time
+ * disables caching. The cache is cleared.
+ */
+void    setCacheLimits_Address      (double positiveTtlSeconds, double negativeTtlSeconds,
+                                     size_t maxEntries);
+void    clearCache_Address          (void);
+
+/**
+ * Looks up host names in a file in the /etc/hosts format instead of using the system
+ * resolver. Numeric addresses are used as is. This is meant for tests that should not
+ * depend on DNS. The cache is cleared.
+ *
+ * @param path  Hosts file. NULL to use the system resolver again.
+ */
+void    setHostsFile_Address        (const char *path);
+void    cacheStats_Address          (iAddressCacheStats *stats_out);
+
 iEndPublic
@@ -55,6 +55,7 @@ struct Impl_Array {
 };
 
 iDeclareType(Array)
+iDeclareType(ThreadPool)
 
 iDeclareTypeConstructionArgs(Array, size_t elementSize)
 
@@ -91,6 +92,42 @@ void        resize_Array    (iArray *, size_t size);
 void        fill_Array      (iArray *, char value);
 void        sort_Array      (iArray *, int (*cmp)(const void *, const void *));
 
+enum iSortKeyType {
+    int32_SortKeyType,
+    uint32_SortKeyType,
+    int64_SortKeyType,
+    uint64_SortKeyType,
+    float_SortKeyType,
+    double_SortKeyType,
+};
+
+/**
+ * Sorts the elements in ascending order of a numeric key stored in each element, using
+ * a radix sort. The sort is stable. NaN keys are placed after all other values.
+ *
+ * @param keyOffset  Offset of the key from the beginning of an element, in bytes.
+ */
+void        sortKey_Array   (iArray *, size_t keyOffset, enum iSortKeyType keyType);
+
+/**
+ * Sorts the elements in ascending order as compared with `memcmp`, i.e., as unsigned
+ * bytes in the order they appear in memory. Uses a pattern-defeating quicksort with
+ * branchless partitioning. The sort is not stable.
+ */
+void        sortBytes_Array (iArray *);
+
+/**
+ * Sorts the elements with a merge sort. Unlike `sort_Array`, equal elements remain in
+ * their original order.
+ */
+void        sortStable_Array(iArray *, int (*cmp)(const void *, const void *));
+
+/**
+ * Sorts the elements with a parallel merge sort, using threads from `pool` in addition to
+ * the calling thread. The sort is stable. Small arrays are sorted in the calling thread.
+ */
+void        sortPool_Array  (iArray *, int (*cmp)(const void *, const void *), iThreadPool *pool);
+
 void        setN_Array      (iArray *, size_t pos, const void *value, size_t count);
 void        pushBackN_Array (iArray *, const void *value, size_t count);
 void        pushFrontN_Array(iArray *, const void *value, size_t count);
@@ -27,14 +27,117 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
-#if __STDC_VERSION__ >= 201100L
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The operation macros accept any of the atomic types below. Without a suffix, an
+ * operation is sequentially consistent. The Relaxed, Acquire, Release, and AcqRel
+ * variants use the corresponding memory order, and the Explicit variants take the order
+ * (one of the C11 `memory_order_*` constants) as an argument.
+ *
+ * compareExchange_Atomic() is the strong variant: it fails only if the current value
+ * differs from `*expected`, which is then updated to the current value. The weak variant
+ * may also fail spuriously and should only be used in a loop that retries.
+ */
+
+#if __STDC_VERSION__ >= 201100L && !defined (__STDC_NO_ATOMICS__)
 #  include <stdatomic.h>
-typedef atomic_int iAtomicInt;
-#  define value_Atomic(a)               atomic_load(a)
-#  define set_Atomic(a, value)          atomic_store(a, value)
-#  define exchange_Atomic(a, value)     atomic_exchange(a, value)
-#  define add_Atomic(a, value)          atomic_fetch_add(a, value)
-#  define addRelaxed_Atomic(a, value)   atomic_fetch_add_explicit(a, value, memory_order_relaxed);
+typedef atomic_int          iAtomicInt;
+typedef _Atomic(int64_t)    iAtomicInt64;
+typedef _Atomic(uint64_t)   iAtomicUInt64;
+typedef _Atomic(size_t)     iAtomicSize;
+typedef _Atomic(void *)     iAtomicPtr;
+#  define init_Atomic(a, value)         atomic_init(a, value)
+#  define valueExplicit_Atomic(a, order)            atomic_load_explicit(a, order)
+#  define setExplicit_Atomic(a, value, order)       atomic_store_explicit(a, value, order)
+#  define exchangeExplicit_Atomic(a, value, order)  atomic_exchange_explicit(a, value, order)
+#  define addExplicit_Atomic(a, value, order)       atomic_fetch_add_explicit(a, value, order)
+#  define subExplicit_Atomic(a, value, order)       atomic_fetch_sub_explicit(a, value, order)
+#  define orExplicit_Atomic(a, value, order)        atomic_fetch_or_explicit(a, value, order)
+#  define andExplicit_Atomic(a, value, order)       atomic_fetch_and_explicit(a, value, order)
+#  define compareExchangeExplicit_Atomic(a, expected, value, success, failure) \
+            atomic_compare_exchange_strong_explicit(a, expected, value, success, failure)
+#  define compareExchangeWeakExplicit_Atomic(a, expected, value, success, failure) \
+            atomic_compare_exchange_weak_explicit(a, expected, value, success, failure)
+#  define fenceExplicit_Atomic(order)   atomic_thread_fence(order)
+#  define signalFence_Atomic()          atomic_signal_fence(memory_order_seq_cst)
+#elif defined (__GNUC__)
+/* Compiler built-ins, e.g., for C99 or C++. */
+typedef int                 iAtomicInt;
+typedef int64_t             iAtomicInt64;
+typedef uint64_t            iAtomicUInt64;
+typedef size_t              iAtomicSize;
+typedef void *              iAtomicPtr;
+#  if !defined (memory_order_relaxed)
+#    define memory_order_relaxed        __ATOMIC_RELAXED
+#    define memory_order_consume        __ATOMIC_CONSUME
+#    define memory_order_acquire        __ATOMIC_ACQUIRE
+#    define memory_order_release        __ATOMIC_RELEASE
+#    define memory_order_acq_rel        __ATOMIC_ACQ_REL
+#    define memory_order_seq_cst        __ATOMIC_SEQ_CST
+#  endif
+#  define init_Atomic(a, value)         __atomic_store_n(a, value, __ATOMIC_RELAXED)
+#  define valueExplicit_Atomic(a, order)            __atomic_load_n(a, order)
+#  define setExplicit_Atomic(a, value, order)       __atomic_store_n(a, value, order)
+#  define exchangeExplicit_Atomic(a, value, order)  __atomic_exchange_n(a, value, order)
+#  define addExplicit_Atomic(a, value, order)       __atomic_fetch_add(a, value, order)
+#  define subExplicit_Atomic(a, value, order)       __atomic_fetch_sub(a, value, order)
+#  define orExplicit_Atomic(a, value, order)        __atomic_fetch_or(a, value, order)
+#  define andExplicit_Atomic(a, value, order)       __atomic_fetch_and(a, value, order)
+#  define compareExchangeExplicit_Atomic(a, expected, value, success, failure) \
+            __atomic_compare_exchange_n(a, expected, value, 0, success, failure)
+#  define compareExchangeWeakExplicit_Atomic(a, expected, value, success, failure) \
+            __atomic_compare_exchange_n(a, expected, value, 1, success, failure)
+#  define fenceExplicit_Atomic(order)   __atomic_thread_fence(order)
+#  define signalFence_Atomic()          __atomic_signal_fence(__ATOMIC_SEQ_CST)
 #else
-typedef int iAtomicInt;
+/* No atomic operations available; only the types are defined. */
+typedef int                 iAtomicInt;
+typedef int64_t             iAtomicInt64;
+typedef uint64_t            iAtomicUInt64;
+typedef size_t              iAtomicSize;
+typedef void *              iAtomicPtr;
 #endif
+
+#define value_Atomic(a)                 valueExplicit_Atomic(a, memory_order_seq_cst)
+#define valueRelaxed_Atomic(a)          valueExplicit_Atomic(a, memory_order_relaxed)
+#define valueAcquire_Atomic(a)          valueExplicit_Atomic(a, memory_order_acquire)
+
+#define set_Atomic(a, value)            setExplicit_Atomic(a, value, memory_order_seq_cst)
+#define setRelaxed_Atomic(a, value)     setExplicit_Atomic(a, value, memory_order_relaxed)
+#define setRelease_Atomic(a, value)     setExplicit_Atomic(a, value, memory_order_release)
+
+#define exchange_Atomic(a, value)       exchangeExplicit_Atomic(a, value, memory_order_seq_cst)
+#define exchangeAcquire_Atomic(a, value) \
+                                        exchangeExplicit_Atomic(a, value, memory_order_acquire)
+#define exchangeAcqRel_Atomic(a, value) exchangeExplicit_Atomic(a, value, memory_order_acq_rel)
+
+/* These return the previous value. */
+#define add_Atomic(a, value)            addExplicit_Atomic(a, value, memory_order_seq_cst)
+#define addRelaxed_Atomic(a, value)     addExplicit_Atomic(a, value, memory_order_relaxed)
+#define addRelease_Atomic(a, value)     addExplicit_Atomic(a, value, memory_order_release)
+#define addAcqRel_Atomic(a, value)      addExplicit_Atomic(a, value, memory_order_acq_rel)
+#define sub_Atomic(a, value)            subExplicit_Atomic(a, value, memory_order_seq_cst)
+#define or_Atomic(a, value)             orExplicit_Atomic(a, value, memory_order_seq_cst)
+#define and_Atomic(a, value)            andExplicit_Atomic(a, value, memory_order_seq_cst)
+
+#define compareExchange_Atomic(a, expected, value) \
+            compareExchangeExplicit_Atomic(a, expected, value, \
+                                           memory_order_seq_cst, memory_order_seq_cst)
+#define compareExchangeWeak_Atomic(a, expected, value) \
+            compareExchangeWeakExplicit_Atomic(a, expected, value, \
+                                               memory_order_seq_cst, memory_order_seq_cst)
+#define compareExchangeAcqRel_Atomic(a, expected, value) \
+            compareExchangeExplicit_Atomic(a, expected, value, \
+                                           memory_order_acq_rel, memory_order_acquire)
+#define compareExchangeWeakAcqRel_Atomic(a, expected, value) \
+            compareExchangeWeakExplicit_Atomic(a, expected, value, \
+                                               memory_order_acq_rel, memory_order_acquire)
+#define compareExchangeWeakRelaxed_Atomic(a, expected, value) \
+            compareExchangeWeakExplicit_Atomic(a, expected, value, \
+                                               memory_order_relaxed, memory_order_relaxed)
+
+#define acquireFence_Atomic()           fenceExplicit_Atomic(memory_order_acquire)
+#define releaseFence_Atomic()           fenceExplicit_Atomic(memory_order_release)
+#define fullFence_Atomic()              fenceExplicit_Atomic(memory_order_seq_cst)
@@ -0,0 +1,88 @@
+#pragma once
+
+/** @file the_Foundation/atomicstack.h  Lock-free stack (free list).
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "defs.h"
+#include "atomic.h"
+
+iBeginPublic
+
+/**
+ * Intrusive lock-free LIFO stack (Treiber stack). Nodes are usually embedded as the first
+ * member of the stored items, or written over the first bytes of free memory blocks.
+ *
+ * The head pointer is combined with a counter that changes on every update, so a node
+ * that is popped and pushed back by other threads while a pop is in progress does not
+ * corrupt the stack (the ABA problem). A pop may still read the link of a node that was
+ * just popped by another thread. Therefore the memory of popped nodes must remain
+ * readable while the stack is in use; this is the case when nodes are never returned to
+ * the system, as in a free list of pooled blocks.
+ *
+ * The counter is kept in the upper bits of the 64-bit head, which are not part of user
+ * space addresses on current platforms (16 bits on x86-64, 8 on AArch64). Pushing a node
+ * whose address uses those bits aborts the program.
+ */
+iDeclareType(AtomicStack)
+iDeclareType(AtomicStackNode)
+
+struct Impl_AtomicStackNode {
+    iAtomicPtr next;
+};
+
+struct Impl_AtomicStack {
+    iAtomicUInt64 head; /* node address and update counter */
+};
+
+void                init_AtomicStack    (iAtomicStack *);
+
+iLocalDef void deinit_AtomicStack(iAtomicStack *d) {
+    iUnused(d);
+}
+
+void                push_AtomicStack    (iAtomicStack *, iAtomicStackNode *node);
+
+/**
+ * Pushes a chain of nodes with a single atomic operation. The nodes from `first` to
+ * `last` must already be linked via their `next` members.
+ */
+void                pushChain_AtomicStack   (iAtomicStack *, iAtomicStackNode *first,
+                                             iAtomicStackNode *last);
+iAtomicStackNode *  pop_AtomicStack     (iAtomicStack *);
+
+/**
+ * Removes all nodes at once. The returned nodes remain linked via their `next` members;
+ * the last one has a NULL link.
+ */
+iAtomicStackNode *  takeAll_AtomicStack (iAtomicStack *);
+iBool               isEmpty_AtomicStack (const iAtomicStack *);
+
+iLocalDef iAtomicStackNode *next_AtomicStackNode(const iAtomicStackNode *d) {
+    return valueRelaxed_Atomic(&iConstCast(iAtomicStackNode *, d)->next);
+}
+
+iEndPublic
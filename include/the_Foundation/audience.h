@@ -27,6 +27,7 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
+#include "atomic.h"
 #include "mutex.h"
 #include "sortedarray.h"
 #include "ptrset.h"
@@ -57,29 +58,66 @@ iBeginPublic
 #define iDefineInlineAudienceGetter(typeName, audienceName) \
     iLocalDef iDefineAudienceGetter(typeName, audienceName)
 
+/* Audiences notified with iNotifyAudienceArgs() cannot have queued observers. */
+#define iDefineDirectAudienceGetter(typeName, audienceName) \
+    iAudience *audienceName##_##typeName(i##typeName *d) { \
+        if (!d->audienceName) { d->audienceName = newDirect_Audience(); }  \
+        return d->audienceName; \
+    }
+
+/*
+ * Notifications do not lock the audience. The observers are called from an immutable
+ * snapshot of the audience, so observers may be connected or disconnected (also from
+ * other threads) while the notification is in progress.
+ *
+ * Observers connected with iConnectQueued() are called via their Dispatch. Identical
+ * notifications that are still pending in the dispatch are coalesced into one call.
+ * Notifications with arguments cannot be queued: their audiences are created with
+ * newDirect_Audience(), which refuses queued observers.
+ */
 #define iNotifyAudience(d, audienceName, notifyName) { \
     if ((d)->audienceName) { \
-        iGuardMutex(&(d)->audienceName->mutex, \
-            iConstForEach(Audience, i, (d)->audienceName) { \
-                iFunctionCast(iNotify##notifyName, i.value->func)(i.value->object, d); \
+        const iAudienceSnapshot *snap_ = beginNotify_Audience((d)->audienceName); \
+        for (size_t i_ = 0; i_ < snap_->count; i_++) { \
+            const iObserver *obs_ = &snap_->observers[i_]; \
+            if (!value_Atomic(&obs_->removed)) { \
+                if (obs_->dispatch) { \
+                    postQueued_Audience((d)->audienceName, obs_, d); \
+                } \
+                else { \
+                    iFunctionCast(iNotify##notifyName, obs_->func)(obs_->object, d); \
+                } \
             } \
-        ); \
+        } \
+        endNotify_Audience((d)->audienceName); \
     } \
 }
 
 #define iNotifyAudienceArgs(d, audienceName, notifyName, ...) { \
     if ((d)->audienceName) { \
-        iGuardMutex(&(d)->audienceName->mutex, \
-            iConstForEach(Audience, i, (d)->audienceName) { \
-                iFunctionCast(iNotify##notifyName, i.value->func)(i.value->object, d, __VA_ARGS__); \
+        const iAudienceSnapshot *snap_ = beginNotify_Audience((d)->audienceName); \
+        for (size_t i_ = 0; i_ < snap_->count; i_++) { \
+            const iObserver *obs_ = &snap_->observers[i_]; \
+            iAssert(!obs_->dispatch); \
+            if (!value_Atomic(&obs_->removed)) { \
+                iFunctionCast(iNotify##notifyName, obs_->func)(obs_->object, d, __VA_ARGS__); \
             } \
-        ); \
+        } \
+        endNotify_Audience((d)->audienceName); \
     } \
 }
 
 #define iConnect(typeName, src, audienceName, dest, function) \
     insert_Audience(audienceName##_##typeName(src), (dest), iFunctionCast(iObserverFunc, function))
 
+/**
+ * Connects an observer whose notifications are called via @a dispatch instead of the
+ * notifying thread.
+ */
+#define iConnectQueued(typeName, src, audienceName, dest, function, dispatch) \
+    insertQueued_Audience(audienceName##_##typeName(src), (dest), \
+                          iFunctionCast(iObserverFunc, function), (dispatch))
+
 #define iDisconnect(typeName, src, audienceName, dest, function) \
     remove_Audience(audienceName##_##typeName(src), (dest), iFunctionCast(iObserverFunc, function))
 
@@ -87,19 +125,38 @@ iBeginPublic
     removeObject_Audience(audienceName##_##typeName(src), (dest))
 
 iDeclareType(Audience)
+iDeclareType(AudienceSnapshot)
 iDeclareType(Observer)
 iDeclareType(Object)
+iDeclareType(Dispatch)
 
 typedef void (*iObserverFunc)(iAnyObject *);
 
 struct Impl_Observer {
     iAnyObject *object;
     iObserverFunc func;
+    iDispatch *dispatch; /* NULL, if called directly; otherwise holds a reference */
+    iAtomicInt removed;  /* set in retired snapshots when the observer is removed */
+};
+
+/**
+ * Immutable copy of an audience's observers. Notifications iterate over the latest
+ * snapshot without locking. An observer whose `removed` flag is set has been removed after
+ * the snapshot was taken and must be skipped. Nothing else in a snapshot changes.
+ */
+struct Impl_AudienceSnapshot {
+    size_t count;
+    iObserver *observers;
+    iAudienceSnapshot *nextRetired;
 };
 
 struct Impl_Audience {
-    iSortedArray observers;
+    iSortedArray observers; /* guarded by `mutex` */
     iMutex mutex;
+    iAtomicPtr snapshot;    /* current iAudienceSnapshot */
+    iAudienceSnapshot *retired;
+    iAtomicInt pendingRemovals;
+    iBool isDirect;         /* notified with arguments; observers cannot be queued */
 };
 
 iDeclareTypeConstruction(Audience)
@@ -107,13 +164,28 @@ iDeclareTypeConstruction(Audience)
 void    init_Audience   (iAudience *);
 void    deinit_Audience (iAudience *);
 
-iBool   insert_Audience (iAudience *d, iAnyObject *object, iObserverFunc func);
-iBool   remove_Audience (iAudience *d, iAnyObject *object, iObserverFunc func);
+iAudience * newDirect_Audience  (void);
+
+iBool   insert_Audience         (iAudience *d, iAnyObject *object, iObserverFunc func);
+iBool   insertQueued_Audience   (iAudience *d, iAnyObject *object, iObserverFunc func,
+                                 iDispatch *dispatch);
+iBool   remove_Audience         (iAudience *d, iAnyObject *object, iObserverFunc func);
 
 iLocalDef iBool removeObject_Audience(iAudience *d, iAnyObject *object) {
     return remove_Audience(d, object, NULL);
 }
 
+iBool   isEmpty_Audience        (const iAudience *); /* NULL is empty */
+
+/**
+ * Begins a notification by acquiring the current snapshot of observers. Must be paired
+ * with a call to endNotify_Audience() in the same thread. Notifications may be nested.
+ */
+const iAudienceSnapshot *   beginNotify_Audience    (iAudience *);
+void                        endNotify_Audience      (iAudience *);
+void                        postQueued_Audience     (const iAudience *, const iObserver *observer,
+                                                     iAnyObject *source);
+
 /** @name Iterators */
 ///@{
 iDeclareConstIterator(Audience, const iAudience *)
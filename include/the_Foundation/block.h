@@ -29,7 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 
 #include "defs.h"
 #include "range.h"
-#include "atomic.h"
+#include "refcount.h"
 
 #include <stdarg.h>
 
@@ -46,7 +46,7 @@ struct Impl_Block {
 };
 
 struct Impl_BlockData {
-    iAtomicInt refCount;
+    iRefCount refCount;
     char *data;
     size_t size;
     size_t allocSize;
@@ -58,7 +58,7 @@ struct Impl_BlockData {
  * make sure that the BlockData is only read and not copy-referenced.
  */
 #define iBlockLiteral(ptr, sz, allocSz) \
-    (iBlock){ &(iBlockData){ .refCount = 2, .data = iConstCast(char *, ptr), .size = (sz), .allocSize = (allocSz) } }
+    (iBlock){ &(iBlockData){ .refCount = { .count = 2 }, .data = iConstCast(char *, ptr), .size = (sz), .allocSize = (allocSz) } }
 
 iDeclareTypeConstructionArgs(Block, size_t size)
 iDeclareTypeSerialization(Block)
@@ -108,6 +108,13 @@ void            fill_Block          (iBlock *, char value);
 void            clear_Block         (iBlock *);
 void            reserve_Block       (iBlock *, size_t reservedSize);
 void            resize_Block        (iBlock *, size_t size);
+
+/**
+ * Makes the block's data unique and confines its reference counting to the calling
+ * thread. Copies of the block made in this thread then avoid atomic operations. Such
+ * copies must also be deinitialized in this thread.
+ */
+void            confine_Block       (iBlock *);
 void            truncate_Block      (iBlock *, size_t size);
 void            remove_Block        (iBlock *, size_t start, size_t count);
 size_t          replace_Block       (iBlock *, char oldValue, char newValue);
@@ -28,6 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
 #include "defs.h"
+#include "atomic.h"
 
 iBeginPublic
 
@@ -45,6 +46,7 @@ struct Impl_Class {
     iAnyObject *(*newObject)   (void); /* default constructor (optional) */
     void        (*serialize)   (const iAnyObject *, iStream *);
     void        (*deserialize) (iAnyObject *, iStream *);
+    iAtomicPtr    pool;        /* iObjectPool, if objects are allocated from a pool */
 };
 
 #define iBeginDeclareClass(className) \
@@ -56,7 +58,8 @@ struct Impl_Class {
         void (*deinit)(void *); \
         iAnyObject *(*newObject)(void); \
         void (*serialize)(const iAnyObject *, iStream *); \
-        void (*deserialize)(iAnyObject *, iStream *);
+        void (*deserialize)(iAnyObject *, iStream *); \
+        iAtomicPtr pool;
 
 #define iEndDeclareClass(className) \
     }; \
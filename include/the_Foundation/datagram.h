@@ -47,6 +47,7 @@ iDeclareAudienceGetter  (Datagram, writeFinished)
 
 iDeclareType(Address)
 iDeclareType(Block)
+iDeclareType(EventLoop)
 
 iBool       open_Datagram       (iDatagram *, uint16_t port);
 void        close_Datagram      (iDatagram *);
@@ -54,6 +55,24 @@ void        close_Datagram      (iDatagram *);
 iBool       isOpen_Datagram     (const iDatagram *);
 uint16_t    port_Datagram       (const iDatagram *);
 
+#if !defined (iPlatformWindows)
+/**
+ * Sets the event loop where messages are sent and received. Must be called before the
+ * datagram is opened. By default, the shared event loop is used.
+ */
+void        setEventLoop_Datagram   (iDatagram *, iEventLoop *loop);
+
+/**
+ * Opens a local (Unix domain) datagram socket. Messages can then be sent to addresses
+ * created with newLocal_Address() using udp_SocketType. A socket file left behind at
+ * @a path is replaced, and the file is removed when the datagram is closed.
+ *
+ * @param path  Filesystem path of the socket, or a name in the abstract namespace
+ *              beginning with '@' (Linux only).
+ */
+iBool       openLocal_Datagram      (iDatagram *, const char *path);
+#endif
+
 void        send_Datagram       (iDatagram *, const iBlock *data, const iAddress *to);
 void        sendData_Datagram   (iDatagram *, const void *data, size_t size, const iAddress *to);
 iBlock *    receive_Datagram    (iDatagram *, iAddress **from_out);
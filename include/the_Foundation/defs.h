@@ -47,6 +47,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 
 #define iLocalDef   static inline
 
+#if !defined (__cplusplus) && __STDC_VERSION__ >= 201112L
+#   define iHaveThreadLocal
+#   if defined (__GNUC__) && !defined (__MINGW32__)
+        /* Avoids a function call per access in shared libraries. */
+#       define iThreadLocal _Thread_local __attribute__((tls_model("initial-exec")))
+#   else
+#       define iThreadLocal _Thread_local
+#   endif
+#endif
+
 #define iFalse      false
 #define iTrue       true
 
@@ -120,18 +130,27 @@ iPublic void        iMd5Hash    (const void *data, size_t size, uint8_t md5_out[
 
 #define iDeclareType(typeName)  typedef struct Impl_##typeName i##typeName;
 
-#define iDeclareTypeConstruction(typeName) \
+#define iDeclareTypeConstructionNoCollectNew_(typeName) \
     i##typeName *new_##typeName(void); \
     void delete_##typeName(i##typeName *); \
     iLocalDef i##typeName *collect_##typeName(i##typeName *d) { \
         return iCollectDel(d, delete_##typeName); \
     } \
-    iLocalDef i##typeName *collectNew_##typeName(void) { \
-        return collect_##typeName(new_##typeName()); \
-    } \
     void init_##typeName(i##typeName *); \
     void deinit_##typeName(i##typeName *);
 
+#define iDeclareTypeConstruction(typeName) \
+    iDeclareTypeConstructionNoCollectNew_(typeName) \
+    iLocalDef i##typeName *collectNew_##typeName(void) { \
+        return collect_##typeName(new_##typeName()); \
+    }
+
+/* collectNew_{Type} is defined with iDefineTypeCollectNew() and uses the arena of the
+   current arena scope. */
+#define iDeclareTypeConstructionArena(typeName) \
+    iDeclareTypeConstructionNoCollectNew_(typeName) \
+    i##typeName *collectNew_##typeName(void);
+
 #define iDeclareTypeConstructionArgs(typeName, ...) \
     i##typeName *new_##typeName(__VA_ARGS__); \
     void delete_##typeName(i##typeName *); \
@@ -141,6 +160,17 @@ iPublic void        iMd5Hash    (const void *data, size_t size, uint8_t md5_out[
     void init_##typeName(i##typeName *, __VA_ARGS__); \
     void deinit_##typeName(i##typeName *);
 
+/* Inside an arena scope, collected instances are allocated from the arena. */
+#define iDefineTypeCollectNew(typeName) \
+    i##typeName *collectNew_##typeName(void) { \
+        i##typeName *d = (i##typeName *) allocArena_Garbage(sizeof(i##typeName)); \
+        if (d) { \
+            init_##typeName(d); \
+            return (i##typeName *) iCollectDel(d, deinit_##typeName); \
+        } \
+        return (i##typeName *) iCollectDel(new_##typeName(), delete_##typeName); \
+    }
+
 #define iDefineTypeConstruction(typeName) \
     i##typeName *new_##typeName(void) { \
         i##typeName *d = iMalloc(typeName); \
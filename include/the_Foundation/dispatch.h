@@ -0,0 +1,103 @@
+#pragma once
+
+/** @file the_Foundation/dispatch.h  Serial queue of calls made in a chosen thread.
+
+A Dispatch is a serial queue of function calls that are made in a chosen thread instead
+of the thread that posted them. Calls are made in the order they were posted.
+
+A Dispatch is either processed manually by its owner thread (for example, the
+application's main loop calls process_Dispatch() on main_Dispatch()), or it runs the
+calls in a thread pool.
+
+Audience observers can be connected with a Dispatch (see iConnectQueued) so that they get
+notified in the dispatch's thread rather than in the thread that emitted the notification.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "object.h"
+#include "audience.h"
+
+iBeginPublic
+
+iDeclareClass(Dispatch)
+iDeclareType(ThreadPool)
+
+typedef void (*iDispatchFunc)(iAny *context);
+
+iDeclareObjectConstruction(Dispatch)
+
+/**
+ * Constructs a dispatch whose calls are made in a thread pool. At most one pooled thread
+ * makes calls from the dispatch at a time.
+ *
+ * @param pool  Thread pool. The dispatch keeps a reference to it.
+ */
+iDispatch * newPool_Dispatch    (iThreadPool *pool);
+
+void        init_Dispatch       (iDispatch *);
+void        initPool_Dispatch   (iDispatch *, iThreadPool *pool);
+void        deinit_Dispatch     (iDispatch *);
+
+/**
+ * Returns the global dispatch intended for the application's main thread. The
+ * application is responsible for regularly calling process_Dispatch() on it.
+ */
+iDispatch * main_Dispatch       (void);
+
+void        post_Dispatch       (iDispatch *, iDispatchFunc func, iAny *context);
+
+/**
+ * Makes all the calls that were pending when the method was called. Must not be used
+ * with a dispatch that runs in a thread pool.
+ *
+ * @return Number of calls made.
+ */
+size_t      process_Dispatch        (iDispatch *);
+
+/**
+ * Waits until at least one call is pending, and then makes all pending calls.
+ *
+ * @param timeoutSeconds  Maximum duration to wait.
+ *
+ * @return Number of calls made. Zero, if timed out.
+ */
+size_t      processTimeout_Dispatch (iDispatch *, double timeoutSeconds);
+
+size_t      size_Dispatch           (const iDispatch *);
+
+iLocalDef iBool isEmpty_Dispatch(const iDispatch *d) {
+    return size_Dispatch(d) == 0;
+}
+
+/** @cond */
+/* Used by Audience for queued observers. */
+void        postNotify_Dispatch     (iDispatch *, const iAudience *audience,
+                                     const iObserver *observer, iAnyObject *source);
+void        cancelObserver_Dispatch (iDispatch *, const iAnyObject *object, iObserverFunc func);
+void        cancelAudience_Dispatch (iDispatch *, const iAudience *audience);
+/** @endcond */
+
+iEndPublic
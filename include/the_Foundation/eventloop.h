@@ -0,0 +1,140 @@
+#pragma once
+
+/** @file the_Foundation/eventloop.h  Event loop for file descriptors, timers, and posted calls.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "object.h"
+
+iBeginPublic
+
+/**
+ * EventLoop waits for file descriptors to become ready and for timers to expire, and
+ * calls the registered functions in the thread that runs the loop. Any thread may add
+ * and remove watchers and timers, and post calls to the loop.
+ *
+ * On Linux the loop is built on epoll, with an eventfd for waking up and a timerfd for
+ * timers. Other POSIX platforms use poll(). EventLoop is not available on Windows.
+ *
+ * The functions are called one at a time, so they should return quickly and never
+ * block; a slow function delays everything else in the loop.
+ */
+iDeclareClass(EventLoop)
+
+/** Identifies a watcher or a timer. Zero is never used as an ID. */
+typedef uint32_t iEventLoopId;
+
+enum iEventLoopEvent {
+    read_EventLoopEvent  = 0x1,
+    write_EventLoopEvent = 0x2,
+    error_EventLoopEvent = 0x4, /* error or hangup; always reported */
+};
+
+typedef void (*iEventLoopFunc)  (iAny *context);
+typedef void (*iEventLoopFdFunc)(iAny *context, int fd, int events);
+
+iDeclareObjectConstruction(EventLoop)
+
+/**
+ * Returns a loop shared by the library's I/O classes, running in its own thread. It is
+ * created when first needed and stopped in deinit_Foundation().
+ */
+iEventLoop *    shared_EventLoop        (void);
+
+/**
+ * Runs the loop in the calling thread until quit_EventLoop() is called.
+ */
+void            run_EventLoop           (iEventLoop *);
+
+/**
+ * Waits for events and makes the calls that are due, once.
+ *
+ * @param timeoutSeconds  Maximum time to wait. Negative to wait until something happens.
+ *
+ * @return Number of calls made.
+ */
+size_t          processEvents_EventLoop (iEventLoop *, double timeoutSeconds);
+
+/**
+ * Starts a thread that runs the loop. The thread is stopped when the loop is deleted.
+ */
+void            start_EventLoop         (iEventLoop *);
+void            quit_EventLoop          (iEventLoop *);
+
+/**
+ * Checks if the calling thread is currently running the loop.
+ */
+iBool           isCurrent_EventLoop     (const iEventLoop *);
+
+/**
+ * Starts watching a file descriptor. There can be only one watcher per file descriptor,
+ * and it must be removed before the file descriptor is closed.
+ *
+ * @param events  Events of interest (read_EventLoopEvent, write_EventLoopEvent).
+ *                Errors are always reported.
+ * @param func    Function called with the events that occurred.
+ *
+ * @return ID of the watcher, or zero if the file descriptor cannot be watched.
+ */
+iEventLoopId    watch_EventLoop         (iEventLoop *, int fd, int events,
+                                         iEventLoopFdFunc func, iAny *context);
+
+void            setEvents_EventLoop     (iEventLoop *, iEventLoopId watcher, int events);
+
+/**
+ * Stops watching a file descriptor. When called in another thread while the watcher's
+ * function is running, waits for the function to return; afterwards the function is no
+ * longer called.
+ */
+void            unwatch_EventLoop       (iEventLoop *, iEventLoopId watcher);
+
+/**
+ * Adds a timer.
+ *
+ * @param delaySeconds     Time until the first call.
+ * @param intervalSeconds  Time between subsequent calls. Zero for a single call.
+ *
+ * @return ID of the timer.
+ */
+iEventLoopId    addTimer_EventLoop      (iEventLoop *, double delaySeconds,
+                                         double intervalSeconds, iEventLoopFunc func,
+                                         iAny *context);
+
+/**
+ * Cancels a timer. Like unwatch_EventLoop(), waits for a call in progress in another
+ * thread to return.
+ *
+ * @return iTrue if the timer was pending and is now cancelled.
+ */
+iBool           cancelTimer_EventLoop   (iEventLoop *, iEventLoopId timer);
+
+/**
+ * Posts a call to be made in the loop. Posted calls are made in the order they were
+ * posted.
+ */
+void            post_EventLoop          (iEventLoop *, iEventLoopFunc func, iAny *context);
+
+iEndPublic
@@ -0,0 +1,120 @@
+#pragma once
+
+/** @file the_Foundation/fiber.h  Lightweight threads of execution on a thread pool.
+
+A Fiber runs a function on a stack of its own, but not on a thread of its own. Fibers are
+scheduled as jobs on a ThreadPool. When a fiber has to wait, it is suspended and the pool
+thread is freed to run other jobs; the fiber resumes later, possibly in another thread of
+the pool. This makes it possible to have a large number of concurrent operations written
+as straight-line code using only a few threads.
+
+Waiting on a Condition (wait_Condition, waitTimeout_Condition) suspends the calling fiber,
+so the library's blocking waits built on conditions are fiber-aware: take_Queue,
+wait_Future, waitForFinished_Address, waitForFinished_TlsRequest, and join_Fiber, for
+example. Operations that block inside system calls can be moved off the pool threads with
+offload_Fiber(). Locking a Mutex still blocks the thread, so mutexes should only be held
+briefly.
+
+Since a fiber may continue in a different thread after a wait, it must not hold a mutex
+or a garbage collection scope (iBeginCollect) over a wait, and it should not keep a
+pointer to thread-local data.
+
+Fibers need ucontext support. On platforms without it, a fiber's function is run as a
+regular pool job and waiting blocks the thread. On Linux and Apple platforms, an
+inaccessible guard page below each stack makes a stack overflow crash the process.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "thread.h"
+
+iBeginPublic
+
+iDeclareClass(Fiber)
+iDeclareType(ThreadPool)
+
+typedef iThreadResult (*iFiberRunFunc)(iFiber *);
+
+enum iFiberDefaults {
+    defaultStackSize_Fiber = 64 * 1024,
+};
+
+iDeclareObjectConstructionArgs(Fiber, iFiberRunFunc run)
+
+void            setUserData_Fiber   (iFiber *, void *userData);
+void            setStackSize_Fiber  (iFiber *, size_t stackSize);
+
+void *          userData_Fiber      (const iFiber *);
+iBool           isFinished_Fiber    (const iFiber *);
+
+/**
+ * Starts running the fiber in a thread pool. The fiber holds a reference to itself until
+ * it finishes.
+ *
+ * @param pool  Thread pool that runs the fiber. The fiber keeps a reference to it until
+ *              it finishes.
+ */
+void            start_Fiber         (iFiber *, iThreadPool *pool);
+
+/**
+ * Waits until the fiber has finished. May be called in a thread or in another fiber.
+ */
+void            join_Fiber          (iFiber *);
+
+/**
+ * Waits until the fiber has finished and returns the value returned by its run function.
+ */
+iThreadResult   result_Fiber        (const iFiber *);
+
+/**
+ * Returns the fiber that is running in the calling thread, or NULL if called outside
+ * a fiber.
+ */
+iFiber *        current_Fiber       (void);
+
+/**
+ * Lets other jobs in the thread pool run before the current fiber continues. Outside a
+ * fiber, does nothing.
+ */
+void            yield_Fiber         (void);
+
+/**
+ * Suspends the current fiber for a period of time. Outside a fiber, the calling thread
+ * sleeps instead.
+ */
+void            sleep_Fiber         (double seconds);
+
+/**
+ * Runs a blocking operation in a separate thread while the current fiber is suspended.
+ * Outside a fiber, the operation is run in the calling thread.
+ *
+ * @param run       Function to run. It gets a Thread as the argument.
+ * @param userData  User data for the Thread.
+ *
+ * @return Result of @a run.
+ */
+iThreadResult   offload_Fiber       (iThreadRunFunc run, void *userData);
+
+iEndPublic
@@ -29,15 +29,38 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 
 #include "thread.h"
 #include "objectlist.h"
+#include "array.h"
 
 iBeginPublic
 
 iDeclareClass(Future)
+iDeclareClass(CancelToken)
 
 iDeclareType(ThreadPool)
 
 typedef void (*iFutureResultAvailable)(iFuture *, iThread *);
 
+/**
+ * Continuation of a future. Called with the value of the completed future, which may be
+ * NULL. The returned object becomes the value of the future returned by then_Future();
+ * the continuation gives its reference to the future.
+ */
+typedef iAnyObject *(*iFutureThenFunc)(iAnyObject *value, void *context);
+
+typedef iAnyObject *(*iFutureAsyncFunc)(void *context);
+
+enum iFutureState {
+    pending_FutureState,
+    resolved_FutureState,
+    cancelled_FutureState,
+};
+
+/**
+ * A Future is a set of pending threads, and/or a single value that becomes available
+ * later. A Future is complete when all its threads have finished and its value has been
+ * resolved (or the future has been cancelled). Futures constructed with new_Future() have
+ * no value to wait for.
+ */
 struct Impl_Future {
     iObject object;
     iObjectList *threads;
@@ -45,12 +68,22 @@ struct Impl_Future {
     iCondition ready;
     iAtomicInt pendingCount;
     iFutureResultAvailable resultAvailable;
+    enum iFutureState state;
+    iAnyObject *value;
+    iArray callbacks; /* called when complete */
+    iCancelToken *cancelToken;
 };
 
 iDeclareObjectConstruction(Future)
 
+/**
+ * Constructs a future whose value is resolved later with resolve_Future().
+ */
+iFuture *   newPending_Future   (void);
+
 void        init_Future         (iFuture *);
 void        initHandler_Future  (iFuture *, iFutureResultAvailable resultAvailable);
+void        initPending_Future  (iFuture *);
 
 void        deinit_Future   (iFuture *);
 
@@ -75,6 +108,71 @@ iThread *   runPool_Future(iFuture *, iThread *thread, iThreadPool *pool);
 iBool       isReady_Future  (const iFuture *);
 void        wait_Future     (iFuture *);
 
+/**
+ * Sets the value of a pending future and schedules its continuations.
+ *
+ * @param value  Value object. The future holds a reference to it. May be NULL.
+ *
+ * @return iTrue if the value was set. iFalse if the future was already resolved or
+ * cancelled.
+ */
+iBool       resolve_Future  (iFuture *, iAnyObject *value);
+
+/**
+ * Cancels a pending future. Its continuations are not called and the futures returned
+ * by then_Future() are cancelled as well.
+ *
+ * @return iTrue if the future was cancelled.
+ */
+iBool       cancel_Future   (iFuture *);
+
+/**
+ * Cancels the future when the token is cancelled.
+ */
+void        setCancelToken_Future   (iFuture *, iCancelToken *token);
+
+iBool       isCancelled_Future      (const iFuture *);
+
+/**
+ * Returns the value of a resolved future. Returns NULL if the future is not resolved.
+ */
+iAnyObject *value_Future    (const iFuture *);
+
+/**
+ * Calls a function in a thread pool. No iThread is exposed to the caller; the returned
+ * future is resolved with the function's return value.
+ *
+ * @return New pending future. Caller gets a reference.
+ */
+iFuture *   async_Future    (iThreadPool *pool, iFutureAsyncFunc func, void *context);
+
+/**
+ * Adds a continuation that is called when the future is complete. Nothing blocks while
+ * waiting: the continuation is queued to `executor` by the thread that completes the
+ * future. If the future is already complete, the continuation is queued immediately.
+ *
+ * @param executor  Thread pool where the continuation is called. If NULL, it is called
+ *                  in the thread that completes the future.
+ *
+ * @return New pending future that is resolved with the continuation's return value, or
+ * cancelled if this future is cancelled. Inherits this future's cancel token. Caller gets
+ * a reference.
+ */
+iFuture *   then_Future     (iFuture *, iFutureThenFunc func, void *context,
+                             iThreadPool *executor);
+
+/**
+ * Returns a future that is resolved (with a NULL value) when all of the given futures
+ * have been resolved. It is cancelled if any of them is cancelled.
+ */
+iFuture *   whenAll_Future  (iFuture **futures, size_t count);
+
+/**
+ * Returns a future that is resolved with the value of the first of the given futures
+ * to be resolved. It is cancelled if all of them are cancelled.
+ */
+iFuture *   whenAny_Future  (iFuture **futures, size_t count);
+
 /**
  * Returns the next complete result. If nothing is ready, waits until a result is
  * available. Caller gets a reference to the returned thread.
@@ -87,4 +185,28 @@ iLocalDef const iObjectList *threads_Future(const iFuture *d) {
     return d->threads;
 }
 
+/*-------------------------------------------------------------------------------------*/
+
+/**
+ * Cancellation token shared by a number of futures and the functions computing their
+ * values. Cancelling the token cancels all futures it has been set to, and long-running
+ * functions should check isCancelled_CancelToken() periodically.
+ */
+iDeclareNotifyFunc(CancelToken, Cancelled)
+iDeclareAudienceGetter(CancelToken, cancelled)
+
+struct Impl_CancelToken {
+    iObject object;
+    iAtomicInt isCancelled;
+    iAudience *cancelled;
+};
+
+iDeclareObjectConstruction(CancelToken)
+
+void        cancel_CancelToken      (iCancelToken *);
+
+iLocalDef iBool isCancelled_CancelToken(const iCancelToken *d) {
+    return d && value_Atomic(&iConstCast(iCancelToken *, d)->isCancelled) != 0;
+}
+
 iEndPublic
@@ -35,11 +35,33 @@ iBeginPublic
 
 void        init_Garbage        (void);
 
-void        recycle_Garbage     (void);
-void        beginScope_Garbage  (void);
-void        endScope_Garbage    (void);
-
-iAny *      collect_Garbage     (iAny *ptr, iDeleteFunc del);
+void        recycle_Garbage         (void);
+void        beginScope_Garbage      (void);
+void        endScope_Garbage        (void);
+
+/**
+ * Begins a scope with a memory arena. Until the matching endScope_Garbage(), the
+ * collectNew constructors of types allocate their memory from a thread-specific arena
+ * using a bump pointer. The collected values are still deinitialized at the end of the
+ * scope, but their memory is released all at once. Reference-counted objects are never
+ * allocated from the arena. Only types declared with iDeclareTypeConstructionArena()
+ * (and Array and String) use the arena.
+ *
+ * recycle_Garbage() during the scope deinitializes the collected values, but the arena
+ * memory is kept until the scope ends.
+ */
+void        beginArenaScope_Garbage (void);
+
+/**
+ * Allocates memory from the arena of the current scope. The memory is valid until the
+ * arena scope ends.
+ *
+ * @return Pointer to uninitialized memory, or NULL if no arena scope has been begun
+ * in the calling thread.
+ */
+iAny *      allocArena_Garbage      (size_t size);
+
+iAny *      collect_Garbage         (iAny *ptr, iDeleteFunc del);
 
 #if !defined (__cplusplus)
 iLocalDef iAny *iCollectMem(iAny *ptr) { return collect_Garbage(ptr, free); }
@@ -47,9 +69,10 @@ iLocalDef iAny *iCollectMem(iAny *ptr) { return collect_Garbage(ptr, free); }
 
 #define iCollectDel(ptr, del)   collect_Garbage(ptr, (iDeleteFunc) (del))
 
-iLocalDef void      iBeginCollect (void) { beginScope_Garbage(); }
-iLocalDef void      iEndCollect   (void) { endScope_Garbage(); }
-iLocalDef void      iRecycle      (void) { recycle_Garbage(); }
+iLocalDef void      iBeginCollect       (void) { beginScope_Garbage(); }
+iLocalDef void      iBeginCollectArena  (void) { beginArenaScope_Garbage(); }
+iLocalDef void      iEndCollect         (void) { endScope_Garbage(); }
+iLocalDef void      iRecycle            (void) { recycle_Garbage(); }
 
 iEndPublic
 
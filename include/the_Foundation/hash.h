@@ -55,7 +55,7 @@ struct Impl_HashNode {
 
 typedef void iAnyNode;
 
-iDeclareTypeConstruction(Hash)
+iDeclareTypeConstructionArena(Hash)
 
 iBool       contains_Hash   (const iHash *, iHashKey key);
 iHashNode * value_Hash      (const iHash *, iHashKey key);
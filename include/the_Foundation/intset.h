@@ -36,7 +36,7 @@ typedef int (*iIntSetCompareFunc)(const int *, const int *);
 
 iDeclareType(Stream)
 
-iDeclareTypeConstruction(IntSet)
+iDeclareTypeConstructionArena(IntSet)
 iDeclareTypeSerialization(IntSet)
 
 iIntSet *   copy_IntSet     (const iIntSet *);
@@ -55,7 +55,7 @@ struct Impl_List {
     size_t size;
 };
 
-iDeclareTypeConstruction(List)
+iDeclareTypeConstructionArena(List)
 
 size_t      size_List   (const iList *);
 iAny *      front_List  (const iList *);
@@ -0,0 +1,102 @@
+#pragma once
+
+/** @file the_Foundation/metrics.h  Lock-free counters and latency histograms.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "defs.h"
+#include "atomic.h"
+#include <stdio.h>
+
+iBeginPublic
+
+/**
+ * Histogram of non-negative values (typically nanoseconds) with logarithmic buckets that
+ * are each subdivided linearly, in the manner of an HDR histogram. Values are recorded
+ * with relaxed atomic operations only, so any number of threads may record at the same
+ * time while another thread reads the histogram. Reported values are accurate to within
+ * 1/16 (about 6%) of the true value. Values above about 4.9 hours are clamped.
+ */
+iDeclareType(Histogram)
+iDeclareType(HistogramSummary)
+
+#define iHistogramSubBits   4
+#define iHistogramBuckets   (41 << iHistogramSubBits)
+
+struct Impl_Histogram {
+    iAtomicUInt64 count;
+    iAtomicUInt64 sum;
+    iAtomicUInt64 max;
+    iAtomicUInt64 buckets[iHistogramBuckets];
+};
+
+struct Impl_HistogramSummary {
+    uint64_t count;
+    uint64_t mean;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+};
+
+iDeclareTypeConstruction(Histogram)
+
+void        record_Histogram        (iHistogram *, uint64_t value);
+void        reset_Histogram         (iHistogram *);
+
+/**
+ * Returns the smallest value such that at least `percentile` percent of the recorded
+ * values are less than or equal to it.
+ */
+uint64_t    percentile_Histogram    (const iHistogram *, double percentile);
+void        summarize_Histogram     (const iHistogram *, iHistogramSummary *summary_out);
+
+iLocalDef uint64_t count_Histogram(const iHistogram *d) {
+    return valueRelaxed_Atomic(&d->count);
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+enum iMetricsFormat {
+    table_MetricsFormat,
+    json_MetricsFormat,
+};
+
+/**
+ * Writes a histogram summary as one table row or one JSON object. Times are in
+ * nanoseconds; tables show them in microseconds.
+ */
+void        print_HistogramSummary  (const iHistogramSummary *, const char *name, FILE *out,
+                                     enum iMetricsFormat format);
+void        printHeader_HistogramSummary    (FILE *out);
+
+/**
+ * Raises a counter to `value` if it is currently smaller.
+ */
+void        raise_MetricsCounter    (iAtomicUInt64 *counter, uint64_t value);
+
+iEndPublic
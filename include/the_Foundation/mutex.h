@@ -28,6 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
 #include "time.h"
+#include "atomic.h"
 #include "stdthreads.h"
 
 iBeginPublic
@@ -56,6 +57,33 @@ iBeginPublic
         deref_Object(d->value); \
     }
 
+/**
+ * Defines a lockable object type that is paired with a read-write lock. Use iGuardRead()
+ * for accessing the value without modifying it, and iGuardWrite() otherwise.
+ * @param typeName  Type of the value object.
+ */
+#define iDeclareRWLockableObject(typeName) \
+    iDeclareType(RWLockable##typeName) \
+    struct Impl_RWLockable##typeName { \
+        iRWLock *lock; \
+        i##typeName *value; \
+    }; \
+    iDeclareTypeConstruction(RWLockable##typeName)
+
+#define iDefineRWLockableObject(typeName) \
+    iDefineTypeConstruction(RWLockable##typeName) \
+    void init_RWLockable##typeName(iRWLockable##typeName *d) { \
+        d->lock = new_RWLock(); \
+        d->value = new_##typeName(); \
+    } \
+    void deinit_RWLockable##typeName(iRWLockable##typeName *d) { \
+        delete_RWLock(d->lock); \
+        deref_Object(d->value); \
+    }
+
+#define iGuardRead(d, stmt)     {lockRead_RWLock((d)->lock); stmt; unlockRead_RWLock((d)->lock);}
+#define iGuardWrite(d, stmt)    {lockWrite_RWLock((d)->lock); stmt; unlockWrite_RWLock((d)->lock);}
+
 #define iLock(d)                lock_Mutex((d)->mutex)
 #define iUnlock(d)              unlock_Mutex((d)->mutex)
 #define iGuard(d, stmt)         {iLock(d); stmt; iUnlock(d);}
@@ -66,6 +94,11 @@ iDeclareType(Mutex)
 
 struct Impl_Mutex {
     mtx_t mtx;
+#if defined (iHaveLockProfiler)
+    struct Impl_LockProfile *profile;
+    uint64_t lockedAt;
+    int      lockDepth;
+#endif
 };
 
 enum iMutexType {
@@ -81,30 +114,176 @@ iBool       lock_Mutex      (iMutex *);
 iBool       tryLock_Mutex   (iMutex *);
 void        unlock_Mutex    (iMutex *);
 
+#if defined (iHaveLockProfiler)
+/**
+ * Sets the name under which the mutex's lock statistics are recorded. Mutexes with the
+ * same name are counted together. Unnamed mutexes are counted under "(unnamed)".
+ * @param name  Name of the mutex. Must remain valid, e.g., a string literal.
+ */
+void        setName_Mutex   (iMutex *, const char *name);
+#else
+iLocalDef void setName_Mutex(iMutex *d, const char *name) { iUnused(d, name); }
+#endif
+
 /*-------------------------------------------------------------------------------------*/
 
 iDeclareType(Condition)
+iDeclareType(FiberWaiter)
 
 struct Impl_Condition {
     cnd_t cnd;
+    iAtomicInt fiberCount;   /* number of fibers waiting */
+    iFiberWaiter *fibers;    /* see fiber.h */
 };
 
 iDeclareTypeConstruction(Condition)
 
+/** @cond */
+void        signalFibers_Condition_ (iCondition *, iBool all); /* fiber.c */
+/** @endcond */
+
 iLocalDef void signal_Condition(iCondition *d) {
     cnd_signal(&d->cnd);
+    if (value_Atomic(&d->fiberCount)) {
+        signalFibers_Condition_(d, iFalse);
+    }
 }
 
 iLocalDef void signalAll_Condition(iCondition *d) {
     cnd_broadcast(&d->cnd);
+    if (value_Atomic(&d->fiberCount)) {
+        signalFibers_Condition_(d, iTrue);
+    }
 }
 
-iLocalDef void wait_Condition(iCondition *d, iMutex *mutex) {
-    cnd_wait(&d->cnd, &mutex->mtx);
-}
+/**
+ * Waits until the condition is signaled. The mutex is not held while waiting. When
+ * called in a Fiber, the fiber is suspended instead of blocking the thread.
+ */
+void        wait_Condition          (iCondition *, iMutex *mutex);
+int         waitTimeout_Condition   (iCondition *, iMutex *mutex, const iTime *timeout);
 
-iLocalDef int waitTimeout_Condition(iCondition *d, iMutex *mutex, const iTime *timeout) {
-    return cnd_timedwait(&d->cnd, &mutex->mtx, &timeout->ts);
-}
+/*-------------------------------------------------------------------------------------*/
+
+#if defined (iHaveLockProfiler)
+/*
+ * Lock contention profiling is enabled with the TFDN_ENABLE_LOCK_PROFILER build option.
+ * Otherwise, none of this is compiled and Mutex has no extra overhead.
+ */
+
+iDeclareType(LockProfileStats)
+
+struct Impl_LockProfileStats {
+    const char *name;
+    uint64_t    acquired;
+    uint64_t    contended;      /* lock was held by another thread */
+    uint64_t    waitNanos;      /* total time spent waiting for contended locks */
+    uint64_t    maxHoldNanos;   /* longest time the lock was held */
+};
+
+enum iLockProfileFormat {
+    table_LockProfileFormat,
+    json_LockProfileFormat,
+};
+
+iBool       stats_LockProfile   (const char *name, iLockProfileStats *stats_out);
+void        print_LockProfile   (FILE *out, enum iLockProfileFormat format);
+void        reset_LockProfile   (void);
+#endif
+
+/*-------------------------------------------------------------------------------------*/
+
+/*
+ * The following primitives are built on atomic state words. Blocked threads sleep on a
+ * futex on Linux; on other platforms they repeatedly yield until woken. None of them
+ * are recursive.
+ */
+
+/**
+ * Mutex that spins for a short while before sleeping. Suitable for short critical
+ * sections. Zero-initialized memory is an unlocked mutex.
+ */
+iDeclareType(SpinMutex)
+
+struct Impl_SpinMutex {
+    iAtomicInt state; /* 0: unlocked, 1: locked, 2: locked with sleepers */
+};
+
+iDeclareTypeConstruction(SpinMutex)
+
+void        lock_SpinMutex      (iSpinMutex *);
+iBool       tryLock_SpinMutex   (iSpinMutex *);
+void        unlock_SpinMutex    (iSpinMutex *);
+
+#define iGuardSpinMutex(d, stmt)    {lock_SpinMutex(iConstCast(iSpinMutex *, d)); stmt; \
+                                     unlock_SpinMutex(iConstCast(iSpinMutex *, d));}
+
+/*-------------------------------------------------------------------------------------*/
+
+iDeclareType(RWLock)
+
+enum iRWLockPreference {
+    readers_RWLockPreference, /* writers may starve while readers keep coming */
+    writers_RWLockPreference, /* new readers wait while a writer is waiting */
+};
+
+struct Impl_RWLock {
+    iAtomicInt state;          /* number of readers, or -1 if write-locked */
+    iAtomicInt waitingWriters;
+    iAtomicInt readersWake;    /* futex sequences */
+    iAtomicInt writersWake;
+    enum iRWLockPreference preference;
+};
+
+iDeclareTypeConstruction(RWLock)
+
+iRWLock *   newPreference_RWLock    (enum iRWLockPreference preference);
+void        initPreference_RWLock   (iRWLock *, enum iRWLockPreference preference);
+
+void        lockRead_RWLock     (iRWLock *);
+iBool       tryLockRead_RWLock  (iRWLock *);
+void        unlockRead_RWLock   (iRWLock *);
+void        lockWrite_RWLock    (iRWLock *);
+iBool       tryLockWrite_RWLock (iRWLock *);
+void        unlockWrite_RWLock  (iRWLock *);
+
+/*-------------------------------------------------------------------------------------*/
+
+iDeclareType(Semaphore)
+
+struct Impl_Semaphore {
+    iAtomicInt count;
+    iAtomicInt sleepers;
+};
+
+iDeclareTypeConstructionArgs(Semaphore, int count)
+
+void        acquire_Semaphore       (iSemaphore *);
+iBool       tryAcquire_Semaphore    (iSemaphore *);
+void        release_Semaphore       (iSemaphore *, int count);
+
+/*-------------------------------------------------------------------------------------*/
+
+/**
+ * Blocks threads until a fixed number of them have arrived. The barrier can be reused
+ * immediately after all threads have been released.
+ */
+iDeclareType(Barrier)
+
+struct Impl_Barrier {
+    int count;
+    iAtomicInt arrived;
+    iAtomicInt generation;
+};
+
+iDeclareTypeConstructionArgs(Barrier, int count)
+
+/**
+ * Waits until `count` threads have arrived at the barrier.
+ *
+ * @return iTrue for exactly one of the threads released at the same time (the last
+ * one to arrive).
+ */
+iBool       wait_Barrier    (iBarrier *);
 
 iEndPublic
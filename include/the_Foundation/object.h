@@ -32,7 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 
 #include "defs.h"
 #include "class.h"
-#include "atomic.h"
+#include "refcount.h"
 
 iBeginPublic
 
@@ -83,7 +83,8 @@ iDeclareType(AudienceMember)
 
 struct Impl_Object {
     const iClass *classObj;
-    iAtomicInt refCount;
+    iRefCount refCount;
+    uint32_t flags;
     iAudienceMember *memberOf;
     void *user; /* custom user contextual data */
     uint32_t __sig; /* validity checks in debug builds */
@@ -91,6 +92,10 @@ struct Impl_Object {
 
 typedef void iAnyObject;
 
+enum iObjectFlag {
+    pooled_ObjectFlag = 0x1, /* memory belongs to the class's ObjectPool */
+};
+
 /**
  * Constructs a new object.
  *
@@ -104,6 +109,20 @@ iAnyObject *    ref_Object      (const iAnyObject *);
 void            deref_Object    (const iAnyObject *);
 const iClass *  class_Object    (const iAnyObject *);
 
+/**
+ * Confines the object's reference counting to the calling thread. References added and
+ * removed in this thread will not use atomic operations. Other threads may still add and
+ * remove their own references. The caller must not be sharing the object with other
+ * threads at the time of the call.
+ *
+ * A reference added in the owner thread must not be released in another thread. Call
+ * unconfine_Object() before handing the object over. Releasing more references in other
+ * threads than they have added aborts the program.
+ */
+void            confine_Object      (iAnyObject *);
+void            unconfine_Object    (iAnyObject *);
+iBool           isConfined_Object   (const iAnyObject *);
+
 iLocalDef iBool isInstance_Object(const iAnyObject *d, const iAnyClass *pClass) {
     return class_Object(d) == pClass || isDerived_Class(class_Object(d), pClass);
 }
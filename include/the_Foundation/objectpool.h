@@ -0,0 +1,78 @@
+#pragma once
+
+/** @file the_Foundation/objectpool.h  Slab allocator for objects.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "class.h"
+#include <stdio.h>
+
+iBeginPublic
+
+/**
+ * Objects of classes with an enabled pool are allocated from slabs owned by the class
+ * instead of the general-purpose allocator. Each thread keeps a small magazine of free
+ * objects per class, so most allocations and deletions do not need any locking. An
+ * object may be deleted in any thread; its memory simply ends up in that thread's
+ * magazine. Memory held by a pool is never returned to the system.
+ */
+iDeclareType(ObjectPool)
+iDeclareType(ObjectPoolStats)
+
+struct Impl_ObjectPoolStats {
+    size_t objectSize;  /* bytes per pooled object */
+    size_t allocated;   /* total number of allocations */
+    size_t freed;       /* total number of deletions */
+    size_t live;        /* allocated but not yet freed */
+    size_t cached;      /* served from a thread's magazine without locking */
+    size_t slabs;
+    size_t reservedSize;
+};
+
+/**
+ * Enables pooled allocation for objects of a class. Objects allocated before the pool
+ * was enabled continue to be freed normally.
+ */
+void    enable_ObjectPool           (const iAnyClass *);
+
+/**
+ * Enables or disables pooled allocation for all classes. Pools are created when a class
+ * is first instantiated. Classes whose pool was already created are not affected.
+ */
+void    setEnabledForAll_ObjectPool (iBool enable);
+
+/**
+ * Returns allocation statistics of a class. The counts include operations that were
+ * completed via thread-local magazines only when those magazines were last refilled or
+ * flushed, so the figures lag behind by up to one magazine per thread.
+ *
+ * @return iFalse, if the class has no pool.
+ */
+iBool   stats_ObjectPool            (const iAnyClass *, iObjectPoolStats *stats_out);
+
+void    printStats_ObjectPool       (FILE *);
+
+iEndPublic
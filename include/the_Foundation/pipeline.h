@@ -0,0 +1,145 @@
+#pragma once
+
+/** @file the_Foundation/pipeline.h  Multi-stage processing with bounded queues.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "object.h"
+
+iBeginPublic
+
+/**
+ * Pipeline passes items through a sequence of stages that run in a thread pool. Each
+ * stage may process several items in parallel. Stages are connected by bounded queues:
+ * when a stage's input queue is full, the previous stage stops taking new items, and
+ * ultimately put_Pipeline() blocks until there is room. Pooled threads never block
+ * waiting for room, so a pipeline can share a pool with other work.
+ *
+ * Items are opaque pointers. A stage function takes ownership of its input item and
+ * returns the item for the next stage, or NULL to drop it. Items returned by the last
+ * stage are taken with take_Pipeline(); if the last stage always returns NULL, nothing
+ * needs to be taken.
+ *
+ * An ordered stage passes its results on in the order the items were originally put in
+ * the pipeline, even if earlier stages were unordered or items were processed in
+ * parallel. Dropped items do not hold up ordered stages.
+ */
+iDeclareClass(Pipeline)
+iDeclareType(PipelineStageStats)
+iDeclareType(ThreadPool)
+
+typedef void *(*iPipelineFunc)(void *context, void *item);
+
+enum iPipelineOrder {
+    unordered_PipelineOrder,
+    ordered_PipelineOrder,
+};
+
+struct Impl_PipelineStageStats {
+    uint64_t received;
+    uint64_t emitted;
+    uint64_t dropped;       /* stage function returned NULL */
+    uint64_t busyNanos;     /* total time spent in the stage function */
+    size_t   queued;        /* items waiting in the input queue */
+    size_t   maxQueued;
+    int      active;        /* items being processed */
+};
+
+/**
+ * Constructs a pipeline.
+ *
+ * @param pool  Thread pool where stages are run. The pipeline keeps a reference to it.
+ *              If NULL, the pipeline creates a pool of its own.
+ */
+iDeclareObjectConstructionArgs(Pipeline, iThreadPool *pool)
+
+/**
+ * Sets the capacity of each queue between stages, and of the output queue. The default
+ * is 64 items. Must be called before any stages are added.
+ *
+ * The capacity also limits how many results an ordered stage holds back while waiting for
+ * earlier items: no new items are accepted while that many are waiting or in progress.
+ */
+void        setCapacity_Pipeline    (iPipeline *, size_t capacity);
+
+/**
+ * Called for items that are discarded because the pipeline is cancelled or deleted
+ * before they reach the end.
+ */
+void        setDeleteFunc_Pipeline  (iPipeline *, iDeleteFunc del);
+
+/**
+ * Appends a stage. All stages must be added before the first item is put in.
+ *
+ * @param parallelism  Maximum number of items processed at the same time. Zero means
+ *                     the number of CPU cores.
+ *
+ * @return Index of the stage.
+ */
+size_t      addStage_Pipeline   (iPipeline *, iPipelineFunc func, void *context,
+                                 int parallelism, enum iPipelineOrder order);
+
+/**
+ * Puts an item in the first stage. Blocks while the first stage's queue is full.
+ *
+ * @return iFalse, if the pipeline has been closed and the item was not taken.
+ */
+iBool       put_Pipeline        (iPipeline *, void *item);
+iBool       tryPut_Pipeline     (iPipeline *, void *item);
+
+/**
+ * Marks the end of the stream. The pipeline finishes after all items put in so far
+ * have passed through every stage.
+ */
+void        close_Pipeline      (iPipeline *);
+
+/**
+ * Discards all queued items and closes the pipeline. Items already being processed
+ * are allowed to finish, but their results are discarded.
+ */
+void        cancel_Pipeline     (iPipeline *);
+
+/**
+ * Takes an item returned by the last stage, waiting until one is available.
+ *
+ * @return Item, or NULL if the pipeline has finished and there are no more items.
+ */
+void *      take_Pipeline       (iPipeline *);
+void *      takeTimeout_Pipeline(iPipeline *, double timeoutSeconds);
+
+/**
+ * Waits until the pipeline has been closed and all items have passed through it. If the
+ * last stage returns items, another thread must be taking them, or the pipeline cannot
+ * finish once the output queue is full.
+ */
+void        wait_Pipeline       (iPipeline *);
+iBool       isFinished_Pipeline (const iPipeline *);
+
+size_t      numStages_Pipeline  (const iPipeline *);
+iBool       stats_Pipeline      (const iPipeline *, size_t stage,
+                                 iPipelineStageStats *stats_out);
+
+iEndPublic
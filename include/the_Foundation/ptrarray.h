@@ -33,7 +33,7 @@ iBeginPublic
 
 typedef iArray iPtrArray;
 
-iDeclareTypeConstruction(PtrArray)
+iDeclareTypeConstructionArena(PtrArray)
 
 iPtrArray * newPointers_PtrArray    (void *ptr, ...); // NULL-terminated
 
@@ -34,7 +34,7 @@ iBeginPublic
 
 typedef iSortedArray iPtrSet;
 
-iDeclareTypeConstruction(PtrSet)
+iDeclareTypeConstructionArena(PtrSet)
 iDeclareType(Stream)
 
 iPtrSet *   copy_PtrSet     (const iPtrSet *);
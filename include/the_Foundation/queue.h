@@ -32,6 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
 #include "defs.h"
+#include "metrics.h"
 #include "mutex.h"
 #include "objectlist.h"
 #include "stdthreads.h"
@@ -46,6 +47,17 @@ struct Impl_Queue {
     iObjectList items;
     iMutex mutex;
     iCondition cond;
+    iAtomicPtr metrics; /* NULL unless enabled */
+};
+
+iDeclareType(QueueMetrics)
+
+struct Impl_QueueMetrics {
+    uint64_t put;
+    uint64_t taken;
+    size_t   depth;
+    size_t   maxDepth;
+    iHistogramSummary wait; /* nanoseconds from put to take */
 };
 
 typedef iAnyObject iQueueItem;
@@ -62,6 +74,22 @@ void        waitForItems_Queue  (iQueue *);
 
 size_t      size_Queue          (const iQueue *d);
 
+/**
+ * Starts collecting metrics about the queue: the number of items put and taken, the
+ * current and maximum depth, and a histogram of how long items wait in the queue.
+ * Metrics cannot be disabled afterwards. A queue without metrics only checks a pointer.
+ */
+void        enableMetrics_Queue (iQueue *);
+void        resetMetrics_Queue  (iQueue *);
+
+/**
+ * Returns a snapshot of the queue's metrics. Does not lock the queue.
+ *
+ * @return iFalse, if metrics have not been enabled.
+ */
+iBool       metrics_Queue       (const iQueue *, iQueueMetrics *metrics_out);
+void        printMetrics_Queue  (const iQueue *, FILE *out, enum iMetricsFormat format);
+
 iLocalDef iBool isEmpty_Queue(const iQueue *d) {
     return size_Queue(d) == 0;
 }
@@ -0,0 +1,96 @@
+#pragma once
+
+/** @file the_Foundation/refcount.h  Reference counter with a biased owner thread.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "defs.h"
+#include "atomic.h"
+
+iBeginPublic
+
+/**
+ * Reference counter that can be confined to an owner thread. References added and
+ * removed by the owner thread are counted without atomic read-modify-write operations.
+ * Other threads may still add and remove references, which are then counted in the
+ * shared counter using atomic operations. The counter stays biased towards the owner
+ * until the owner has released all of its references.
+ *
+ * A reference added by the owner thread must also be removed by the owner thread. To
+ * hand over references to other threads, call unconfine_RefCount() first. Removing more
+ * references in other threads than they have added aborts the program.
+ *
+ * Objects that are not confined use only the shared counter. Removing a reference has
+ * release semantics, and the final removal acquires all prior writes.
+ */
+iDeclareType(RefCount)
+
+struct Impl_RefCount {
+    iAtomicInt count;  /* shared references, plus iRefCountBiasedFlag while confined */
+    iAtomicInt biased; /* references of the owner thread; only modified by the owner */
+    iAtomicInt owner;  /* thread tag of the owner, or zero */
+};
+
+#define iRefCountBiasedFlag     0x40000000
+
+/**
+ * Returns a tag that identifies the calling thread. Zero, if thread-local storage is
+ * not available, in which case reference counters are never confined.
+ */
+int     threadTag_RefCount  (void);
+
+void    init_RefCount       (iRefCount *, int count);
+
+/**
+ * Confines the counter to the calling thread. No other thread may be using the counter
+ * at the same time, e.g., the caller has the only references.
+ */
+void    confine_RefCount    (iRefCount *);
+
+/**
+ * Moves the owner thread's references to the shared counter. Must be called in the
+ * owner thread.
+ */
+void    unconfine_RefCount  (iRefCount *);
+
+/**
+ * Returns the total number of references. Only exact when there are no concurrent
+ * modifications by other threads.
+ */
+int     value_RefCount      (const iRefCount *);
+
+void    add_RefCount        (iRefCount *);
+
+/**
+ * Removes a reference.
+ *
+ * @return iTrue, if the last reference was removed.
+ */
+iBool   remove_RefCount     (iRefCount *);
+
+iBool   isConfined_RefCount (const iRefCount *);
+
+iEndPublic
@@ -34,17 +34,48 @@ iBeginPublic
 
 iDeclareClass(Service)
 
+iDeclareType(EventLoop)
 iDeclareType(Socket)
 
 iDeclareObjectConstructionArgs(Service, uint16_t port)
 
 iDeclareNotifyFuncArgs(Service, IncomingAccepted, iSocket *incoming)
+iDeclareNotifyFuncArgs(Service, IncomingFd, int fd)
 
 iBool   open_Service    (iService *);
 void    close_Service   (iService *);
 
 iBool   isOpen_Service  (const iService *);
 
+#if !defined (iPlatformWindows)
+/**
+ * Sets the event loop where incoming connections are accepted. Must be called before
+ * the service is opened. The accepted sockets do their I/O in the same loop.
+ *
+ * By default, connections are accepted in the shared event loop, and each accepted
+ * socket has a thread of its own.
+ */
+void    setEventLoop_Service    (iService *, iEventLoop *loop);
+
+/**
+ * Creates a service that listens on a local (Unix domain) socket. A socket file left
+ * behind at @a path is replaced when the service is opened, and the file is removed when
+ * the service is closed.
+ *
+ * @param path  Filesystem path of the socket, or a name in the abstract namespace
+ *              beginning with '@' (Linux only).
+ */
+iService *newLocal_Service      (const char *path);
+
+/**
+ * While the `incomingFd` audience has observers, accepted connections are not made into
+ * Sockets. The observers get the connection's file descriptor instead, and are responsible
+ * for closing it. For example, the descriptor can be passed to a worker process with
+ * sendFd_Socket().
+ */
+iDeclareAudienceGetter(Service, incomingFd)
+#endif
+
 iDeclareAudienceGetter(Service, incomingAccepted)
 
 iEndPublic
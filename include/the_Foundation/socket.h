@@ -10,11 +10,15 @@ up and the pending data is sent. You may wish to use another Buffer to queue up
 send in larger chunks.
 
 Socket is derived from Stream, so all Stream methods can be used on it for writing and
-reading data. Both reading and writing is non-blocking. When writing, a copy of the data
-is made into an internal buffer for the I/O thread. When reading, only data already
-received and waiting in the input buffer will be returned. To wait for incoming data you
+reading data. Both reading and writing is non-blocking, unless water marks have been set
+for the output. When writing, a copy of the data is made into an internal buffer for the
+I/O thread; writeBlocks_Socket() queues blocks without copying. When reading, only data
+already received and waiting in the input buffer will be returned. To wait for incoming data you
 can join the `readyRead` audience.
 
+On POSIX platforms a Socket can also be connected to a local (Unix domain) socket, which
+can pass file descriptors to another process.
+
 @authors Copyright (c) 2017 Jaakko Keränen <jaakko.keranen@iki.fi>
 
 @par License
@@ -48,6 +52,7 @@ iBeginPublic
 typedef iStreamClass iSocketClass;
 
 iDeclareType(Socket)
+iDeclareType(EventLoop)
 iDeclareType(Mutex)
 
 iDeclareNotifyFunc    (Socket, Connected)
@@ -87,13 +92,117 @@ size_t              receivedBytes_Socket    (const iSocket *);
 size_t              bytesToSend_Socket      (const iSocket *);
 const iAddress *    address_Socket          (const iSocket *);
 
+size_t              writeData_Socket        (iSocket *, const void *data, size_t size);
+
+#if !defined (iPlatformWindows)
+/**
+ * Sets the event loop where the socket's I/O happens. By default, each connected socket
+ * has a thread of its own, and connections are formed in the shared event loop.
+ *
+ * With a loop, notifications are made in the loop's thread. flush_Socket() does not wait
+ * when called in the loop's thread. May be called before the socket is opened, or while
+ * it is connected.
+ *
+ * @param loop  Event loop. The socket keeps a reference to it. NULL to use a thread.
+ */
+void                setEventLoop_Socket     (iSocket *, iEventLoop *loop);
+
+/**
+ * Queues blocks to be sent without copying their contents. The socket keeps a
+ * reference to each block until it has been sent, and pending blocks are sent with a
+ * single gathering system call. Empty blocks are skipped.
+ *
+ * @return Number of bytes queued.
+ */
+size_t              writeBlocks_Socket      (iSocket *, const iBlock *const *blocks, size_t count);
+
+/**
+ * Sets the TCP_NODELAY option, i.e., whether small segments are sent immediately
+ * instead of being combined. Options set before connecting are applied when the
+ * connection is established.
+ */
+void                setNoDelay_Socket       (iSocket *, iBool noDelay);
+
+/**
+ * Corks the socket (TCP_CORK/TCP_NOPUSH) so only full segments are sent. Uncorking
+ * sends any partial segment immediately.
+ */
+void                setCork_Socket          (iSocket *, iBool cork);
+
+/**
+ * Limits the amount of queued output. When at least @a high bytes are waiting to be
+ * sent, writeData_Socket(), write_Socket(), writeBlocks_Socket(), and writes via the
+ * Stream interface block until the output has drained to @a low bytes. Writes made in the
+ * socket's own I/O thread or event loop never block.
+ *
+ * @param high  High water mark. Zero for no limit (the default).
+ * @param low   Low water mark. Must be less than @a high.
+ */
+void                setWaterMarks_Socket    (iSocket *, size_t high, size_t low);
+
+/**
+ * Sets how connections are formed when the host has several addresses. As in RFC 8305
+ * ("Happy Eyeballs"), the addresses are tried alternating between IPv6 and IPv4, and a new
+ * attempt is started every @a attemptDelaySeconds while the earlier ones are still
+ * pending. The first attempt to connect is used and the others are abandoned.
+ *
+ * @param attemptDelaySeconds  Delay between attempts (default: 0.25).
+ * @param timeoutSeconds       Time limit for connecting to any of the addresses
+ *                             (default: 6). Zero or negative for no limit.
+ */
+void                setConnectTimeouts_Socket(iSocket *, double attemptDelaySeconds,
+                                              double timeoutSeconds);
+
+/**
+ * Creates a stream socket for connecting to a local (Unix domain) socket.
+ *
+ * @param path  Filesystem path of the socket, or a name in the abstract namespace
+ *              beginning with '@' (Linux only).
+ */
+iSocket *           newLocal_Socket         (const char *path);
+
+/**
+ * Creates two sockets connected to each other within the process. Data is exchanged in
+ * memory without system calls. Blocks written with write_Socket() or writeBlocks_Socket()
+ * are passed to the other end as references without copying, and readAll_Socket() returns
+ * them as is when nothing else is waiting to be read.
+ *
+ * Both sockets are connected when created. The `readyRead`, `bytesWritten`,
+ * `writeFinished`, and `disconnected` audiences are notified in the shared event loop,
+ * or in the loop set with setEventLoop_Socket(). Data written before one end is closed
+ * can still be read by the other end. Water marks limit how much data may be waiting to
+ * be read by the other end.
+ *
+ * @param other_out  The other end is returned here. The caller gets a reference to both.
+ *
+ * @return One end of the pair.
+ */
+iSocket *           newPair_Socket          (iSocket **other_out);
+
+/**
+ * Passes a file descriptor to the process at the other end of a connected local socket
+ * (SCM_RIGHTS). The descriptor is sent along with @a data; if @a size is zero, a single
+ * zero byte is sent. Queued output is sent first. The descriptor remains open in this
+ * process, so the caller usually closes it afterwards.
+ *
+ * @return @c iTrue if the descriptor was sent.
+ */
+iBool               sendFd_Socket           (iSocket *, int fd, const void *data, size_t size);
+
+/**
+ * Takes the oldest descriptor received over a local socket. The descriptor arrives with
+ * data that is readable when `readyRead` is notified. The caller becomes responsible for
+ * closing the descriptor; a connected socket can be passed to newExisting_Socket() with
+ * a NULL address.
+ *
+ * @return Descriptor, or -1 if none have been received.
+ */
+int                 takeFd_Socket           (iSocket *);
+#endif
+
+size_t              write_Socket            (iSocket *, const iBlock *data);
+iBlock *            readAll_Socket          (iSocket *);
+
 iLocalDef void      flush_Socket        (iSocket *d) { flush_Stream((iStream *) d); }
-iLocalDef iBlock *  readAll_Socket      (iSocket *d) { return readAll_Stream((iStream *) d); }
-iLocalDef size_t    writeData_Socket    (iSocket *d, const void *data, size_t size) {
-    return writeData_Stream((iStream *) d, data, size);
-}
-iLocalDef size_t    write_Socket        (iSocket *d, const iBlock *data) {
-    return writeData_Socket(d, constData_Block(data), size_Block(data));
-}
 
 iEndPublic
@@ -88,6 +88,16 @@ void        clear_SortedArray   (iSortedArray *);
 iBool       insert_SortedArray  (iSortedArray *, const void *value); /* returns true if inserted/replaced */
 iBool       remove_SortedArray  (iSortedArray *, const void *value);
 
+/**
+ * Inserts many elements at once. The new values are sorted together and merged with the
+ * existing elements, which is much faster than inserting them one by one. As with
+ * insert_SortedArray(), new values replace equal existing ones, and of several equal new
+ * values the last one is kept.
+ *
+ * @param values  Array of `count` elements.
+ */
+void        insertN_SortedArray (iSortedArray *, const void *values, size_t count);
+
 /**
  * Inserts a new element, or replaces an existing one if the provided predicate is true.
  *
@@ -109,7 +109,7 @@ struct Impl_String {
 
 #define iStringLiteral(str)     (iString){ iBlockLiteral(str, strlen(str), strlen(str) + 1) }
 
-iDeclareTypeConstruction(String)
+iDeclareTypeConstructionArena(String)
 iDeclareTypeSerialization(String)
 
 iString *       newCStr_String      (const char *utf8CStr);
@@ -130,8 +130,8 @@ iLocalDef iString * newRange_String     (const iRangecc range) { return newCStrN
 iLocalDef iString * newLocal_String     (const iBlock *localChars) { return newLocalCStrN_String(cstr_Block(localChars), size_Block(localChars)); }
 
 iString *           collectNewFormat_String (const char *format, ...);
-iLocalDef iString * collectNewCStr_String   (const char *cstr) { return collect_String(newCStr_String(cstr)); }
-iLocalDef iString * collectNewRange_String  (const iRangecc range) { return collect_String(newRange_String(range)); }
+iString *           collectNewRange_String  (const iRangecc range);
+iLocalDef iString * collectNewCStr_String   (const char *cstr) { return collectNewRange_String((iRangecc){ cstr, cstr + strlen(cstr) }); }
 
 void            init_String             (iString *);
 void            initCStr_String         (iString *, const char *utf8CStr);
@@ -202,6 +202,10 @@ iLocalDef const iBlock *utf8_String(const iString *d) {
     return &d->chars; /* unmodified internal representation (UTF-8) */
 }
 
+iLocalDef void confine_String(iString *d) {
+    confine_Block(&d->chars); /* see confine_Block() */
+}
+
 iLocalDef iBool         isEmpty_String   (const iString *d) { return size_String(d) == 0; }
 iLocalDef const char *  constBegin_String(const iString *d) { return cstr_String(d); }
 iLocalDef const char *  constEnd_String  (const iString *d) { return cstr_String(d) + size_String(d); }
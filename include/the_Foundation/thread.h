@@ -104,6 +104,13 @@ void        terminate_Thread(iThread *);
 }
 
 void        sleep_Thread    (double seconds);
+
+/**
+ * Returns the Thread object of the calling thread. Threads not started with
+ * start_Thread() (e.g., the main thread) have no Thread object.
+ *
+ * @return Current thread, or NULL.
+ */
 iThread *   current_Thread  (void);
 iBool       isCurrent_Thread(const iThread *);
 
@@ -112,6 +119,34 @@ iBool       isCurrent_Thread(const iThread *);
  */
 int     idealConcurrentCount_Thread (void);
 
+/**
+ * Returns the CPU core the calling thread is currently running on, or -1 if this is
+ * not known.
+ */
+int     currentCpu_Thread   (void);
+
+/**
+ * Returns the NUMA node that a CPU core belongs to. Returns zero if the platform does
+ * not provide this information.
+ */
+int     numaNode_Thread     (int cpu);
+
+/**
+ * Determines whether the process may run on a CPU core. The process may be restricted
+ * to a subset of the cores, for example with `taskset` or a cgroup cpuset.
+ */
+iBool   isAllowedCpu_Thread (int cpu);
+
+/**
+ * Restricts a thread to run only on the given CPU core.
+ *
+ * @param d    Running thread. Use NULL for the calling thread.
+ * @param cpu  CPU core, or -1 to allow all the cores available to the process again.
+ *
+ * @return iTrue, if the affinity was changed.
+ */
+iBool   setAffinity_Thread  (iThread *d, int cpu);
+
 iLocalDef thrd_t id_Thread(const iThread *d) {
     return d->id;
 }
@@ -122,6 +157,25 @@ iLocalDef enum iThreadState state_Thread(const iThread *d) {
 
 iDefineInlineAudienceGetter(Thread, finished)
 
+/*-------------------------------------------------------------------------------------*/
+
+/**
+ * Storage slot with a separate value in each thread. When a thread exits, its value is
+ * deleted using the delete function given when the slot was created (unless NULL).
+ * Values of the main thread and values remaining when the slot is deleted are not
+ * deleted automatically.
+ */
+iDeclareType(ThreadStorage)
+
+struct Impl_ThreadStorage {
+    tss_t key;
+};
+
+iDeclareTypeConstructionArgs(ThreadStorage, iDeleteFunc del)
+
+void *  value_ThreadStorage     (const iThreadStorage *);
+void    setValue_ThreadStorage  (iThreadStorage *, void *value);
+
 /** @cond */
 iDeclareBlockHash(ThreadHash, ThreadId, Thread)
 iDeclareLockableObject(ThreadHash)
@@ -29,16 +29,61 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 
 #include "thread.h"
 #include "queue.h"
+#include "ptrarray.h"
 
 iBeginPublic
 
 iDeclareClass(ThreadPool)
 
+enum iThreadPoolPriority {
+    normal_ThreadPoolPriority,
+    high_ThreadPoolPriority, /* taken before any normal priority jobs */
+};
+
 struct Impl_ThreadPool {
-    iQueue queue;
+    iQueue queue;               /* normal priority jobs; its mutex guards all members */
+    iObjectList *highPriority;
     iObjectList *threads;
+    iObjectList *retired;       /* idle workers that have exited but not been joined */
+    int minThreads;
+    int maxThreads;             /* same as minThreads unless the pool is elastic */
+    int idleThreads;
+    uint64_t pendingSince;      /* when the front job was queued or became the front */
+    double growAfterSeconds;
+    double idleTimeoutSeconds;
+    iThread *monitor;
+    iCondition monitorCond;
+    iBool isStopping;
+    iBool isPinned;
+    int nextCpu;
+    iArray *cpuOrder;
+    iAtomicPtr metrics;         /* NULL unless enabled */
+};
+
+iDeclareType(ThreadPoolMetrics)
+iDeclareType(ThreadPoolWorkerMetrics)
+
+struct Impl_ThreadPoolWorkerMetrics {
+    uint64_t jobs;
+    uint64_t busyNanos;
+    uint64_t idleNanos;
 };
 
+struct Impl_ThreadPoolMetrics {
+    uint64_t submitted;
+    uint64_t submittedHigh;     /* included in `submitted` */
+    uint64_t completed;
+    size_t   depth;
+    size_t   maxDepth;
+    size_t   idleThreads;
+    iHistogramSummary wait;     /* nanoseconds from queued to started */
+    iHistogramSummary run;      /* nanoseconds from started to finished */
+    iHistogramSummary idle;     /* nanoseconds a pooled thread waited for a job */
+    iArray workers;             /* iThreadPoolWorkerMetrics of each pooled thread */
+};
+
+iDeclareTypeConstruction(ThreadPoolMetrics)
+
 iDeclareObjectConstruction(ThreadPool)
 
 /**
@@ -50,11 +95,66 @@ iDeclareObjectConstruction(ThreadPool)
  */
 iThreadPool *   newLimits_ThreadPool    (int minThreads, int reservedCores);
 
+/**
+ * Constructs a thread pool whose size varies with the load. A thread is added when
+ * queued jobs have been waiting longer than the grow threshold while all the threads
+ * are busy, and a thread exits after it has been idle for the idle timeout.
+ *
+ * @param minThreads  Number of threads that are always kept running (at least one).
+ * @param maxThreads  Maximum number of threads.
+ */
+iThreadPool *   newElastic_ThreadPool   (int minThreads, int maxThreads);
+
 void        init_ThreadPool         (iThreadPool *);
 void        initLimits_ThreadPool   (iThreadPool *, int minThreads, int reservedCores);
+void        initElastic_ThreadPool  (iThreadPool *, int minThreads, int maxThreads);
 void        deinit_ThreadPool       (iThreadPool *);
 
-iThread *   run_ThreadPool          (iThreadPool *, iThread *thread);
+void        setGrowThreshold_ThreadPool (iThreadPool *, double seconds);
+void        setIdleTimeout_ThreadPool   (iThreadPool *, double seconds);
+
+/**
+ * Pins each thread of the pool to a single CPU core. Cores are assigned in the order of
+ * their NUMA nodes, so consecutive threads share a node where possible. Threads added
+ * later are pinned as well. Has no effect on platforms that do not support affinity.
+ */
+void        setPinned_ThreadPool    (iThreadPool *, iBool pinned);
+
+/**
+ * Starts collecting metrics about the pool: job counts, queue depth, histograms of
+ * queue wait, run, and idle times, and the busy and idle time of each pooled thread.
+ * Metrics cannot be disabled afterwards. A pool without metrics only checks a pointer
+ * when jobs are queued and run.
+ */
+void        enableMetrics_ThreadPool    (iThreadPool *);
+void        resetMetrics_ThreadPool     (iThreadPool *);
+
+/**
+ * Returns a snapshot of the pool's metrics. The counters and histograms are read without
+ * locking; the pool is locked briefly to list its threads.
+ *
+ * @return iFalse, if metrics have not been enabled.
+ */
+iBool       metrics_ThreadPool          (const iThreadPool *, iThreadPoolMetrics *metrics_out);
+void        printMetrics_ThreadPool     (const iThreadPool *, FILE *out,
+                                         enum iMetricsFormat format);
+
+size_t      size_ThreadPool         (const iThreadPool *);
+iBool       isElastic_ThreadPool    (const iThreadPool *);
+
+/**
+ * Queues a thread to be run in the pool. High priority jobs are taken before any normal
+ * priority jobs, so latency-sensitive work does not have to wait behind bulk work.
+ * Jobs of the same priority are run in the order they were queued.
+ *
+ * @return The thread, for convenience.
+ */
+iThread *   runPriority_ThreadPool  (iThreadPool *, iThread *thread,
+                                     enum iThreadPoolPriority priority);
+
+iLocalDef iThread *run_ThreadPool(iThreadPool *d, iThread *thread) {
+    return runPriority_ThreadPool(d, thread, normal_ThreadPoolPriority);
+}
 
 /**
  * Use the calling thread to run another queud thread. Returns immediately after a queued thread
@@ -68,4 +168,41 @@ iThread *   run_ThreadPool          (iThreadPool *, iThread *thread);
  */
 iBool       yield_ThreadPool        (iThreadPool *, double timeoutSeconds);
 
+/*-------------------------------------------------------------------------------------*/
+
+typedef void (*iParallelForFunc)(void *context, iRanges range);
+typedef void (*iParallelReduceFunc)(void *context, iRanges range, void *accum);
+typedef void (*iParallelCombineFunc)(void *context, void *accum, const void *other);
+typedef void (*iParallelElementFunc)(void *context, void *element, size_t index);
+
+/**
+ * Calls `func` for subranges of `range` in parallel. The calling thread participates and
+ * pooled threads help if they are available, so this can be called from a pooled thread
+ * without risking a deadlock. Returns after the entire range has been processed.
+ *
+ * Subranges start large and get smaller toward the end of the range, to balance the
+ * load between threads. If the range is not larger than the grain size, or `pool` is
+ * NULL, everything is processed in the calling thread.
+ *
+ * @param grain  Minimum number of indices in a subrange. Use zero to choose automatically.
+ */
+void        parallelFor_ThreadPool      (iThreadPool *, iRanges range, size_t grain,
+                                         iParallelForFunc func, void *context);
+
+/**
+ * Reduces `range` in parallel. Each participating thread starts with a copy of the
+ * initial contents of `result` (the identity value) and accumulates subranges into it with
+ * `func`. The accumulators are then merged into `result` with `combine`, which is called
+ * one thread at a time in an unspecified order.
+ */
+void        parallelReduce_ThreadPool   (iThreadPool *, iRanges range, size_t grain,
+                                         void *result, size_t resultSize,
+                                         iParallelReduceFunc func, iParallelCombineFunc combine,
+                                         void *context);
+
+void        parallelForArray_ThreadPool     (iThreadPool *, iArray *array, size_t grain,
+                                             iParallelElementFunc func, void *context);
+void        parallelForPtrArray_ThreadPool  (iThreadPool *, iPtrArray *array, size_t grain,
+                                             iParallelElementFunc func, void *context);
+
 iEndPublic
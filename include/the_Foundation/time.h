@@ -71,6 +71,13 @@ void    initSeconds_Time    (iTime *, double seconds);
 void    initTimeout_Time    (iTime *, double seconds);
 
 iTime       now_Time        (void);
+
+/**
+ * Returns the current value of a monotonic clock in nanoseconds. The value is unrelated
+ * to calendar time, but it does not jump when the system clock is adjusted.
+ */
+uint64_t    monotonicNanoseconds_Time   (void);
+
 double      seconds_Time    (const iTime *);
 iString *   format_Time     (const iTime *, const char *format);
 
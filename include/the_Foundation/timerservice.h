@@ -0,0 +1,112 @@
+#pragma once
+
+/** @file the_Foundation/timerservice.h  Delayed and periodic calls.
+
+A TimerService makes calls after a delay, optionally repeating them at a fixed interval.
+Timers are kept in a hierarchical timing wheel with a resolution of one millisecond, so
+adding and cancelling a timer takes constant time regardless of how many timers there
+are. This makes it cheap to have a timeout for each of thousands of connections, most of
+which are cancelled before they expire.
+
+The service has a thread of its own that sleeps until the next timer is due. Time is
+measured with a monotonic clock, so changes to the system clock do not affect timers.
+Expired timers are called in the service's thread, in a thread pool, or via a Dispatch.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "object.h"
+
+iBeginPublic
+
+iDeclareClass(TimerService)
+iDeclareType(Dispatch)
+iDeclareType(ThreadPool)
+
+typedef void (*iTimerFunc)(iAny *context);
+
+/** Identifies a timer. Zero is never used as an ID. */
+typedef uint32_t iTimerId;
+
+/**
+ * Constructs a timer service that makes calls in its own thread. The calls should
+ * return quickly, as they delay the timers that expire after them.
+ */
+iDeclareObjectConstruction(TimerService)
+
+/**
+ * Constructs a timer service that makes calls in a thread pool.
+ *
+ * @param pool  Thread pool. The service keeps a reference to it.
+ */
+iTimerService * newPool_TimerService        (iThreadPool *pool);
+
+/**
+ * Constructs a timer service that posts calls to a Dispatch, to be made in the thread
+ * that processes the dispatch.
+ *
+ * @param dispatch  Dispatch. The service keeps a reference to it.
+ */
+iTimerService * newDispatch_TimerService    (iDispatch *dispatch);
+
+void    init_TimerService           (iTimerService *);
+void    initPool_TimerService       (iTimerService *, iThreadPool *pool);
+void    initDispatch_TimerService   (iTimerService *, iDispatch *dispatch);
+void    deinit_TimerService         (iTimerService *);
+
+/**
+ * Starts a timer.
+ *
+ * @param delaySeconds     Time until the first call.
+ * @param intervalSeconds  Time between subsequent calls. Zero for a single call.
+ * @param func             Function to call.
+ * @param context          Argument for @a func.
+ *
+ * @return ID of the timer.
+ */
+iTimerId    addPeriodic_TimerService    (iTimerService *, double delaySeconds,
+                                         double intervalSeconds, iTimerFunc func,
+                                         iAny *context);
+
+/**
+ * Cancels a timer. A call that has already been scheduled (for example, posted to a
+ * thread pool) will still be made.
+ *
+ * @return iTrue if the timer was pending and is now cancelled, iFalse if it had already
+ * expired or been cancelled.
+ */
+iBool       cancel_TimerService         (iTimerService *, iTimerId id);
+
+size_t      size_TimerService           (const iTimerService *);
+
+iLocalDef iTimerId add_TimerService(iTimerService *d, double delaySeconds, iTimerFunc func,
+                                    iAny *context) {
+    return addPeriodic_TimerService(d, delaySeconds, 0.0, func, context);
+}
+iLocalDef iBool isEmpty_TimerService(const iTimerService *d) {
+    return size_TimerService(d) == 0;
+}
+
+iEndPublic
@@ -108,6 +108,11 @@ iBlock *            privateKeyFingerprint_TlsCertificate(const iTlsCertificate *
 
 /*----------------------------------------------------------------------------------------------*/
 
+/* TlsRequest does not use threads of its own. All requests are processed in one event
+   loop thread (on Windows, in the I/O thread of each request's socket), where the
+   `readyRead`, `sent`, and `finished` audiences are also notified. Observers should
+   therefore return quickly. */
+
 iDeclareClass(TlsRequest)
 iDeclareObjectConstruction(TlsRequest)
 
@@ -150,4 +155,28 @@ void        setCiphers_TlsRequest       (const char *cipherList);
 void        setVerifyFunc_TlsRequest    (iTlsRequestVerifyFunc verifyFunc);
 const char *libraryName_TlsRequest      (void); /* "OpenSSL" or "LibreSSL", for example */
 
+/**
+ * Sets limits for the cache of sessions that can be resumed, which makes handshakes with
+ * recently visited servers faster. A session is kept until the lifetime given by the
+ * server ends, but at most @a maxAgeSeconds. When the cache is full, the least recently
+ * used sessions are removed. The default is 128 sessions for at most one day. Zero
+ * @a maxSessions disables the cache.
+ */
+void        setSessionCacheLimits_TlsRequest(size_t maxSessions, double maxAgeSeconds);
+void        clearSessionCache_TlsRequest    (void);
+
+/**
+ * Saves the cached sessions to a file so they can be resumed after the application has
+ * been restarted. The file contains secrets of the sessions, so on POSIX platforms it is
+ * created readable only by the owner. An existing file is replaced and its permissions
+ * are restricted the same way.
+ */
+iBool       saveSessionCache_TlsRequest     (const iString *path);
+
+/**
+ * Loads sessions saved with saveSessionCache_TlsRequest(). Expired sessions are skipped,
+ * and sessions already in the cache are kept.
+ */
+iBool       loadSessionCache_TlsRequest     (const iString *path);
+
 iEndPublic
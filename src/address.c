@@ -26,11 +26,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
 #include "the_Foundation/address.h"
+#include "the_Foundation/atomic.h"
+#include "the_Foundation/file.h"
 #include "the_Foundation/mutex.h"
 #include "the_Foundation/string.h"
+#include "the_Foundation/stringhash.h"
 #include "the_Foundation/objectlist.h"
-#include "the_Foundation/queue.h"
-#include "the_Foundation/thread.h"
+#include "the_Foundation/threadpool.h"
+#include "the_Foundation/time.h"
+
+#include <ctype.h>
 
 #if defined (iPlatformWindows)
 #  define WIN32_LEAN_AND_MEAN
@@ -42,6 +47,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 #else
 #  include <sys/types.h>
 #  include <sys/socket.h>
+#  include <sys/un.h>
 #  include <netdb.h>
 #  include <arpa/inet.h>
 #  include <netinet/in.h>
@@ -60,8 +66,7 @@ struct Impl_Address {
     int socktype;
     int flags;
     int count;
-    struct addrinfo *info;
-    iBool infoWasAllocatedWithMalloc;
+    struct addrinfo *info; /* allocated with malloc */
     iAudience *lookupFinished;
     iCondition *lookupDidFinish;
 };
@@ -78,78 +83,445 @@ iDefineAudienceGetter(Address, lookupFinished)
 #   define AI_V4MAPPED_CFG  AI_V4MAPPED
 #endif
 
-static iThread *lookupThread_;
-static iQueue * lookupQueue_;
+static struct addrinfo *copyInfo_(const struct addrinfo *src) {
+    struct addrinfo *first = NULL;
+    struct addrinfo **next = &first;
+    for (; src; src = src->ai_next) {
+        struct addrinfo *info = malloc(sizeof(struct addrinfo));
+        *info = *src;
+        info->ai_canonname = NULL;
+        info->ai_next = NULL;
+        info->ai_addr = malloc(src->ai_addrlen);
+        memcpy(info->ai_addr, src->ai_addr, src->ai_addrlen);
+        *next = info;
+        next = &info->ai_next;
+    }
+    return first;
+}
+
+static void freeInfo_(struct addrinfo *info) {
+    while (info) {
+        struct addrinfo *next = info->ai_next;
+        free(info->ai_addr);
+        free(info);
+        info = next;
+    }
+}
 
-static iThreadResult runAddressLookup_(iThread *thd) {
-    iUnused(thd);
-    iDebug("[Address] lookup thread started\n");
-    while (lookupThread_) {
-        waitForItems_Queue(lookupQueue_);
-        iAddress *d = tryTake_Queue(lookupQueue_);
-        if (!lookupThread_ || !d) {
-            break;
+static void finishLookup_Address_(iAddress *d, struct addrinfo *info, int rc);
+
+/*----------------------------------------------------------------------------------------------*/
+
+/* Address lookups are done asynchronously in a pool of resolver threads because they may
+   involve blocking for unknown periods of time. Results are cached, and concurrent lookups
+   of the same name are made only once. */
+
+iDeclareType(Resolver)
+iDeclareClass(CachedLookup)
+iDeclareClass(ResolveJob)
+
+static const int    defaultMaxThreads_Resolver_  = 4;
+static const double defaultPositiveTtl_Resolver_ = 60.0; /* seconds */
+static const double defaultNegativeTtl_Resolver_ = 5.0;
+static const size_t defaultMaxEntries_Resolver_  = 256;
+
+struct Impl_CachedLookup {
+    iObject          object;
+    iString          key;
+    int              rc; /* getaddrinfo() result; nonzero if the host was not found */
+    struct addrinfo *info;
+    iTime            timestamp;
+    iAtomicUInt64    lastUsed;
+};
+
+static void init_CachedLookup(iCachedLookup *d, const iString *key, const struct addrinfo *info,
+                              int rc) {
+    initCopy_String(&d->key, key);
+    d->rc = rc;
+    d->info = copyInfo_(info);
+    initCurrent_Time(&d->timestamp);
+    init_Atomic(&d->lastUsed, 0);
+}
+
+static void deinit_CachedLookup(iCachedLookup *d) {
+    freeInfo_(d->info);
+    deinit_String(&d->key);
+}
+
+iDefineClass(CachedLookup)
+iDefineObjectConstructionArgs(CachedLookup,
+                              (const iString *key, const struct addrinfo *info, int rc),
+                              key, info, rc)
+
+struct Impl_Resolver {
+    iRWLock       lock;       /* guards the members below */
+    iStringHash * cache;      /* CachedLookup objects; key is "socktype:service:host" */
+    iStringHash * pending;    /* ResolveJob objects that are queued or running */
+    iThreadPool * pool;
+    int           maxThreads;
+    double        positiveTtl;
+    double        negativeTtl;
+    size_t        maxEntries;
+    iString       hostsFile;  /* looked up instead of using the system resolver */
+    iAtomicUInt64 useCounter; /* for finding the least recently used entries */
+    iAtomicUInt64 hits;
+    iAtomicUInt64 misses;
+    iAtomicUInt64 joined;
+};
+
+struct Impl_ResolveJob {
+    iThread      thread;
+    iResolver *  resolver;
+    iString      key;
+    iString      hostName;
+    iString      service;
+    int          socktype;
+    iObjectList *waiting; /* Addresses; guarded by the resolver's lock */
+};
+
+static iAtomicPtr resolver_;
+
+static iResolver *resolver_Address_(void) {
+    iResolver *d = value_Atomic(&resolver_);
+    if (!d) {
+        void *expected = NULL;
+        d = iMalloc(Resolver);
+        init_RWLock(&d->lock);
+        d->cache       = new_StringHash();
+        d->pending     = new_StringHash();
+        d->pool        = NULL;
+        d->maxThreads  = defaultMaxThreads_Resolver_;
+        d->positiveTtl = defaultPositiveTtl_Resolver_;
+        d->negativeTtl = defaultNegativeTtl_Resolver_;
+        d->maxEntries  = defaultMaxEntries_Resolver_;
+        init_String(&d->hostsFile);
+        init_Atomic(&d->useCounter, 0);
+        init_Atomic(&d->hits, 0);
+        init_Atomic(&d->misses, 0);
+        init_Atomic(&d->joined, 0);
+        if (!compareExchange_Atomic(&resolver_, &expected, d)) {
+            iRelease(d->pending);
+            iRelease(d->cache);
+            deinit_String(&d->hostsFile);
+            deinit_RWLock(&d->lock);
+            free(d);
+            d = expected;
+        }
+    }
+    return d;
+}
+
+void deinit_Address_(void) { /* called from deinit_Foundation */
+    iResolver *d = exchange_Atomic(&resolver_, NULL);
+    if (d) {
+        /* Queued lookups are finished before the pool is gone. */
+        iRelease(d->pool);
+        iRelease(d->pending);
+        iRelease(d->cache);
+        deinit_String(&d->hostsFile);
+        deinit_RWLock(&d->lock);
+        free(d);
+    }
+}
+
+static iBool isExpired_CachedLookup_(const iCachedLookup *d, const iResolver *resolver) {
+    return elapsedSeconds_Time(&d->timestamp) >
+           (d->rc == 0 ? resolver->positiveTtl : resolver->negativeTtl);
+}
+
+static void touch_CachedLookup_(iCachedLookup *d, iResolver *resolver) {
+    set_Atomic(&d->lastUsed, add_Atomic(&resolver->useCounter, 1) + 1);
+}
+
+static void insertCache_Resolver_(iResolver *d, const iString *key, const struct addrinfo *info,
+                                  int rc) {
+    /* Note: Locked for writing. */
+    if ((rc == 0 ? d->positiveTtl : d->negativeTtl) <= 0.0 || d->maxEntries == 0) {
+        return;
+    }
+    remove_StringHash(d->cache, key);
+    /* Make room by removing expired entries and then the least recently used ones. */
+    iForEach(StringHash, i, d->cache) {
+        if (isExpired_CachedLookup_(i.value->object, d)) {
+            remove_StringHashIterator(&i);
         }
-        /* Perform the lookup. */
-        /* TODO: hostName/service accessed without locking... */
-        const int hintFlags = AI_V4MAPPED_CFG | AI_ADDRCONFIG | (isEmpty_String(&d->hostName) ? AI_PASSIVE : 0);
-        const struct addrinfo hints = {
-            .ai_socktype = d->socktype,
-            .ai_family   = (d->socktype == SOCK_DGRAM ? AF_INET     : AF_UNSPEC /* v4 or v6 */),
-            .ai_protocol = (d->socktype == SOCK_DGRAM ? IPPROTO_UDP : IPPROTO_TCP),
-            .ai_flags    = hintFlags,
-        };
-        int rc = getaddrinfo(!isEmpty_String(&d->hostName) ? cstr_String(&d->hostName) : NULL,
-                             !isEmpty_String(&d->service)  ? cstr_String(&d->service)  : NULL,
-                             &hints,
-                             &d->info);
-        iGuardMutex(d->mutex,
-            d->count = 0;
-            if (rc == 0) {
-                for (const struct addrinfo *at = d->info; at; at = at->ai_next, d->count++) {}
+    }
+    while (size_StringHash(d->cache) >= d->maxEntries) {
+        const iString *oldest = NULL;
+        uint64_t oldestUse = UINT64_MAX;
+        iConstForEach(StringHash, i, d->cache) {
+            const iCachedLookup *entry = i.value->object;
+            const uint64_t used = value_Atomic(&iConstCast(iCachedLookup *, entry)->lastUsed);
+            if (used < oldestUse) {
+                oldest    = &entry->key;
+                oldestUse = used;
             }
-            else {
-                iWarning("[Address] host lookup failed with error: %s\n", gai_strerror(rc));
+        }
+        iString *removed = copy_String(oldest);
+        remove_StringHash(d->cache, removed);
+        delete_String(removed);
+    }
+    iCachedLookup *entry = new_CachedLookup(key, info, rc);
+    touch_CachedLookup_(entry, d);
+    insert_StringHash(d->cache, key, entry);
+    iRelease(entry);
+}
+
+static int lookupHostsFile_Resolver_(const iString *path, const char *hostName,
+                                     const char *service, const struct addrinfo *hints,
+                                     struct addrinfo **info_out) {
+    /* Hosts file format: an address followed by one or more names on each line. */
+    *info_out = NULL;
+    iFile *file = new_File(path);
+    if (!open_File(file, readOnly_FileMode | text_FileMode)) {
+        iWarning("[Address] hosts file \"%s\" not found\n", cstr_String(path));
+        iRelease(file);
+        return EAI_NONAME;
+    }
+    iString *content = readString_File(file);
+    iRelease(file);
+    struct addrinfo **next = info_out;
+    iRangecc line = iNullRange;
+    while (nextSplit_Rangecc(range_String(content), "\n", &line)) {
+        const char *end = line.start;
+        while (end != line.end && *end != '#') end++;
+        iRangecc addr = iNullRange;
+        for (const char *pos = line.start; pos != end; ) {
+            while (pos != end && isspace((int) *pos)) pos++;
+            const char *start = pos;
+            while (pos != end && !isspace((int) *pos)) pos++;
+            const iRangecc token = { start, pos };
+            if (isEmpty_Range(&token)) {
+                break;
             }
-            d->flags |= finished_AddressFlag;
-        );
-        iNotifyAudience(d, lookupFinished, AddressLookupFinished);
-        signalAll_Condition(d->lookupDidFinish);
-        iRelease(d); /* ref was added by Queue */
+            if (!addr.start) {
+                addr = token;
+            }
+            else if (equalCase_Rangecc(token, hostName)) {
+                iString *numeric = newRange_String(addr);
+                struct addrinfo numericHints = *hints;
+                numericHints.ai_flags |= AI_NUMERICHOST;
+                struct addrinfo *found = NULL;
+                if (getaddrinfo(cstr_String(numeric), service, &numericHints, &found) == 0) {
+                    *next = copyInfo_(found);
+                    while (*next) next = &(*next)->ai_next;
+                    freeaddrinfo(found);
+                }
+                delete_String(numeric);
+                break;
+            }
+        }
     }
-    iDebug("[Address] lookup thread exited\n");
-    return 0;
+    delete_String(content);
+    return *info_out ? 0 : EAI_NONAME;
 }
 
-static void startLookupThread_Address_(void) {
-    /* Address lookup is done asynchronously because it may involve blocking for unknown
-       periods of time. */
-    if (!lookupThread_) {
-        lookupQueue_  = new_Queue();
-        lookupThread_ = new_Thread(runAddressLookup_);
-        setName_Thread(lookupThread_, "runAddressLookup_");
-        start_Thread(lookupThread_);
+static iThreadResult run_ResolveJob_(iThread *thread) {
+    iResolveJob *d = (iAny *) thread;
+    iResolver *res = d->resolver;
+    const char *hostName = !isEmpty_String(&d->hostName) ? cstr_String(&d->hostName) : NULL;
+    const char *service  = !isEmpty_String(&d->service)  ? cstr_String(&d->service)  : NULL;
+    const int hintFlags = AI_V4MAPPED_CFG | AI_ADDRCONFIG | (!hostName ? AI_PASSIVE : 0);
+    struct addrinfo hints = {
+        .ai_socktype = d->socktype,
+        .ai_family   = (d->socktype == SOCK_DGRAM ? AF_INET     : AF_UNSPEC /* v4 or v6 */),
+        .ai_protocol = (d->socktype == SOCK_DGRAM ? IPPROTO_UDP : IPPROTO_TCP),
+        .ai_flags    = hintFlags,
+    };
+    iString *hostsFile;
+    lockRead_RWLock(&res->lock);
+    hostsFile = copy_String(&res->hostsFile);
+    unlockRead_RWLock(&res->lock);
+    struct addrinfo *found = NULL;
+    struct addrinfo *info  = NULL;
+    int rc;
+    if (hostName && !isEmpty_String(hostsFile)) {
+        /* Numeric addresses are used as is, and other names are looked up in the file. */
+        hints.ai_flags |= AI_NUMERICHOST;
+        rc = getaddrinfo(hostName, service, &hints, &found);
+        if (rc == EAI_NONAME) {
+            hints.ai_flags &= ~AI_NUMERICHOST;
+            rc = lookupHostsFile_Resolver_(hostsFile, hostName, service, &hints, &info);
+        }
     }
+    else {
+        rc = getaddrinfo(hostName, service, &hints, &found);
+    }
+    delete_String(hostsFile);
+    if (found) {
+        info = copyInfo_(found);
+        freeaddrinfo(found);
+    }
+    /* Later lookups of the name will use the cached result. */
+    iObjectList *waiting;
+    lockWrite_RWLock(&res->lock);
+    insertCache_Resolver_(res, &d->key, info, rc);
+    if (value_StringHash(res->pending, &d->key) == d) {
+        remove_StringHash(res->pending, &d->key);
+    }
+    waiting = d->waiting;
+    d->waiting = NULL;
+    unlockWrite_RWLock(&res->lock);
+    iForEach(ObjectList, i, waiting) {
+        finishLookup_Address_(i.object, copyInfo_(info), rc);
+    }
+    iRelease(waiting);
+    freeInfo_(info);
+    return 0;
 }
 
-void deinit_Address_(void) {
-    if (lookupThread_) {
-        iThread *thd = lookupThread_;
-        lookupThread_ = NULL;
-        signal_Condition(&lookupQueue_->cond);
-        join_Thread(thd);
-        iRelease(thd);
-        iReleasePtr(&lookupQueue_);
+static void init_ResolveJob(iResolveJob *d, iResolver *resolver, const iString *key,
+                            const iAddress *address) {
+    init_Thread(&d->thread, run_ResolveJob_);
+    setName_Thread(&d->thread, "ResolveJob");
+    d->resolver = resolver;
+    initCopy_String(&d->key, key);
+    initCopy_String(&d->hostName, &address->hostName);
+    initCopy_String(&d->service, &address->service);
+    d->socktype = address->socktype;
+    d->waiting = new_ObjectList();
+}
+
+static void deinit_ResolveJob(iResolveJob *d) {
+    iRelease(d->waiting);
+    deinit_String(&d->service);
+    deinit_String(&d->hostName);
+    deinit_String(&d->key);
+}
+
+iDefineSubclass(ResolveJob, Thread)
+iDefineObjectConstructionArgs(ResolveJob,
+                              (iResolver *resolver, const iString *key, const iAddress *address),
+                              resolver, key, address)
+
+static void lookup_Resolver_(iResolver *d, iAddress *address) {
+    iString *key = new_String();
+    format_String(key, "%d:%s:%s", address->socktype, cstr_String(&address->service),
+                  cstr_String(&address->hostName));
+    /* A cached result is used immediately. */
+    struct addrinfo *info = NULL;
+    int rc = 0;
+    iBool isCached = iFalse;
+    lockRead_RWLock(&d->lock);
+    iCachedLookup *entry = value_StringHash(d->cache, key);
+    if (entry && equal_String(&entry->key, key) && !isExpired_CachedLookup_(entry, d)) {
+        touch_CachedLookup_(entry, d);
+        info = copyInfo_(entry->info);
+        rc = entry->rc;
+        isCached = iTrue;
+    }
+    unlockRead_RWLock(&d->lock);
+    if (isCached) {
+        add_Atomic(&d->hits, 1);
+        finishLookup_Address_(address, info, rc);
+        delete_String(key);
+        return;
     }
+    /* Join an identical lookup that is already in progress, or start a new one. */
+    iResolveJob *job = NULL;
+    lockWrite_RWLock(&d->lock);
+    iResolveJob *pending = value_StringHash(d->pending, key);
+    if (pending && equal_String(&pending->key, key)) {
+        pushBack_ObjectList(pending->waiting, address);
+        add_Atomic(&d->joined, 1);
+    }
+    else {
+        job = new_ResolveJob(d, key, address);
+        pushBack_ObjectList(job->waiting, address);
+        if (!pending) {
+            insert_StringHash(d->pending, key, job);
+        }
+        if (!d->pool) {
+            d->pool = newElastic_ThreadPool(1, d->maxThreads);
+            setGrowThreshold_ThreadPool(d->pool, 0.01);
+        }
+        run_ThreadPool(d->pool, &job->thread);
+        add_Atomic(&d->misses, 1);
+    }
+    unlockWrite_RWLock(&d->lock);
+    iRelease(job);
+    delete_String(key);
+}
+
+void setResolverThreads_Address(int maxThreads) {
+    iResolver *d = resolver_Address_();
+    iThreadPool *old;
+    lockWrite_RWLock(&d->lock);
+    d->maxThreads = iMaxi(1, maxThreads);
+    old = d->pool;
+    d->pool = NULL; /* a new pool is created when needed */
+    unlockWrite_RWLock(&d->lock);
+    iRelease(old); /* lookups already queued are finished first */
+}
+
+void setCacheLimits_Address(double positiveTtlSeconds, double negativeTtlSeconds,
+                            size_t maxEntries) {
+    iResolver *d = resolver_Address_();
+    lockWrite_RWLock(&d->lock);
+    d->positiveTtl = positiveTtlSeconds;
+    d->negativeTtl = negativeTtlSeconds;
+    d->maxEntries  = maxEntries;
+    clear_StringHash(d->cache);
+    unlockWrite_RWLock(&d->lock);
 }
 
+void clearCache_Address(void) {
+    iResolver *d = resolver_Address_();
+    lockWrite_RWLock(&d->lock);
+    clear_StringHash(d->cache);
+    unlockWrite_RWLock(&d->lock);
+}
+
+void setHostsFile_Address(const char *path) {
+    iResolver *d = resolver_Address_();
+    lockWrite_RWLock(&d->lock);
+    setCStr_String(&d->hostsFile, path ? path : "");
+    clear_StringHash(d->cache);
+    unlockWrite_RWLock(&d->lock);
+}
+
+void cacheStats_Address(iAddressCacheStats *stats_out) {
+    iResolver *d = resolver_Address_();
+    lockRead_RWLock(&d->lock);
+    stats_out->entries = size_StringHash(d->cache);
+    unlockRead_RWLock(&d->lock);
+    stats_out->hits    = value_Atomic(&d->hits);
+    stats_out->misses  = value_Atomic(&d->misses);
+    stats_out->joined  = value_Atomic(&d->joined);
+}
+
+/*----------------------------------------------------------------------------------------------*/
+
 iLocalDef socklen_t sockAddrSize_addrinfo_(const struct addrinfo *d) {
     if (d->ai_family == AF_INET) {
         return sizeof(struct sockaddr_in);
     }
+#if !defined (iPlatformWindows)
+    if (d->ai_family == AF_UNIX) {
+        return d->ai_addrlen;
+    }
+#endif
     return sizeof(struct sockaddr_in6);
 }
 
+#if !defined (iPlatformWindows)
+static void setLocalPath_(iString *path, const struct sockaddr_un *addr, size_t addrSize) {
+    /* Abstract names begin with a zero byte; they are shown with a '@' prefix. */
+    const size_t pathOffset = offsetof(struct sockaddr_un, sun_path);
+    clear_String(path);
+    if (addrSize > pathOffset) {
+        const char *start = addr->sun_path;
+        size_t len = addrSize - pathOffset;
+        if (*start == 0) {
+            appendCStr_String(path, "@");
+            start++;
+            len--;
+        }
+        appendCStrN_String(path, start, strnlen(start, len));
+    }
+}
+#endif
+
 iDefineObjectConstruction(Address)
 
 iAddress *newBroadcast_Address(uint16_t port) {
@@ -167,21 +539,68 @@ iAddress *newSockAddr_Address(const void *     sockAddr,
     d->count = 1;
     d->info = calloc(1, sizeof(struct addrinfo));
     d->info->ai_addrlen = (socklen_t) sockAddrSize;
-    d->info->ai_addr = malloc(sockAddrSize);
+    /* Room for any kind of address, so it can be read without knowing the size. */
+    d->info->ai_addr = calloc(1, iMax(sockAddrSize, sizeof(struct sockaddr_storage)));
     d->info->ai_socktype = d->socktype;
     d->info->ai_family = (sockAddrSize == sizeof(struct sockaddr_in6) ? AF_INET6 : AF_INET);
     memcpy(d->info->ai_addr, sockAddr, sockAddrSize);
-    d->infoWasAllocatedWithMalloc = iTrue;
+#if !defined (iPlatformWindows)
+    if (sockAddrSize >= sizeof(sa_family_t) &&
+        ((const struct sockaddr *) sockAddr)->sa_family == AF_UNIX) {
+        d->info->ai_family = AF_UNIX;
+        setLocalPath_(&d->hostName, sockAddr, sockAddrSize);
+    }
+#endif
+    return d;
+}
+
+#if !defined (iPlatformWindows)
+iAddress *newLocal_Address(const char *path, enum iSocketType socketType) {
+    iAddress *d = iNew(Address);
+    init_Address(d);
+    d->socktype = (socketType == udp_SocketType ? SOCK_DGRAM : SOCK_STREAM);
+    setCStr_String(&d->hostName, path);
+    struct sockaddr_un addr;
+    iZap(addr);
+    addr.sun_family = AF_UNIX;
+    const iBool isAbstract = (path[0] == '@');
+    const size_t len = strlen(path);
+    if (len >= sizeof(addr.sun_path)) {
+        iWarning("[Address] local socket path is too long: %s\n", path);
+        d->count = 0; /* not found */
+        return d;
+    }
+    if (isAbstract) {
+        memcpy(addr.sun_path + 1, path + 1, len - 1); /* sun_path[0] remains zero */
+    }
+    else {
+        memcpy(addr.sun_path, path, len);
+    }
+    d->count = 1;
+    d->info = calloc(1, sizeof(struct addrinfo));
+    d->info->ai_family   = AF_UNIX;
+    d->info->ai_socktype = d->socktype;
+    d->info->ai_addrlen  = (socklen_t) (offsetof(struct sockaddr_un, sun_path) + len +
+                                        (isAbstract ? 0 : 1));
+    d->info->ai_addr     = malloc(sizeof(addr));
+    memcpy(d->info->ai_addr, &addr, sizeof(addr));
     return d;
 }
 
+iBool isLocal_Address(const iAddress *d) {
+    iBool isLocal;
+    iGuardMutex(d->mutex, isLocal = (d->info && d->info->ai_family == AF_UNIX));
+    return isLocal;
+}
+#endif
+
 void init_Address(iAddress *d) {
     d->mutex = new_Mutex();
+    setName_Mutex(d->mutex, "Address");
     init_String(&d->hostName);
     init_String(&d->service);
     d->socktype = SOCK_STREAM;
     d->info = NULL;
-    d->infoWasAllocatedWithMalloc = iFalse;
     d->count = -1;
     d->flags = finished_AddressFlag;
     d->lookupFinished = NULL;
@@ -189,21 +608,29 @@ void init_Address(iAddress *d) {
 }
 
 static void freeInfo_Address_(iAddress *d) {
-    if (d->info) {
-        if (d->infoWasAllocatedWithMalloc) {
-            free(d->info->ai_addr);
-            free(d->info);
+    freeInfo_(d->info);
+    d->info = NULL;
+}
+
+static void finishLookup_Address_(iAddress *d, struct addrinfo *info, int rc) {
+    iGuardMutex(d->mutex, {
+        freeInfo_Address_(d);
+        d->info  = info;
+        d->count = 0;
+        if (rc == 0) {
+            for (const struct addrinfo *at = d->info; at; at = at->ai_next, d->count++) {}
         }
         else {
-            freeaddrinfo(d->info);
+            iWarning("[Address] host lookup failed with error: %s\n", gai_strerror(rc));
         }
-        d->info = NULL;
-    }
-    d->infoWasAllocatedWithMalloc = iFalse;
+        d->flags |= finished_AddressFlag;
+    });
+    iNotifyAudience(d, lookupFinished, AddressLookupFinished);
+    signalAll_Condition(d->lookupDidFinish);
 }
 
 void deinit_Address(iAddress *d) {
-    /* Note: This is never called when lookup is pending because `lookupQueue_` holds a ref. */
+    /* Note: This is never called when lookup is pending because the resolver holds a ref. */
     lock_Mutex(d->mutex);
     delete_Condition(d->lookupDidFinish);
     freeInfo_Address_(d);
@@ -324,8 +751,7 @@ void lookupCStr_Address(iAddress *d, const char *hostName, uint16_t port, enum i
     else {
         clear_String(&d->service);
     }
-    startLookupThread_Address_();
-    put_Queue(lookupQueue_, d);
+    lookup_Resolver_(resolver_Address_(), d);
 }
 
 void waitForFinished_Address(const iAddress *d) {
@@ -363,6 +789,12 @@ iString *toString_SockAddr(const struct sockaddr *addr) {
     char hbuf[NI_MAXHOST];
     char sbuf[NI_MAXSERV];
     iString *str = new_String();
+#if !defined (iPlatformWindows)
+    if (addr->sa_family == AF_UNIX) {
+        setLocalPath_(str, (const struct sockaddr_un *) addr, sizeof(struct sockaddr_un));
+        return str;
+    }
+#endif
     if (!getnameinfo(addr,
                      addr->sa_family == AF_INET6 ? sizeof(struct sockaddr_in6)
                                                  : sizeof(struct sockaddr),
@@ -389,6 +821,12 @@ iString *toStringFlags_Address(const iAddress *d, int flags, int family) {
     waitForFinished_Address(d);
     iString *str = new_String();
     if (!d) return str;
+#if !defined (iPlatformWindows)
+    if ((family == AF_UNSPEC || family == AF_UNIX) && isLocal_Address(d)) {
+        set_String(str, &d->hostName); /* the path */
+        return str;
+    }
+#endif
     iGuardMutex(d->mutex, {
         for (const struct addrinfo *i = d->info; i; i = i->ai_next) {
             if (family == AF_UNSPEC || i->ai_family == family) {
@@ -330,6 +330,9 @@ static iBool readDirectory_Archive_(iArchive *d) {
     iBool ok = iTrue;
     iString path;
     init_String(&path);
+    iArray entries;
+    init_Array(&entries, sizeof(iArchiveEntry));
+    reserve_Array(&entries, entryCount);
     for (size_t index = 0; index < entryCount; index++) {
         iCentralFileHeader header;
         read_CentralFileHeader_(&header, is);
@@ -383,9 +386,12 @@ static iBool readDirectory_Archive_(iArchive *d) {
                     pos_Stream(is) + localHeader.fileNameSize + localHeader.extraFieldSize;
             }
             seek_Stream(is, oldPos);
-            insert_SortedArray(d->entries, &entry);
+            pushBack_Array(&entries, &entry);
         }
     }
+    /* Sort all entries at once. */
+    insertN_SortedArray(d->entries, constData_Array(&entries), size_Array(&entries));
+    deinit_Array(&entries);
     deinit_String(&path);
     return ok;
 }
@@ -26,6 +26,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
 #include "the_Foundation/array.h"
+#include "the_Foundation/threadpool.h"
 
 #include <stdlib.h>
 
@@ -79,7 +80,12 @@ static void rebalance_Array_(iArray *d) {
 iDefineTypeConstructionArgs(Array, (size_t elemSize), elemSize)
 
 iArray *collectNew_Array(size_t elementSize) {
-    return collect_Array(new_Array(elementSize));
+    iArray *d = allocArena_Garbage(sizeof(iArray));
+    if (!d) {
+        return collect_Array(new_Array(elementSize));
+    }
+    init_Array(d, elementSize);
+    return iCollectDel(d, deinit_Array);
 }
 
 iArray *copy_Array(const iArray *other) {
@@ -351,6 +357,667 @@ void sort_Array(iArray *d, int (*cmp)(const void *, const void *)) {
 
 /*-------------------------------------------------------------------------------------*/
 
+iLocalDef void copyElement_(void *dst, const void *src, size_t size) {
+    /* Constant-size copies are inlined. */
+    switch (size) {
+        case 4:  memcpy(dst, src, 4); break;
+        case 8:  memcpy(dst, src, 8); break;
+        case 16: memcpy(dst, src, 16); break;
+        default: memcpy(dst, src, size); break;
+    }
+}
+
+static uint64_t radixKey_(const char *element, enum iSortKeyType keyType) {
+    /* Keys are converted to unsigned integers that have the same order. */
+    switch (keyType) {
+        case int32_SortKeyType: {
+            uint32_t k; memcpy(&k, element, 4);
+            return k ^ 0x80000000u;
+        }
+        case uint32_SortKeyType: {
+            uint32_t k; memcpy(&k, element, 4);
+            return k;
+        }
+        case int64_SortKeyType: {
+            uint64_t k; memcpy(&k, element, 8);
+            return k ^ 0x8000000000000000ull;
+        }
+        case uint64_SortKeyType: {
+            uint64_t k; memcpy(&k, element, 8);
+            return k;
+        }
+        case float_SortKeyType: {
+            uint32_t k; memcpy(&k, element, 4);
+            if ((k & 0x7fffffffu) > 0x7f800000u) {
+                k &= 0x7fffffffu; /* all NaNs go last, whatever their sign */
+            }
+            return k & 0x80000000u ? ~k : (k | 0x80000000u);
+        }
+        case double_SortKeyType: {
+            uint64_t k; memcpy(&k, element, 8);
+            if ((k & 0x7fffffffffffffffull) > 0x7ff0000000000000ull) {
+                k &= 0x7fffffffffffffffull;
+            }
+            return k & 0x8000000000000000ull ? ~k : (k | 0x8000000000000000ull);
+        }
+    }
+    return 0;
+}
+
+void sortKey_Array(iArray *d, size_t keyOffset, enum iSortKeyType keyType) {
+    const size_t count = size_Array(d);
+    if (count < 2) {
+        return;
+    }
+    const size_t size     = d->elementSize;
+    const size_t keyBytes = (keyType == int64_SortKeyType || keyType == uint64_SortKeyType ||
+                             keyType == double_SortKeyType ? 8 : 4);
+    iAssert(keyOffset + keyBytes <= size);
+    /* Histograms of all digits are counted in a single pass. */
+    size_t (*counts)[256] = calloc(keyBytes, sizeof(*counts));
+    char *src = front_Array(d);
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t key = radixKey_(src + i * size + keyOffset, keyType);
+        for (size_t b = 0; b < keyBytes; b++) {
+            counts[b][(key >> (8 * b)) & 0xff]++;
+        }
+    }
+    char *buf = malloc(count * size);
+    char *dst = buf;
+    for (size_t b = 0; b < keyBytes; b++) {
+        size_t *digitCounts = counts[b];
+        if (digitCounts[(radixKey_(src + keyOffset, keyType) >> (8 * b)) & 0xff] == count) {
+            continue; /* all elements have the same digit */
+        }
+        size_t offset = 0;
+        for (int i = 0; i < 256; i++) {
+            const size_t n = digitCounts[i];
+            digitCounts[i] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; i++) {
+            const char *elem = src + i * size;
+            const unsigned digit = (radixKey_(elem + keyOffset, keyType) >> (8 * b)) & 0xff;
+            copyElement_(dst + digitCounts[digit]++ * size, elem, size);
+        }
+        iSwap(char *, src, dst);
+    }
+    if (src != front_Array(d)) {
+        memcpy(front_Array(d), src, count * size);
+    }
+    free(buf);
+    free(counts);
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+/* Pattern-defeating quicksort (Orson Peters) with BlockQuicksort-style branchless
+   partitioning (Edelkamp & Weiss), specialized for comparing elements with memcmp. */
+
+#define iPdqInsertionSortThreshold  24
+#define iPdqNintherThreshold        128
+#define iPdqPartialInsertionLimit   8
+#define iPdqBlockSize               64
+
+iDeclareType(BytesSort)
+
+struct Impl_BytesSort {
+    size_t size;
+    char *pivot; /* temporary element storage */
+    char *temp;
+};
+
+iLocalDef iBool less_BytesSort_(const iBytesSort *d, const char *a, const char *b) {
+    /* Fixed sizes are compared as big-endian integers without calling memcmp. */
+    switch (d->size) {
+        case 4: {
+            uint32_t x, y; memcpy(&x, a, 4); memcpy(&y, b, 4);
+#if !defined (iHaveBigEndian)
+            x = __builtin_bswap32(x); y = __builtin_bswap32(y);
+#endif
+            return x < y;
+        }
+        case 8: {
+            uint64_t x, y; memcpy(&x, a, 8); memcpy(&y, b, 8);
+#if !defined (iHaveBigEndian)
+            x = __builtin_bswap64(x); y = __builtin_bswap64(y);
+#endif
+            return x < y;
+        }
+    }
+    return memcmp(a, b, d->size) < 0;
+}
+
+#define elem_BytesSort_(d, base, i)   ((base) + (size_t) (i) * (d)->size)
+
+iLocalDef void copy_BytesSort_(const iBytesSort *d, char *dst, const char *src) {
+    copyElement_(dst, src, d->size);
+}
+
+iLocalDef void swap_BytesSort_(const iBytesSort *d, char *a, char *b) {
+    copyElement_(d->temp, a, d->size);
+    copyElement_(a, b, d->size);
+    copyElement_(b, d->temp, d->size);
+}
+
+static void insertionSort_BytesSort_(const iBytesSort *d, char *begin, char *end) {
+    const size_t size = d->size;
+    for (char *cur = begin + size; cur < end; cur += size) {
+        if (less_BytesSort_(d, cur, cur - size)) {
+            char *sift = cur;
+            copy_BytesSort_(d, d->temp, cur);
+            do {
+                copy_BytesSort_(d, sift, sift - size);
+                sift -= size;
+            } while (sift != begin && less_BytesSort_(d, d->temp, sift - size));
+            copy_BytesSort_(d, sift, d->temp);
+        }
+    }
+}
+
+static iBool partialInsertionSort_BytesSort_(const iBytesSort *d, char *begin, char *end) {
+    /* Gives up if too many elements need to be moved. */
+    const size_t size  = d->size;
+    size_t       limit = 0;
+    for (char *cur = begin + size; cur < end; cur += size) {
+        if (less_BytesSort_(d, cur, cur - size)) {
+            char *sift = cur;
+            copy_BytesSort_(d, d->temp, cur);
+            do {
+                copy_BytesSort_(d, sift, sift - size);
+                sift -= size;
+            } while (sift != begin && less_BytesSort_(d, d->temp, sift - size));
+            copy_BytesSort_(d, sift, d->temp);
+            limit += (size_t) (cur - sift) / size;
+        }
+        if (limit > iPdqPartialInsertionLimit) {
+            return iFalse;
+        }
+    }
+    return iTrue;
+}
+
+static void siftDown_BytesSort_(const iBytesSort *d, char *base, size_t root, size_t count) {
+    for (;;) {
+        size_t child = 2 * root + 1;
+        if (child >= count) {
+            break;
+        }
+        if (child + 1 < count && less_BytesSort_(d, elem_BytesSort_(d, base, child),
+                                                 elem_BytesSort_(d, base, child + 1))) {
+            child++;
+        }
+        if (!less_BytesSort_(d, elem_BytesSort_(d, base, root), elem_BytesSort_(d, base, child))) {
+            break;
+        }
+        swap_BytesSort_(d, elem_BytesSort_(d, base, root), elem_BytesSort_(d, base, child));
+        root = child;
+    }
+}
+
+static void heapSort_BytesSort_(const iBytesSort *d, char *begin, char *end) {
+    const size_t count = (size_t) (end - begin) / d->size;
+    for (size_t i = count / 2; i-- > 0; ) {
+        siftDown_BytesSort_(d, begin, i, count);
+    }
+    for (size_t n = count; n > 1; n--) {
+        swap_BytesSort_(d, begin, elem_BytesSort_(d, begin, n - 1));
+        siftDown_BytesSort_(d, begin, 0, n - 1);
+    }
+}
+
+iLocalDef void sort2_BytesSort_(const iBytesSort *d, char *a, char *b) {
+    if (less_BytesSort_(d, b, a)) {
+        swap_BytesSort_(d, a, b);
+    }
+}
+
+static void sort3_BytesSort_(const iBytesSort *d, char *a, char *b, char *c) {
+    sort2_BytesSort_(d, a, b);
+    sort2_BytesSort_(d, b, c);
+    sort2_BytesSort_(d, a, b);
+}
+
+static void swapOffsets_BytesSort_(const iBytesSort *d, char *first, char *last,
+                                   const uint8_t *offsetsLeft, const uint8_t *offsetsRight,
+                                   size_t num, iBool useSwaps) {
+    const size_t size = d->size;
+    if (useSwaps) {
+        /* Needed when the numbers of elements on both sides are equal; a cyclic
+           permutation would be incorrect. */
+        for (size_t i = 0; i < num; i++) {
+            swap_BytesSort_(d, first + offsetsLeft[i] * size, last - offsetsRight[i] * size);
+        }
+    }
+    else if (num > 0) {
+        char *l = first + offsetsLeft[0] * size;
+        char *r = last - offsetsRight[0] * size;
+        copy_BytesSort_(d, d->temp, l);
+        copy_BytesSort_(d, l, r);
+        for (size_t i = 1; i < num; i++) {
+            l = first + offsetsLeft[i] * size;
+            copy_BytesSort_(d, r, l);
+            r = last - offsetsRight[i] * size;
+            copy_BytesSort_(d, l, r);
+        }
+        copy_BytesSort_(d, r, d->temp);
+    }
+}
+
+static char *partitionRight_BytesSort_(const iBytesSort *d, char *begin, char *end,
+                                       iBool *alreadyPartitioned) {
+    /* Elements less than the pivot (at `begin`) go to the left. Returns the final
+       position of the pivot. */
+    const size_t size = d->size;
+    char *pivot = d->pivot;
+    copy_BytesSort_(d, pivot, begin);
+    char *first = begin;
+    char *last  = end;
+    /* The median-of-three guarantees there is an element >= pivot at the end. */
+    while (less_BytesSort_(d, first += size, pivot)) {}
+    if (first - size == begin) {
+        while (first < last && !less_BytesSort_(d, last -= size, pivot)) {}
+    }
+    else {
+        while (!less_BytesSort_(d, last -= size, pivot)) {}
+    }
+    *alreadyPartitioned = first >= last;
+    if (!*alreadyPartitioned) {
+        swap_BytesSort_(d, first, last);
+        first += size;
+        /* Branchless block partitioning: offsets of misplaced elements are collected
+           in blocks, and then swapped in bulk. */
+        uint8_t offsetsLeftBuf[iPdqBlockSize], offsetsRightBuf[iPdqBlockSize];
+        uint8_t *offsetsLeft = offsetsLeftBuf, *offsetsRight = offsetsRightBuf;
+        size_t numLeft = 0, numRight = 0, startLeft = 0, startRight = 0;
+        const size_t blockBytes = iPdqBlockSize * size;
+        while (last - first > (ptrdiff_t) (2 * blockBytes)) {
+            if (numLeft == 0) {
+                startLeft = 0;
+                const char *it = first;
+                for (uint8_t i = 0; i < iPdqBlockSize; it += size) {
+                    offsetsLeft[numLeft] = i++;
+                    numLeft += !less_BytesSort_(d, it, pivot);
+                }
+            }
+            if (numRight == 0) {
+                startRight = 0;
+                const char *it = last;
+                for (uint8_t i = 0; i < iPdqBlockSize; ) {
+                    offsetsRight[numRight] = ++i;
+                    numRight += less_BytesSort_(d, it -= size, pivot);
+                }
+            }
+            const size_t num = iMin(numLeft, numRight);
+            swapOffsets_BytesSort_(d, first, last, offsetsLeft + startLeft,
+                                   offsetsRight + startRight, num, numLeft == numRight);
+            numLeft -= num; numRight -= num;
+            startLeft += num; startRight += num;
+            if (numLeft == 0) first += blockBytes;
+            if (numRight == 0) last -= blockBytes;
+        }
+        /* The remaining elements. */
+        size_t sizeLeft = 0, sizeRight = 0;
+        const size_t unknownLeft =
+            (size_t) (last - first) / size - ((numRight || numLeft) ? iPdqBlockSize : 0);
+        if (numRight) {
+            sizeLeft  = unknownLeft;
+            sizeRight = iPdqBlockSize;
+        }
+        else if (numLeft) {
+            sizeLeft  = iPdqBlockSize;
+            sizeRight = unknownLeft;
+        }
+        else {
+            sizeLeft  = unknownLeft / 2;
+            sizeRight = unknownLeft - sizeLeft;
+        }
+        if (unknownLeft && !numLeft) {
+            startLeft = 0;
+            const char *it = first;
+            for (uint8_t i = 0; i < sizeLeft; it += size) {
+                offsetsLeft[numLeft] = i++;
+                numLeft += !less_BytesSort_(d, it, pivot);
+            }
+        }
+        if (unknownLeft && !numRight) {
+            startRight = 0;
+            const char *it = last;
+            for (uint8_t i = 0; i < sizeRight; ) {
+                offsetsRight[numRight] = ++i;
+                numRight += less_BytesSort_(d, it -= size, pivot);
+            }
+        }
+        const size_t num = iMin(numLeft, numRight);
+        swapOffsets_BytesSort_(d, first, last, offsetsLeft + startLeft,
+                               offsetsRight + startRight, num, numLeft == numRight);
+        numLeft -= num; numRight -= num;
+        startLeft += num; startRight += num;
+        if (numLeft == 0) first += sizeLeft * size;
+        if (numRight == 0) last -= sizeRight * size;
+        /* One side may still have misplaced elements left over. */
+        if (numLeft) {
+            offsetsLeft += startLeft;
+            while (numLeft--) {
+                swap_BytesSort_(d, first + offsetsLeft[numLeft] * size, last -= size);
+            }
+            first = last;
+        }
+        if (numRight) {
+            offsetsRight += startRight;
+            while (numRight--) {
+                swap_BytesSort_(d, last - offsetsRight[numRight] * size, first);
+                first += size;
+            }
+            last = first;
+        }
+    }
+    char *pivotPos = first - size;
+    copy_BytesSort_(d, begin, pivotPos);
+    copy_BytesSort_(d, pivotPos, pivot);
+    return pivotPos;
+}
+
+static char *partitionLeft_BytesSort_(const iBytesSort *d, char *begin, char *end) {
+    /* Elements equal to the pivot go to the left. Used when there are many equal
+       elements. */
+    const size_t size = d->size;
+    char *pivot = d->pivot;
+    copy_BytesSort_(d, pivot, begin);
+    char *first = begin;
+    char *last  = end;
+    while (less_BytesSort_(d, pivot, last -= size)) {}
+    if (last + size == end) {
+        while (first < last && !less_BytesSort_(d, pivot, first += size)) {}
+    }
+    else {
+        while (!less_BytesSort_(d, pivot, first += size)) {}
+    }
+    while (first < last) {
+        swap_BytesSort_(d, first, last);
+        while (less_BytesSort_(d, pivot, last -= size)) {}
+        while (!less_BytesSort_(d, pivot, first += size)) {}
+    }
+    copy_BytesSort_(d, begin, last);
+    copy_BytesSort_(d, last, pivot);
+    return last;
+}
+
+static void breakPatterns_BytesSort_(const iBytesSort *d, char *begin, char *end) {
+    /* Swaps a few elements to avoid repeating a bad partitioning. */
+    const size_t count   = (size_t) (end - begin) / d->size;
+    const size_t quarter = count / 4;
+    if (count >= iPdqInsertionSortThreshold) {
+        swap_BytesSort_(d, begin, elem_BytesSort_(d, begin, quarter));
+        swap_BytesSort_(d, elem_BytesSort_(d, begin, count - 1),
+                        elem_BytesSort_(d, begin, count - quarter));
+        if (count > iPdqNintherThreshold) {
+            swap_BytesSort_(d, elem_BytesSort_(d, begin, 1), elem_BytesSort_(d, begin, quarter + 1));
+            swap_BytesSort_(d, elem_BytesSort_(d, begin, 2), elem_BytesSort_(d, begin, quarter + 2));
+            swap_BytesSort_(d, elem_BytesSort_(d, begin, count - 2),
+                            elem_BytesSort_(d, begin, count - quarter - 1));
+            swap_BytesSort_(d, elem_BytesSort_(d, begin, count - 3),
+                            elem_BytesSort_(d, begin, count - quarter - 2));
+        }
+    }
+}
+
+static void pdqSort_BytesSort_(const iBytesSort *d, char *begin, char *end, int badAllowed,
+                               iBool leftmost) {
+    const size_t size = d->size;
+    for (;;) {
+        const size_t count = (size_t) (end - begin) / size;
+        if (count < iPdqInsertionSortThreshold) {
+            insertionSort_BytesSort_(d, begin, end);
+            return;
+        }
+        /* Choose a pivot as median of three or pseudomedian of nine; move it to `begin`. */
+        const size_t half = count / 2;
+        if (count > iPdqNintherThreshold) {
+            sort3_BytesSort_(d, begin, elem_BytesSort_(d, begin, half), end - size);
+            sort3_BytesSort_(d, begin + size, elem_BytesSort_(d, begin, half - 1), end - 2 * size);
+            sort3_BytesSort_(d, begin + 2 * size, elem_BytesSort_(d, begin, half + 1), end - 3 * size);
+            sort3_BytesSort_(d, elem_BytesSort_(d, begin, half - 1), elem_BytesSort_(d, begin, half),
+                             elem_BytesSort_(d, begin, half + 1));
+            swap_BytesSort_(d, begin, elem_BytesSort_(d, begin, half));
+        }
+        else {
+            sort3_BytesSort_(d, elem_BytesSort_(d, begin, half), begin, end - size);
+        }
+        /* If the pivot equals the element before this range, all elements equal to the
+           pivot can be skipped. */
+        if (!leftmost && !less_BytesSort_(d, begin - size, begin)) {
+            begin = partitionLeft_BytesSort_(d, begin, end) + size;
+            continue;
+        }
+        iBool alreadyPartitioned;
+        char *pivotPos = partitionRight_BytesSort_(d, begin, end, &alreadyPartitioned);
+        const size_t sizeLeft  = (size_t) (pivotPos - begin) / size;
+        const size_t sizeRight = (size_t) (end - pivotPos) / size - 1;
+        if (sizeLeft < count / 8 || sizeRight < count / 8) {
+            if (--badAllowed == 0) {
+                heapSort_BytesSort_(d, begin, end);
+                return;
+            }
+            breakPatterns_BytesSort_(d, begin, pivotPos);
+            breakPatterns_BytesSort_(d, pivotPos + size, end);
+        }
+        else if (alreadyPartitioned &&
+                 partialInsertionSort_BytesSort_(d, begin, pivotPos) &&
+                 partialInsertionSort_BytesSort_(d, pivotPos + size, end)) {
+            return;
+        }
+        /* Recurse into the left side, loop on the right side. */
+        pdqSort_BytesSort_(d, begin, pivotPos, badAllowed, leftmost);
+        begin    = pivotPos + size;
+        leftmost = iFalse;
+    }
+}
+
+void sortBytes_Array(iArray *d) {
+    const size_t count = size_Array(d);
+    if (count < 2) {
+        return;
+    }
+    char *buf = malloc(2 * d->elementSize);
+    const iBytesSort sorter = { .size = d->elementSize, .pivot = buf, .temp = buf + d->elementSize };
+    int log2 = 0;
+    for (size_t n = count; n > 1; n >>= 1) {
+        log2++;
+    }
+    char *begin = front_Array(d);
+    pdqSort_BytesSort_(&sorter, begin, begin + count * d->elementSize, log2, iTrue);
+    free(buf);
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+#define iMergeSortRunLength     16
+#define iPoolSortMinSize        16384
+#define iPoolSortMinSegment     8192
+
+typedef int (*iArrayCompareFunc)(const void *, const void *);
+
+static void merge_(const char *a, size_t countA, const char *b, size_t countB, char *out,
+                   size_t size, iArrayCompareFunc cmp) {
+    const char *endA = a + countA * size;
+    const char *endB = b + countB * size;
+    while (a < endA && b < endB) {
+        /* Equal elements are taken from the first run to keep the sort stable. */
+        if (cmp(b, a) < 0) {
+            copyElement_(out, b, size);
+            b += size;
+        }
+        else {
+            copyElement_(out, a, size);
+            a += size;
+        }
+        out += size;
+    }
+    memcpy(out, a, (size_t) (endA - a));
+    out += endA - a;
+    memcpy(out, b, (size_t) (endB - b));
+}
+
+static void insertionSort_(char *base, size_t count, size_t size, char *temp,
+                           iArrayCompareFunc cmp) {
+    for (size_t i = 1; i < count; i++) {
+        char *cur = base + i * size;
+        if (cmp(cur, cur - size) < 0) {
+            char *sift = cur;
+            copyElement_(temp, cur, size);
+            do {
+                copyElement_(sift, sift - size, size);
+                sift -= size;
+            } while (sift != base && cmp(temp, sift - size) < 0);
+            copyElement_(sift, temp, size);
+        }
+    }
+}
+
+static void mergeSort_(char *base, char *buf, size_t count, size_t size, iArrayCompareFunc cmp) {
+    /* Bottom-up merge sort of `count` elements; `buf` is scratch space of the same size. */
+    for (size_t i = 0; i < count; i += iMergeSortRunLength) {
+        insertionSort_(base + i * size, iMin(iMergeSortRunLength, count - i), size, buf, cmp);
+    }
+    char *src = base;
+    char *dst = buf;
+    for (size_t width = iMergeSortRunLength; width < count; width *= 2) {
+        for (size_t i = 0; i < count; i += 2 * width) {
+            const size_t mid = iMin(i + width, count);
+            const size_t end = iMin(i + 2 * width, count);
+            merge_(src + i * size, mid - i, src + mid * size, end - mid, dst + i * size, size, cmp);
+        }
+        iSwap(char *, src, dst);
+    }
+    if (src != base) {
+        memcpy(base, src, count * size);
+    }
+}
+
+void sortStable_Array(iArray *d, int (*cmp)(const void *, const void *)) {
+    const size_t count = size_Array(d);
+    if (count > 1) {
+        char *buf = malloc(count * d->elementSize);
+        mergeSort_(front_Array(d), buf, count, d->elementSize, cmp);
+        free(buf);
+    }
+}
+
+iDeclareType(PoolSort)
+iDeclareType(PoolSortSegment)
+
+struct Impl_PoolSortSegment {
+    size_t runA;     /* start of the first run */
+    size_t runB;     /* start of the second run */
+    size_t runEnd;
+    size_t outStart; /* output positions relative to `runA` */
+    size_t outEnd;
+};
+
+struct Impl_PoolSort {
+    char *src;
+    char *dst;
+    size_t count;
+    size_t size;
+    size_t runLength;
+    iArrayCompareFunc cmp;
+    iPoolSortSegment *segments;
+};
+
+static void sortRuns_PoolSort_(void *context, iRanges range) {
+    const iPoolSort *d = context;
+    for (size_t run = range.start; run < range.end; run++) {
+        const size_t start = run * d->runLength;
+        if (start >= d->count) {
+            break;
+        }
+        const size_t count = iMin(d->runLength, d->count - start);
+        mergeSort_(d->src + start * d->size, d->dst + start * d->size, count, d->size, d->cmp);
+    }
+}
+
+static size_t coRank_PoolSort_(const iPoolSort *d, size_t k, const char *a, size_t countA,
+                               const char *b, size_t countB) {
+    /* Finds how many of the first `k` merged elements come from `a`. */
+    size_t lo = k > countB ? k - countB : 0;
+    size_t hi = iMin(k, countA);
+    while (lo < hi) {
+        const size_t i = (lo + hi) / 2;
+        const size_t j = k - i;
+        if (d->cmp(b + (j - 1) * d->size, a + i * d->size) >= 0) {
+            lo = i + 1;
+        }
+        else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+static void mergeSegments_PoolSort_(void *context, iRanges range) {
+    const iPoolSort *d = context;
+    for (size_t s = range.start; s < range.end; s++) {
+        const iPoolSortSegment *seg = &d->segments[s];
+        const char * a      = d->src + seg->runA * d->size;
+        const char * b      = d->src + seg->runB * d->size;
+        const size_t countA = seg->runB - seg->runA;
+        const size_t countB = seg->runEnd - seg->runB;
+        const size_t i0     = coRank_PoolSort_(d, seg->outStart, a, countA, b, countB);
+        const size_t i1     = coRank_PoolSort_(d, seg->outEnd, a, countA, b, countB);
+        const size_t j0     = seg->outStart - i0;
+        const size_t j1     = seg->outEnd - i1;
+        merge_(a + i0 * d->size, i1 - i0, b + j0 * d->size, j1 - j0,
+               d->dst + (seg->runA + seg->outStart) * d->size, d->size, d->cmp);
+    }
+}
+
+void sortPool_Array(iArray *d, int (*cmp)(const void *, const void *), iThreadPool *pool) {
+    const size_t count = size_Array(d);
+    if (!pool || count < iPoolSortMinSize) {
+        sortStable_Array(d, cmp);
+        return;
+    }
+    /* The pool's threads and the calling thread all take part. */
+    const size_t threads = size_ThreadPool(pool) + 1;
+    char *buf = malloc(count * d->elementSize);
+    iPoolSort sort = { .src = front_Array(d), .dst = buf, .count = count,
+                       .size = d->elementSize, .cmp = cmp };
+    /* Sort runs independently. */
+    size_t runCount = 1;
+    while (runCount < 2 * threads) {
+        runCount *= 2;
+    }
+    sort.runLength = (count + runCount - 1) / runCount;
+    runCount = (count + sort.runLength - 1) / sort.runLength; /* no empty runs at the end */
+    parallelFor_ThreadPool(pool, (iRanges){ 0, runCount }, 1, sortRuns_PoolSort_, &sort);
+    /* Merge pairs of runs. Each merge is split into output segments so that the final
+       merges also use all threads. */
+    const size_t segmentLength = iMax(iPoolSortMinSegment, count / (4 * threads));
+    sort.segments = malloc(sizeof(iPoolSortSegment) * (count / segmentLength + runCount + 1));
+    for (size_t width = sort.runLength; width < count; width *= 2) {
+        size_t numSegments = 0;
+        for (size_t i = 0; i < count; i += 2 * width) {
+            const size_t mid = iMin(i + width, count);
+            const size_t end = iMin(i + 2 * width, count);
+            for (size_t pos = 0; pos < end - i; pos += segmentLength) {
+                sort.segments[numSegments++] = (iPoolSortSegment){
+                    .runA = i, .runB = mid, .runEnd = end,
+                    .outStart = pos, .outEnd = iMin(pos + segmentLength, end - i) };
+            }
+        }
+        parallelFor_ThreadPool(pool, (iRanges){ 0, numSegments }, 1, mergeSegments_PoolSort_, &sort);
+        iSwap(char *, sort.src, sort.dst);
+    }
+    if (sort.src != (char *) front_Array(d)) {
+        memcpy(front_Array(d), sort.src, count * d->elementSize);
+    }
+    free(sort.segments);
+    free(buf);
+}
+
+/*-------------------------------------------------------------------------------------*/
+
 void init_ArrayIterator(iArrayIterator *d, iArray *array) {
     d->array = array;
     d->pos = 0;
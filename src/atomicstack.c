@@ -0,0 +1,109 @@
+/** @file atomicstack.c  Lock-free stack (free list).
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "the_Foundation/atomicstack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* The update counter is kept in pointer bits that are unused in user space addresses. */
+#if UINTPTR_MAX == UINT32_MAX
+#   define iAtomicStackTagShift     32
+#   define iAtomicStackTagMask      UINT64_C(0xffffffff00000000)
+#elif defined (__aarch64__)
+    /* The top byte may be used for pointer tagging. */
+#   define iAtomicStackTagShift     48
+#   define iAtomicStackTagMask      UINT64_C(0x00ff000000000000)
+#else
+#   define iAtomicStackTagShift     48
+#   define iAtomicStackTagMask      UINT64_C(0xffff000000000000)
+#endif
+
+static iAtomicStackNode *node_AtomicStack_(uint64_t head) {
+    return (iAtomicStackNode *) (uintptr_t) (head & ~iAtomicStackTagMask);
+}
+
+static uint64_t pack_AtomicStack_(const iAtomicStackNode *node, uint64_t oldHead) {
+    const uint64_t addr = (uint64_t) (uintptr_t) node;
+    if (addr & iAtomicStackTagMask) {
+        /* For example, 5-level paging or a tagged pointer. Masking the address would corrupt
+           the stack, so this is checked in release builds as well. */
+        fprintf(stderr, "[AtomicStack] node address %p overlaps the update counter bits\n",
+                (const void *) node);
+        abort();
+    }
+    const uint64_t tag =
+        ((oldHead & iAtomicStackTagMask) + (UINT64_C(1) << iAtomicStackTagShift)) &
+        iAtomicStackTagMask;
+    return tag | addr;
+}
+
+void init_AtomicStack(iAtomicStack *d) {
+    set_Atomic(&d->head, 0);
+}
+
+void push_AtomicStack(iAtomicStack *d, iAtomicStackNode *node) {
+    pushChain_AtomicStack(d, node, node);
+}
+
+void pushChain_AtomicStack(iAtomicStack *d, iAtomicStackNode *first, iAtomicStackNode *last) {
+    uint64_t head = valueRelaxed_Atomic(&d->head);
+    do {
+        setRelaxed_Atomic(&last->next, node_AtomicStack_(head));
+    } while (!compareExchangeWeakExplicit_Atomic(&d->head, &head, pack_AtomicStack_(first, head),
+                                                 memory_order_release, memory_order_relaxed));
+}
+
+iAtomicStackNode *pop_AtomicStack(iAtomicStack *d) {
+    uint64_t head = valueAcquire_Atomic(&d->head);
+    for (;;) {
+        iAtomicStackNode *node = node_AtomicStack_(head);
+        if (!node) {
+            return NULL;
+        }
+        /* If another thread pops `node` first, the counter will differ and this fails. */
+        iAtomicStackNode *next = valueRelaxed_Atomic(&node->next);
+        if (compareExchangeWeakExplicit_Atomic(&d->head, &head, pack_AtomicStack_(next, head),
+                                               memory_order_acquire, memory_order_acquire)) {
+            return node;
+        }
+    }
+}
+
+iAtomicStackNode *takeAll_AtomicStack(iAtomicStack *d) {
+    uint64_t head = valueRelaxed_Atomic(&d->head);
+    while (node_AtomicStack_(head) &&
+           !compareExchangeWeakExplicit_Atomic(&d->head, &head, pack_AtomicStack_(NULL, head),
+                                               memory_order_acquire, memory_order_relaxed)) {
+        /* `head` was updated; try again. */
+    }
+    return node_AtomicStack_(head);
+}
+
+iBool isEmpty_AtomicStack(const iAtomicStack *d) {
+    return node_AtomicStack_(valueRelaxed_Atomic(&iConstCast(iAtomicStack *, d)->head)) == NULL;
+}
@@ -26,7 +26,113 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
 #include "the_Foundation/audience.h"
+#include "the_Foundation/dispatch.h"
 #include "the_Foundation/object.h"
+#include "the_Foundation/ptrarray.h"
+#include "the_Foundation/stdthreads.h"
+
+#include <stdlib.h>
+
+/*
+ * Snapshots of observers are reclaimed using hazard pointers. A notifying thread publishes
+ * the snapshot it is iterating in its own hazard slot, and a retired snapshot is freed only
+ * after no thread has it published any more.
+ */
+
+iDeclareType(ObserverHazards)
+
+#define iObserverHazardMax  16 /* nesting depth of notifications */
+
+struct Impl_ObserverHazards { /* Thread-specific. */
+    iAtomicPtr slots[iObserverHazardMax];
+    iAtomicInt overflow; /* too deeply nested: all snapshots are considered hazardous */
+    iAtomicInt inUse;
+    iAtomicInt removing; /* waiting in removeObservers_Audience_(); changes under `removals_` */
+    int depth;
+    iObserverHazards *next; /* never changes after being added to `allHazards_` */
+};
+
+/* Records are never freed; ones released by finished threads get reused. */
+static iAtomicPtr allHazards_;
+static tss_t      threadHazards_;
+static mtx_t      removals_;
+static cnd_t      hazardsDropped_; /* signaled under `removals_` */
+static iAtomicInt hazardWaiters_;
+#if defined (iHaveC11Threads)
+static once_flag  initHazards_ = ONCE_FLAG_INIT;
+#else
+static once_flag  initHazards_ = PTHREAD_ONCE_INIT;
+#endif
+
+static void signalDropped_ObserverHazards_(void) {
+    /* The waiter increments `hazardWaiters_` before checking the hazards, so either it
+       sees the hazard gone or it is seen here. */
+    if (value_Atomic(&hazardWaiters_)) {
+        mtx_lock(&removals_);
+        cnd_broadcast(&hazardsDropped_);
+        mtx_unlock(&removals_);
+    }
+}
+
+static void release_ObserverHazards_(void *any) {
+    iObserverHazards *d = any;
+    for (int i = 0; i < iObserverHazardMax; i++) {
+        set_Atomic(&d->slots[i], NULL);
+    }
+    set_Atomic(&d->overflow, 0);
+    set_Atomic(&d->removing, 0);
+    d->depth = 0;
+    set_Atomic(&d->inUse, 0);
+    signalDropped_ObserverHazards_();
+}
+
+static void init_ObserverHazards_(void) {
+    tss_create(&threadHazards_, release_ObserverHazards_);
+    mtx_init(&removals_, mtx_plain);
+    cnd_init(&hazardsDropped_);
+}
+
+static iObserverHazards *forThread_ObserverHazards_(void) {
+    call_once(&initHazards_, init_ObserverHazards_);
+    iObserverHazards *d = tss_get(threadHazards_);
+    if (!d) {
+        for (d = value_Atomic(&allHazards_); d; d = d->next) {
+            if (exchange_Atomic(&d->inUse, 1) == 0) {
+                break; /* reusing a released record */
+            }
+        }
+        if (!d) {
+            d = calloc(1, sizeof(iObserverHazards));
+            set_Atomic(&d->inUse, 1);
+            void *head = value_Atomic(&allHazards_);
+            do {
+                d->next = head;
+            } while (!compareExchange_Atomic(&allHazards_, &head, d));
+        }
+        tss_set(threadHazards_, d);
+    }
+    return d;
+}
+
+static iBool isHazardous_ObserverHazards_(const iAudienceSnapshot *snapshot,
+                                          const iObserverHazards *exceptThread,
+                                          iBool exceptRemoving) {
+    for (iObserverHazards *d = value_Atomic(&allHazards_); d; d = d->next) {
+        if (d == exceptThread) continue;
+        if (exceptRemoving && value_Atomic(&d->removing)) continue;
+        if (value_Atomic(&d->overflow)) {
+            return iTrue;
+        }
+        for (int i = 0; i < iObserverHazardMax; i++) {
+            if (value_Atomic(&d->slots[i]) == snapshot) {
+                return iTrue;
+            }
+        }
+    }
+    return iFalse;
+}
+
+/*-------------------------------------------------------------------------------------*/
 
 static int cmpObject_Observer_(const void *a, const void *b) {
     const iObserver *x = a, *y = b;
@@ -41,61 +147,305 @@ static int cmp_Observer_(const void *a, const void *b) {
     return iCmp((intptr_t) x->func, (intptr_t) y->func);
 }
 
+static iAudienceSnapshot *new_AudienceSnapshot_(const iSortedArray *observers) {
+    const size_t count = size_SortedArray(observers);
+    iAudienceSnapshot *d = malloc(sizeof(iAudienceSnapshot) + count * sizeof(iObserver));
+    d->count = count;
+    d->observers = (iObserver *) (d + 1);
+    d->nextRetired = NULL;
+    if (count) {
+        memcpy(d->observers, constData_Array(&observers->values), count * sizeof(iObserver));
+    }
+    /* Notifying threads may post to the dispatches as long as they use the snapshot. */
+    for (size_t i = 0; i < count; i++) {
+        ref_Object(d->observers[i].dispatch);
+    }
+    return d;
+}
+
+static void free_AudienceSnapshot_(iAudienceSnapshot *d, iPtrArray *released) {
+    /* Dispatches are released after unlocking the audience. */
+    for (size_t i = 0; i < d->count; i++) {
+        if (d->observers[i].dispatch) {
+            pushBack_PtrArray(released, d->observers[i].dispatch);
+        }
+    }
+    free(d);
+}
+
+static void releaseDispatches_(iPtrArray *released) {
+    iForEach(PtrArray, i, released) {
+        iRelease(i.ptr);
+    }
+    deinit_PtrArray(released);
+}
+
+static void reclaim_Audience_(iAudience *d, iPtrArray *released) {
+    /* Note: The audience is assumed to be locked already. */
+    if (value_Atomic(&d->pendingRemovals) > 0) {
+        return; /* retired snapshots are being modified */
+    }
+    for (iAudienceSnapshot **i = &d->retired; *i; ) {
+        iAudienceSnapshot *snap = *i;
+        if (!isHazardous_ObserverHazards_(snap, NULL, iFalse)) {
+            *i = snap->nextRetired;
+            free_AudienceSnapshot_(snap, released);
+        }
+        else {
+            i = &snap->nextRetired;
+        }
+    }
+}
+
+static void publish_Audience_(iAudience *d, iPtrArray *released) {
+    /* Note: The audience is assumed to be locked already. */
+    iAudienceSnapshot *old = exchange_Atomic(&d->snapshot, new_AudienceSnapshot_(&d->observers));
+    old->nextRetired = d->retired;
+    d->retired = old;
+    reclaim_Audience_(d, released);
+}
+
+static void waitUntilDropped_ObserverHazards_(const iAudienceSnapshot *snapshots,
+                                              const iObserverHazards *self,
+                                              iBool exceptRemoving) {
+    /* Note: `removals_` is assumed to be locked already. */
+    add_Atomic(&hazardWaiters_, 1);
+    for (;;) {
+        iBool hazardous = iFalse;
+        for (const iAudienceSnapshot *snap = snapshots; snap && !hazardous;
+             snap = snap->nextRetired) {
+            hazardous = isHazardous_ObserverHazards_(snap, self, exceptRemoving);
+        }
+        if (!hazardous) break;
+        cnd_wait(&hazardsDropped_, &removals_);
+    }
+    add_Atomic(&hazardWaiters_, -1);
+}
+
+static void disableObservers_AudienceSnapshot_(iAudienceSnapshot *retired,
+                                               const iAnyObject *object,
+                                               iObserverFunc func) {
+    /* Notifications that have not yet reached the removed observer skip it. Other threads
+       may still be calling it via a retired snapshot, though, so wait until they are done.
+       Threads that are themselves waiting here are not waited for, because they might be
+       waiting for this thread. */
+    iObserverHazards *self = forThread_ObserverHazards_();
+    set_Atomic(&self->removing, 1);
+    mtx_lock(&removals_);
+    cnd_broadcast(&hazardsDropped_); /* this thread is no longer waited for */
+    for (iAudienceSnapshot *snap = retired; snap; snap = snap->nextRetired) {
+        for (size_t i = 0; i < snap->count; i++) {
+            iObserver *obs = &snap->observers[i];
+            if (obs->object == object && (!func || obs->func == func)) {
+                set_Atomic(&obs->removed, 1);
+            }
+        }
+    }
+    waitUntilDropped_ObserverHazards_(retired, self, iTrue);
+    set_Atomic(&self->removing, 0);
+    mtx_unlock(&removals_);
+}
+
 iDefineTypeConstruction(Audience)
 
 void init_Audience(iAudience *d) {
     init_SortedArray(&d->observers, sizeof(iObserver), cmp_Observer_);
     init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "Audience");
+    set_Atomic(&d->snapshot, new_AudienceSnapshot_(&d->observers));
+    d->retired = NULL;
+    set_Atomic(&d->pendingRemovals, 0);
+    d->isDirect = iFalse;
+}
+
+iAudience *newDirect_Audience(void) {
+    iAudience *d = new_Audience();
+    d->isDirect = iTrue;
+    return d;
+}
+
+static void cancelQueued_Audience_(const iAudience *d, iPtrArray *dispatches,
+                                   const iAnyObject *object, iObserverFunc func) {
+    /* Pending calls to removed observers are discarded. */
+    iForEach(PtrArray, i, dispatches) {
+        iDispatch *disp = i.ptr;
+        if (object) {
+            cancelObserver_Dispatch(disp, object, func);
+        }
+        else {
+            cancelAudience_Dispatch(disp, d);
+        }
+        iRelease(disp);
+    }
 }
 
 void deinit_Audience(iAudience *d) {
+    iAudienceSnapshot *snap;
+    iPtrArray dispatches, released;
+    init_PtrArray(&dispatches);
+    init_PtrArray(&released);
     /* Tells members of this audience that the audience is going away. */
     iGuardMutex(&d->mutex, {
         iConstForEach(Audience, i, d) {
             iAudienceMember *memberOf = ((const iObject *) i.value->object)->memberOf;
             iAssert(memberOf != NULL);
             remove_PtrSet(&memberOf->audiences, d);
+            if (i.value->dispatch) {
+                pushBack_PtrArray(&dispatches, i.value->dispatch);
+            }
         }
         deinit_SortedArray(&d->observers);
+        snap = exchange_Atomic(&d->snapshot, NULL);
+        snap->nextRetired = d->retired;
+        d->retired = NULL;
     });
+    /* Notifications that are still finishing must be done with the snapshots. */
+    const iObserverHazards *self = forThread_ObserverHazards_();
+    mtx_lock(&removals_);
+    waitUntilDropped_ObserverHazards_(snap, self, iFalse);
+    mtx_unlock(&removals_);
+    while (snap) {
+        iAudienceSnapshot *next = snap->nextRetired;
+        free_AudienceSnapshot_(snap, &released);
+        snap = next;
+    }
+    cancelQueued_Audience_(d, &dispatches, NULL, NULL);
+    deinit_PtrArray(&dispatches);
+    releaseDispatches_(&released);
     deinit_Mutex(&d->mutex);
 }
 
+const iAudienceSnapshot *beginNotify_Audience(iAudience *d) {
+    iObserverHazards *hazards = forThread_ObserverHazards_();
+    if (hazards->depth >= iObserverHazardMax) {
+        hazards->depth++;
+        add_Atomic(&hazards->overflow, 1);
+        return value_Atomic(&d->snapshot);
+    }
+    iAtomicPtr *slot = &hazards->slots[hazards->depth++];
+    for (;;) {
+        void *snap = value_Atomic(&d->snapshot);
+        set_Atomic(slot, snap);
+        /* The snapshot may have been retired before it was marked hazardous. */
+        if (value_Atomic(&d->snapshot) == snap) {
+            return snap;
+        }
+    }
+}
+
+void endNotify_Audience(iAudience *d) {
+    iUnused(d);
+    iObserverHazards *hazards = forThread_ObserverHazards_();
+    iAssert(hazards->depth > 0);
+    if (hazards->depth-- > iObserverHazardMax) {
+        add_Atomic(&hazards->overflow, -1);
+    }
+    else {
+        set_Atomic(&hazards->slots[hazards->depth], NULL);
+    }
+    signalDropped_ObserverHazards_();
+}
+
+void postQueued_Audience(const iAudience *d, const iObserver *observer, iAnyObject *source) {
+    postNotify_Dispatch(observer->dispatch, d, observer, source);
+}
+
 iBool insert_Audience(iAudience *d, iAnyObject *object, iObserverFunc func) {
+    return insertQueued_Audience(d, object, func, NULL);
+}
+
+iBool insertQueued_Audience(iAudience *d, iAnyObject *object, iObserverFunc func,
+                            iDispatch *dispatch) {
     /* This object becomes an audience member. */
     iAssert(object != NULL);
+    if (dispatch && d->isDirect) {
+        /* The notification arguments could not be passed on to the dispatch. */
+        iWarning("[Audience] observers of notifications with arguments cannot be queued\n");
+        iAssert(iFalse);
+        return iFalse;
+    }
     iBool inserted;
+    iDispatch *oldDispatch = NULL;
+    iPtrArray released;
+    init_PtrArray(&released);
+    const iObserver obs = { object, func, ref_Object(dispatch) };
     iGuardMutex(&d->mutex, {
         insert_AudienceMember(audienceMember_Object(object), d);
-        inserted = insert_SortedArray(&d->observers, &(iObserver){ object, func });
+        size_t pos;
+        if (locate_SortedArray(&d->observers, &obs, &pos)) {
+            /* Already connected; only the dispatch may change. */
+            oldDispatch = ((iObserver *) at_SortedArray(&d->observers, pos))->dispatch;
+        }
+        inserted = insert_SortedArray(&d->observers, &obs);
+        if (inserted) {
+            publish_Audience_(d, &released);
+        }
     });
+    /* Snapshots that still contain the old dispatch have their own references to it. */
+    iRelease(oldDispatch);
+    releaseDispatches_(&released);
     return inserted;
 }
 
-static iBool removeObject_Audience_(iAudience *d, const iAnyObject *object) {
+static iBool removeObservers_Audience_(iAudience *d, const iAnyObject *object, iObserverFunc func) {
     iBool removed;
+    iAudienceSnapshot *retired = NULL;
+    iPtrArray dispatches, released;
+    init_PtrArray(&dispatches);
+    init_PtrArray(&released);
+    const iObserver key = { iConstCast(void *, object), func, NULL };
     iGuardMutex(&d->mutex, {
-        const iRanges range = locateRange_SortedArray(
-            &d->observers, &(iObserver){ iConstCast(void *, object), NULL }, cmpObject_Observer_);
+        iRanges range;
+        if (func) {
+            range.start = 0;
+            range.end = 0;
+            if (locate_SortedArray(&d->observers, &key, &range.start)) {
+                range.end = range.start + 1;
+            }
+        }
+        else {
+            range = locateRange_SortedArray(&d->observers, &key, cmpObject_Observer_);
+        }
+        for (size_t i = range.start; i < range.end; i++) {
+            iDispatch *disp = ((const iObserver *) at_SortedArray(&d->observers, i))->dispatch;
+            if (disp) {
+                pushBack_PtrArray(&dispatches, disp);
+            }
+        }
         removeRange_SortedArray(&d->observers, range);
         removed = !isEmpty_Range(&range);
+        if (removed) {
+            publish_Audience_(d, &released);
+            add_Atomic(&d->pendingRemovals, 1);
+            retired = d->retired;
+        }
     });
+    if (retired) {
+        /* Wait without locking so ongoing notifications may still modify the audience. */
+        disableObservers_AudienceSnapshot_(retired, object, func);
+        iGuardMutex(&d->mutex, {
+            add_Atomic(&d->pendingRemovals, -1);
+            reclaim_Audience_(d, &released);
+        });
+    }
+    cancelQueued_Audience_(d, &dispatches, object, func);
+    deinit_PtrArray(&dispatches);
+    releaseDispatches_(&released);
     return removed;
 }
 
 iBool remove_Audience(iAudience *d, iAnyObject *object, iObserverFunc func) {
     /* This object is no longer an audience member. */
-    iBool removed;
-    iGuardMutex(&d->mutex, {
-        remove_AudienceMember(audienceMember_Object(object), d);
-        if (func) {
-            removed = remove_SortedArray(&d->observers, &(iObserver){ object, func });
-        }
-        else {
-            removed = removeObject_Audience_(d, object);
-        }
-    });
-    return removed;
+    iGuardMutex(&d->mutex, remove_AudienceMember(audienceMember_Object(object), d));
+    return removeObservers_Audience_(d, object, func);
+}
+
+iBool isEmpty_Audience(const iAudience *d) {
+    iBool isEmpty = iTrue;
+    if (d) {
+        iGuardMutex(&d->mutex, isEmpty = isEmpty_SortedArray(&d->observers));
+    }
+    return isEmpty;
 }
 
 /*-------------------------------------------------------------------------------------*/
@@ -124,7 +474,7 @@ void init_AudienceMember(iAudienceMember *d, iAnyObject *object) {
 
 void deinit_AudienceMember(iAudienceMember *d) {
     iForEach(PtrSet, i, &d->audiences) {
-        removeObject_Audience_(*(iAudience **) i.value, d->object);
+        removeObservers_Audience_(*(iAudience **) i.value, d->object, NULL);
     }
     deinit_PtrSet(&d->audiences);
 }
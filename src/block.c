@@ -43,7 +43,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 
 /// @todo Needs a ref-counting mutex.
 static iBlockData emptyBlockData = {
-    .refCount = 1,
+    .refCount = { .count = 1 },
     .data = "",
     .size = 0,
     .allocSize = 1,
@@ -51,7 +51,7 @@ static iBlockData emptyBlockData = {
 
 static iBlockData *new_BlockData_(size_t size, size_t allocSize) {
     iBlockData *d = iMalloc(BlockData);
-    set_Atomic(&d->refCount, 1);
+    init_RefCount(&d->refCount, 1);
     d->size = size;
     d->allocSize = iMax(size + 1, allocSize);
     d->data = malloc(d->allocSize);
@@ -60,7 +60,7 @@ static iBlockData *new_BlockData_(size_t size, size_t allocSize) {
 
 static iBlockData *newPrealloc_BlockData_(void *data, size_t size, size_t allocSize) {
     iBlockData *d = iMalloc(BlockData);
-    set_Atomic(&d->refCount, 1);
+    init_RefCount(&d->refCount, 1);
     d->size = size;
     d->allocSize = allocSize;
     d->data = data;
@@ -77,8 +77,7 @@ static iBlockData *duplicate_BlockData_(const iBlockData *d, size_t allocSize) {
 }
 
 static void deref_BlockData_(iBlockData *d) {
-    const int refWas = addRelaxed_Atomic(&d->refCount, -1);
-    if (refWas == 1) {
+    if (remove_RefCount(&d->refCount)) {
         iAssert(d != &emptyBlockData);
         free(d->data);
         free(d);
@@ -96,7 +95,7 @@ iLocalDef size_t allocSize_(size_t contentSize) {
 
 static void reserve_BlockData_(iBlockData *d, size_t size) {
     if (d->allocSize >= size + 1) return;
-    iAssert(value_Atomic(&d->refCount) == 1);
+    iAssert(value_RefCount(&d->refCount) == 1);
     iAssert(d->allocSize > 0);
     /* Reserve increased amount of memory in powers-of-two. */
 #if defined (iHaveDebugOutput)
@@ -119,12 +118,12 @@ static void memcpyFrom_Block_(iBlock *d, const void *data, size_t size) {
 }
 
 static void detach_Block_(iBlock *d, size_t allocSize) {
-    if (value_Atomic(&d->i->refCount) > 1) {
+    if (value_RefCount(&d->i->refCount) > 1) {
         iBlockData *detached = duplicate_BlockData_(d->i, allocSize);
         deref_BlockData_(d->i);
         d->i = detached;
     }
-    iAssert(value_Atomic(&d->i->refCount) == 1);
+    iAssert(value_RefCount(&d->i->refCount) == 1);
 }
 
 /*-------------------------------------------------------------------------------------*/
@@ -161,7 +160,7 @@ iBlock *copy_Block(const iBlock *d) {
 void init_Block(iBlock *d, size_t size) {
     if (size == 0) {
         d->i = &emptyBlockData;
-        addRelaxed_Atomic(&emptyBlockData.refCount, 1);
+        add_RefCount(&emptyBlockData.refCount);
     }
     else {
         d->i = new_BlockData_(size, 0);
@@ -188,7 +187,7 @@ void initPrealloc_Block(iBlock *d, void *data, size_t size, size_t allocSize) {
 
 void initCopy_Block(iBlock *d, const iBlock *other) {
     if (other) {
-        addRelaxed_Atomic(&other->i->refCount, 1);
+        add_RefCount(&other->i->refCount);
         d->i = other->i;
     }
     else {
@@ -263,7 +262,7 @@ void *data_Block(iBlock *d) {
 void clear_Block(iBlock *d) {
     deref_BlockData_(d->i);
     d->i = &emptyBlockData;
-    addRelaxed_Atomic(&emptyBlockData.refCount, 1);
+    add_RefCount(&emptyBlockData.refCount);
 }
 
 void reserve_Block(iBlock *d, size_t reservedSize) {
@@ -273,6 +272,11 @@ void reserve_Block(iBlock *d, size_t reservedSize) {
     reserve_BlockData_(d->i, reservedSize);
 }
 
+void confine_Block(iBlock *d) {
+    detach_Block_(d, 0);
+    confine_RefCount(&d->i->refCount);
+}
+
 void resize_Block(iBlock *d, size_t size) {
     if (size < size_Block(d)) {
         truncate_Block(d, size);
@@ -354,7 +358,7 @@ void popBack_Block(iBlock *d) {
 
 void set_Block(iBlock *d, const iBlock *other) {
     if (d->i != other->i) {
-        addRelaxed_Atomic(&other->i->refCount, 1);
+        add_RefCount(&other->i->refCount);
         deref_BlockData_(d->i);
         d->i = other->i;
     }
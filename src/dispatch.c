@@ -0,0 +1,312 @@
+/** @file dispatch.c  Serial queue of calls made in a chosen thread.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "the_Foundation/dispatch.h"
+#include "the_Foundation/hash.h"
+#include "the_Foundation/list.h"
+#include "the_Foundation/mutex.h"
+#include "the_Foundation/threadpool.h"
+#include "the_Foundation/time.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+iDeclareType(DispatchCall)
+
+struct Impl_DispatchCall {
+    iListNode        node;
+    iHashNode        pendingNode; /* used if indexed in `pending` */
+    iBool            isIndexed;
+    const iAudience *audience;    /* NULL if a posted function */
+    iAnyObject *     object;
+    iObserverFunc    notify;
+    iAnyObject *     source;
+    iDispatchFunc    func;
+    iAny *           context;
+};
+
+static iDispatchCall *new_DispatchCall_(void) {
+    return iZapMalloc(DispatchCall);
+}
+
+iLocalDef iDispatchCall *fromPendingNode_DispatchCall_(iHashNode *node) {
+    return node ? (iDispatchCall *) ((char *) node - offsetof(iDispatchCall, pendingNode)) : NULL;
+}
+
+static iHashKey key_DispatchCall_(const iAudience *audience, const iAnyObject *object,
+                                  iObserverFunc notify, const iAnyObject *source) {
+    uint64_t h = (uint64_t) (uintptr_t) audience;
+    h = h * 0x9e3779b97f4a7c15ull ^ (uint64_t) (uintptr_t) object;
+    h = h * 0x9e3779b97f4a7c15ull ^ (uint64_t) (uintptr_t) notify;
+    h = h * 0x9e3779b97f4a7c15ull ^ (uint64_t) (uintptr_t) source;
+    return (iHashKey) (h ^ (h >> 32));
+}
+
+static iBool isSameNotify_DispatchCall_(const iDispatchCall *d, const iAudience *audience,
+                                        const iAnyObject *object, iObserverFunc notify,
+                                        const iAnyObject *source) {
+    return d->audience == audience && d->object == object && d->notify == notify &&
+           d->source == source;
+}
+
+static void call_DispatchCall_(const iDispatchCall *d) {
+    if (d->audience) {
+        ((void (*)(iAny *, iAny *)) d->notify)(d->object, d->source);
+    }
+    else {
+        d->func(d->context);
+    }
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+struct Impl_Dispatch {
+    iObject object;
+    iMutex mutex;
+    iCondition posted;
+    iCondition callFinished;
+    iList calls;
+    iHash pending; /* notifications that can be coalesced */
+    iThreadPool *pool;
+    iBool isDraining; /* pooled thread is making calls */
+    iDispatchCall running;
+    iBool isRunning;
+    iThreadId runningThread;
+};
+
+iDefineClass(Dispatch)
+iDefineObjectConstruction(Dispatch)
+
+iDispatch *newPool_Dispatch(iThreadPool *pool) {
+    iDispatch *d = iNew(Dispatch);
+    initPool_Dispatch(d, pool);
+    return d;
+}
+
+void init_Dispatch(iDispatch *d) {
+    initPool_Dispatch(d, NULL);
+}
+
+void initPool_Dispatch(iDispatch *d, iThreadPool *pool) {
+    init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "Dispatch");
+    init_Condition(&d->posted);
+    init_Condition(&d->callFinished);
+    init_List(&d->calls);
+    init_Hash(&d->pending);
+    d->pool = ref_Object(pool);
+    d->isDraining = iFalse;
+    d->isRunning = iFalse;
+    iZap(d->running);
+}
+
+void deinit_Dispatch(iDispatch *d) {
+    iAssert(!d->isDraining);
+    iForEach(List, i, &d->calls) {
+        free(i.value);
+    }
+    deinit_List(&d->calls);
+    deinit_Hash(&d->pending);
+    iRelease(d->pool);
+    deinit_Condition(&d->callFinished);
+    deinit_Condition(&d->posted);
+    deinit_Mutex(&d->mutex);
+}
+
+static iAtomicPtr mainDispatch_;
+
+iDispatch *main_Dispatch(void) {
+    iDispatch *d = value_Atomic(&mainDispatch_);
+    if (!d) {
+        void *expected = NULL;
+        d = new_Dispatch();
+        if (!compareExchange_Atomic(&mainDispatch_, &expected, d)) {
+            iRelease(d);
+            d = expected;
+        }
+    }
+    return d;
+}
+
+void deinit_MainDispatch_(void) {
+    iRelease(exchange_Atomic(&mainDispatch_, NULL));
+}
+
+static void unlinkPending_Dispatch_(iDispatch *d, iDispatchCall *call) {
+    remove_List(&d->calls, call);
+    if (call->isIndexed) {
+        remove_Hash(&d->pending, call->pendingNode.key);
+        call->isIndexed = iFalse;
+    }
+}
+
+static iBool runNext_Dispatch_(iDispatch *d) {
+    /* Note: The dispatch is assumed to be locked already. */
+    iDispatchCall *call = front_List(&d->calls);
+    if (!call) {
+        return iFalse;
+    }
+    unlinkPending_Dispatch_(d, call);
+    d->running       = *call;
+    d->isRunning     = iTrue;
+    d->runningThread = thrd_current();
+    free(call);
+    unlock_Mutex(&d->mutex);
+    call_DispatchCall_(&d->running);
+    lock_Mutex(&d->mutex);
+    d->isRunning = iFalse;
+    signalAll_Condition(&d->callFinished);
+    return iTrue;
+}
+
+static iThreadResult drain_Dispatch_(iThread *thd) {
+    iDispatch *d = userData_Thread(thd);
+    iGuardMutex(&d->mutex, {
+        while (runNext_Dispatch_(d)) {}
+        d->isDraining = iFalse;
+    });
+    iRelease(d); /* ref was added when the thread was created */
+    return 0;
+}
+
+static void schedule_Dispatch_(iDispatch *d) {
+    /* Note: The dispatch is assumed to be locked already. */
+    if (d->pool) {
+        if (!d->isDraining) {
+            d->isDraining = iTrue;
+            iThread *drain = new_Thread(drain_Dispatch_);
+            setUserData_Thread(drain, ref_Object(d));
+            run_ThreadPool(d->pool, drain);
+            iRelease(drain);
+        }
+    }
+    else {
+        signal_Condition(&d->posted);
+    }
+}
+
+void post_Dispatch(iDispatch *d, iDispatchFunc func, iAny *context) {
+    iAssert(func);
+    iDispatchCall *call = new_DispatchCall_();
+    call->func    = func;
+    call->context = context;
+    iGuardMutex(&d->mutex, {
+        pushBack_List(&d->calls, call);
+        schedule_Dispatch_(d);
+    });
+}
+
+void postNotify_Dispatch(iDispatch *d, const iAudience *audience, const iObserver *observer,
+                         iAnyObject *source) {
+    const iHashKey key = key_DispatchCall_(audience, observer->object, observer->func, source);
+    iGuardMutex(&d->mutex, {
+        const iDispatchCall *pending = fromPendingNode_DispatchCall_(value_Hash(&d->pending, key));
+        /* An identical notification that is still pending makes this one redundant. */
+        if (!pending || !isSameNotify_DispatchCall_(
+                            pending, audience, observer->object, observer->func, source)) {
+            iDispatchCall *call = new_DispatchCall_();
+            call->audience = audience;
+            call->object   = observer->object;
+            call->notify   = observer->func;
+            call->source   = source;
+            if (!pending) {
+                call->pendingNode.key = key;
+                call->isIndexed       = iTrue;
+                insert_Hash(&d->pending, &call->pendingNode);
+            }
+            pushBack_List(&d->calls, call);
+            schedule_Dispatch_(d);
+        }
+    });
+}
+
+static void waitForRunning_Dispatch_(iDispatch *d, const iAudience *audience,
+                                     const iAnyObject *object, iObserverFunc notify) {
+    /* Note: The dispatch is assumed to be locked already. */
+    while (d->isRunning && d->running.audience && !thrd_equal(d->runningThread, thrd_current()) &&
+           ((audience && d->running.audience == audience) ||
+            (object && d->running.object == object && (!notify || d->running.notify == notify)))) {
+        wait_Condition(&d->callFinished, &d->mutex);
+    }
+}
+
+void cancelObserver_Dispatch(iDispatch *d, const iAnyObject *object, iObserverFunc func) {
+    iGuardMutex(&d->mutex, {
+        iForEach(List, i, &d->calls) {
+            iDispatchCall *call = (iDispatchCall *) i.value;
+            if (call->audience && call->object == object && (!func || call->notify == func)) {
+                unlinkPending_Dispatch_(d, call);
+                free(call);
+            }
+        }
+        waitForRunning_Dispatch_(d, NULL, object, func);
+    });
+}
+
+void cancelAudience_Dispatch(iDispatch *d, const iAudience *audience) {
+    iGuardMutex(&d->mutex, {
+        iForEach(List, i, &d->calls) {
+            iDispatchCall *call = (iDispatchCall *) i.value;
+            if (call->audience == audience) {
+                unlinkPending_Dispatch_(d, call);
+                free(call);
+            }
+        }
+        waitForRunning_Dispatch_(d, audience, NULL, NULL);
+    });
+}
+
+size_t process_Dispatch(iDispatch *d) {
+    iAssert(!d->pool);
+    size_t count = 0;
+    iGuardMutex(&d->mutex, {
+        /* Calls posted during processing are left for next time. */
+        for (size_t avail = size_List(&d->calls); avail > 0 && runNext_Dispatch_(d); avail--) {
+            count++;
+        }
+    });
+    return count;
+}
+
+size_t processTimeout_Dispatch(iDispatch *d, double timeoutSeconds) {
+    iTime until;
+    initTimeout_Time(&until, timeoutSeconds);
+    iGuardMutex(&d->mutex, {
+        while (isEmpty_List(&d->calls)) {
+            if (waitTimeout_Condition(&d->posted, &d->mutex, &until) == thrd_timedout) {
+                break;
+            }
+        }
+    });
+    return process_Dispatch(d);
+}
+
+size_t size_Dispatch(const iDispatch *d) {
+    size_t size;
+    iGuardMutex(&d->mutex, size = size_List(&d->calls));
+    return size;
+}
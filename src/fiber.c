@@ -0,0 +1,570 @@
+/** @file fiber.c  Lightweight threads of execution on a thread pool.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "the_Foundation/fiber.h"
+#include "the_Foundation/mutex.h"
+#include "the_Foundation/threadpool.h"
+#include "the_Foundation/timerservice.h"
+#include "the_Foundation/time.h"
+
+#include <stdlib.h>
+
+#if defined (iHaveUContext) && defined (iHaveThreadLocal)
+#   define iHaveFibers
+#   include <ucontext.h>
+#   if defined (iPlatformLinux) || defined (iPlatformApple)
+#       include <sys/mman.h>
+#       include <unistd.h>
+#       define iHaveMmapStacks
+#   endif
+#endif
+
+enum iFiberState {
+    running_FiberState,
+    notified_FiberState, /* resumed before it was fully suspended */
+    suspended_FiberState,
+};
+
+enum iFiberSwitch {
+    suspend_FiberSwitch,
+    yield_FiberSwitch,
+    finish_FiberSwitch,
+};
+
+struct Impl_Fiber {
+    iObject object;
+    iFiberRunFunc run;
+    void *userData;
+    iThreadResult result;
+    iThreadPool *pool;
+    iMutex mutex;
+    iCondition finishedCond;
+    iBool isFinished;
+    size_t stackSize;
+    void *stack;
+    iAtomicInt state;
+#if defined (iHaveFibers)
+    enum iFiberSwitch switchReason;
+    ucontext_t context;
+    ucontext_t *scheduler; /* context of the pool thread running the fiber */
+#endif
+};
+
+iDefineClass(Fiber)
+iDefineObjectConstructionArgs(Fiber, (iFiberRunFunc run), run)
+
+void init_Fiber(iFiber *d, iFiberRunFunc run) {
+    d->run        = run;
+    d->userData   = NULL;
+    d->result     = 0;
+    d->pool       = NULL;
+    init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "Fiber");
+    init_Condition(&d->finishedCond);
+    d->isFinished = iFalse;
+    d->stackSize  = defaultStackSize_Fiber;
+    d->stack      = NULL;
+    set_Atomic(&d->state, running_FiberState);
+}
+
+void deinit_Fiber(iFiber *d) {
+    iAssert(!d->stack);
+    iRelease(d->pool);
+    deinit_Condition(&d->finishedCond);
+    deinit_Mutex(&d->mutex);
+}
+
+void setUserData_Fiber(iFiber *d, void *userData) {
+    d->userData = userData;
+}
+
+void setStackSize_Fiber(iFiber *d, size_t stackSize) {
+    iAssert(!d->stack);
+    d->stackSize = iMax(stackSize, 16 * 1024);
+}
+
+void *userData_Fiber(const iFiber *d) {
+    return d->userData;
+}
+
+iBool isFinished_Fiber(const iFiber *d) {
+    iBool finished;
+    iGuardMutex(&d->mutex, finished = d->isFinished);
+    return finished;
+}
+
+void join_Fiber(iFiber *d) {
+    iGuardMutex(&d->mutex, {
+        while (!d->isFinished) {
+            wait_Condition(&d->finishedCond, &d->mutex);
+        }
+    });
+}
+
+iThreadResult result_Fiber(const iFiber *d) {
+    join_Fiber(iConstCast(iFiber *, d));
+    return d->result;
+}
+
+static void finish_Fiber_(iFiber *d) {
+    /* The owner's reference keeps the pool alive at least until it has joined the fiber. */
+    iRelease(d->pool);
+    d->pool = NULL;
+    iGuardMutex(&d->mutex, {
+        d->isFinished = iTrue;
+        signalAll_Condition(&d->finishedCond);
+    });
+    iRelease(d); /* reference added by start_Fiber */
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+static iAtomicPtr timers_;
+
+static iTimerService *timers_Fiber_(void) {
+    iTimerService *d = value_Atomic(&timers_);
+    if (!d) {
+        void *expected = NULL;
+        d = new_TimerService();
+        if (!compareExchange_Atomic(&timers_, &expected, d)) {
+            iRelease(d);
+            d = expected;
+        }
+    }
+    return d;
+}
+
+#if defined (iHaveFibers)
+
+/* Stacks of the default size are reused. */
+enum { maxCachedStacks_Fiber_ = 64 };
+
+static iSpinMutex stackCacheMutex_; /* zero-initialized */
+static void *     stackCache_[maxCachedStacks_Fiber_];
+static int        stackCacheSize_;
+
+static iThreadLocal iFiber *currentFiber_;
+
+#if defined (iHaveMmapStacks)
+static size_t guardSize_Fiber_(void) {
+    return (size_t) sysconf(_SC_PAGESIZE);
+}
+
+static void unmapStack_Fiber_(void *stack, size_t size) {
+    const size_t guard = guardSize_Fiber_();
+    munmap((char *) stack - guard, size + guard);
+}
+#endif
+
+static void *allocStack_Fiber_(size_t size) {
+    if (size == defaultStackSize_Fiber) {
+        void *stack = NULL;
+        iGuardSpinMutex(&stackCacheMutex_, {
+            if (stackCacheSize_ > 0) {
+                stack = stackCache_[--stackCacheSize_];
+            }
+        });
+        if (stack) {
+            return stack;
+        }
+    }
+#if defined (iHaveMmapStacks)
+    /* Pages are committed only when used. The stack grows down, and the inaccessible page
+       below it makes an overflow crash instead of overwriting other memory. */
+    const size_t guard = guardSize_Fiber_();
+    char *mem = mmap(NULL, size + guard, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+    if (mem == MAP_FAILED) {
+        return NULL;
+    }
+    if (mprotect(mem, guard, PROT_NONE)) {
+        munmap(mem, size + guard);
+        return NULL;
+    }
+    return mem + guard;
+#else
+    return malloc(size);
+#endif
+}
+
+static void freeStack_Fiber_(void *stack, size_t size) {
+    if (size == defaultStackSize_Fiber) {
+        iBool cached = iFalse;
+        iGuardSpinMutex(&stackCacheMutex_, {
+            if (stackCacheSize_ < maxCachedStacks_Fiber_) {
+                stackCache_[stackCacheSize_++] = stack;
+                cached = iTrue;
+            }
+        });
+        if (cached) {
+            return;
+        }
+    }
+#if defined (iHaveMmapStacks)
+    unmapStack_Fiber_(stack, size);
+#else
+    free(stack);
+#endif
+}
+
+static void schedule_Fiber_(iFiber *d);
+
+static iThreadResult runJob_Fiber_(iThread *job) {
+    iFiber *d = userData_Thread(job);
+    ucontext_t scheduler;
+    d->scheduler = &scheduler;
+    currentFiber_ = d;
+    swapcontext(&scheduler, &d->context);
+    currentFiber_ = NULL;
+    /* The fiber has switched back here. */
+    switch (d->switchReason) {
+        case suspend_FiberSwitch: {
+            int expected = running_FiberState;
+            if (!compareExchange_Atomic(&d->state, &expected, suspended_FiberState)) {
+                /* Someone resumed it already. */
+                iAssert(expected == notified_FiberState);
+                set_Atomic(&d->state, running_FiberState);
+                schedule_Fiber_(d);
+            }
+            break;
+        }
+        case yield_FiberSwitch:
+            schedule_Fiber_(d);
+            break;
+        case finish_FiberSwitch:
+            freeStack_Fiber_(d->stack, d->stackSize);
+            d->stack = NULL;
+            finish_Fiber_(d);
+            break;
+    }
+    return 0;
+}
+
+static void schedule_Fiber_(iFiber *d) {
+    iThread *job = new_Thread(runJob_Fiber_);
+    setUserData_Thread(job, d);
+    iRelease(run_ThreadPool(d->pool, job));
+}
+
+static void switch_Fiber_(iFiber *d, enum iFiberSwitch reason) {
+    d->switchReason = reason;
+    swapcontext(&d->context, d->scheduler);
+    /* Note: May continue in a different thread. */
+}
+
+static void resume_Fiber_(iFiber *d) {
+    for (;;) {
+        int state = value_Atomic(&d->state);
+        if (state == suspended_FiberState) {
+            if (compareExchange_Atomic(&d->state, &state, running_FiberState)) {
+                schedule_Fiber_(d);
+                return;
+            }
+        }
+        else if (state == running_FiberState) {
+            /* The fiber is still on its way out; the scheduler will notice. */
+            if (compareExchange_Atomic(&d->state, &state, notified_FiberState)) {
+                return;
+            }
+        }
+        else {
+            return;
+        }
+    }
+}
+
+static void entry_Fiber_(void) {
+    iFiber *d = currentFiber_;
+    d->result = d->run(d);
+    switch_Fiber_(d, finish_FiberSwitch);
+}
+
+void start_Fiber(iFiber *d, iThreadPool *pool) {
+    iAssert(!d->pool);
+    d->pool  = ref_Object(pool);
+    d->stack = allocStack_Fiber_(d->stackSize);
+    ref_Object(d);
+    if (!d->stack) {
+        iWarning("[Fiber] failed to allocate a stack\n");
+        finish_Fiber_(d);
+        return;
+    }
+    getcontext(&d->context);
+    d->context.uc_stack.ss_sp   = d->stack;
+    d->context.uc_stack.ss_size = d->stackSize;
+    d->context.uc_link          = NULL;
+    makecontext(&d->context, entry_Fiber_, 0);
+    schedule_Fiber_(d);
+}
+
+iFiber *current_Fiber(void) {
+    return currentFiber_;
+}
+
+void yield_Fiber(void) {
+    iFiber *d = current_Fiber();
+    if (d) {
+        switch_Fiber_(d, yield_FiberSwitch);
+    }
+}
+
+static void wake_Fiber_(iAny *fiber) {
+    resume_Fiber_(fiber);
+}
+
+void sleep_Fiber(double seconds) {
+    iFiber *d = current_Fiber();
+    if (d) {
+        add_TimerService(timers_Fiber_(), seconds, wake_Fiber_, d);
+        switch_Fiber_(d, suspend_FiberSwitch);
+    }
+    else {
+        sleep_Thread(seconds);
+    }
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+/* A fiber waiting on a Condition. Waiters are linked into the condition's list, which is
+   guarded by one of a set of spin mutexes chosen by the condition's address. Whoever
+   unlinks a waiter (a signal or a timeout) is responsible for resuming the fiber. */
+struct Impl_FiberWaiter {
+    iFiberWaiter *next;
+    iFiberWaiter *prev;
+    iFiber *fiber;
+    iCondition *cond;
+    iBool isLinked;
+    iBool isTimedOut;
+    iAtomicInt isTimerDone;
+};
+
+enum { waiterLockCount_Fiber_ = 64 };
+
+static iSpinMutex waiterLocks_[waiterLockCount_Fiber_]; /* zero-initialized */
+
+static iSpinMutex *waiterLock_Condition_(const iCondition *d) {
+    uintptr_t h = (uintptr_t) d;
+    h ^= h >> 7;
+    h ^= h >> 13;
+    return &waiterLocks_[h % waiterLockCount_Fiber_];
+}
+
+static void link_FiberWaiter_(iFiberWaiter *d) {
+    /* Note: The condition's waiter lock is assumed to be locked already. */
+    iCondition *cond = d->cond;
+    d->next = NULL;
+    if (cond->fibers) {
+        /* The head's `prev` points to the tail. */
+        d->prev = cond->fibers->prev;
+        cond->fibers->prev->next = d;
+        cond->fibers->prev = d;
+    }
+    else {
+        d->prev = d;
+        cond->fibers = d;
+    }
+    d->isLinked = iTrue;
+    add_Atomic(&cond->fiberCount, 1);
+}
+
+static void unlink_FiberWaiter_(iFiberWaiter *d) {
+    /* Note: The condition's waiter lock is assumed to be locked already. */
+    iCondition *cond = d->cond;
+    iAssert(d->isLinked);
+    if (cond->fibers == d) {
+        cond->fibers = d->next;
+        if (d->next) {
+            d->next->prev = d->prev;
+        }
+    }
+    else {
+        d->prev->next = d->next;
+        if (d->next) {
+            d->next->prev = d->prev;
+        }
+        else {
+            cond->fibers->prev = d->prev;
+        }
+    }
+    d->isLinked = iFalse;
+    add_Atomic(&cond->fiberCount, -1);
+}
+
+static void timeout_FiberWaiter_(iAny *context) {
+    iFiberWaiter *d = context;
+    iSpinMutex *lock = waiterLock_Condition_(d->cond);
+    iFiber *fiber = NULL;
+    lock_SpinMutex(lock);
+    if (d->isLinked) {
+        unlink_FiberWaiter_(d);
+        d->isTimedOut = iTrue;
+        fiber = d->fiber;
+    }
+    unlock_SpinMutex(lock);
+    if (fiber) {
+        resume_Fiber_(fiber);
+    }
+    else {
+        /* The waiter was signaled and is waiting for this to return. */
+        set_Atomic(&d->isTimerDone, 1);
+    }
+}
+
+void signalFibers_Condition_(iCondition *d, iBool all) {
+    iSpinMutex *lock = waiterLock_Condition_(d);
+    iFiberWaiter *woken = NULL;
+    lock_SpinMutex(lock);
+    if (d->fibers) {
+        if (all) {
+            woken = d->fibers;
+            for (iFiberWaiter *w = woken; w; w = w->next) {
+                w->isLinked = iFalse;
+                add_Atomic(&d->fiberCount, -1);
+            }
+            d->fibers = NULL;
+        }
+        else {
+            woken = d->fibers;
+            unlink_FiberWaiter_(woken);
+            woken->next = NULL;
+        }
+    }
+    unlock_SpinMutex(lock);
+    /* Waiters are on the stacks of the fibers; don't touch them after resuming. */
+    while (woken) {
+        iFiberWaiter *next = woken->next;
+        resume_Fiber_(woken->fiber);
+        woken = next;
+    }
+}
+
+iBool waitFiber_Condition_(iCondition *d, iMutex *mutex, const iTime *timeout, int *rc) {
+    iFiber *fiber = current_Fiber();
+    if (!fiber) {
+        return iFalse;
+    }
+    iTimerService *timers = NULL;
+    iTimerId timer = 0;
+    double seconds = 0.0;
+    if (timeout) {
+        /* The deadline is in real time, as with cnd_timedwait(). The timer service measures
+           the remaining time with the monotonic clock. */
+        seconds = secondsSince_Time(timeout, &(iTime){ now_Time().ts });
+        if (seconds <= 0.0) {
+            *rc = thrd_timedout;
+            return iTrue;
+        }
+        timers = timers_Fiber_();
+    }
+    iFiberWaiter waiter = { .fiber = fiber, .cond = d };
+    iSpinMutex *lock = waiterLock_Condition_(d);
+    iGuardSpinMutex(lock, link_FiberWaiter_(&waiter));
+    if (timers) {
+        timer = add_TimerService(timers, seconds, timeout_FiberWaiter_, &waiter);
+    }
+    unlock_Mutex(mutex);
+    switch_Fiber_(fiber, suspend_FiberSwitch);
+    if (timer && !waiter.isTimedOut && !cancel_TimerService(timers, timer)) {
+        /* The timer already expired. Its callback still refers to the waiter. */
+        while (!value_Atomic(&waiter.isTimerDone)) {
+            thrd_yield();
+        }
+    }
+    lock_Mutex(mutex);
+    *rc = waiter.isTimedOut ? thrd_timedout : thrd_success;
+    return iTrue;
+}
+
+#else /* no fibers */
+
+static iThreadResult runJob_Fiber_(iThread *job) {
+    iFiber *d = userData_Thread(job);
+    d->result = d->run(d);
+    finish_Fiber_(d);
+    return 0;
+}
+
+void start_Fiber(iFiber *d, iThreadPool *pool) {
+    iAssert(!d->pool);
+    d->pool = ref_Object(pool);
+    ref_Object(d);
+    iThread *job = new_Thread(runJob_Fiber_);
+    setUserData_Thread(job, d);
+    iRelease(run_ThreadPool(pool, job));
+}
+
+iFiber *current_Fiber(void) {
+    return NULL;
+}
+
+void yield_Fiber(void) {}
+
+void sleep_Fiber(double seconds) {
+    sleep_Thread(seconds);
+}
+
+void signalFibers_Condition_(iCondition *d, iBool all) {
+    iUnused(d, all);
+}
+
+iBool waitFiber_Condition_(iCondition *d, iMutex *mutex, const iTime *timeout, int *rc) {
+    iUnused(d, mutex, timeout, rc);
+    return iFalse;
+}
+
+#endif /* iHaveFibers */
+
+iThreadResult offload_Fiber(iThreadRunFunc run, void *userData) {
+    iThread *thread = new_Thread(run);
+    setUserData_Thread(thread, userData);
+    iThreadResult result;
+    if (current_Fiber()) {
+        start_Thread(thread);
+        result = result_Thread(thread); /* joining suspends the fiber */
+    }
+    else {
+        result = run(thread);
+    }
+    iRelease(thread);
+    return result;
+}
+
+void deinit_Fibers_(void) {
+    iRelease(exchange_Atomic(&timers_, NULL));
+#if defined (iHaveFibers)
+    lock_SpinMutex(&stackCacheMutex_);
+    while (stackCacheSize_ > 0) {
+        void *stack = stackCache_[--stackCacheSize_];
+#   if defined (iHaveMmapStacks)
+        unmapStack_Fiber_(stack, defaultStackSize_Fiber);
+#   else
+        free(stack);
+#   endif
+    }
+    unlock_SpinMutex(&stackCacheMutex_);
+#endif
+}
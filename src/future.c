@@ -28,19 +28,107 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 #include "the_Foundation/future.h"
 #include "the_Foundation/threadpool.h"
 
+#include <stdlib.h>
+
 iDefineClass(Future)
 iDefineObjectConstruction(Future)
 
+typedef void (*iFutureCallbackFunc)(iFuture *, void *context);
+
+iDeclareType(FutureCallback)
+
+struct Impl_FutureCallback {
+    iFutureCallbackFunc func;
+    void *context;
+    iThreadPool *pool;
+};
+
+static iBool isComplete_Future_(const iFuture *d) {
+    return value_Atomic(&iConstCast(iFuture *, d)->pendingCount) == 0 &&
+           d->state != pending_FutureState;
+}
+
+iDeclareType(QueuedFutureCallback)
+
+struct Impl_QueuedFutureCallback {
+    iFutureCallbackFunc func;
+    void *context;
+    iFuture *future;
+};
+
+static iThreadResult runCallback_Future_(iThread *job) {
+    iQueuedFutureCallback *queued = userData_Thread(job);
+    queued->func(queued->future, queued->context);
+    iRelease(queued->future);
+    free(queued);
+    return 0;
+}
+
+static void scheduleCallbacks_Future_(iFuture *d, iArray *callbacks) {
+    /* Called without holding the mutex. */
+    iConstForEach(Array, i, callbacks) {
+        const iFutureCallback *cb = i.value;
+        if (cb->pool) {
+            iQueuedFutureCallback *queued = malloc(sizeof(iQueuedFutureCallback));
+            queued->func    = cb->func;
+            queued->context = cb->context;
+            queued->future  = ref_Object(d);
+            iThread *job = new_Thread(runCallback_Future_);
+            setUserData_Thread(job, queued);
+            iRelease(run_ThreadPool(cb->pool, job));
+        }
+        else {
+            cb->func(d, cb->context);
+        }
+    }
+    deinit_Array(callbacks);
+}
+
+static iBool takeCallbacks_Future_(iFuture *d, iArray *callbacks_out) {
+    /* Mutex must be locked. */
+    if (isComplete_Future_(d) && !isEmpty_Array(&d->callbacks)) {
+        *callbacks_out = d->callbacks;
+        init_Array(&d->callbacks, sizeof(iFutureCallback));
+        return iTrue;
+    }
+    return iFalse;
+}
+
+static void addCallback_Future_(iFuture *d, iFutureCallbackFunc func, void *context,
+                                iThreadPool *pool) {
+    const iFutureCallback cb = { func, context, pool };
+    iArray callbacks;
+    iBool isComplete;
+    lock_Mutex(&d->mutex);
+    pushBack_Array(&d->callbacks, &cb);
+    isComplete = takeCallbacks_Future_(d, &callbacks);
+    unlock_Mutex(&d->mutex);
+    if (isComplete) {
+        scheduleCallbacks_Future_(d, &callbacks);
+    }
+}
+
 static void threadFinished_Future_(iAny *any, iThread *thread) {
     iFuture *d = any;
     if (d->resultAvailable) {
         d->resultAvailable(d, thread);
     }
-    iGuardMutex(&d->mutex, {
-        addRelaxed_Atomic(&d->pendingCount, -1);
-        iAssert(value_Atomic(&d->pendingCount) >= 0);
-        signalAll_Condition(&d->ready);
-    });
+    iArray callbacks;
+    iBool isComplete;
+    lock_Mutex(&d->mutex);
+    addRelaxed_Atomic(&d->pendingCount, -1);
+    iAssert(value_Atomic(&d->pendingCount) >= 0);
+    signalAll_Condition(&d->ready);
+    isComplete = takeCallbacks_Future_(d, &callbacks);
+    unlock_Mutex(&d->mutex);
+    if (isComplete) {
+        scheduleCallbacks_Future_(d, &callbacks);
+    }
+}
+
+static void tokenCancelled_Future_(iAny *any, iCancelToken *token) {
+    iUnused(token);
+    cancel_Future(any);
 }
 
 void init_Future(iFuture *d) {
@@ -49,18 +137,53 @@ void init_Future(iFuture *d) {
 
 void initHandler_Future(iFuture *d, iFutureResultAvailable resultAvailable) {
     init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "Future");
     init_Condition(&d->ready);
     d->threads = new_ObjectList();
     set_Atomic(&d->pendingCount, 0);
     d->resultAvailable = resultAvailable;
+    d->state = resolved_FutureState;
+    d->value = NULL;
+    init_Array(&d->callbacks, sizeof(iFutureCallback));
+    d->cancelToken = NULL;
+}
+
+iFuture *newPending_Future(void) {
+    iFuture *d = iNew(Future);
+    initPending_Future(d);
+    return d;
+}
+
+void initPending_Future(iFuture *d) {
+    init_Future(d);
+    d->state = pending_FutureState;
 }
 
 void deinit_Future(iFuture *d) {
-    wait_Future(d);
+    /* Only threads need to be waited for; nobody can resolve the value any more. */
+    iGuardMutex(&d->mutex, {
+        while (value_Atomic(&d->pendingCount) > 0) {
+            wait_Condition(&d->ready, &d->mutex);
+        }
+    });
     /* Stop observing the remaining threads. */
     iForEach(ObjectList, i, d->threads) {
         iDisconnect(Thread, i.object, finished, d, threadFinished_Future_);
     }
+    if (d->cancelToken) {
+        iDisconnect(CancelToken, d->cancelToken, cancelled, d, tokenCancelled_Future_);
+        iRelease(d->cancelToken);
+    }
+    /* Continuations still waiting will never be called. Let them know in this thread. */
+    if (d->state == pending_FutureState) {
+        d->state = cancelled_FutureState;
+    }
+    iConstForEach(Array, cb, &d->callbacks) {
+        const iFutureCallback *pending = cb.value;
+        pending->func(d, pending->context);
+    }
+    deinit_Array(&d->callbacks);
+    iRelease(d->value);
     iRelease(d->threads);
     deinit_Condition(&d->ready);
     deinit_Mutex(&d->mutex);
@@ -83,18 +206,188 @@ iThread *runPool_Future(iFuture *d, iThread *thread, iThreadPool *pool) {
 
 iBool isReady_Future(const iFuture *d) {
     iBool ready = iFalse;
-    iGuardMutex(&d->mutex, ready = (value_Atomic(&iConstCast(iFuture *, d)->pendingCount) == 0));
+    iGuardMutex(&d->mutex, ready = isComplete_Future_(d));
     return ready;
 }
 
 void wait_Future(iFuture *d) {
     iGuardMutex(&d->mutex, {
-        while (value_Atomic(&d->pendingCount) > 0) {
+        while (!isComplete_Future_(d)) {
             wait_Condition(&d->ready, &d->mutex);
         }
     });
 }
 
+static iBool complete_Future_(iFuture *d, enum iFutureState state, iAnyObject *value) {
+    iArray callbacks;
+    iBool isComplete = iFalse;
+    iBool changed = iFalse;
+    lock_Mutex(&d->mutex);
+    if (d->state == pending_FutureState) {
+        d->state = state;
+        d->value = (value ? ref_Object(value) : NULL);
+        changed = iTrue;
+        signalAll_Condition(&d->ready);
+        isComplete = takeCallbacks_Future_(d, &callbacks);
+    }
+    unlock_Mutex(&d->mutex);
+    if (isComplete) {
+        scheduleCallbacks_Future_(d, &callbacks);
+    }
+    return changed;
+}
+
+iBool resolve_Future(iFuture *d, iAnyObject *value) {
+    return complete_Future_(d, resolved_FutureState, value);
+}
+
+iBool cancel_Future(iFuture *d) {
+    return complete_Future_(d, cancelled_FutureState, NULL);
+}
+
+void setCancelToken_Future(iFuture *d, iCancelToken *token) {
+    iAssert(d->cancelToken == NULL);
+    d->cancelToken = ref_Object(token);
+    iConnect(CancelToken, token, cancelled, d, tokenCancelled_Future_);
+    if (isCancelled_CancelToken(token)) {
+        cancel_Future(d);
+    }
+}
+
+iBool isCancelled_Future(const iFuture *d) {
+    iBool cancelled;
+    iGuardMutex(&d->mutex, cancelled = (d->state == cancelled_FutureState));
+    return cancelled;
+}
+
+iAnyObject *value_Future(const iFuture *d) {
+    iAnyObject *value;
+    iGuardMutex(&d->mutex, value = (d->state == resolved_FutureState ? d->value : NULL));
+    return value;
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+iDeclareType(FutureThen)
+
+struct Impl_FutureThen {
+    iFutureThenFunc func;
+    void *context;
+    iFuture *result;
+};
+
+static void continue_FutureThen_(iFuture *source, void *context) {
+    iFutureThen *d = context;
+    if (source->state == resolved_FutureState && !isCancelled_Future(d->result)) {
+        iAnyObject *value = d->func(source->value, d->context);
+        resolve_Future(d->result, value);
+        iRelease(value);
+    }
+    else {
+        cancel_Future(d->result);
+    }
+    iRelease(d->result);
+    free(d);
+}
+
+iFuture *then_Future(iFuture *d, iFutureThenFunc func, void *context, iThreadPool *executor) {
+    iFuture *result = newPending_Future();
+    if (d->cancelToken) {
+        setCancelToken_Future(result, d->cancelToken);
+    }
+    iFutureThen *then = malloc(sizeof(iFutureThen));
+    then->func    = func;
+    then->context = context;
+    then->result  = ref_Object(result);
+    addCallback_Future_(d, continue_FutureThen_, then, executor);
+    return result;
+}
+
+iDeclareType(FutureAsync)
+
+struct Impl_FutureAsync {
+    iFutureAsyncFunc func;
+    void *context;
+};
+
+static iAnyObject *call_FutureAsync_(iAnyObject *value, void *context) {
+    iFutureAsync *d = context;
+    iAnyObject *result = d->func(d->context);
+    iUnused(value);
+    free(d);
+    return result;
+}
+
+iFuture *async_Future(iThreadPool *pool, iFutureAsyncFunc func, void *context) {
+    /* The work is a continuation of an already resolved future. */
+    iFuture *start = new_Future();
+    iFutureAsync *call = malloc(sizeof(iFutureAsync));
+    call->func    = func;
+    call->context = context;
+    iFuture *result = then_Future(start, call_FutureAsync_, call, pool);
+    iRelease(start);
+    return result;
+}
+
+iDeclareType(FutureGroup)
+
+struct Impl_FutureGroup {
+    iAtomicInt refs;
+    iAtomicInt remaining;
+    iBool isAny;
+    iFuture *result;
+};
+
+static void memberComplete_FutureGroup_(iFuture *member, void *context) {
+    iFutureGroup *d = context;
+    const iBool isLast = (add_Atomic(&d->remaining, -1) == 1);
+    if (d->isAny) {
+        if (member->state == resolved_FutureState) {
+            resolve_Future(d->result, member->value);
+        }
+        else if (isLast) {
+            cancel_Future(d->result); /* all of them were cancelled */
+        }
+    }
+    else {
+        if (member->state != resolved_FutureState) {
+            cancel_Future(d->result);
+        }
+        else if (isLast) {
+            resolve_Future(d->result, NULL);
+        }
+    }
+    if (add_Atomic(&d->refs, -1) == 1) {
+        iRelease(d->result);
+        free(d);
+    }
+}
+
+static iFuture *newGroup_Future_(iFuture **futures, size_t count, iBool isAny) {
+    iFuture *result = newPending_Future();
+    if (count == 0) {
+        resolve_Future(result, NULL);
+        return result;
+    }
+    iFutureGroup *group = malloc(sizeof(iFutureGroup));
+    set_Atomic(&group->refs, (int) count);
+    set_Atomic(&group->remaining, (int) count);
+    group->isAny  = isAny;
+    group->result = ref_Object(result);
+    for (size_t i = 0; i < count; i++) {
+        addCallback_Future_(futures[i], memberComplete_FutureGroup_, group, NULL);
+    }
+    return result;
+}
+
+iFuture *whenAll_Future(iFuture **futures, size_t count) {
+    return newGroup_Future_(futures, count, iFalse);
+}
+
+iFuture *whenAny_Future(iFuture **futures, size_t count) {
+    return newGroup_Future_(futures, count, iTrue);
+}
+
 iBool isEmpty_Future(const iFuture *d) {
     iBool empty;
     iGuardMutex(&d->mutex, empty = isEmpty_ObjectList(d->threads));
@@ -122,3 +415,24 @@ iThread *nextResult_Future(iFuture *d) {
     });
     return result;
 }
+
+/*-------------------------------------------------------------------------------------*/
+
+iDefineClass(CancelToken)
+iDefineObjectConstruction(CancelToken)
+iDefineAudienceGetter(CancelToken, cancelled)
+
+void init_CancelToken(iCancelToken *d) {
+    set_Atomic(&d->isCancelled, 0);
+    d->cancelled = new_Audience();
+}
+
+void deinit_CancelToken(iCancelToken *d) {
+    delete_Audience(d->cancelled);
+}
+
+void cancel_CancelToken(iCancelToken *d) {
+    if (exchange_Atomic(&d->isCancelled, 1) == 0) {
+        iNotifyAudience(d, cancelled, CancelTokenCancelled);
+    }
+}
@@ -78,41 +78,145 @@ static void delete_GarbageNode_(iGarbageNode *d) {
 
 /*-------------------------------------------------------------------------------------*/
 
+iDeclareType(ArenaChunk)
+
+#define iArenaChunkSize     (32 * 1024)
+#define iArenaAlign         16
+
+struct Impl_ArenaChunk {
+    iArenaChunk *prev;
+    char *end;
+    char *pos;
+};
+
+iLocalDef char *begin_ArenaChunk_(iArenaChunk *d) {
+    return (char *) d + ((sizeof(iArenaChunk) + iArenaAlign - 1) & ~(size_t) (iArenaAlign - 1));
+}
+
+static iArenaChunk *new_ArenaChunk_(iArenaChunk *prev, size_t minSize) {
+    const size_t size = iMax(iArenaChunkSize, minSize + sizeof(iArenaChunk) + iArenaAlign);
+    iArenaChunk *d = malloc(size);
+    d->prev = prev;
+    d->end = (char *) d + size;
+    d->pos = begin_ArenaChunk_(d);
+    return d;
+}
+
+/*-------------------------------------------------------------------------------------*/
+
 iDeclareType(Collected)
 
 struct Impl_Collected { // Thread-specific.
     iList collected;
     iBool isRecycling;
+    int arenaDepth;     /* number of nested arena scopes */
+    iArenaChunk *arena; /* most recent chunk */
+    iArenaChunk *spare; /* kept for reuse after the arena is released */
 };
 
 static iCollected *new_Collected_(void) {
     iCollected *d = iMalloc(Collected);
     init_List(&d->collected);
     d->isRecycling = iFalse;
+    d->arenaDepth = 0;
+    d->arena = NULL;
+    d->spare = NULL;
     return d;
 }
 
+static void *alloc_Collected_(iCollected *d, size_t size) {
+    size = (size + iArenaAlign - 1) & ~(size_t) (iArenaAlign - 1);
+    if (d->arena->pos + size > d->arena->end) {
+        if (d->spare && size <= (size_t) (d->spare->end - begin_ArenaChunk_(d->spare))) {
+            d->spare->prev = d->arena;
+            d->arena = d->spare;
+            d->spare = NULL;
+        }
+        else {
+            d->arena = new_ArenaChunk_(d->arena, size);
+        }
+    }
+    void *ptr = d->arena->pos;
+    d->arena->pos += size;
+    return ptr;
+}
+
+static void rewindArena_Collected_(iCollected *d, const char *mark) {
+    /* Frees all memory allocated in the arena after `mark`. */
+    while (d->arena && !(mark >= begin_ArenaChunk_(d->arena) && mark <= d->arena->end)) {
+        iArenaChunk *chunk = d->arena;
+        d->arena = chunk->prev;
+        if (!d->spare && chunk->end - (char *) chunk == iArenaChunkSize) {
+            chunk->pos = begin_ArenaChunk_(chunk);
+            d->spare = chunk;
+        }
+        else {
+            free(chunk);
+        }
+    }
+    iAssert(d->arena);
+    d->arena->pos = iConstCast(char *, mark);
+}
+
+static void releaseArena_Collected_(iCollected *d) {
+    while (d->arena) {
+        iArenaChunk *chunk = d->arena;
+        d->arena = chunk->prev;
+        free(chunk);
+    }
+    free(d->spare);
+    d->spare = NULL;
+    d->arenaDepth = 0;
+}
+
+static void push_Collected_(iCollected *d, iCollectedPtr colptr);
+
 static void recycle_Collected_(iCollected *d) {
     if (!d->isRecycling && !isEmpty_List(&d->collected)) {
         d->isRecycling = iTrue; /* avoid re-entrant recycling */
         iDebug("[Garbage] recycling %zu allocations\n", size_List(&d->collected));
+        /* Arena scopes that are still open keep their markers, and the arena is released
+           only when they end. Memory allocated from it may still be in use. */
+        void **marks = NULL;
+        int numMarks = 0;
+        if (d->arenaDepth > 0) {
+            marks = malloc(sizeof(void *) * d->arenaDepth);
+            iConstForEach(List, i, &d->collected) {
+                const iGarbageNode *node = (const iGarbageNode *) i.value;
+                for (int j = 0; j < node->count; j++) {
+                    if (node->allocs[j].ptr && !node->allocs[j].del) {
+                        marks[numMarks++] = node->allocs[j].ptr;
+                    }
+                }
+            }
+            iAssert(numMarks == d->arenaDepth);
+        }
         iReverseForEach(List, i, &d->collected) {
             delete_GarbageNode_((iGarbageNode *) i.value);
         }
         clear_List(&d->collected);
+        for (int i = 0; i < numMarks; i++) {
+            push_Collected_(d, (iCollectedPtr){ marks[i], NULL });
+        }
+        free(marks);
+        if (d->arenaDepth == 0) {
+            releaseArena_Collected_(d);
+        }
         d->isRecycling = iFalse;
     }
 }
 
 static void delete_Collected_(iCollected *d) {
     if (d) {
+        d->arenaDepth = 0; /* the thread is exiting; all scopes are discarded */
         recycle_Collected_(d);
+        releaseArena_Collected_(d);
         deinit_List(&d->collected);
         free(d);
     }
 }
 
-static iBool pop_Collected_(iCollected *d) {
+static iBool pop_Collected_(iCollected *d, void **marker_out) {
     if (isEmpty_List(&d->collected)) {
         return iFalse;
     }
@@ -120,8 +224,13 @@ static iBool pop_Collected_(iCollected *d) {
     if (isEmpty_GarbageNode_(node) && size_List(&d->collected) > 1) {
         popBack_List(&d->collected);
         delete_GarbageNode_(node);
+        node = back_List(&d->collected);
     }
-    return popBack_GarbageNode_(back_List(&d->collected));
+    if (marker_out && !isEmpty_GarbageNode_(node) && !node->allocs[node->count - 1].del) {
+        /* Scope markers have no delete function. Arena scopes have a non-NULL marker. */
+        *marker_out = node->allocs[node->count - 1].ptr;
+    }
+    return popBack_GarbageNode_(node);
 }
 
 #if !defined (NDEBUG)
@@ -136,7 +245,8 @@ static void *previous_Collected_(const iCollected *d, size_t offset) {
         node = (const iGarbageNode *) node->node.prev;
     }
     if (offset <= (size_t) node->count) {
-        return node->allocs[node->count - offset].ptr;
+        const iCollectedPtr *alloc = &node->allocs[node->count - offset];
+        return alloc->del ? alloc->ptr : NULL; /* markers may point to the arena */
     }
     return NULL;
 }
@@ -151,7 +261,7 @@ static void push_Collected_(iCollected *d, iCollectedPtr colptr) {
     /* In debug builds, try to catch recent duplicate collections.
        NULL pointers are used as scope markers, and objects are allowed
        to be released multiple times. */
-    if (colptr.ptr && colptr.del != (iDeleteFunc) deref_Object) {
+    if (colptr.ptr && colptr.del && colptr.del != (iDeleteFunc) deref_Object) {
         iAssert(previous_Collected_(d, 1) != colptr.ptr);
         iAssert(previous_Collected_(d, 2) != colptr.ptr);
         iAssert(previous_Collected_(d, 3) != colptr.ptr);
@@ -167,31 +277,53 @@ static void push_Collected_(iCollected *d, iCollectedPtr colptr) {
 
 /*-------------------------------------------------------------------------------------*/
 
-static tss_t threadLocal_Garbage_;
+static tss_t threadLocal_Garbage_; /* deletes the state when a thread exits */
+#if defined (iHaveThreadLocal)
+static iThreadLocal iCollected *collected_;
+#endif
+
+static iCollected *forThread_Garbage_(void) {
+#if defined (iHaveThreadLocal)
+    return collected_;
+#else
+    return tss_get(threadLocal_Garbage_);
+#endif
+}
+
+static void setForThread_Garbage_(iCollected *d) {
+    tss_set(threadLocal_Garbage_, d);
+#if defined (iHaveThreadLocal)
+    collected_ = d;
+#endif
+}
 
 void deinitForThread_Garbage_(void) {
-    iCollected *d = tss_get(threadLocal_Garbage_);
+    iCollected *d = forThread_Garbage_();
     if (d) {
+        setForThread_Garbage_(NULL);
         delete_Collected_(d);
-        tss_set(threadLocal_Garbage_, NULL);
     }
 }
 
+static void deleteForThread_Garbage_(void *d) {
+#if defined (iHaveThreadLocal)
+    collected_ = NULL;
+#endif
+    delete_Collected_(d);
+}
+
 void init_Garbage(void) {
-    tss_create(&threadLocal_Garbage_, (tss_dtor_t) delete_Collected_);
+    tss_create(&threadLocal_Garbage_, deleteForThread_Garbage_);
 }
 
 static iCollected *initForThread_Garbage_(void) {
-    iCollected *d = tss_get(threadLocal_Garbage_);
+    iCollected *d = forThread_Garbage_();
     if (!d) {
-        tss_set(threadLocal_Garbage_, d = new_Collected_());
+        setForThread_Garbage_(d = new_Collected_());
     }
     return d;
 }
 
-static iBool pop_Garbage_(void) {
-    return pop_Collected_(initForThread_Garbage_());
-}
 
 void *collect_Garbage(void *ptr, iDeleteFunc del) {
     push_Collected_(initForThread_Garbage_(), (iCollectedPtr){ ptr, del });
@@ -202,16 +334,52 @@ void beginScope_Garbage(void) {
     collect_Garbage(NULL, NULL); // marks beginning of scope
 }
 
+void beginArenaScope_Garbage(void) {
+    iCollected *d = initForThread_Garbage_();
+    if (!d->arena) {
+        d->arena = d->spare ? d->spare : new_ArenaChunk_(NULL, 0);
+        d->arena->prev = NULL;
+        d->spare = NULL;
+    }
+    d->arenaDepth++;
+    /* The marker remembers where the arena should be rewound to. */
+    push_Collected_(d, (iCollectedPtr){ d->arena->pos, NULL });
+}
+
 void endScope_Garbage(void) {
+    iCollected *d = initForThread_Garbage_();
+    void *marker = NULL;
     int count = 0;
-    while (pop_Garbage_()) { count++; }
+    while (pop_Collected_(d, &marker)) { count++; }
     if (count) {
         iDebug("[Garbage] recycled %i scope allocations\n", count);
     }
+    if (marker) {
+        /* End of an arena scope; everything allocated in it is released at once. */
+        iAssert(d->arenaDepth > 0);
+        rewindArena_Collected_(d, marker);
+        if (--d->arenaDepth == 0) {
+            if (!d->spare && d->arena->end - (char *) d->arena == iArenaChunkSize) {
+                d->spare = d->arena;
+            }
+            else {
+                free(d->arena);
+            }
+            d->arena = NULL;
+        }
+    }
+}
+
+void *allocArena_Garbage(size_t size) {
+    iCollected *d = forThread_Garbage_();
+    if (d && d->arenaDepth > 0) {
+        return alloc_Collected_(d, size);
+    }
+    return NULL;
 }
 
 void recycle_Garbage(void) {
-    iCollected *d = tss_get(threadLocal_Garbage_);
+    iCollected *d = forThread_Garbage_();
     if (d) {
         recycle_Collected_(d);
     }
@@ -189,6 +189,7 @@ static iHashBucket *nextInOrder_HashBucket_(const iHashBucket *d) {
 /*-------------------------------------------------------------------------------------*/
 
 iDefineTypeConstruction(Hash)
+iDefineTypeCollectNew(Hash)
 
 void init_Hash(iHash *d) {
     d->root = calloc(sizeof(iHashBucket), 1);
@@ -33,6 +33,7 @@ static int cmp_IntSet_(const void *a, const void *b) {
 }
 
 iDefineTypeConstruction(IntSet)
+iDefineTypeCollectNew(IntSet)
 
 iIntSet *newCmp_IntSet(iIntSetCompareFunc cmp) {
     iIntSet *d = new_IntSet();
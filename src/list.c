@@ -42,6 +42,7 @@ static iListNode *prevNode_List_(const iList *d, const iListNode *node) {
 }
 
 iDefineTypeConstruction(List)
+iDefineTypeCollectNew(List)
 
 void init_List(iList *d) {
     clear_List(d);
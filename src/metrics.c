@@ -0,0 +1,163 @@
+/** @file metrics.c  Lock-free counters and latency histograms.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "the_Foundation/metrics.h"
+
+#include <string.h>
+
+#define iHistogramMaxValue  ((UINT64_C(1) << 44) - 1)
+
+static size_t index_Histogram_(uint64_t value) {
+    if (value < (1u << iHistogramSubBits)) {
+        return (size_t) value;
+    }
+    if (value > iHistogramMaxValue) {
+        value = iHistogramMaxValue;
+    }
+    /* The highest set bit selects the range and the following bits the subdivision. */
+    const int exponent = 63 - __builtin_clzll(value);
+    const size_t sub = (size_t) (value >> (exponent - iHistogramSubBits)) &
+                       ((1u << iHistogramSubBits) - 1);
+    return ((size_t) (exponent - iHistogramSubBits + 1) << iHistogramSubBits) + sub;
+}
+
+static uint64_t highestValue_Histogram_(size_t index) {
+    if (index < (1u << iHistogramSubBits)) {
+        return index;
+    }
+    const int exponent = (int) (index >> iHistogramSubBits) + iHistogramSubBits - 1;
+    const uint64_t sub = index & ((1u << iHistogramSubBits) - 1);
+    const uint64_t lowest = ((UINT64_C(1) << iHistogramSubBits) + sub)
+                            << (exponent - iHistogramSubBits);
+    return lowest + (UINT64_C(1) << (exponent - iHistogramSubBits)) - 1;
+}
+
+iDefineTypeConstruction(Histogram)
+
+void init_Histogram(iHistogram *d) {
+    reset_Histogram(d);
+}
+
+void deinit_Histogram(iHistogram *d) {
+    iUnused(d);
+}
+
+void record_Histogram(iHistogram *d, uint64_t value) {
+    addRelaxed_Atomic(&d->buckets[index_Histogram_(value)], 1);
+    addRelaxed_Atomic(&d->sum, value);
+    addRelaxed_Atomic(&d->count, 1);
+    raise_MetricsCounter(&d->max, value);
+}
+
+void reset_Histogram(iHistogram *d) {
+    for (size_t i = 0; i < iHistogramBuckets; i++) {
+        setRelaxed_Atomic(&d->buckets[i], 0);
+    }
+    setRelaxed_Atomic(&d->count, 0);
+    setRelaxed_Atomic(&d->sum, 0);
+    setRelaxed_Atomic(&d->max, 0);
+}
+
+static uint64_t percentileOf_Histogram_(const iHistogram *d, const uint64_t *buckets,
+                                        uint64_t total, double percentile) {
+    if (total == 0) {
+        return 0;
+    }
+    const uint64_t max = valueRelaxed_Atomic(&d->max);
+    uint64_t rank = (uint64_t) (percentile / 100.0 * (double) total + 0.5);
+    rank = iMax(1, iMin(rank, total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < iHistogramBuckets; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return iMin(highestValue_Histogram_(i), max);
+        }
+    }
+    return max;
+}
+
+static uint64_t copyBuckets_Histogram_(const iHistogram *d, uint64_t *buckets) {
+    /* Concurrent recording may continue, so the total is counted from the copy. */
+    uint64_t total = 0;
+    for (size_t i = 0; i < iHistogramBuckets; i++) {
+        buckets[i] = valueRelaxed_Atomic(&d->buckets[i]);
+        total += buckets[i];
+    }
+    return total;
+}
+
+uint64_t percentile_Histogram(const iHistogram *d, double percentile) {
+    uint64_t buckets[iHistogramBuckets];
+    const uint64_t total = copyBuckets_Histogram_(d, buckets);
+    return percentileOf_Histogram_(d, buckets, total, percentile);
+}
+
+void summarize_Histogram(const iHistogram *d, iHistogramSummary *summary_out) {
+    uint64_t buckets[iHistogramBuckets];
+    const uint64_t total = copyBuckets_Histogram_(d, buckets);
+    const uint64_t count = valueRelaxed_Atomic(&d->count);
+    summary_out->count = total;
+    summary_out->mean  = (count ? valueRelaxed_Atomic(&d->sum) / count
+                                : 0);
+    summary_out->p50   = percentileOf_Histogram_(d, buckets, total, 50.0);
+    summary_out->p90   = percentileOf_Histogram_(d, buckets, total, 90.0);
+    summary_out->p99   = percentileOf_Histogram_(d, buckets, total, 99.0);
+    summary_out->p999  = percentileOf_Histogram_(d, buckets, total, 99.9);
+    summary_out->max   = valueRelaxed_Atomic(&d->max);
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+void print_HistogramSummary(const iHistogramSummary *d, const char *name, FILE *out,
+                            enum iMetricsFormat format) {
+    if (format == json_MetricsFormat) {
+        fprintf(out, "{\"name\": \"%s\", \"count\": %llu, \"mean\": %llu, \"p50\": %llu, "
+                "\"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}",
+                name, (unsigned long long) d->count, (unsigned long long) d->mean,
+                (unsigned long long) d->p50, (unsigned long long) d->p90,
+                (unsigned long long) d->p99, (unsigned long long) d->p999,
+                (unsigned long long) d->max);
+    }
+    else {
+        fprintf(out, "%-12s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                name, (unsigned long long) d->count, d->mean / 1.0e3, d->p50 / 1.0e3,
+                d->p90 / 1.0e3, d->p99 / 1.0e3, d->p999 / 1.0e3, d->max / 1.0e3);
+    }
+}
+
+void printHeader_HistogramSummary(FILE *out) {
+    fprintf(out, "%-12s %10s %10s %10s %10s %10s %10s %10s\n",
+            "Microseconds", "Count", "Mean", "p50", "p90", "p99", "p99.9", "Max");
+}
+
+void raise_MetricsCounter(iAtomicUInt64 *counter, uint64_t value) {
+    uint64_t current = valueRelaxed_Atomic(counter);
+    while (current < value &&
+           !compareExchangeWeakRelaxed_Atomic(counter, &current, value)) {
+        /* `current` was updated; try again. */
+    }
+}
@@ -27,8 +27,167 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 
 #include "the_Foundation/mutex.h"
 
+#include <limits.h>
+
+#if defined (iPlatformLinux)
+#   include <linux/futex.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+iBool waitFiber_Condition_(iCondition *, iMutex *, const iTime *timeout, int *rc); /* fiber.c */
+
+#if defined (iHaveLockProfiler)
+#   include <stdlib.h>
+#   include <time.h>
+
+iDeclareType(LockProfile)
+
+struct Impl_LockProfile {
+    iLockProfile *next;
+    const char *  name;
+    iAtomicUInt64 acquired;
+    iAtomicUInt64 contended;
+    iAtomicUInt64 waitNanos;
+    iAtomicUInt64 maxHoldNanos;
+};
+
+static iLockProfile  unnamed_LockProfile_ = { .name = "(unnamed)" };
+static iAtomicPtr    profiles_ = &unnamed_LockProfile_; /* entries are never freed */
+static iSpinMutex    profilesMutex_; /* zero-initialized */
+
+static uint64_t nanos_LockProfile_(void) {
+    struct timespec ts;
+#if defined (CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static iLockProfile *find_LockProfile_(const char *name) {
+    /* Entries are only ever prepended, so the list can be read without locking. */
+    for (iLockProfile *p = value_Atomic(&profiles_); p; p = p->next) {
+        if (!strcmp(p->name, name)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static void acquired_Mutex_(iMutex *d) {
+    addRelaxed_Atomic(&d->profile->acquired, 1);
+    if (d->lockDepth++ == 0) {
+        d->lockedAt = nanos_LockProfile_();
+    }
+}
+
+static void released_Mutex_(iMutex *d) {
+    iAssert(d->lockDepth > 0);
+    if (--d->lockDepth == 0) {
+        const uint64_t held = nanos_LockProfile_() - d->lockedAt;
+        uint64_t max = valueRelaxed_Atomic(&d->profile->maxHoldNanos);
+        while (held > max && !compareExchange_Atomic(&d->profile->maxHoldNanos, &max, held)) {}
+    }
+}
+
+void setName_Mutex(iMutex *d, const char *name) {
+    lock_SpinMutex(&profilesMutex_);
+    iLockProfile *p = find_LockProfile_(name);
+    if (!p) {
+        p = calloc(1, sizeof(iLockProfile));
+        p->name = name;
+        p->next = value_Atomic(&profiles_);
+        set_Atomic(&profiles_, p);
+    }
+    unlock_SpinMutex(&profilesMutex_);
+    d->profile = p;
+}
+
+static void get_LockProfile_(const iLockProfile *d, iLockProfileStats *stats_out) {
+    stats_out->name         = d->name;
+    stats_out->acquired     = valueRelaxed_Atomic(&d->acquired);
+    stats_out->contended    = valueRelaxed_Atomic(&d->contended);
+    stats_out->waitNanos    = valueRelaxed_Atomic(&d->waitNanos);
+    stats_out->maxHoldNanos = valueRelaxed_Atomic(&d->maxHoldNanos);
+}
+
+iBool stats_LockProfile(const char *name, iLockProfileStats *stats_out) {
+    const iLockProfile *p = find_LockProfile_(name);
+    if (p) {
+        get_LockProfile_(p, stats_out);
+        return iTrue;
+    }
+    iZap(*stats_out);
+    return iFalse;
+}
+
+static int cmpWait_LockProfileStats_(const void *a, const void *b) {
+    const uint64_t x = ((const iLockProfileStats *) a)->waitNanos;
+    const uint64_t y = ((const iLockProfileStats *) b)->waitNanos;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+void print_LockProfile(FILE *out, enum iLockProfileFormat format) {
+    const iLockProfile *head = value_Atomic(&profiles_);
+    size_t count = 0;
+    for (const iLockProfile *p = head; p; p = p->next) {
+        count++;
+    }
+    iLockProfileStats *stats = malloc(sizeof(iLockProfileStats) * count);
+    count = 0;
+    for (const iLockProfile *p = head; p; p = p->next) {
+        get_LockProfile_(p, &stats[count++]);
+    }
+    /* Most time spent waiting first. */
+    qsort(stats, count, sizeof(iLockProfileStats), cmpWait_LockProfileStats_);
+    if (format == json_LockProfileFormat) {
+        fprintf(out, "[");
+        for (size_t i = 0; i < count; i++) {
+            const iLockProfileStats *st = &stats[i];
+            fprintf(out, "%s\n  {\"name\": \"%s\", \"acquired\": %llu, \"contended\": %llu, "
+                    "\"waitNanos\": %llu, \"maxHoldNanos\": %llu}",
+                    i > 0 ? "," : "", st->name, (unsigned long long) st->acquired,
+                    (unsigned long long) st->contended, (unsigned long long) st->waitNanos,
+                    (unsigned long long) st->maxHoldNanos);
+        }
+        fprintf(out, "\n]\n");
+    }
+    else {
+        fprintf(out, "%-24s %12s %12s %7s %12s %12s %12s\n",
+                "Mutex", "Acquired", "Contended", "%", "Wait ms", "Avg wait us", "Max hold us");
+        for (size_t i = 0; i < count; i++) {
+            const iLockProfileStats *st = &stats[i];
+            fprintf(out, "%-24s %12llu %12llu %7.2f %12.3f %12.3f %12.3f\n",
+                    st->name, (unsigned long long) st->acquired,
+                    (unsigned long long) st->contended,
+                    st->acquired ? 100.0 * st->contended / st->acquired : 0.0,
+                    st->waitNanos / 1.0e6,
+                    st->contended ? st->waitNanos / 1.0e3 / st->contended : 0.0,
+                    st->maxHoldNanos / 1.0e3);
+        }
+    }
+    free(stats);
+}
+
+void reset_LockProfile(void) {
+    for (iLockProfile *p = value_Atomic(&profiles_); p; p = p->next) {
+        set_Atomic(&p->acquired, 0);
+        set_Atomic(&p->contended, 0);
+        set_Atomic(&p->waitNanos, 0);
+        set_Atomic(&p->maxHoldNanos, 0);
+    }
+}
+#endif /* iHaveLockProfiler */
+
 static void init_Mutex_(iMutex *d, enum iMutexType type) {
     mtx_init(&d->mtx, type == recursive_MutexType? mtx_recursive : mtx_plain);
+#if defined (iHaveLockProfiler)
+    d->profile   = &unnamed_LockProfile_;
+    d->lockedAt  = 0;
+    d->lockDepth = 0;
+#endif
 }
 
 iDefineTypeConstruction(Mutex)
@@ -47,6 +206,35 @@ void deinit_Mutex(iMutex *d) {
     mtx_destroy(&d->mtx);
 }
 
+#if defined (iHaveLockProfiler)
+iBool lock_Mutex(iMutex *d) {
+    int rc = mtx_trylock(&d->mtx);
+    if (rc == thrd_busy) {
+        const uint64_t startedAt = nanos_LockProfile_();
+        rc = mtx_lock(&d->mtx);
+        addRelaxed_Atomic(&d->profile->contended, 1);
+        addRelaxed_Atomic(&d->profile->waitNanos, nanos_LockProfile_() - startedAt);
+    }
+    if (rc != thrd_success) {
+        return iFalse;
+    }
+    acquired_Mutex_(d);
+    return iTrue;
+}
+
+iBool tryLock_Mutex(iMutex *d) {
+    if (mtx_trylock(&d->mtx) == thrd_success) {
+        acquired_Mutex_(d);
+        return iTrue;
+    }
+    return iFalse;
+}
+
+void unlock_Mutex(iMutex *d) {
+    released_Mutex_(d);
+    mtx_unlock(&d->mtx);
+}
+#else
 iBool lock_Mutex(iMutex *d) {
     return mtx_lock(&d->mtx) == thrd_success;
 }
@@ -58,6 +246,7 @@ iBool tryLock_Mutex(iMutex *d) {
 void unlock_Mutex(iMutex *d) {
     mtx_unlock(&d->mtx);
 }
+#endif
 
 /*-------------------------------------------------------------------------------------*/
 
@@ -65,8 +254,332 @@ iDefineTypeConstruction(Condition)
 
 void init_Condition(iCondition *d) {
     cnd_init(&d->cnd);
+    set_Atomic(&d->fiberCount, 0);
+    d->fibers = NULL;
 }
 
 void deinit_Condition(iCondition *d) {
+    iAssert(value_Atomic(&d->fiberCount) == 0);
     cnd_destroy(&d->cnd);
 }
+
+void wait_Condition(iCondition *d, iMutex *mutex) {
+    int rc;
+    if (waitFiber_Condition_(d, mutex, NULL, &rc)) {
+        return;
+    }
+#if defined (iHaveLockProfiler)
+    const int depth = mutex->lockDepth;
+    mutex->lockDepth = 1;
+    released_Mutex_(mutex);
+    cnd_wait(&d->cnd, &mutex->mtx);
+    mutex->lockDepth = depth;
+    mutex->lockedAt  = nanos_LockProfile_();
+#else
+    cnd_wait(&d->cnd, &mutex->mtx);
+#endif
+}
+
+int waitTimeout_Condition(iCondition *d, iMutex *mutex, const iTime *timeout) {
+    int rc;
+    if (waitFiber_Condition_(d, mutex, timeout, &rc)) {
+        return rc;
+    }
+#if defined (iHaveLockProfiler)
+    const int depth = mutex->lockDepth;
+    mutex->lockDepth = 1;
+    released_Mutex_(mutex);
+    rc = cnd_timedwait(&d->cnd, &mutex->mtx, &timeout->ts);
+    mutex->lockDepth = depth;
+    mutex->lockedAt  = nanos_LockProfile_();
+#else
+    rc = cnd_timedwait(&d->cnd, &mutex->mtx, &timeout->ts);
+#endif
+    return rc;
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+#define iSpinCount  100
+
+iLocalDef void pause_(void) {
+#if defined (__x86_64__) || defined (__i386__)
+    __builtin_ia32_pause();
+#elif defined (__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+#if !defined (iPlatformLinux)
+/* Without futexes, waiters sleep on a condition variable chosen by the address of the
+   word. The value is checked while holding the bucket's mutex, and wakers lock the same
+   mutex, so wakeups are not lost. Words that share a bucket cause spurious wakeups. */
+
+#define iFutexBuckets   64
+
+iDeclareType(FutexBucket)
+
+struct Impl_FutexBucket {
+    mtx_t mtx;
+    cnd_t cnd;
+};
+
+static iFutexBucket futexBuckets_[iFutexBuckets];
+#if defined (iHaveC11Threads)
+static once_flag    initFutexBuckets_ = ONCE_FLAG_INIT;
+#else
+static once_flag    initFutexBuckets_ = PTHREAD_ONCE_INIT;
+#endif
+
+static void initBuckets_Futex_(void) {
+    for (size_t i = 0; i < iFutexBuckets; i++) {
+        mtx_init(&futexBuckets_[i].mtx, mtx_plain);
+        cnd_init(&futexBuckets_[i].cnd);
+    }
+}
+
+static iFutexBucket *bucket_Futex_(const iAtomicInt *word) {
+    call_once(&initFutexBuckets_, initBuckets_Futex_);
+    const uintptr_t addr = (uintptr_t) word;
+    return &futexBuckets_[((addr >> 2) ^ (addr >> 8)) % iFutexBuckets];
+}
+#endif
+
+static void wait_Futex_(iAtomicInt *word, int expected) {
+    /* Returns when woken up or if `word` no longer has the expected value. Spurious
+       wakeups are possible. */
+#if defined (iPlatformLinux)
+    syscall(SYS_futex, (int *) word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+    iFutexBucket *bucket = bucket_Futex_(word);
+    mtx_lock(&bucket->mtx);
+    if (value_Atomic(word) == expected) {
+        cnd_wait(&bucket->cnd, &bucket->mtx);
+    }
+    mtx_unlock(&bucket->mtx);
+#endif
+}
+
+static void wake_Futex_(iAtomicInt *word, int count) {
+#if defined (iPlatformLinux)
+    syscall(SYS_futex, (int *) word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+#else
+    /* Other words may be waited on in the same bucket, so everyone is woken up. */
+    iFutexBucket *bucket = bucket_Futex_(word);
+    iUnused(count);
+    mtx_lock(&bucket->mtx);
+    cnd_broadcast(&bucket->cnd);
+    mtx_unlock(&bucket->mtx);
+#endif
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+iDefineTypeConstruction(SpinMutex)
+
+void init_SpinMutex(iSpinMutex *d) {
+    set_Atomic(&d->state, 0);
+}
+
+void deinit_SpinMutex(iSpinMutex *d) {
+    iAssert(value_Atomic(&d->state) == 0);
+    iUnused(d);
+}
+
+iBool tryLock_SpinMutex(iSpinMutex *d) {
+    int unlocked = 0;
+    return compareExchange_Atomic(&d->state, &unlocked, 1);
+}
+
+void lock_SpinMutex(iSpinMutex *d) {
+    for (int i = 0; i < iSpinCount; i++) {
+        if (tryLock_SpinMutex(d)) {
+            return;
+        }
+        pause_();
+    }
+    /* Mark that there are sleepers so the unlocker will wake one up. */
+    while (exchange_Atomic(&d->state, 2) != 0) {
+        wait_Futex_(&d->state, 2);
+    }
+}
+
+void unlock_SpinMutex(iSpinMutex *d) {
+    if (exchange_Atomic(&d->state, 0) == 2) {
+        wake_Futex_(&d->state, 1);
+    }
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+iDefineTypeConstruction(RWLock)
+
+iRWLock *newPreference_RWLock(enum iRWLockPreference preference) {
+    iRWLock *d = iMalloc(RWLock);
+    initPreference_RWLock(d, preference);
+    return d;
+}
+
+void init_RWLock(iRWLock *d) {
+    initPreference_RWLock(d, readers_RWLockPreference);
+}
+
+void initPreference_RWLock(iRWLock *d, enum iRWLockPreference preference) {
+    set_Atomic(&d->state, 0);
+    set_Atomic(&d->waitingWriters, 0);
+    set_Atomic(&d->readersWake, 0);
+    set_Atomic(&d->writersWake, 0);
+    d->preference = preference;
+}
+
+void deinit_RWLock(iRWLock *d) {
+    iAssert(value_Atomic(&d->state) == 0);
+    iUnused(d);
+}
+
+iBool tryLockRead_RWLock(iRWLock *d) {
+    int readers = value_Atomic(&d->state);
+    while (readers >= 0) {
+        if (d->preference == writers_RWLockPreference && value_Atomic(&d->waitingWriters) > 0) {
+            return iFalse;
+        }
+        if (compareExchange_Atomic(&d->state, &readers, readers + 1)) {
+            return iTrue;
+        }
+    }
+    return iFalse;
+}
+
+void lockRead_RWLock(iRWLock *d) {
+    for (int i = 0; ; i++) {
+        const int seq = value_Atomic(&d->readersWake);
+        if (tryLockRead_RWLock(d)) {
+            return;
+        }
+        if (i < iSpinCount) {
+            pause_();
+        }
+        else {
+            wait_Futex_(&d->readersWake, seq);
+        }
+    }
+}
+
+void unlockRead_RWLock(iRWLock *d) {
+    iAssert(value_Atomic(&d->state) > 0);
+    if (add_Atomic(&d->state, -1) == 1 && value_Atomic(&d->waitingWriters) > 0) {
+        add_Atomic(&d->writersWake, 1);
+        wake_Futex_(&d->writersWake, 1);
+    }
+}
+
+iBool tryLockWrite_RWLock(iRWLock *d) {
+    int unlocked = 0;
+    return compareExchange_Atomic(&d->state, &unlocked, -1);
+}
+
+void lockWrite_RWLock(iRWLock *d) {
+    if (tryLockWrite_RWLock(d)) {
+        return;
+    }
+    add_Atomic(&d->waitingWriters, 1);
+    for (int i = 0; ; i++) {
+        const int seq = value_Atomic(&d->writersWake);
+        if (tryLockWrite_RWLock(d)) {
+            break;
+        }
+        if (i < iSpinCount) {
+            pause_();
+        }
+        else {
+            wait_Futex_(&d->writersWake, seq);
+        }
+    }
+    add_Atomic(&d->waitingWriters, -1);
+}
+
+void unlockWrite_RWLock(iRWLock *d) {
+    iAssert(value_Atomic(&d->state) == -1);
+    set_Atomic(&d->state, 0);
+    if (value_Atomic(&d->waitingWriters) > 0) {
+        add_Atomic(&d->writersWake, 1);
+        wake_Futex_(&d->writersWake, 1);
+    }
+    /* Readers recheck whether they may proceed. */
+    add_Atomic(&d->readersWake, 1);
+    wake_Futex_(&d->readersWake, INT_MAX);
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+iDefineTypeConstructionArgs(Semaphore, (int count), count)
+
+void init_Semaphore(iSemaphore *d, int count) {
+    set_Atomic(&d->count, count);
+    set_Atomic(&d->sleepers, 0);
+}
+
+void deinit_Semaphore(iSemaphore *d) {
+    iUnused(d);
+}
+
+iBool tryAcquire_Semaphore(iSemaphore *d) {
+    int count = value_Atomic(&d->count);
+    while (count > 0) {
+        if (compareExchange_Atomic(&d->count, &count, count - 1)) {
+            return iTrue;
+        }
+    }
+    return iFalse;
+}
+
+void acquire_Semaphore(iSemaphore *d) {
+    for (int i = 0; i < iSpinCount; i++) {
+        if (tryAcquire_Semaphore(d)) {
+            return;
+        }
+        pause_();
+    }
+    add_Atomic(&d->sleepers, 1);
+    while (!tryAcquire_Semaphore(d)) {
+        wait_Futex_(&d->count, 0);
+    }
+    add_Atomic(&d->sleepers, -1);
+}
+
+void release_Semaphore(iSemaphore *d, int count) {
+    iAssert(count > 0);
+    add_Atomic(&d->count, count);
+    if (value_Atomic(&d->sleepers) > 0) {
+        wake_Futex_(&d->count, count);
+    }
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+iDefineTypeConstructionArgs(Barrier, (int count), count)
+
+void init_Barrier(iBarrier *d, int count) {
+    iAssert(count > 0);
+    d->count = count;
+    set_Atomic(&d->arrived, 0);
+    set_Atomic(&d->generation, 0);
+}
+
+void deinit_Barrier(iBarrier *d) {
+    iUnused(d);
+}
+
+iBool wait_Barrier(iBarrier *d) {
+    const int generation = value_Atomic(&d->generation);
+    if (add_Atomic(&d->arrived, 1) + 1 == d->count) {
+        set_Atomic(&d->arrived, 0);
+        add_Atomic(&d->generation, 1);
+        wake_Futex_(&d->generation, INT_MAX);
+        return iTrue;
+    }
+    while (value_Atomic(&d->generation) == generation) {
+        wait_Futex_(&d->generation, generation);
+    }
+    return iFalse;
+}
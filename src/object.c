@@ -31,6 +31,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 #include <stdio.h>
 #include <stdlib.h>
 
+void *  alloc_ObjectPool_   (const iClass *class);          /* objectpool.c */
+void    free_ObjectPool_    (const iClass *class, void *);  /* objectpool.c */
+
 #define iObjectSignature    0x4a424f69 // iOBJ
 
 #if 0
@@ -73,14 +76,26 @@ static void free_Object_(iObject *d) {
     d->__sig = 0xdeadbeef;
     add_Atomic(&totalCount_, -1);
 #endif
-    free(d);
+    if (d->flags & pooled_ObjectFlag) {
+        free_ObjectPool_(d->classObj, d);
+    }
+    else {
+        free(d);
+    }
 }
 
 iAnyObject *new_Object(const iAnyClass *class) {
     iAssert(class != NULL);
     iAssert(((const iClass *) class)->size >= sizeof(iObject));
-    iObject *d = malloc(((const iClass *) class)->size);
-    set_Atomic(&d->refCount, 1);
+    iObject *d = alloc_ObjectPool_(class);
+    if (d) {
+        d->flags = pooled_ObjectFlag;
+    }
+    else {
+        d = malloc(((const iClass *) class)->size);
+        d->flags = 0;
+    }
+    init_RefCount(&d->refCount, 1);
     d->classObj = class;
     d->memberOf = NULL;
 #if !defined (NDEBUG)
@@ -105,7 +120,7 @@ iAnyObject *ref_Object(const iAnyObject *any) {
     if (any) {
         iObject *d = iConstCast(iObject *, any);
         iAssertIsObject(d);
-        add_Atomic(&d->refCount, 1);
+        add_RefCount(&d->refCount);
         return d;
     }
     return NULL;
@@ -115,13 +130,30 @@ void deref_Object(const iAnyObject *any) {
     if (any) {
         iObject *d = iConstCast(iObject *, any);
         iAssertIsObject(d);
-        iAssert(d->refCount > 0);
-        if (add_Atomic(&d->refCount, -1) == 1) {
+        iAssert(value_RefCount(&d->refCount) > 0);
+        if (remove_RefCount(&d->refCount)) {
             free_Object_(d);
         }
     }
 }
 
+void confine_Object(iAnyObject *any) {
+    iObject *d = any;
+    iAssertIsObject(d);
+    confine_RefCount(&d->refCount);
+}
+
+void unconfine_Object(iAnyObject *any) {
+    iObject *d = any;
+    iAssertIsObject(d);
+    unconfine_RefCount(&d->refCount);
+}
+
+iBool isConfined_Object(const iAnyObject *d) {
+    iAssertIsObject(d);
+    return isConfined_RefCount(&((const iObject *) d)->refCount);
+}
+
 const iClass *class_Object(const iAnyObject *d) {
     if (d) {
         iAssertIsObject(d);
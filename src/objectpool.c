@@ -0,0 +1,295 @@
+/** @file objectpool.c  Slab allocator for objects.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "the_Foundation/objectpool.h"
+#include "the_Foundation/atomicstack.h"
+#include "the_Foundation/mutex.h"
+#include "the_Foundation/stdthreads.h"
+
+#include <stdlib.h>
+
+#define iObjectPoolMagazineSize     32
+#define iObjectPoolSlabSize         (64 * 1024)
+#define iObjectPoolAlign            16
+
+iDeclareType(ObjectPoolMagazine)
+iDeclareType(ObjectPoolThread)
+
+struct Impl_ObjectPool {
+    const iClass *class;
+    size_t index; /* in each thread's list of magazines */
+    size_t blockSize;
+    iMutex mutex;   /* guards the slabs */
+    iAtomicStack freeList; /* blocks flushed from magazines */
+    void *slabs;    /* first word links to next */
+    char *slabPos;
+    char *slabEnd;
+    iObjectPoolStats stats; /* slab counts */
+    iAtomicSize allocated;
+    iAtomicSize freed;
+    iAtomicSize cached;
+    iObjectPool *next;
+};
+
+struct Impl_ObjectPoolMagazine { /* Thread-specific. */
+    iObjectPool *pool;
+    int count;
+    void *blocks[iObjectPoolMagazineSize];
+    size_t allocated; /* not yet added to pool stats */
+    size_t freed;
+    size_t cached;
+};
+
+struct Impl_ObjectPoolThread {
+    size_t count;
+    iObjectPoolMagazine **magazines; /* indexed by pool index */
+};
+
+static iMutex      poolsMutex_;
+static iObjectPool *pools_;       /* guarded by `poolsMutex_`; never freed */
+static size_t      poolCount_;
+static iAtomicInt  enabledForAll_;
+static tss_t       threadMagazines_; /* for releasing magazines when a thread exits */
+#if defined (iHaveThreadLocal)
+static iThreadLocal iObjectPoolThread *thread_;
+#endif
+#if defined (iHaveC11Threads)
+static once_flag   initPools_ = ONCE_FLAG_INIT;
+#else
+static once_flag   initPools_ = PTHREAD_ONCE_INIT;
+#endif
+
+static void addStats_ObjectPoolMagazine_(iObjectPoolMagazine *d) {
+    iObjectPool *pool = d->pool;
+    addRelaxed_Atomic(&pool->allocated, d->allocated);
+    addRelaxed_Atomic(&pool->freed, d->freed);
+    addRelaxed_Atomic(&pool->cached, d->cached);
+    d->allocated = d->freed = d->cached = 0;
+}
+
+static void flush_ObjectPoolMagazine_(iObjectPoolMagazine *d, int keepCount) {
+    if (d->count > keepCount) {
+        /* Link the blocks first so they can be pushed at once. */
+        iAtomicStackNode *last = d->blocks[keepCount];
+        iAtomicStackNode *first = last;
+        setRelaxed_Atomic(&last->next, NULL);
+        for (int i = keepCount + 1; i < d->count; i++) {
+            iAtomicStackNode *node = d->blocks[i];
+            setRelaxed_Atomic(&node->next, first);
+            first = node;
+        }
+        pushChain_AtomicStack(&d->pool->freeList, first, last);
+        d->count = keepCount;
+    }
+    addStats_ObjectPoolMagazine_(d);
+}
+
+static void releaseThread_ObjectPool_(void *any) {
+    iObjectPoolThread *d = any;
+    for (size_t i = 0; i < d->count; i++) {
+        iObjectPoolMagazine *mag = d->magazines[i];
+        if (mag) {
+            flush_ObjectPoolMagazine_(mag, 0);
+            free(mag);
+        }
+    }
+    free(d->magazines);
+    free(d);
+#if defined (iHaveThreadLocal)
+    /* Other thread-specific destructors may still use pools in this thread. */
+    thread_ = NULL;
+#endif
+}
+
+static void init_ObjectPools_(void) {
+    init_Mutex(&poolsMutex_);
+    setName_Mutex(&poolsMutex_, "ObjectPool.pools");
+    tss_create(&threadMagazines_, releaseThread_ObjectPool_);
+}
+
+static iObjectPoolThread *forThread_ObjectPoolThread_(void) {
+#if defined (iHaveThreadLocal)
+    iObjectPoolThread *d = thread_;
+#else
+    iObjectPoolThread *d = tss_get(threadMagazines_);
+#endif
+    if (!d) {
+        d = calloc(1, sizeof(iObjectPoolThread));
+        tss_set(threadMagazines_, d);
+#if defined (iHaveThreadLocal)
+        thread_ = d;
+#endif
+    }
+    return d;
+}
+
+static iObjectPoolMagazine *magazine_ObjectPool_(iObjectPool *d) {
+    iObjectPoolThread *thd = forThread_ObjectPoolThread_();
+    if (d->index >= thd->count) {
+        const size_t newCount = d->index + 8;
+        thd->magazines = realloc(thd->magazines, sizeof(thd->magazines[0]) * newCount);
+        for (size_t i = thd->count; i < newCount; i++) {
+            thd->magazines[i] = NULL;
+        }
+        thd->count = newCount;
+    }
+    iObjectPoolMagazine *mag = thd->magazines[d->index];
+    if (!mag) {
+        mag = calloc(1, sizeof(iObjectPoolMagazine));
+        mag->pool = d;
+        thd->magazines[d->index] = mag;
+    }
+    return mag;
+}
+
+static iObjectPool *get_ObjectPool_(const iClass *class, iBool create) {
+    iObjectPool *d = value_Atomic(&iConstCast(iClass *, class)->pool);
+    if (d || !create) {
+        return d;
+    }
+    call_once(&initPools_, init_ObjectPools_);
+    iGuardMutex(&poolsMutex_, {
+        d = value_Atomic(&iConstCast(iClass *, class)->pool);
+        if (!d) {
+            d = calloc(1, sizeof(iObjectPool));
+            d->class = class;
+            d->index = poolCount_++;
+            d->blockSize = (class->size + iObjectPoolAlign - 1) & ~(size_t) (iObjectPoolAlign - 1);
+            d->stats.objectSize = d->blockSize;
+            init_Mutex(&d->mutex);
+            setName_Mutex(&d->mutex, "ObjectPool");
+            init_AtomicStack(&d->freeList);
+            d->next = pools_;
+            pools_ = d;
+            set_Atomic(&iConstCast(iClass *, class)->pool, d);
+        }
+    });
+    return d;
+}
+
+static void *carve_ObjectPool_(iObjectPool *d) {
+    /* Note: The pool is assumed to be locked already. */
+    if (d->slabPos + d->blockSize > d->slabEnd) {
+        const size_t size = iMax(iObjectPoolSlabSize, 16 * d->blockSize);
+        char *slab = malloc(size);
+        *(void **) slab = d->slabs;
+        d->slabs = slab;
+        d->slabPos = slab + iObjectPoolAlign; /* skip the link */
+        d->slabEnd = slab + size;
+        d->stats.slabs++;
+        d->stats.reservedSize += size;
+    }
+    void *block = d->slabPos;
+    d->slabPos += d->blockSize;
+    return block;
+}
+
+static void refill_ObjectPoolMagazine_(iObjectPoolMagazine *d) {
+    /* Slabs are never freed, so popped blocks always remain readable. */
+    iObjectPool *pool = d->pool;
+    while (d->count < iObjectPoolMagazineSize / 2) {
+        void *block = pop_AtomicStack(&pool->freeList);
+        if (!block) {
+            break;
+        }
+        d->blocks[d->count++] = block;
+    }
+    if (d->count < iObjectPoolMagazineSize / 2) {
+        iGuardMutex(&pool->mutex, {
+            while (d->count < iObjectPoolMagazineSize / 2) {
+                d->blocks[d->count++] = carve_ObjectPool_(pool);
+            }
+        });
+    }
+    addStats_ObjectPoolMagazine_(d);
+}
+
+void *alloc_ObjectPool_(const iClass *class) {
+    iObjectPool *d = get_ObjectPool_(class, value_Atomic(&enabledForAll_) != 0);
+    if (!d) {
+        return NULL;
+    }
+    iObjectPoolMagazine *mag = magazine_ObjectPool_(d);
+    if (mag->count > 0) {
+        mag->cached++;
+    }
+    else {
+        refill_ObjectPoolMagazine_(mag);
+    }
+    mag->allocated++;
+    return mag->blocks[--mag->count];
+}
+
+void free_ObjectPool_(const iClass *class, void *block) {
+    iObjectPool *d = get_ObjectPool_(class, iFalse);
+    iAssert(d != NULL);
+    iObjectPoolMagazine *mag = magazine_ObjectPool_(d);
+    if (mag->count == iObjectPoolMagazineSize) {
+        /* Half is kept so alternating allocations and deletions stay thread-local. */
+        flush_ObjectPoolMagazine_(mag, iObjectPoolMagazineSize / 2);
+    }
+    mag->blocks[mag->count++] = block;
+    mag->freed++;
+}
+
+void enable_ObjectPool(const iAnyClass *class) {
+    get_ObjectPool_(class, iTrue);
+}
+
+void setEnabledForAll_ObjectPool(iBool enable) {
+    set_Atomic(&enabledForAll_, enable ? 1 : 0);
+}
+
+iBool stats_ObjectPool(const iAnyClass *class, iObjectPoolStats *stats_out) {
+    iObjectPool *d = get_ObjectPool_(class, iFalse);
+    if (!d) {
+        iZap(*stats_out);
+        return iFalse;
+    }
+    addStats_ObjectPoolMagazine_(magazine_ObjectPool_(d)); /* this thread's counts are current */
+    iGuardMutex(&d->mutex, *stats_out = d->stats);
+    stats_out->allocated = valueRelaxed_Atomic(&d->allocated);
+    stats_out->freed     = valueRelaxed_Atomic(&d->freed);
+    stats_out->cached    = valueRelaxed_Atomic(&d->cached);
+    stats_out->live = stats_out->allocated - iMin(stats_out->allocated, stats_out->freed);
+    return iTrue;
+}
+
+void printStats_ObjectPool(FILE *out) {
+    call_once(&initPools_, init_ObjectPools_);
+    lock_Mutex(&poolsMutex_);
+    fprintf(out, "%-24s %8s %12s %12s %10s %6s %10s\n",
+            "Class", "Size", "Allocated", "Cached", "Live", "Slabs", "Reserved");
+    for (const iObjectPool *d = pools_; d; d = d->next) {
+        iObjectPoolStats st;
+        stats_ObjectPool(d->class, &st);
+        fprintf(out, "%-24s %8zu %12zu %12zu %10zu %6zu %10zu\n",
+                d->class->name, st.objectSize, st.allocated, st.cached, st.live, st.slabs,
+                st.reservedSize);
+    }
+    unlock_Mutex(&poolsMutex_);
+}
@@ -0,0 +1,464 @@
+/** @file pipeline.c  Multi-stage processing with bounded queues.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "the_Foundation/pipeline.h"
+#include "the_Foundation/array.h"
+#include "the_Foundation/mutex.h"
+#include "the_Foundation/ptrarray.h"
+#include "the_Foundation/threadpool.h"
+#include "the_Foundation/time.h"
+
+#include <stdlib.h>
+
+#define iPipelineDefaultCapacity    64
+
+iDeclareType(PipelineEntry)
+iDeclareType(PipelineStage)
+
+struct Impl_PipelineEntry {
+    uint64_t seq;   /* order in which the item was put in the pipeline */
+    void *   item;  /* NULL if dropped by an earlier stage */
+};
+
+struct Impl_PipelineStage {
+    iPipeline *         pipeline;
+    size_t              index;
+    iPipelineFunc       func;
+    void *              context;
+    int                 parallelism;
+    enum iPipelineOrder order;
+    iBool               forwardsDropped; /* a later stage is ordered */
+    iArray              input;
+    iArray              reorder;    /* results waiting for earlier items; sorted by seq */
+    uint64_t            nextSeq;    /* next result to pass on, if ordered */
+    size_t              inFlight;   /* items taken from the input but not yet emitted */
+    iArray              outbox;     /* results waiting for room in the next queue */
+    iBool               isEnded;
+    iPipelineStageStats stats;
+};
+
+struct Impl_Pipeline {
+    iObject      object;
+    iMutex       mutex;
+    iCondition   room;      /* first stage has room in its queue */
+    iCondition   output;    /* output is available or the pipeline has finished */
+    iThreadPool *pool;
+    iPtrArray    stages;
+    size_t       capacity;
+    iDeleteFunc  deleteFunc;
+    iArray       outputs;   /* void * */
+    uint64_t     nextSeq;
+    iBool        isClosed;
+    iBool        isCancelled;
+    iBool        isFinished;
+};
+
+iDefineClass(Pipeline)
+iDefineObjectConstructionArgs(Pipeline, (iThreadPool *pool), pool)
+
+static iPipelineStage *stage_Pipeline_(const iPipeline *d, size_t index) {
+    if (index >= size_PtrArray(&d->stages)) {
+        return NULL;
+    }
+    return iConstCast(iPipelineStage *, constAt_PtrArray(&d->stages, index));
+}
+
+static void discard_Pipeline_(iPipeline *d, void *item) {
+    if (item && d->deleteFunc) {
+        d->deleteFunc(item);
+    }
+}
+
+static void discardEntries_Pipeline_(iPipeline *d, iArray *entries) {
+    iConstForEach(Array, i, entries) {
+        discard_Pipeline_(d, ((const iPipelineEntry *) i.value)->item);
+    }
+    clear_Array(entries);
+}
+
+static void schedule_PipelineStage_(iPipelineStage *d);
+
+/*-------------------------------------------------------------------------------------*/
+
+static void pushInput_PipelineStage_(iPipelineStage *d, const iPipelineEntry *entry) {
+    /* Note: The pipeline is assumed to be locked already. */
+    pushBack_Array(&d->input, entry);
+    d->stats.queued    = size_Array(&d->input);
+    d->stats.maxQueued = iMax(d->stats.maxQueued, d->stats.queued);
+}
+
+static void flush_PipelineStage_(iPipelineStage *d) {
+    /* Note: The pipeline is assumed to be locked already. */
+    iPipeline *pipe = d->pipeline;
+    iPipelineStage *next = stage_Pipeline_(pipe, d->index + 1);
+    while (!isEmpty_Array(&d->outbox)) {
+        const iPipelineEntry *entry = constFront_Array(&d->outbox);
+        if (next) {
+            if (size_Array(&next->input) >= pipe->capacity) {
+                break;
+            }
+            pushInput_PipelineStage_(next, entry);
+        }
+        else if (entry->item) {
+            if (size_Array(&pipe->outputs) >= pipe->capacity) {
+                break;
+            }
+            pushBack_Array(&pipe->outputs, &entry->item);
+            signal_Condition(&pipe->output);
+        }
+        popFront_Array(&d->outbox);
+    }
+    if (next) {
+        schedule_PipelineStage_(next);
+    }
+    schedule_PipelineStage_(d);
+}
+
+static void emit_PipelineStage_(iPipelineStage *d, uint64_t seq, void *result) {
+    /* Note: The pipeline is assumed to be locked already. */
+    const iPipelineEntry entry = { seq, result };
+    d->inFlight--;
+    if (d->order == ordered_PipelineOrder) {
+        size_t pos = size_Array(&d->reorder);
+        while (pos > 0 && ((const iPipelineEntry *) constAt_Array(&d->reorder, pos - 1))->seq > seq) {
+            pos--;
+        }
+        insert_Array(&d->reorder, pos, &entry);
+        while (!isEmpty_Array(&d->reorder)) {
+            const iPipelineEntry *front = constFront_Array(&d->reorder);
+            if (front->seq != d->nextSeq) {
+                break;
+            }
+            if (front->item || d->forwardsDropped) {
+                pushBack_Array(&d->outbox, front);
+            }
+            d->nextSeq++;
+            popFront_Array(&d->reorder);
+        }
+        /* New items may be waiting for the reorder buffer to shrink. */
+        signal_Condition(&d->pipeline->room);
+    }
+    else if (result || d->forwardsDropped) {
+        pushBack_Array(&d->outbox, &entry);
+    }
+    flush_PipelineStage_(d);
+}
+
+static void pulled_PipelineStage_(iPipelineStage *d) {
+    /* Note: The pipeline is assumed to be locked already. */
+    d->stats.queued = size_Array(&d->input);
+    if (d->index == 0) {
+        signal_Condition(&d->pipeline->room);
+    }
+    else {
+        flush_PipelineStage_(stage_Pipeline_(d->pipeline, d->index - 1));
+    }
+}
+
+static void update_Pipeline_(iPipeline *d) {
+    /* Note: The pipeline is assumed to be locked already. */
+    iBool upstreamEnded = d->isClosed;
+    iConstForEach(PtrArray, i, &d->stages) {
+        iPipelineStage *stage = i.ptr;
+        stage->isEnded = upstreamEnded && isEmpty_Array(&stage->input) &&
+                         stage->stats.active == 0 && isEmpty_Array(&stage->outbox) &&
+                         isEmpty_Array(&stage->reorder);
+        upstreamEnded = stage->isEnded;
+    }
+    if (upstreamEnded && !d->isFinished) {
+        d->isFinished = iTrue;
+        signalAll_Condition(&d->output);
+    }
+}
+
+static iThreadResult run_PipelineStage_(iThread *thd) {
+    iPipelineStage *d = userData_Thread(thd);
+    iPipeline *pipe = d->pipeline;
+    lock_Mutex(&pipe->mutex);
+    /* Stop when the next queue is full; this job is rescheduled when there is room. */
+    while (!isEmpty_Array(&d->input) && isEmpty_Array(&d->outbox) && !pipe->isCancelled) {
+        iPipelineEntry entry;
+        take_Array(&d->input, 0, &entry);
+        d->inFlight++;
+        pulled_PipelineStage_(d);
+        if (entry.item) {
+            d->stats.received++;
+            unlock_Mutex(&pipe->mutex);
+            const uint64_t startedAt = monotonicNanoseconds_Time();
+            void *result = d->func(d->context, entry.item);
+            const uint64_t busy = monotonicNanoseconds_Time() - startedAt;
+            lock_Mutex(&pipe->mutex);
+            d->stats.busyNanos += busy;
+            if (result) {
+                d->stats.emitted++;
+            }
+            else {
+                d->stats.dropped++;
+            }
+            entry.item = result;
+        }
+        if (pipe->isCancelled) {
+            discard_Pipeline_(pipe, entry.item);
+            d->inFlight--;
+            break;
+        }
+        emit_PipelineStage_(d, entry.seq, entry.item);
+    }
+    d->stats.active--;
+    update_Pipeline_(pipe);
+    unlock_Mutex(&pipe->mutex);
+    return 0;
+}
+
+static void schedule_PipelineStage_(iPipelineStage *d) {
+    /* Note: The pipeline is assumed to be locked already. */
+    iPipeline *pipe = d->pipeline;
+    if (pipe->isCancelled || !isEmpty_Array(&d->outbox)) {
+        return;
+    }
+    const int wanted = (int) iMin((size_t) d->parallelism, size_Array(&d->input));
+    while (d->stats.active < wanted) {
+        d->stats.active++;
+        iThread *job = new_Thread(run_PipelineStage_);
+        setUserData_Thread(job, d);
+        iRelease(run_ThreadPool(pipe->pool, job));
+    }
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+void init_Pipeline(iPipeline *d, iThreadPool *pool) {
+    init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "Pipeline");
+    init_Condition(&d->room);
+    init_Condition(&d->output);
+    d->pool = (pool ? ref_Object(pool) : new_ThreadPool());
+    init_PtrArray(&d->stages);
+    d->capacity   = iPipelineDefaultCapacity;
+    d->deleteFunc = NULL;
+    init_Array(&d->outputs, sizeof(void *));
+    d->nextSeq     = 0;
+    d->isClosed    = iFalse;
+    d->isCancelled = iFalse;
+    d->isFinished  = iFalse;
+}
+
+void deinit_Pipeline(iPipeline *d) {
+    /* Jobs may still be running in the pool. */
+    cancel_Pipeline(d);
+    wait_Pipeline(d);
+    iForEach(PtrArray, i, &d->stages) {
+        iPipelineStage *stage = i.ptr;
+        iAssert(stage->stats.active == 0);
+        discardEntries_Pipeline_(d, &stage->input);
+        discardEntries_Pipeline_(d, &stage->reorder);
+        discardEntries_Pipeline_(d, &stage->outbox);
+        deinit_Array(&stage->input);
+        deinit_Array(&stage->reorder);
+        deinit_Array(&stage->outbox);
+        free(stage);
+    }
+    deinit_PtrArray(&d->stages);
+    iConstForEach(Array, j, &d->outputs) {
+        discard_Pipeline_(d, *(void * const *) j.value);
+    }
+    deinit_Array(&d->outputs);
+    iRelease(d->pool);
+    deinit_Condition(&d->output);
+    deinit_Condition(&d->room);
+    deinit_Mutex(&d->mutex);
+}
+
+void setCapacity_Pipeline(iPipeline *d, size_t capacity) {
+    iAssert(isEmpty_PtrArray(&d->stages));
+    d->capacity = iMax(1, capacity);
+}
+
+void setDeleteFunc_Pipeline(iPipeline *d, iDeleteFunc del) {
+    d->deleteFunc = del;
+}
+
+size_t addStage_Pipeline(iPipeline *d, iPipelineFunc func, void *context, int parallelism,
+                         enum iPipelineOrder order) {
+    iAssert(func);
+    iAssert(d->nextSeq == 0); /* nothing put in yet */
+    iPipelineStage *stage = calloc(1, sizeof(iPipelineStage));
+    stage->pipeline    = d;
+    stage->func        = func;
+    stage->context     = context;
+    stage->parallelism = (parallelism > 0 ? parallelism : (int) size_ThreadPool(d->pool));
+    stage->order       = order;
+    init_Array(&stage->input, sizeof(iPipelineEntry));
+    init_Array(&stage->reorder, sizeof(iPipelineEntry));
+    init_Array(&stage->outbox, sizeof(iPipelineEntry));
+    iGuardMutex(&d->mutex, {
+        stage->index = size_PtrArray(&d->stages);
+        if (order == ordered_PipelineOrder) {
+            /* Earlier stages must tell this one about dropped items. */
+            iForEach(PtrArray, i, &d->stages) {
+                ((iPipelineStage *) i.ptr)->forwardsDropped = iTrue;
+            }
+        }
+        pushBack_PtrArray(&d->stages, stage);
+    });
+    return stage->index;
+}
+
+static iBool hasRoom_Pipeline_(const iPipeline *d) {
+    /* Note: The pipeline is assumed to be locked already. */
+    if (size_Array(&stage_Pipeline_(d, 0)->input) >= d->capacity) {
+        return iFalse;
+    }
+    /* Results held back by an ordered stage are not in any queue, so they are counted
+       separately. Otherwise one slow item would let the reorder buffer grow without limit. */
+    iConstForEach(PtrArray, i, &d->stages) {
+        const iPipelineStage *stage = i.ptr;
+        if (stage->order == ordered_PipelineOrder &&
+            size_Array(&stage->reorder) + stage->inFlight >= d->capacity) {
+            return iFalse;
+        }
+    }
+    return iTrue;
+}
+
+static iBool put_Pipeline_(iPipeline *d, void *item, iBool wait) {
+    iAssert(item);
+    iAssert(!isEmpty_PtrArray(&d->stages));
+    iBool accepted = iFalse;
+    lock_Mutex(&d->mutex);
+    iPipelineStage *first = stage_Pipeline_(d, 0);
+    while (wait && !d->isClosed && !hasRoom_Pipeline_(d)) {
+        wait_Condition(&d->room, &d->mutex);
+    }
+    if (!d->isClosed && hasRoom_Pipeline_(d)) {
+        const iPipelineEntry entry = { d->nextSeq++, item };
+        pushInput_PipelineStage_(first, &entry);
+        schedule_PipelineStage_(first);
+        accepted = iTrue;
+    }
+    unlock_Mutex(&d->mutex);
+    return accepted;
+}
+
+iBool put_Pipeline(iPipeline *d, void *item) {
+    return put_Pipeline_(d, item, iTrue);
+}
+
+iBool tryPut_Pipeline(iPipeline *d, void *item) {
+    return put_Pipeline_(d, item, iFalse);
+}
+
+void close_Pipeline(iPipeline *d) {
+    iGuardMutex(&d->mutex, {
+        d->isClosed = iTrue;
+        signalAll_Condition(&d->room);
+        update_Pipeline_(d);
+    });
+}
+
+void cancel_Pipeline(iPipeline *d) {
+    iGuardMutex(&d->mutex, {
+        d->isClosed    = iTrue;
+        d->isCancelled = iTrue;
+        iForEach(PtrArray, i, &d->stages) {
+            iPipelineStage *stage = i.ptr;
+            discardEntries_Pipeline_(d, &stage->input);
+            discardEntries_Pipeline_(d, &stage->reorder);
+            discardEntries_Pipeline_(d, &stage->outbox);
+            stage->stats.queued = 0;
+        }
+        iConstForEach(Array, j, &d->outputs) {
+            discard_Pipeline_(d, *(void * const *) j.value);
+        }
+        clear_Array(&d->outputs);
+        signalAll_Condition(&d->room);
+        update_Pipeline_(d);
+    });
+}
+
+static void *take_Pipeline_(iPipeline *d, const iTime *until) {
+    void *item = NULL;
+    lock_Mutex(&d->mutex);
+    while (isEmpty_Array(&d->outputs) && !d->isFinished) {
+        if (!until) {
+            wait_Condition(&d->output, &d->mutex);
+        }
+        else if (waitTimeout_Condition(&d->output, &d->mutex, until) == thrd_timedout) {
+            break;
+        }
+    }
+    if (!isEmpty_Array(&d->outputs)) {
+        take_Array(&d->outputs, 0, &item);
+        /* The last stage may be waiting for room. */
+        flush_PipelineStage_(back_PtrArray(&d->stages));
+        update_Pipeline_(d);
+    }
+    unlock_Mutex(&d->mutex);
+    return item;
+}
+
+void *take_Pipeline(iPipeline *d) {
+    return take_Pipeline_(d, NULL);
+}
+
+void *takeTimeout_Pipeline(iPipeline *d, double timeoutSeconds) {
+    iTime until;
+    initTimeout_Time(&until, timeoutSeconds);
+    return take_Pipeline_(d, &until);
+}
+
+void wait_Pipeline(iPipeline *d) {
+    iGuardMutex(&d->mutex, {
+        while (!d->isFinished) {
+            wait_Condition(&d->output, &d->mutex);
+        }
+    });
+}
+
+iBool isFinished_Pipeline(const iPipeline *d) {
+    iBool finished;
+    iGuardMutex(&d->mutex, finished = d->isFinished);
+    return finished;
+}
+
+size_t numStages_Pipeline(const iPipeline *d) {
+    size_t count;
+    iGuardMutex(&d->mutex, count = size_PtrArray(&d->stages));
+    return count;
+}
+
+iBool stats_Pipeline(const iPipeline *d, size_t stage, iPipelineStageStats *stats_out) {
+    iBool found = iFalse;
+    iGuardMutex(&d->mutex, {
+        const iPipelineStage *st = stage_Pipeline_(d, stage);
+        if (st) {
+            *stats_out = st->stats;
+            found = iTrue;
+        }
+    });
+    return found;
+}
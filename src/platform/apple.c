@@ -39,3 +39,22 @@ int idealConcurrentCount_Thread(void) {
     }
     return logicalCpus;
 }
+
+int currentCpu_Thread(void) {
+    return -1;
+}
+
+int numaNode_Thread(int cpu) {
+    iUnused(cpu);
+    return 0;
+}
+
+iBool isAllowedCpu_Thread(int cpu) {
+    return cpu >= 0 && cpu < idealConcurrentCount_Thread();
+}
+
+iBool setAffinity_Thread(iThread *d, int cpu) {
+    /* Not supported. */
+    iUnused(d, cpu);
+    return iFalse;
+}
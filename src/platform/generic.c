@@ -31,3 +31,22 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 int idealConcurrentCount_Thread(void) {
     return 2; // conservative
 }
+
+int currentCpu_Thread(void) {
+    return -1;
+}
+
+int numaNode_Thread(int cpu) {
+    iUnused(cpu);
+    return 0;
+}
+
+iBool isAllowedCpu_Thread(int cpu) {
+    return cpu >= 0 && cpu < idealConcurrentCount_Thread();
+}
+
+iBool setAffinity_Thread(iThread *d, int cpu) {
+    /* Not supported. */
+    iUnused(d, cpu);
+    return iFalse;
+}
@@ -31,6 +31,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 #include "the_Foundation/file.h"
 #include "the_Foundation/regexp.h"
 
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
 int idealConcurrentCount_Thread(void) {
     static int ncpu;
     if (ncpu == 0) {
@@ -53,3 +62,82 @@ int idealConcurrentCount_Thread(void) {
     }
     return ncpu;
 }
+
+int currentCpu_Thread(void) {
+    return sched_getcpu();
+}
+
+int numaNode_Thread(int cpu) {
+    /* The CPU's sysfs directory has a link to its node. */
+    char path[64];
+    int node = 0;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (dir) {
+        const struct dirent *ent;
+        while ((ent = readdir(dir)) != NULL) {
+            if (!strncmp(ent->d_name, "node", 4) && isdigit((unsigned char) ent->d_name[4])) {
+                node = atoi(ent->d_name + 4);
+                break;
+            }
+        }
+        closedir(dir);
+    }
+    return node;
+}
+
+static cpu_set_t allowedCpus_;
+#if defined (iHaveC11Threads)
+static once_flag  initAllowedCpus_ = ONCE_FLAG_INIT;
+#else
+static once_flag  initAllowedCpus_ = PTHREAD_ONCE_INIT;
+#endif
+
+static void initAllowedCpus_Thread_(void) {
+    /* The process may be restricted to some of the cores (taskset, cgroup cpuset).
+       The main thread's affinity is what the process was started with. */
+    if (sched_getaffinity(getpid(), sizeof(allowedCpus_), &allowedCpus_) != 0) {
+        CPU_ZERO(&allowedCpus_);
+        for (int i = 0; i < iMin(idealConcurrentCount_Thread(), CPU_SETSIZE); i++) {
+            CPU_SET(i, &allowedCpus_);
+        }
+    }
+}
+
+iBool isAllowedCpu_Thread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return iFalse;
+    }
+    call_once(&initAllowedCpus_, initAllowedCpus_Thread_);
+    return CPU_ISSET(cpu, &allowedCpus_) != 0;
+}
+
+iBool setAffinity_Thread(iThread *d, int cpu) {
+    cpu_set_t set;
+    if (cpu >= 0) {
+        if (!isAllowedCpu_Thread(cpu)) {
+            iWarning("[Thread] CPU %d is not available to this process\n", cpu);
+            return iFalse;
+        }
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+    }
+    else {
+        call_once(&initAllowedCpus_, initAllowedCpus_Thread_);
+        set = allowedCpus_;
+    }
+#if defined (iPlatformAndroid)
+    /* Bionic has no pthread_setaffinity_np(). */
+    if (d && !isCurrent_Thread(d)) {
+        return iFalse;
+    }
+    const int err = (sched_setaffinity(0, sizeof(set), &set) == 0 ? 0 : errno);
+#else
+    const int err = pthread_setaffinity_np(d ? id_Thread(d) : pthread_self(), sizeof(set), &set);
+#endif
+    if (err) {
+        iWarning("[Thread] failed to set CPU affinity to %d: %s\n", cpu, strerror(err));
+        return iFalse;
+    }
+    return iTrue;
+}
@@ -28,14 +28,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 #include "the_Foundation/datagram.h"
 #include "the_Foundation/mutex.h"
 #include "the_Foundation/address.h"
+#include "the_Foundation/eventloop.h"
 #include "the_Foundation/queue.h"
-#include "the_Foundation/thread.h"
-#include "the_Foundation/ptrset.h"
-#include "pipe.h"
 
 #include <errno.h>
-#include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 /* address.c */
@@ -73,8 +71,11 @@ struct Impl_Datagram {
     iMutex mutex;
     uint16_t port;
     int fd;
+    int family;         /* of the socket; destinations must have an address of this family */
     iAddress *address;
     iAddress *destination;
+    iEventLoop *loop;
+    iEventLoopId watcher;
     iCondition allSent;
     iCondition messageReceived;
     iQueue *output;
@@ -85,185 +86,104 @@ struct Impl_Datagram {
     iAudience *writeFinished;
 };
 
-iDeclareClass(DatagramThread)
-
-enum iDatagramThreadMode {
-    run_DatagramThreadMode,
-    stop_DatagramThreadMode,
-};
-
-struct Impl_DatagramThread {
-    iThread thread;
-    iPipe wakeup;
-    iMutex mutex;
-    iPtrSet datagrams;
-    iAtomicInt mode;
-};
-
 #define iMessageMaxDataSize 4096
 
-static iThreadResult run_DatagramThread_(iThread *thread) {
-    iDatagramThread *d = (iAny *) thread;
-    iMutex *mtx = &d->mutex;
-    while (d->mode == run_DatagramThreadMode) {
-        /* Wait for activity. */
-        fd_set reads, errors; {
-            FD_ZERO(&reads);
-            FD_ZERO(&errors);
-            FD_SET(output_Pipe(&d->wakeup), &reads);
-            int maxfd = output_Pipe(&d->wakeup);
-            iGuardMutex(mtx, {
-                iConstForEach(PtrSet, i, &d->datagrams) {
-                    const iDatagram *dgm = *i.value;
-                    FD_SET(dgm->fd, &reads);
-                    FD_SET(dgm->fd, &errors);
-                    maxfd = iMax(maxfd, dgm->fd);
-                }
-            });
-            int ready = select(maxfd + 1, &reads, NULL, &errors, NULL);
-            if (ready == -1) {
-                return errno;
-            }
-        }
-        /* Clear the wakeup. */
-        if (FD_ISSET(output_Pipe(&d->wakeup), &reads)) {
-            readByte_Pipe(&d->wakeup);
-        }
-        lock_Mutex(mtx); { // thread locked during datagram iteration
-            iForEach(PtrSet, i, &d->datagrams) {
-                iDatagram *dgm = *i.value;
-                /* Problem with the socket? */
-                if (FD_ISSET(dgm->fd, &errors)) {
-                    iWarning("[Datagram] socket %i has exception status\n", dgm->fd);
-                }
-                /* Check for incoming data. */
-                if (FD_ISSET(dgm->fd, &reads)) {
-                    char buf[iMessageMaxDataSize];
-                    struct sockaddr_storage addr;
-                    socklen_t addrSize = sizeof(addr);
-                    ssize_t dataSize = recvfrom(
-                        dgm->fd, buf, iMessageMaxDataSize - 1, 0, (struct sockaddr *) &addr, &addrSize);
-                    if (dataSize == -1) {
-                        iWarning("[Datagram] socket %i: error %i while receiving: %s\n",
-                                 dgm->fd, errno, strerror(errno));
-                        iNotifyAudienceArgs(dgm, error, DatagramError, errno, strerror(errno));
-                        /* Maybe remove the datagram from the set? */
-                    }
-                    /* Keep the data as a message. */ {
-                        iMessage *msg = new_Message();
-                        msg->address = newSockAddr_Address(&addr, addrSize, udp_SocketType);
-                        setData_Block(&msg->data, buf, dataSize);
-                        put_Queue(dgm->input, msg);
-                        iRelease(msg);
-                    }
-                    iGuardMutex(&dgm->mutex, signal_Condition(&dgm->messageReceived));
-                    if (dgm->message) {
-                        iNotifyAudience(dgm, message, DatagramMessage);
-                    }
-                }
-            }
-        }
-        unlock_Mutex(mtx);
-        /* Now that received messages have been handled, check for outgoing messages. */
-        lock_Mutex(mtx); {  // thread locked during datagram iteration
-            iForEach(PtrSet, i, &d->datagrams) {
-                iDatagram *dgm = *i.value;
-                iMessage *msg = NULL;
-                iBool didSend = iFalse;
-                while ((msg = tryTake_Queue(dgm->output)) != NULL) {
-                    socklen_t destLen;
-                    struct sockaddr *destAddr;
-                    getSockAddr_Address(msg->address, &destAddr, &destLen, AF_INET, 0);
-                    ssize_t rc = sendto(dgm->fd,
-                                        data_Block(&msg->data),
-                                        size_Block(&msg->data),
-                                        0,
-                                        destAddr,
-                                        destLen);
-                    if (rc != (ssize_t) size_Block(&msg->data)) {
-                        iWarning("[Datagram] socket %i: error %i while sending %zu bytes: %s\n",
-                                 dgm->fd,
-                                 errno,
-                                 size_Block(&msg->data),
-                                 strerror(errno));
-                        iNotifyAudienceArgs(dgm, error, DatagramError, errno, strerror(errno));
-                        /* Maybe remove the datagram from the set? */
-                    }
-                    iRelease(msg);
-                    didSend = iTrue;
-                }
-                if (didSend) {
-                    iGuardMutex(&dgm->mutex, signal_Condition(&dgm->allSent));
-                    if (dgm->writeFinished) {
-                        iNotifyAudience(dgm, writeFinished, DatagramWriteFinished);
-                    }
-                }
-            }
-        }
-        unlock_Mutex(mtx);
+static void receive_Datagram_(iDatagram *d) {
+    char buf[iMessageMaxDataSize];
+    struct sockaddr_storage addr;
+    socklen_t addrSize = sizeof(addr);
+    ssize_t dataSize = recvfrom(
+        d->fd, buf, iMessageMaxDataSize - 1, 0, (struct sockaddr *) &addr, &addrSize);
+    if (dataSize == -1) {
+        iWarning("[Datagram] socket %i: error %i while receiving: %s\n",
+                 d->fd, errno, strerror(errno));
+        iNotifyAudienceArgs(d, error, DatagramError, errno, strerror(errno));
+        return;
+    }
+    /* Keep the data as a message. */ {
+        iMessage *msg = new_Message();
+        msg->address = newSockAddr_Address(&addr, addrSize, udp_SocketType); /* may be unnamed */
+        setData_Block(&msg->data, buf, dataSize);
+        put_Queue(d->input, msg);
+        iRelease(msg);
+    }
+    iGuardMutex(&d->mutex, signal_Condition(&d->messageReceived));
+    if (d->message) {
+        iNotifyAudience(d, message, DatagramMessage);
     }
-    return 0;
-}
-
-static void init_DatagramThread(iDatagramThread *d) {
-    init_Thread(&d->thread, run_DatagramThread_);
-    setName_Thread(&d->thread, "DatagramThread");
-    init_Pipe(&d->wakeup);
-    init_Mutex(&d->mutex);
-    init_PtrSet(&d->datagrams);
-    d->mode = run_DatagramThreadMode;
 }
 
-static void deinit_DatagramThread(iDatagramThread *d) {
+static void send_Datagram_(iDatagram *d) {
+    iMessage *msg = NULL;
+    iBool didSend = iFalse;
+    while ((msg = tryTake_Queue(d->output)) != NULL) {
+        socklen_t destLen;
+        struct sockaddr *destAddr;
+        getSockAddr_Address(msg->address, &destAddr, &destLen, d->family, 0);
+        ssize_t rc = sendto(d->fd,
+                            data_Block(&msg->data),
+                            size_Block(&msg->data),
+                            0,
+                            destAddr,
+                            destLen);
+        if (rc != (ssize_t) size_Block(&msg->data)) {
+            iWarning("[Datagram] socket %i: error %i while sending %zu bytes: %s\n",
+                     d->fd,
+                     errno,
+                     size_Block(&msg->data),
+                     strerror(errno));
+            iNotifyAudienceArgs(d, error, DatagramError, errno, strerror(errno));
+        }
+        iRelease(msg);
+        didSend = iTrue;
+    }
     iGuardMutex(&d->mutex, {
-        deinit_PtrSet(&d->datagrams);
-        deinit_Mutex(&d->mutex);
-        deinit_Pipe(&d->wakeup);
+        /* Messages put in the queue after this will enable writing again. */
+        if (isEmpty_Queue(d->output)) {
+            setEvents_EventLoop(d->loop, d->watcher, read_EventLoopEvent);
+            signal_Condition(&d->allSent);
+        }
     });
+    if (didSend && d->writeFinished) {
+        iNotifyAudience(d, writeFinished, DatagramWriteFinished);
+    }
 }
 
-iDefineObjectConstruction(DatagramThread)
-
-iLocalDef void start_DatagramThread_(iDatagramThread *d) { start_Thread(&d->thread); }
-
-static void exit_DatagramThread_(iDatagramThread *d) {
-    d->mode = stop_DatagramThreadMode;
-    writeByte_Pipe(&d->wakeup, 1);
-    join_Thread(&d->thread);
-}
-
-static iDatagramThread *datagramIO_ = NULL;
-
-void init_DatagramThreads_(void) {
-    iAssert(datagramIO_ == NULL);
-    datagramIO_ = new_DatagramThread();
-    start_DatagramThread_(datagramIO_);
-}
-
-void deinit_DatagramThreads_(void) { /* called from deinit_Foundation */
-    if (datagramIO_) {
-        exit_DatagramThread_(datagramIO_);
-        iRelease(datagramIO_);
-        datagramIO_ = NULL;
+static void process_Datagram_(iAny *context, int fd, int events) {
+    iDatagram *d = context;
+    iUnused(fd);
+    /* Problem with the socket? */
+    if (events & error_EventLoopEvent) {
+        iWarning("[Datagram] socket %i has exception status\n", d->fd);
+    }
+    /* Check for incoming data. */
+    if (events & read_EventLoopEvent) {
+        receive_Datagram_(d);
+    }
+    /* Now that received messages have been handled, check for outgoing messages. */
+    if (events & write_EventLoopEvent) {
+        send_Datagram_(d);
     }
 }
 
-iDefineSubclass(DatagramThread, Thread)
-
 /*-------------------------------------------------------------------------------------*/
 
 iDefineObjectConstruction(Datagram)
 iDefineClass(Datagram)
-iDefineAudienceGetter(Datagram, error)
+iDefineDirectAudienceGetter(Datagram, error)
 iDefineAudienceGetter(Datagram, message)
 iDefineAudienceGetter(Datagram, writeFinished)
 
 void init_Datagram(iDatagram *d) {
     init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "Datagram");
     d->port = 0;
     d->fd = -1;
+    d->family = AF_INET;
     d->address = NULL;
     d->destination = NULL;
+    d->loop = NULL;
+    d->watcher = 0;
     init_Condition(&d->allSent);
     init_Condition(&d->messageReceived);
     d->output = new_Queue();
@@ -277,10 +197,18 @@ iBool isOpen_Datagram(const iDatagram *d) {
     return d->fd != -1;
 }
 
+static void startIO_Datagram_(iDatagram *d);
+
 uint16_t port_Datagram(const iDatagram *d) {
     return d->port;
 }
 
+void setEventLoop_Datagram(iDatagram *d, iEventLoop *loop) {
+    iAssert(!isOpen_Datagram(d));
+    iRelease(d->loop);
+    d->loop = ref_Object(loop);
+}
+
 iBool open_Datagram(iDatagram *d, uint16_t port) {
     if (isOpen_Datagram(d)) {
         return iFalse;
@@ -295,6 +223,7 @@ iBool open_Datagram(iDatagram *d, uint16_t port) {
         socklen_t sockLen;
         struct sockaddr *sockAddr;
         iSocketParameters sp = socketParametersFamily_Address(d->address, AF_INET);
+        d->family = AF_INET;
         d->fd = socket(sp.family, sp.type, sp.protocol);
         if (d->fd == -1) {
             iWarning("[Datagram] error creating socket\n");
@@ -314,27 +243,80 @@ iBool open_Datagram(iDatagram *d, uint16_t port) {
             return iFalse;
         }
     }
-    /* All open datagrams share the I/O thread. */ {
-        if (!datagramIO_) {
-            init_DatagramThreads_();
+    startIO_Datagram_(d);
+    return iTrue;
+}
+
+static const char *localPath_Datagram_(const iDatagram *d) {
+    /* Filesystem path of a local socket, if there is one. */
+    if (d->family == AF_UNIX && d->address) {
+        const char *path = cstr_String(hostName_Address(d->address));
+        if (*path && *path != '@') {
+            return path;
         }
-        iGuardMutex(&datagramIO_->mutex, insert_PtrSet(&datagramIO_->datagrams, d));
-        writeByte_Pipe(&datagramIO_->wakeup, 1); // update the set of waiting datagrams
     }
+    return NULL;
+}
+
+iBool openLocal_Datagram(iDatagram *d, const char *path) {
+    if (isOpen_Datagram(d)) {
+        return iFalse;
+    }
+    iRelease(d->address);
+    d->address = newLocal_Address(path, udp_SocketType);
+    d->port = 0;
+    d->family = AF_UNIX;
+    socklen_t sockLen;
+    struct sockaddr *sockAddr;
+    getSockAddr_Address(d->address, &sockAddr, &sockLen, AF_UNIX, 0);
+    if (!sockLen) {
+        iReleasePtr(&d->address);
+        return iFalse;
+    }
+    const char *filePath = localPath_Datagram_(d);
+    if (filePath) {
+        /* A socket file left behind by an earlier process would prevent binding. */
+        struct stat st;
+        if (!lstat(filePath, &st) && S_ISSOCK(st.st_mode)) {
+            unlink(filePath);
+        }
+    }
+    d->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (d->fd == -1 || bind(d->fd, sockAddr, sockLen) == -1) {
+        iWarning("[Datagram] error binding socket (%s): %s\n", path, strerror(errno));
+        if (d->fd != -1) {
+            close(d->fd);
+            d->fd = -1;
+        }
+        iReleasePtr(&d->address);
+        return iFalse;
+    }
+    startIO_Datagram_(d);
     return iTrue;
 }
 
+static void startIO_Datagram_(iDatagram *d) {
+    if (!d->loop) {
+        d->loop = ref_Object(shared_EventLoop());
+    }
+    iGuardMutex(&d->mutex, {
+        d->watcher = watch_EventLoop(
+            d->loop, d->fd, read_EventLoopEvent | write_EventLoopEvent, process_Datagram_, d);
+    });
+}
+
 void close_Datagram(iDatagram *d) {
     flush_Datagram(d);
-    /* Remove from the I/O thread. */
-    if (datagramIO_) {
-        iGuardMutex(&datagramIO_->mutex, remove_PtrSet(&datagramIO_->datagrams, d));
-        writeByte_Pipe(&datagramIO_->wakeup, 1); // update the set of waiting datagrams
-    }
+    /* The watcher's function locks the datagram, so it cannot be locked here. */
+    unwatch_EventLoop(d->loop, d->watcher);
     iGuardMutex(&d->mutex, {
+        d->watcher = 0;
         if (isOpen_Datagram(d)) {
             close(d->fd);
             d->fd = -1;
+            if (localPath_Datagram_(d)) {
+                unlink(localPath_Datagram_(d));
+            }
         }
     });
 }
@@ -344,6 +326,7 @@ void deinit_Datagram(iDatagram *d) {
     iGuardMutex(&d->mutex, {
         iRelease(d->address);
         iRelease(d->destination);
+        iRelease(d->loop);
         iRelease(d->output);
         iRelease(d->input);
         deinit_Condition(&d->allSent);
@@ -363,9 +346,13 @@ void send_Datagram(iDatagram *d, const iBlock *data, const iAddress *to) {
     waitForFinished_Address(to);
     msg->address = ref_Object(to);
     set_Block(&msg->data, data);
-    put_Queue(d->output, msg);
+    iGuardMutex(&d->mutex, {
+        put_Queue(d->output, msg);
+        if (d->watcher) {
+            setEvents_EventLoop(d->loop, d->watcher, read_EventLoopEvent | write_EventLoopEvent);
+        }
+    });
     iRelease(msg);
-    writeByte_Pipe(&datagramIO_->wakeup, 1);
 }
 
 void sendData_Datagram(iDatagram *d, const void *data, size_t size, const iAddress *to) {
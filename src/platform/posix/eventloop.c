@@ -0,0 +1,634 @@
+/** @file posix/eventloop.c  Event loop for file descriptors, timers, and posted calls.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "the_Foundation/eventloop.h"
+#include "the_Foundation/array.h"
+#include "the_Foundation/atomic.h"
+#include "the_Foundation/hash.h"
+#include "the_Foundation/mutex.h"
+#include "the_Foundation/ptrarray.h"
+#include "the_Foundation/thread.h"
+#include "the_Foundation/time.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#if defined (iHaveEpoll) && defined (iHaveTimerFd)
+#   define iEventLoopEpoll
+#   include <sys/epoll.h>
+#   include <sys/eventfd.h>
+#   include <sys/timerfd.h>
+#else
+#   include "pipe.h"
+#endif
+
+iDeclareType(EventLoopWatcher)
+iDeclareType(EventLoopTimer)
+iDeclareType(EventLoopCall)
+iDeclareType(EventLoopReady)
+
+struct Impl_EventLoopWatcher {
+    iHashNode        node; /* key is the ID */
+    int              fd;
+    int              events;
+    iEventLoopFdFunc func;
+    iAny *           context;
+};
+
+struct Impl_EventLoopTimer {
+    iHashNode      node; /* key is the ID */
+    uint64_t       due;      /* monotonic nanoseconds */
+    uint64_t       interval; /* nanoseconds; zero if the timer is not periodic */
+    iEventLoopFunc func;
+    iAny *         context;
+    iBool          isCancelled;
+};
+
+struct Impl_EventLoopCall {
+    iEventLoopFunc func;
+    iAny *         context;
+};
+
+struct Impl_EventLoopReady {
+    iEventLoopId watcher;
+    int          events;
+};
+
+struct Impl_EventLoop {
+    iObject      object;
+    iMutex       mutex;
+    iCondition   callFinished;
+    iHash        watchers;
+    iHash        timers;
+    iPtrArray    timerHeap; /* earliest first; cancelled timers are removed when reached */
+    iArray       posted;
+    iArray       ready;     /* used only by the loop thread */
+    iEventLoopId lastId;
+    iEventLoopId calling;   /* watcher or timer whose function is being called */
+    iAtomicInt   isQuitting;
+    iThread *    thread;
+#if defined (iEventLoopEpoll)
+    int          epollFd;
+    int          wakeFd;
+    int          timerFd;
+    uint64_t     armedDue;
+#else
+    iPipe        wakeup;
+#endif
+};
+
+iDefineClass(EventLoop)
+iDefineObjectConstruction(EventLoop)
+
+static iThreadLocal iEventLoop *currentLoop_;
+
+#if defined (iEventLoopEpoll)
+static const uint64_t wakeKey_EventLoop_  = UINT64_C(1) << 32;
+static const uint64_t timerKey_EventLoop_ = UINT64_C(2) << 32;
+#endif
+
+#if defined (iEventLoopEpoll)
+static uint32_t epollEvents_(int events) {
+    return (events & read_EventLoopEvent ? EPOLLIN : 0) |
+           (events & write_EventLoopEvent ? EPOLLOUT : 0);
+}
+#endif
+
+static void wake_EventLoop_(iEventLoop *d) {
+#if defined (iEventLoopEpoll)
+    const uint64_t one = 1;
+    const ssize_t written = write(d->wakeFd, &one, sizeof(one));
+    iUnused(written); /* counter may be saturated, which is fine */
+#else
+    writeByte_Pipe(&d->wakeup, 1); /* non-blocking; a full pipe is awake already */
+#endif
+}
+
+static iEventLoopId newId_EventLoop_(iEventLoop *d) {
+    /* Note: The loop is assumed to be locked already. */
+    do {
+        d->lastId++;
+    } while (d->lastId == 0 || contains_Hash(&d->watchers, d->lastId) ||
+             contains_Hash(&d->timers, d->lastId));
+    return d->lastId;
+}
+
+static void waitForCall_EventLoop_(iEventLoop *d, iEventLoopId id) {
+    /* Note: The loop is assumed to be locked already. */
+    if (!isCurrent_EventLoop(d)) {
+        while (d->calling == id) {
+            wait_Condition(&d->callFinished, &d->mutex);
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+static iBool isEarlier_EventLoopTimer_(const iEventLoopTimer *a, const iEventLoopTimer *b) {
+    return a->due < b->due || (a->due == b->due && a->node.key < b->node.key);
+}
+
+static iEventLoopTimer *heapAt_EventLoop_(iEventLoop *d, size_t pos) {
+    return at_PtrArray(&d->timerHeap, pos);
+}
+
+static void swapHeap_EventLoop_(iEventLoop *d, size_t a, size_t b) {
+    void *tmp = heapAt_EventLoop_(d, a);
+    set_PtrArray(&d->timerHeap, a, heapAt_EventLoop_(d, b));
+    set_PtrArray(&d->timerHeap, b, tmp);
+}
+
+static void pushHeap_EventLoop_(iEventLoop *d, iEventLoopTimer *timer) {
+    pushBack_PtrArray(&d->timerHeap, timer);
+    for (size_t pos = size_PtrArray(&d->timerHeap) - 1; pos > 0; ) {
+        const size_t parent = (pos - 1) / 2;
+        if (!isEarlier_EventLoopTimer_(heapAt_EventLoop_(d, pos), heapAt_EventLoop_(d, parent))) {
+            break;
+        }
+        swapHeap_EventLoop_(d, pos, parent);
+        pos = parent;
+    }
+}
+
+static void popHeap_EventLoop_(iEventLoop *d) {
+    const size_t size = size_PtrArray(&d->timerHeap) - 1;
+    swapHeap_EventLoop_(d, 0, size);
+    popBack_PtrArray(&d->timerHeap);
+    for (size_t pos = 0; ; ) {
+        size_t earliest = pos;
+        for (size_t child = 2 * pos + 1; child <= 2 * pos + 2 && child < size; child++) {
+            if (isEarlier_EventLoopTimer_(heapAt_EventLoop_(d, child),
+                                          heapAt_EventLoop_(d, earliest))) {
+                earliest = child;
+            }
+        }
+        if (earliest == pos) {
+            break;
+        }
+        swapHeap_EventLoop_(d, pos, earliest);
+        pos = earliest;
+    }
+}
+
+static iEventLoopTimer *nextTimer_EventLoop_(iEventLoop *d) {
+    /* Note: The loop is assumed to be locked already. */
+    while (!isEmpty_PtrArray(&d->timerHeap)) {
+        iEventLoopTimer *timer = heapAt_EventLoop_(d, 0);
+        if (!timer->isCancelled) {
+            return timer;
+        }
+        popHeap_EventLoop_(d);
+        free(timer);
+    }
+    return NULL;
+}
+
+static void armTimer_EventLoop_(iEventLoop *d) {
+    /* Note: The loop is assumed to be locked already. */
+#if defined (iEventLoopEpoll)
+    const iEventLoopTimer *next = nextTimer_EventLoop_(d);
+    const uint64_t due = next ? next->due : 0;
+    if (due != d->armedDue) {
+        struct itimerspec spec;
+        iZap(spec); /* disarmed */
+        spec.it_value.tv_sec  = (time_t) (due / 1000000000);
+        spec.it_value.tv_nsec = (long) (due % 1000000000);
+        timerfd_settime(d->timerFd, TFD_TIMER_ABSTIME, &spec, NULL);
+        d->armedDue = due;
+    }
+#else
+    /* The wait timeout is based on the next timer. */
+    wake_EventLoop_(d);
+#endif
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+void init_EventLoop(iEventLoop *d) {
+    init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "EventLoop");
+    init_Condition(&d->callFinished);
+    init_Hash(&d->watchers);
+    init_Hash(&d->timers);
+    init_PtrArray(&d->timerHeap);
+    init_Array(&d->posted, sizeof(iEventLoopCall));
+    init_Array(&d->ready, sizeof(iEventLoopReady));
+    d->lastId  = 0;
+    d->calling = 0;
+    set_Atomic(&d->isQuitting, iFalse);
+    d->thread = NULL;
+#if defined (iEventLoopEpoll)
+    d->epollFd  = epoll_create1(EPOLL_CLOEXEC);
+    d->wakeFd   = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    d->timerFd  = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    d->armedDue = 0;
+    iAssert(d->epollFd >= 0 && d->wakeFd >= 0 && d->timerFd >= 0);
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = wakeKey_EventLoop_ };
+    epoll_ctl(d->epollFd, EPOLL_CTL_ADD, d->wakeFd, &ev);
+    ev.data.u64 = timerKey_EventLoop_;
+    epoll_ctl(d->epollFd, EPOLL_CTL_ADD, d->timerFd, &ev);
+#else
+    init_Pipe(&d->wakeup);
+    fcntl(input_Pipe(&d->wakeup), F_SETFL, O_NONBLOCK);
+    fcntl(output_Pipe(&d->wakeup), F_SETFL, O_NONBLOCK);
+#endif
+}
+
+void deinit_EventLoop(iEventLoop *d) {
+    if (d->thread) {
+        iAssert(!isCurrent_EventLoop(d));
+        quit_EventLoop(d);
+        join_Thread(d->thread);
+        iReleasePtr(&d->thread);
+    }
+    iForEach(Hash, i, &d->watchers) {
+        free(remove_HashIterator(&i));
+    }
+    /* Cancelled timers are only in the heap. */
+    iForEach(PtrArray, j, &d->timerHeap) {
+        free(j.ptr);
+    }
+    deinit_PtrArray(&d->timerHeap);
+    deinit_Hash(&d->timers);
+    deinit_Hash(&d->watchers);
+    deinit_Array(&d->posted);
+    deinit_Array(&d->ready);
+#if defined (iEventLoopEpoll)
+    close(d->timerFd);
+    close(d->wakeFd);
+    close(d->epollFd);
+#else
+    deinit_Pipe(&d->wakeup);
+#endif
+    deinit_Condition(&d->callFinished);
+    deinit_Mutex(&d->mutex);
+}
+
+static iThreadResult run_EventLoopThread_(iThread *thd) {
+    run_EventLoop(userData_Thread(thd));
+    return 0;
+}
+
+void start_EventLoop(iEventLoop *d) {
+    iAssert(d->thread == NULL);
+    d->thread = new_Thread(run_EventLoopThread_);
+    setName_Thread(d->thread, "EventLoop");
+    setUserData_Thread(d->thread, d);
+    start_Thread(d->thread);
+}
+
+void quit_EventLoop(iEventLoop *d) {
+    set_Atomic(&d->isQuitting, iTrue);
+    wake_EventLoop_(d);
+}
+
+void run_EventLoop(iEventLoop *d) {
+    while (!value_Atomic(&d->isQuitting)) {
+        processEvents_EventLoop(d, -1.0);
+    }
+    set_Atomic(&d->isQuitting, iFalse);
+}
+
+iBool isCurrent_EventLoop(const iEventLoop *d) {
+    return currentLoop_ == d;
+}
+
+static void wait_EventLoop_(iEventLoop *d, double timeoutSeconds) {
+    /* Collects the ready watchers in `d->ready`. */
+    clear_Array(&d->ready);
+    int timeoutMs = -1;
+    lock_Mutex(&d->mutex);
+    if (!isEmpty_Array(&d->posted)) {
+        timeoutMs = 0;
+    }
+    else if (timeoutSeconds >= 0.0) {
+        timeoutMs = (int) (timeoutSeconds * 1000.0 + 0.999);
+    }
+#if defined (iEventLoopEpoll)
+    unlock_Mutex(&d->mutex);
+    struct epoll_event events[64];
+    const int count = epoll_wait(d->epollFd, events, iElemCount(events), timeoutMs);
+    for (int i = 0; i < count; i++) {
+        const uint64_t key = events[i].data.u64;
+        if (key == wakeKey_EventLoop_ || key == timerKey_EventLoop_) {
+            uint64_t value;
+            const ssize_t got = read(key == wakeKey_EventLoop_ ? d->wakeFd : d->timerFd,
+                                     &value, sizeof(value));
+            iUnused(got); /* only the wakeup matters */
+            if (key == timerKey_EventLoop_) {
+                iGuardMutex(&d->mutex, d->armedDue = 0); /* expired */
+            }
+            continue;
+        }
+        const uint32_t flags = events[i].events;
+        iEventLoopReady ready = { (iEventLoopId) key, 0 };
+        if (flags & EPOLLIN) {
+            ready.events |= read_EventLoopEvent;
+        }
+        if (flags & EPOLLOUT) {
+            ready.events |= write_EventLoopEvent;
+        }
+        if (flags & (EPOLLERR | EPOLLHUP)) {
+            ready.events |= error_EventLoopEvent | read_EventLoopEvent;
+        }
+        pushBack_Array(&d->ready, &ready);
+    }
+#else
+    const iEventLoopTimer *next = nextTimer_EventLoop_(d);
+    if (next) {
+        const uint64_t now = monotonicNanoseconds_Time();
+        const int untilDue = next->due > now ? (int) ((next->due - now + 999999) / 1000000) : 0;
+        timeoutMs = timeoutMs < 0 ? untilDue : iMin(timeoutMs, untilDue);
+    }
+    iArray fds;
+    init_Array(&fds, sizeof(struct pollfd));
+    pushBack_Array(&fds, &(struct pollfd){ output_Pipe(&d->wakeup), POLLIN, 0 });
+    iConstForEach(Hash, i, &d->watchers) {
+        const iEventLoopWatcher *w = (const iEventLoopWatcher *) i.value;
+        struct pollfd pfd = { w->fd, 0, 0 };
+        if (w->events & read_EventLoopEvent) {
+            pfd.events |= POLLIN;
+        }
+        if (w->events & write_EventLoopEvent) {
+            pfd.events |= POLLOUT;
+        }
+        pushBack_Array(&fds, &pfd);
+        pushBack_Array(&d->ready, &(iEventLoopReady){ w->node.key, 0 });
+    }
+    unlock_Mutex(&d->mutex);
+    if (poll(data_Array(&fds), size_Array(&fds), timeoutMs) > 0) {
+        const struct pollfd *pfd = constData_Array(&fds);
+        if (pfd[0].revents & POLLIN) {
+            uint8_t buf[64];
+            while (read_Pipe(&d->wakeup, sizeof(buf), buf) == sizeof(buf)) {}
+        }
+        iForEach(Array, j, &d->ready) {
+            iEventLoopReady *ready = j.value;
+            const short flags = pfd[index_ArrayIterator(&j) + 1].revents;
+            if (flags & POLLIN) {
+                ready->events |= read_EventLoopEvent;
+            }
+            if (flags & POLLOUT) {
+                ready->events |= write_EventLoopEvent;
+            }
+            if (flags & (POLLERR | POLLHUP | POLLNVAL)) {
+                ready->events |= error_EventLoopEvent | read_EventLoopEvent;
+            }
+        }
+    }
+    else {
+        clear_Array(&d->ready);
+    }
+    deinit_Array(&fds);
+#endif
+}
+
+static size_t dispatchReady_EventLoop_(iEventLoop *d) {
+    size_t count = 0;
+    lock_Mutex(&d->mutex);
+    iConstForEach(Array, i, &d->ready) {
+        const iEventLoopReady *ready = i.value;
+        /* The watcher may have been removed or changed since the wait. */
+        const iEventLoopWatcher *w = (const iEventLoopWatcher *) value_Hash(&d->watchers,
+                                                                            ready->watcher);
+        if (!w) {
+            continue;
+        }
+        const int events = ready->events & (w->events | error_EventLoopEvent);
+        if (!events) {
+            continue;
+        }
+        const iEventLoopFdFunc func    = w->func;
+        iAny *                 context = w->context;
+        const int              fd      = w->fd;
+        d->calling = ready->watcher;
+        unlock_Mutex(&d->mutex);
+        func(context, fd, events);
+        lock_Mutex(&d->mutex);
+        d->calling = 0;
+        signalAll_Condition(&d->callFinished);
+        count++;
+    }
+    unlock_Mutex(&d->mutex);
+    return count;
+}
+
+static size_t dispatchTimers_EventLoop_(iEventLoop *d) {
+    size_t count = 0;
+    lock_Mutex(&d->mutex);
+    const uint64_t now = monotonicNanoseconds_Time();
+    iEventLoopTimer *timer;
+    while ((timer = nextTimer_EventLoop_(d)) != NULL && timer->due <= now) {
+        const iEventLoopId   id      = timer->node.key;
+        const iEventLoopFunc func    = timer->func;
+        iAny *               context = timer->context;
+        popHeap_EventLoop_(d);
+        if (timer->interval) {
+            /* Missed calls are skipped. */
+            timer->due += timer->interval;
+            if (timer->due <= now) {
+                timer->due = now + timer->interval;
+            }
+            pushHeap_EventLoop_(d, timer);
+        }
+        else {
+            remove_Hash(&d->timers, id);
+            free(timer);
+        }
+        d->calling = id;
+        unlock_Mutex(&d->mutex);
+        func(context);
+        lock_Mutex(&d->mutex);
+        d->calling = 0;
+        signalAll_Condition(&d->callFinished);
+        count++;
+    }
+    armTimer_EventLoop_(d);
+    unlock_Mutex(&d->mutex);
+    return count;
+}
+
+static size_t dispatchPosted_EventLoop_(iEventLoop *d) {
+    size_t count = 0;
+    lock_Mutex(&d->mutex);
+    /* Calls posted during these calls are made on the next round. */
+    for (size_t n = size_Array(&d->posted); n > 0; n--) {
+        iEventLoopCall call;
+        take_Array(&d->posted, 0, &call);
+        unlock_Mutex(&d->mutex);
+        call.func(call.context);
+        lock_Mutex(&d->mutex);
+        count++;
+    }
+    unlock_Mutex(&d->mutex);
+    return count;
+}
+
+size_t processEvents_EventLoop(iEventLoop *d, double timeoutSeconds) {
+    iEventLoop *outer = currentLoop_;
+    currentLoop_ = d;
+    wait_EventLoop_(d, timeoutSeconds);
+    size_t count = dispatchReady_EventLoop_(d);
+    count += dispatchTimers_EventLoop_(d);
+    count += dispatchPosted_EventLoop_(d);
+    currentLoop_ = outer;
+    return count;
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+iEventLoopId watch_EventLoop(iEventLoop *d, int fd, int events, iEventLoopFdFunc func,
+                             iAny *context) {
+    iAssert(fd >= 0);
+    iAssert(func);
+    iEventLoopWatcher *w = iMalloc(EventLoopWatcher);
+    w->fd      = fd;
+    w->events  = events;
+    w->func    = func;
+    w->context = context;
+    lock_Mutex(&d->mutex);
+    w->node.key = newId_EventLoop_(d);
+#if defined (iEventLoopEpoll)
+    struct epoll_event ev = { .events = epollEvents_(events), .data.u64 = w->node.key };
+    if (epoll_ctl(d->epollFd, EPOLL_CTL_ADD, fd, &ev)) {
+        iWarning("[EventLoop] cannot watch fd %d: %s\n", fd, strerror(errno));
+        unlock_Mutex(&d->mutex);
+        free(w);
+        return 0;
+    }
+#endif
+    insert_Hash(&d->watchers, &w->node);
+    const iEventLoopId id = w->node.key;
+#if !defined (iEventLoopEpoll)
+    wake_EventLoop_(d);
+#endif
+    unlock_Mutex(&d->mutex);
+    return id;
+}
+
+void setEvents_EventLoop(iEventLoop *d, iEventLoopId watcher, int events) {
+    lock_Mutex(&d->mutex);
+    iEventLoopWatcher *w = (iEventLoopWatcher *) value_Hash(&d->watchers, watcher);
+    if (w && w->events != events) {
+        w->events = events;
+#if defined (iEventLoopEpoll)
+        struct epoll_event ev = { .events = epollEvents_(events), .data.u64 = watcher };
+        epoll_ctl(d->epollFd, EPOLL_CTL_MOD, w->fd, &ev);
+#else
+        wake_EventLoop_(d);
+#endif
+    }
+    unlock_Mutex(&d->mutex);
+}
+
+void unwatch_EventLoop(iEventLoop *d, iEventLoopId watcher) {
+    if (!watcher) {
+        return;
+    }
+    lock_Mutex(&d->mutex);
+    iEventLoopWatcher *w = (iEventLoopWatcher *) remove_Hash(&d->watchers, watcher);
+    if (w) {
+#if defined (iEventLoopEpoll)
+        epoll_ctl(d->epollFd, EPOLL_CTL_DEL, w->fd, NULL);
+#else
+        wake_EventLoop_(d);
+#endif
+        free(w);
+    }
+    waitForCall_EventLoop_(d, watcher);
+    unlock_Mutex(&d->mutex);
+}
+
+iEventLoopId addTimer_EventLoop(iEventLoop *d, double delaySeconds, double intervalSeconds,
+                                iEventLoopFunc func, iAny *context) {
+    iAssert(func);
+    iEventLoopTimer *timer = iMalloc(EventLoopTimer);
+    timer->due         = monotonicNanoseconds_Time() + (uint64_t) (iMax(0.0, delaySeconds) * 1.0e9);
+    timer->interval    = (uint64_t) (iMax(0.0, intervalSeconds) * 1.0e9);
+    timer->func        = func;
+    timer->context     = context;
+    timer->isCancelled = iFalse;
+    iEventLoopId id;
+    iGuardMutex(&d->mutex, {
+        id = timer->node.key = newId_EventLoop_(d);
+        insert_Hash(&d->timers, &timer->node);
+        pushHeap_EventLoop_(d, timer);
+        if (nextTimer_EventLoop_(d) == timer) {
+            armTimer_EventLoop_(d);
+        }
+    });
+    return id;
+}
+
+iBool cancelTimer_EventLoop(iEventLoop *d, iEventLoopId timer) {
+    if (!timer) {
+        return iFalse;
+    }
+    lock_Mutex(&d->mutex);
+    iEventLoopTimer *t = (iEventLoopTimer *) remove_Hash(&d->timers, timer);
+    if (t) {
+        t->isCancelled = iTrue; /* freed when it reaches the top of the heap */
+    }
+    waitForCall_EventLoop_(d, timer);
+    unlock_Mutex(&d->mutex);
+    return t != NULL;
+}
+
+void post_EventLoop(iEventLoop *d, iEventLoopFunc func, iAny *context) {
+    iAssert(func);
+    const iEventLoopCall call = { func, context };
+    iGuardMutex(&d->mutex, {
+        pushBack_Array(&d->posted, &call);
+        wake_EventLoop_(d);
+    });
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+static iAtomicPtr sharedLoop_;
+
+iEventLoop *shared_EventLoop(void) {
+    iEventLoop *d = value_Atomic(&sharedLoop_);
+    if (!d) {
+        void *expected = NULL;
+        d = new_EventLoop();
+        if (!compareExchange_Atomic(&sharedLoop_, &expected, d)) {
+            iRelease(d);
+            d = expected;
+        }
+        else {
+            start_EventLoop(d);
+        }
+    }
+    return d;
+}
+
+void deinit_SharedEventLoop_(void) { /* called from deinit_Foundation */
+    iRelease(exchange_Atomic(&sharedLoop_, NULL));
+}
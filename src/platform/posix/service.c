@@ -26,86 +26,184 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
 #include "the_Foundation/service.h"
+#include "the_Foundation/address.h"
+#include "the_Foundation/eventloop.h"
 #include "the_Foundation/socket.h"
 #include "the_Foundation/string.h"
-#include "the_Foundation/thread.h"
-#include "pipe.h"
 
 #include <netdb.h>
 #include <unistd.h>
-#include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
 
+#define iServiceRetryDelay  1.0 /* seconds until accepting is resumed after an error */
+
 struct Impl_Service {
     iObject object;
     uint16_t port;
+    iAddress *local;  /* Unix domain socket address, or NULL for TCP */
     int fd;
-    iPipe stop;
-    iThread *listening;
+    iEventLoop *loop;
+    iBool isUserLoop; /* accepted sockets use the loop, too */
+    iEventLoopId listening;
+    iEventLoopId retry;       /* timer for resuming after an error */
     iAudience *incomingAccepted;
+    iAudience *incomingFd;
 };
 
-iDefineAudienceGetter(Service, incomingAccepted)
+iDefineDirectAudienceGetter(Service, incomingAccepted)
+iDefineDirectAudienceGetter(Service, incomingFd)
 
 iDefineObjectConstructionArgs(Service, (uint16_t port), port)
 
-static iThreadResult listen_Service_(iThread *thd) {
-    iService *d = userData_Thread(thd);
-    while (d->fd >= 0) {
-        /* Wait for activity. */
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(d->fd, &fds);
-        FD_SET(output_Pipe(&d->stop), &fds);
-        const int maxfds = iMax(d->fd, output_Pipe(&d->stop));
-        if (select(maxfds + 1, &fds, NULL, NULL, NULL) == -1) {
-            break;
-        }
-        if (FD_ISSET(output_Pipe(&d->stop), &fds)) {
-            break;
-        }
-        if (FD_ISSET(d->fd, &fds)) {
-            struct sockaddr_storage addr;
-            socklen_t size = sizeof(addr);
-            int incoming = accept(d->fd, (struct sockaddr *) &addr, &size);
-            if (incoming < 0) {
-                iWarning("[Service] error on accept: %s\n", strerror(errno));
-                break;
-            }
-            iSocket *socket = newExisting_Socket(incoming, &addr, size, tcp_SocketType);
-            iNotifyAudienceArgs(d, incomingAccepted, ServiceIncomingAccepted, socket);
-            iRelease(socket);
+/* address.c */
+int getSockAddr_Address(const iAddress *  d,
+                        struct sockaddr **addr_out,
+                        socklen_t *       addrSize_out,
+                        int               family,
+                        int               indexInFamily);
+
+/* socket.c */
+iSocket *newExistingLoop_Socket_(int fd, const void *sockAddr, size_t sockAddrSize,
+                                 enum iSocketType socketType, iEventLoop *loop);
+
+static void accept_Service_(iAny *context, int fd, int events);
+
+static void resume_Service_(iAny *context) {
+    iService *d = context;
+    d->retry = 0;
+    if (d->fd >= 0 && !d->listening) {
+        d->listening = watch_EventLoop(d->loop, d->fd, read_EventLoopEvent, accept_Service_, d);
+    }
+}
+
+static void pause_Service_(iService *d) {
+    /* The listening socket is level-triggered, so it would be reported again right away.
+       For example, running out of file descriptors lasts until some are closed. */
+    unwatch_EventLoop(d->loop, d->listening);
+    d->listening = 0;
+    d->retry = addTimer_EventLoop(d->loop, iServiceRetryDelay, 0.0, resume_Service_, d);
+}
+
+static void accept_Service_(iAny *context, int fd, int events) {
+    iService *d = context;
+    if (events & error_EventLoopEvent) {
+        iWarning("[Service] error on listening socket\n");
+        pause_Service_(d);
+        return;
+    }
+    struct sockaddr_storage addr;
+    socklen_t size = sizeof(addr);
+    int incoming = accept(fd, (struct sockaddr *) &addr, &size);
+    if (incoming < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+            errno != ECONNABORTED) {
+            iWarning("[Service] error on accept: %s\n", strerror(errno));
+            pause_Service_(d);
         }
+        return;
+    }
+    if (d->incomingFd && !isEmpty_Audience(d->incomingFd)) {
+        /* The observers will pass the connection on, e.g., to another process. */
+        iNotifyAudienceArgs(d, incomingFd, ServiceIncomingFd, incoming);
+        return;
     }
-    iReleasePtr(&d->listening);
-    return 0;
+    iSocket *socket = newExistingLoop_Socket_(
+        incoming, &addr, size, tcp_SocketType, d->isUserLoop ? d->loop : NULL);
+    iNotifyAudienceArgs(d, incomingAccepted, ServiceIncomingAccepted, socket);
+    iRelease(socket);
+}
+
+iService *newLocal_Service(const char *path) {
+    iService *d = new_Service(0);
+    d->local = newLocal_Address(path, tcp_SocketType);
+    return d;
 }
 
 void init_Service(iService *d, uint16_t port) {
     d->port = port;
+    d->local = NULL;
     d->fd = -1;
-    d->listening = NULL;
-    init_Pipe(&d->stop);
-    d->incomingAccepted = new_Audience();
+    d->loop = NULL;
+    d->isUserLoop = iFalse;
+    d->listening = 0;
+    d->retry = 0;
+    d->incomingAccepted = newDirect_Audience();
+    d->incomingFd = NULL;
 }
 
 void deinit_Service(iService *d) {
     close_Service(d);
-    deinit_Pipe(&d->stop);
-    iAssert(d->listening == NULL);
+    iAssert(d->listening == 0);
     iAssert(d->fd < 0);
+    iRelease(d->loop);
+    iRelease(d->local);
     delete_Audience(d->incomingAccepted);
+    delete_Audience(d->incomingFd);
 }
 
 iBool isOpen_Service(const iService *d) {
     return d->fd >= 0;
 }
 
+void setEventLoop_Service(iService *d, iEventLoop *loop) {
+    iAssert(!isOpen_Service(d));
+    iRelease(d->loop);
+    d->loop = ref_Object(loop);
+    d->isUserLoop = (loop != NULL);
+}
+
+static const char *localPath_Service_(const iService *d) {
+    /* Filesystem path of the local socket, if there is one. */
+    if (d->local) {
+        const char *path = cstr_String(hostName_Address(d->local));
+        if (*path && *path != '@') {
+            return path;
+        }
+    }
+    return NULL;
+}
+
+static iBool openLocal_Service_(iService *d) {
+    struct sockaddr *addr;
+    socklen_t addrSize;
+    getSockAddr_Address(d->local, &addr, &addrSize, AF_UNIX, 0);
+    if (!addrSize) {
+        return iFalse;
+    }
+    const char *path = localPath_Service_(d);
+    if (path) {
+        /* A socket file left behind by an earlier process would prevent binding. */
+        struct stat st;
+        if (!lstat(path, &st) && S_ISSOCK(st.st_mode)) {
+            unlink(path);
+        }
+    }
+    d->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (d->fd < 0) {
+        iWarning("[Service] failed to open socket: %s\n", strerror(errno));
+        return iFalse;
+    }
+    if (bind(d->fd, addr, addrSize) < 0 || listen(d->fd, 10) < 0) {
+        iWarning("[Service] failed to listen on %s: %s\n",
+                 cstr_String(hostName_Address(d->local)), strerror(errno));
+        close(d->fd);
+        d->fd = -1;
+        return iFalse;
+    }
+    return iTrue;
+}
+
 iBool open_Service(iService *d) {
     if (isOpen_Service(d)) return iFalse;
-    /* Set up the socket. */ {
+    if (d->local) {
+        if (!openLocal_Service_(d)) {
+            return iFalse;
+        }
+    }
+    else /* Set up the socket. */ {
         struct addrinfo *info, hints = {
             .ai_socktype = SOCK_STREAM,
 #if defined (iPlatformCygwin)
@@ -143,20 +241,28 @@ iBool open_Service(iService *d) {
             return iFalse;
         }
     }
-    d->listening = new_Thread(listen_Service_);
-    setUserData_Thread(d->listening, d);
-    start_Thread(d->listening);
+    if (!d->loop) {
+        d->loop = ref_Object(shared_EventLoop());
+    }
+    d->listening = watch_EventLoop(d->loop, d->fd, read_EventLoopEvent, accept_Service_, d);
     return iTrue;
 }
 
 void close_Service(iService *d) {
-    if (d->listening) {
-        /* Signal the listening thread to stop. */
-        writeByte_Pipe(&d->stop, 1);
-        close(d->fd);
+    if (d->fd >= 0) {
+        /* Once `fd` is cleared, a retry no longer starts watching again. An error that
+           occurs before the watcher is removed may still set up a new retry. */
+        const int fd = d->fd;
         d->fd = -1;
-        join_Thread(d->listening);
-        iAssert(d->listening == NULL);
+        cancelTimer_EventLoop(d->loop, d->retry);
+        unwatch_EventLoop(d->loop, d->listening);
+        cancelTimer_EventLoop(d->loop, d->retry);
+        d->retry = 0;
+        d->listening = 0;
+        close(fd);
+        if (localPath_Service_(d)) {
+            unlink(localPath_Service_(d));
+        }
     }
 }
 
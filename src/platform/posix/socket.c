@@ -27,7 +27,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 
 #include "the_Foundation/socket.h"
 #include "the_Foundation/buffer.h"
+#include "the_Foundation/eventloop.h"
 #include "the_Foundation/mutex.h"
+#include "the_Foundation/ptrarray.h"
 #include "the_Foundation/thread.h"
 #include "the_Foundation/atomic.h"
 #include "pipe.h"
@@ -35,11 +37,35 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
-static const int connectionTimeoutSeconds_Socket_ = 6;
+static const double defaultAttemptDelay_Socket_   = 0.25; /* seconds; RFC 8305 */
+static const double defaultConnectTimeout_Socket_ = 6.0;
+
+enum iSocketOutputLimits {
+    coalesceSize_Socket_ = 0x4000,  /* smaller writes are appended to the previous block */
+    maxVectors_Socket_   = 64,      /* blocks gathered for one sendmsg() */
+    maxSendSize_Socket_  = 0x10000, /* bytes gathered for one sendmsg() */
+    maxReceivedFds_Socket_ = 16,    /* descriptors accepted by one recvmsg() */
+};
+
+#if defined (MSG_NOSIGNAL)
+#   define iSendFlags   MSG_NOSIGNAL
+#else
+#   define iSendFlags   0
+#endif
+
+#if defined (MSG_CMSG_CLOEXEC)
+#   define iReceiveFlags    MSG_CMSG_CLOEXEC
+#else
+#   define iReceiveFlags    0
+#endif
 
 /* address.c */
 int getSockAddr_Address(const iAddress *  d,
@@ -49,20 +75,150 @@ int getSockAddr_Address(const iAddress *  d,
                         int               indexInFamily);
 
 iDeclareType(SocketThread)
+iDeclareType(SocketConnectAttempt)
+
+struct Impl_SocketConnectAttempt {
+    int fd;
+    iEventLoopId watcher;
+};
+
+/*-------------------------------------------------------------------------------------*/
+
+iDeclareType(SocketQueue)
+
+struct Impl_SocketQueue {
+    iPtrArray blocks;   /* iBlock *; oldest first */
+    size_t pos;         /* bytes of the first block already consumed */
+    size_t size;        /* total number of bytes queued */
+    iBlock *tail;       /* last block, if small writes can be appended to it */
+};
+
+static void init_SocketQueue_(iSocketQueue *d) {
+    init_PtrArray(&d->blocks);
+    d->pos  = 0;
+    d->size = 0;
+    d->tail = NULL;
+}
+
+static void deinit_SocketQueue_(iSocketQueue *d) {
+    iForEach(PtrArray, i, &d->blocks) {
+        delete_Block(i.ptr);
+    }
+    deinit_PtrArray(&d->blocks);
+}
+
+static void appendData_SocketQueue_(iSocketQueue *d, const void *data, size_t size) {
+    if (d->tail && size_Block(d->tail) + size <= coalesceSize_Socket_) {
+        appendData_Block(d->tail, data, size);
+    }
+    else {
+        iBlock *block = newData_Block(data, size);
+        pushBack_PtrArray(&d->blocks, block);
+        d->tail = (size < coalesceSize_Socket_ ? block : NULL);
+    }
+    d->size += size;
+}
+
+static void prependData_SocketQueue_(iSocketQueue *d, const void *data, size_t size) {
+    /* Nothing of the first block may have been consumed yet. */
+    iAssert(d->pos == 0);
+    pushFront_PtrArray(&d->blocks, newData_Block(data, size));
+    d->size += size;
+}
+
+static void appendBlock_SocketQueue_(iSocketQueue *d, const iBlock *block) {
+    /* The data is shared with `block`, so nothing must be appended to it. */
+    pushBack_PtrArray(&d->blocks, copy_Block(block));
+    d->tail = NULL;
+    d->size += size_Block(block);
+}
+
+static void consume_SocketQueue_(iSocketQueue *d, size_t size) {
+    d->size -= size;
+    while (size > 0) {
+        iBlock *first = front_PtrArray(&d->blocks);
+        const size_t avail = size_Block(first) - d->pos;
+        if (size < avail) {
+            d->pos += size;
+            break;
+        }
+        size -= avail;
+        d->pos = 0;
+        if (first == d->tail) {
+            d->tail = NULL;
+        }
+        delete_Block(first);
+        popFront_PtrArray(&d->blocks);
+    }
+}
+
+static size_t read_SocketQueue_(iSocketQueue *d, size_t size, void *data_out) {
+    size_t readSize = 0;
+    iConstForEach(PtrArray, i, &d->blocks) {
+        if (readSize == size) {
+            break;
+        }
+        const size_t offset = (readSize == 0 ? d->pos : 0);
+        const size_t count  = iMin(size_Block(i.ptr) - offset, size - readSize);
+        memcpy((char *) data_out + readSize, (const char *) constData_Block(i.ptr) + offset,
+               count);
+        readSize += count;
+    }
+    consume_SocketQueue_(d, readSize);
+    return readSize;
+}
+
+static iBlock *takeAll_SocketQueue_(iSocketQueue *d) {
+    if (size_PtrArray(&d->blocks) == 1 && d->pos == 0) {
+        /* The only block is handed over as is. */
+        iBlock *block = front_PtrArray(&d->blocks);
+        popFront_PtrArray(&d->blocks);
+        d->tail = NULL;
+        d->size = 0;
+        return block;
+    }
+    iBlock *data = new_Block(d->size);
+    read_SocketQueue_(d, d->size, data_Block(data));
+    return data;
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+iDeclareClass(SocketLink)
 
 struct Impl_Socket {
     iStream stream;
-    iBuffer *output;
+    iSocketQueue output;        /* waiting to be sent */
+    size_t highWaterMark;       /* writers wait when this much output is queued (0: never) */
+    size_t lowWaterMark;        /* writers may continue when output has drained to this */
+    iBool noDelay;
+    iBool cork;
     iBuffer *input;
+    iArray receivedFds;         /* int; descriptors passed over a local socket */
+    iBool isLocal;              /* Unix domain socket */
     enum iSocketStatus status;
     enum iSocketType type;
     iAddress *address;
     int fd;
-    iPipe *stopConnect;
-    iThread *connecting;
+    iEventLoop *loop;           /* for connecting, and for I/O if `isOnLoop` */
+    iBool isOnLoop;             /* I/O happens in the loop instead of a SocketThread */
+    iArray connAttempts;        /* iSocketConnectAttempt; connections being formed */
+    iArray connOrder;           /* int; address indices in the order they are tried */
+    size_t connNext;            /* position of the next address in `connOrder` */
+    int connError;              /* error from the latest failed attempt */
+    iEventLoopId connTimer;     /* starts connecting, or the next attempt */
+    iEventLoopId connDeadline;  /* gives up connecting */
+    double attemptDelay;
+    double connectTimeout;
+    iEventLoopId ioWatcher;
     iSocketThread *thread;
     iCondition allSent;
+    iCondition drained;         /* output is at or below the low water mark */
+    iBool isSendingFd;          /* sendFd_Socket() in progress; other output waits */
+    iCondition fdSent;
     iMutex mutex;
+    iSocketLink *link;          /* in-process pair; data is exchanged via the link */
+    int linkEnd;
     /* Audiences: */
     iAudience *connected;
     iAudience *disconnected;
@@ -77,9 +233,9 @@ static void shutdown_Socket_(iSocket *d);
 
 iDefineAudienceGetter(Socket, connected)
 iDefineAudienceGetter(Socket, disconnected)
-iDefineAudienceGetter(Socket, error)
+iDefineDirectAudienceGetter(Socket, error)
 iDefineAudienceGetter(Socket, readyRead)
-iDefineAudienceGetter(Socket, bytesWritten)
+iDefineDirectAudienceGetter(Socket, bytesWritten)
 iDefineAudienceGetter(Socket, writeFinished)
 
 /*-------------------------------------------------------------------------------------*/
@@ -99,18 +255,55 @@ struct Impl_SocketThread {
 };
 
 static void setError_Socket_(iSocket *d, int number, const char *message);
+static void sendOutput_Socket_(iSocket *d);
+
+static ssize_t receive_Socket_(iSocket *d, int fd, void *buf, size_t size) {
+    /* Called in the socket's I/O thread or in the event loop thread. */
+    if (!d->isLocal) {
+        return recv(fd, buf, size, 0);
+    }
+    /* Descriptors passed with the data are kept until they are taken. */
+    union {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof(int) * maxReceivedFds_Socket_)];
+    } control;
+    struct iovec vec = { .iov_base = buf, .iov_len = size };
+    struct msghdr msg;
+    iZap(msg);
+    msg.msg_iov        = &vec;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    const ssize_t readSize = recvmsg(fd, &msg, iReceiveFlags);
+    if (readSize > 0) {
+        if (msg.msg_flags & MSG_CTRUNC) {
+            iWarning("[Socket] some of the received descriptors were discarded\n");
+        }
+        lock_Mutex(&d->mutex);
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                pushBackN_Array(&d->receivedFds,
+                                CMSG_DATA(cmsg),
+                                (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            }
+        }
+        unlock_Mutex(&d->mutex);
+    }
+    return readSize;
+}
+
+static iBool hasOutput_Socket_(iSocket *d) {
+    iBool has;
+    iGuardMutex(&d->mutex, has = (d->output.size > 0 && !d->isSendingFd));
+    return has;
+}
 
 static iThreadResult run_SocketThread_(iThread *thread) {
     iSocketThread *d = (iAny *) thread;
     iMutex *smx = &d->socket->mutex;
     iBlock *inbuf = collect_Block(new_Block(0x20000));
-    iGuardMutex(smx, {
-        /* Connection has been formed. */
-        delete_Pipe(d->socket->stopConnect);
-        d->socket->stopConnect = NULL;
-    });
     while (value_Atomic(&d->mode) == run_SocketThreadMode) {
-        if (bytesToSend_Socket(d->socket) > 0) {
+        if (hasOutput_Socket_(d->socket)) {
             /* Make sure we won't block on select() when there's still data to send. */
             writeByte_Pipe(&d->wakeup, 0);
         }
@@ -133,7 +326,8 @@ static iThreadResult run_SocketThread_(iThread *thread) {
         }
         /* Check for incoming data. */
         if (FD_ISSET(d->socket->fd, &reads)) {
-            ssize_t readSize = recv(d->socket->fd, data_Block(inbuf), size_Block(inbuf), 0);
+            ssize_t readSize = receive_Socket_(d->socket, d->socket->fd, data_Block(inbuf),
+                                               size_Block(inbuf));
             if (readSize == 0) {
                 iWarning("[Socket] peer closed the connection while we were receiving\n");
                 shutdown_Socket_(d->socket);
@@ -166,46 +360,9 @@ static iThreadResult run_SocketThread_(iThread *thread) {
             }
             return 0;
         }
-        /* Check for data to send. */ {
-            iBlock *data = NULL;
-            size_t remaining = 0;
-            iGuardMutex(smx, {
-                if (d->mode != stop_SocketThreadMode) {
-                    if (!isEmpty_Buffer(d->socket->output)) {
-                        data = consumeBlock_Buffer(d->socket->output, 0x10000);
-                    }
-                }
-            });
-            if (data) {
-                const char * ptr         = constData_Block(data);
-                const size_t totalToSend = remaining = size_Block(data);
-                while (remaining > 0) {
-                    ssize_t sent = send(d->socket->fd, ptr, remaining, 0);
-                    if (sent == -1) {
-                        /* Error! */
-                        iWarning("[Socket] peer closed the connection while we were sending "
-                                 "(errno:%d)\n", errno);
-                        /* Don't quit immediately because we need to see if something was received. */
-                        /* TODO: Need to set the Socket in a fail state, though?
-                           Now we're assuming that the error will be noticed later. */
-                        break;
-                    }
-                    remaining -= sent;
-                    ptr += sent;
-                }
-                delete_Block(data);
-                iNotifyAudienceArgs(d->socket, bytesWritten, SocketBytesWritten, totalToSend);
-                iGuardMutex(smx, {
-                    if (isEmpty_Buffer(d->socket->output)) {
-                        signal_Condition(&d->socket->allSent);
-                        if (d->socket->writeFinished) {
-                            unlock_Mutex(smx);
-                            iNotifyAudience(d->socket, writeFinished, SocketWriteFinished);
-                            lock_Mutex(smx);
-                        }
-                    }
-                }
-            });
+        /* Check for data to send. */
+        if (value_Atomic(&d->mode) == run_SocketThreadMode) {
+            sendOutput_Socket_(d->socket);
         }
     }
     return 0;
@@ -260,18 +417,38 @@ static iBool setStatus_Socket_(iSocket *d, enum iSocketStatus status) {
 
 static void init_Socket_(iSocket *d) {
     init_Stream(&d->stream);
-    d->output = new_Buffer();
+    init_SocketQueue_(&d->output);
+    d->highWaterMark = 0;
+    d->lowWaterMark = 0;
+    d->noDelay = iFalse;
+    d->cork = iFalse;
     d->input = new_Buffer();
-    openEmpty_Buffer(d->output);
     openEmpty_Buffer(d->input);
+    init_Array(&d->receivedFds, sizeof(int));
+    d->isLocal = iFalse;
     d->fd = -1;
     d->type = tcp_SocketType;
     d->address = NULL;
-    d->stopConnect = new_Pipe(); /* used for aborting select() on user action */
-    d->connecting = NULL;
+    d->loop = NULL;
+    d->isOnLoop = iFalse;
+    init_Array(&d->connAttempts, sizeof(iSocketConnectAttempt));
+    init_Array(&d->connOrder, sizeof(int));
+    d->connNext = 0;
+    d->connError = 0;
+    d->connTimer = 0;
+    d->connDeadline = 0;
+    d->attemptDelay = defaultAttemptDelay_Socket_;
+    d->connectTimeout = defaultConnectTimeout_Socket_;
+    d->ioWatcher = 0;
     d->thread = NULL;
     init_Condition(&d->allSent);
+    init_Condition(&d->drained);
+    d->isSendingFd = iFalse;
+    init_Condition(&d->fdSent);
     init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "Socket");
+    d->link = NULL;
+    d->linkEnd = 0;
     d->connected = NULL;
     d->disconnected = NULL;
     d->error = NULL;
@@ -284,14 +461,24 @@ static void init_Socket_(iSocket *d) {
 void deinit_Socket(iSocket *d) {
     close_Socket(d);
     iGuardMutex(&d->mutex, {
-        iReleasePtr(&d->output);
+        deinit_SocketQueue_(&d->output);
         iReleasePtr(&d->input);
+        /* Descriptors that were never taken. */
+        iConstForEach(Array, j, &d->receivedFds) {
+            close(*(const int *) j.value);
+        }
+        deinit_Array(&d->receivedFds);
     });
     waitForFinished_Address(d->address);
     iReleasePtr(&d->address);
+    iReleasePtr(&d->loop);
+    iReleasePtr(&d->link);
+    deinit_Array(&d->connOrder);
+    deinit_Array(&d->connAttempts);
     deinit_Mutex(&d->mutex);
-    delete_Pipe(d->stopConnect);
     deinit_Condition(&d->allSent);
+    deinit_Condition(&d->drained);
+    deinit_Condition(&d->fdSent);
     delete_Audience(d->connected);
     delete_Audience(d->disconnected);
     delete_Audience(d->error);
@@ -314,19 +501,32 @@ static void stopThread_Socket_(iSocket *d) {
     }
 }
 
-static iBool setNonBlocking_Socket_(iSocket *d, iBool set) {
-    long flags = fcntl(d->fd, F_GETFL, 0);
+static iBool setNonBlocking_(int fd, iBool set) {
+    long flags = fcntl(fd, F_GETFL, 0);
     if (flags < 0) {
         return iFalse;
     }
     iChangeFlags(flags, O_NONBLOCK, set);
-    if (fcntl(d->fd, F_SETFL, flags) < 0) {
+    if (fcntl(fd, F_SETFL, flags) < 0) {
         return iFalse;
     }
     return iTrue;
 }
 
+static void stopLoop_Socket_(iSocket *d) {
+    /* The watcher's function locks the socket, so it cannot be locked here. */
+    iEventLoopId watcher;
+    iGuardMutex(&d->mutex, {
+        watcher = d->ioWatcher;
+        d->ioWatcher = 0;
+    });
+    if (watcher) {
+        unwatch_EventLoop(d->loop, watcher);
+    }
+}
+
 static void shutdown_Socket_(iSocket *d) {
+    stopLoop_Socket_(d);
     iGuardMutex(&d->mutex, {
         setStatus_Socket_(d, disconnecting_SocketStatus);
         if (d->fd >= 0) {
@@ -335,12 +535,20 @@ static void shutdown_Socket_(iSocket *d) {
     });
     iBool notify = iFalse;
     iGuardMutex(&d->mutex, {
+        while (d->isSendingFd) {
+            /* Interrupt sendFd_Socket() if it is blocked. */
+            shutdown(d->fd, SHUT_RDWR);
+            wait_Condition(&d->fdSent, &d->mutex);
+        }
         if (d->fd >= 0) {
             close(d->fd);
             d->fd = -1;
         }
         notify = setStatus_Socket_(d, disconnected_SocketStatus);
         iAssert(d->fd < 0);
+        /* Nothing more will be sent. */
+        signalAll_Condition(&d->allSent);
+        signalAll_Condition(&d->drained);
     });
     if (notify) {
         iNotifyAudience(d, disconnected, SocketDisconnected);
@@ -352,6 +560,7 @@ iString *toString_SockAddr(const struct sockaddr *addr); /* address.c */
 static void setError_Socket_(iSocket *d, int number, const char *message) {
     lock_Mutex(&d->mutex);
     setStatus_Socket_(d, disconnected_SocketStatus);
+    signalAll_Condition(&d->drained);
     unlock_Mutex(&d->mutex);
     iWarning("[Socket] connection failed: %s\n", message);
     if (d->error) {
@@ -359,109 +568,617 @@ static void setError_Socket_(iSocket *d, int number, const char *message) {
     }
 }
 
-static iThreadResult connectAsync_Socket_(iThread *thd) {
-    iSocket *d = userData_Thread(thd);
-    struct sockaddr *addr;
-    socklen_t addrSize;
-    /* Try each known address until one works. */
-    int rc = -1;
-    for (int proto = 0; rc && proto < 2; proto++) {
-        for (int indexInFamily = 0; rc && indexInFamily < count_Address(d->address); indexInFamily++) {
-            const int addrIndex = getSockAddr_Address(
-                d->address, &addr, &addrSize, proto == 0 ? AF_INET : AF_INET6, indexInFamily);
-            if (!addrSize) {
-                /* Ran out of addresses. */
+/*-------------------------------------------------------------------------------------*/
+
+/* The ends of an in-process pair share a SocketLink. Data written by one end is queued
+   in the link as references to blocks until the other end reads it, so nothing is
+   copied unless the data is written as plain bytes. Notifications are posted to the
+   event loop of the socket being notified, so observers may write back immediately. */
+
+struct Impl_SocketLink {
+    iObject object;
+    iMutex mutex;
+    iCondition changed;             /* data was read, or an end was closed */
+    iSocketQueue data[2];           /* data[i] was written by ends[i] */
+    iSocket *ends[2];               /* NULL after the end has been closed */
+    iBool isClosed[2];
+    iBool isPosted[2];              /* notification of ends[i] pending */
+    iBool isReadable[2];            /* ends[i] has new data to read */
+    size_t delivered[2];            /* bytes written by ends[i] read by the other end */
+    int busy[2];                    /* notifications of ends[i] in progress */
+    iThread *notifyThread[2];
+};
+
+static void init_SocketLink(iSocketLink *d) {
+    init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "SocketLink");
+    init_Condition(&d->changed);
+    iForIndices(i, d->data) {
+        init_SocketQueue_(&d->data[i]);
+        d->ends[i]         = NULL;
+        d->isClosed[i]     = iFalse;
+        d->isPosted[i]     = iFalse;
+        d->isReadable[i]   = iFalse;
+        d->delivered[i]    = 0;
+        d->busy[i]         = 0;
+        d->notifyThread[i] = NULL;
+    }
+}
+
+static void deinit_SocketLink(iSocketLink *d) {
+    iForIndices(i, d->data) {
+        deinit_SocketQueue_(&d->data[i]);
+    }
+    deinit_Condition(&d->changed);
+    deinit_Mutex(&d->mutex);
+}
+
+iDefineObjectConstruction(SocketLink)
+iDefineClass(SocketLink)
+
+static void notify_SocketLink_(iSocketLink *d, int end) {
+    /* Called in the event loop of ends[end]. */
+    lock_Mutex(&d->mutex);
+    d->isPosted[end] = iFalse;
+    iSocket *sock = d->ends[end];
+    if (!sock) {
+        unlock_Mutex(&d->mutex);
+        return;
+    }
+    const iBool  isReadable   = d->isReadable[end];
+    const size_t delivered    = d->delivered[end];
+    const iBool  isAllSent    = (d->data[end].size == 0);
+    const iBool  isPeerClosed = d->isClosed[end ^ 1];
+    d->isReadable[end] = iFalse;
+    d->delivered[end]  = 0;
+    /* Closing the socket in another thread waits until the notifications are done. */
+    d->busy[end]++;
+    d->notifyThread[end] = current_Thread();
+    unlock_Mutex(&d->mutex);
+    for (int step = 0; step < 3; step++) {
+        iBool isAlive;
+        /* The socket may have been closed by an observer. */
+        iGuardMutex(&d->mutex, isAlive = (d->ends[end] == sock));
+        if (!isAlive) {
+            break;
+        }
+        if (step == 0 && isReadable) {
+            iNotifyAudience(sock, readyRead, SocketReadyRead);
+        }
+        else if (step == 1 && delivered) {
+            iNotifyAudienceArgs(sock, bytesWritten, SocketBytesWritten, delivered);
+            if (isAllSent && sock->writeFinished) {
+                iNotifyAudience(sock, writeFinished, SocketWriteFinished);
+            }
+        }
+        else if (step == 2 && isPeerClosed) {
+            iBool notify;
+            iGuardMutex(&sock->mutex, notify = setStatus_Socket_(sock, disconnected_SocketStatus));
+            if (notify) {
+                iNotifyAudience(sock, disconnected, SocketDisconnected);
+            }
+        }
+    }
+    lock_Mutex(&d->mutex);
+    if (--d->busy[end] == 0) {
+        d->notifyThread[end] = NULL;
+    }
+    signalAll_Condition(&d->changed);
+    unlock_Mutex(&d->mutex);
+}
+
+static void notifyFirst_SocketLink_(iAny *context) {
+    notify_SocketLink_(context, 0);
+    iRelease(context);
+}
+
+static void notifySecond_SocketLink_(iAny *context) {
+    notify_SocketLink_(context, 1);
+    iRelease(context);
+}
+
+static void post_SocketLink_(iSocketLink *d, int end) {
+    /* Note: The link is assumed to be locked already. */
+    iSocket *sock = d->ends[end];
+    if (!sock || d->isPosted[end]) {
+        return;
+    }
+    iEventLoop *loop;
+    iGuardMutex(&sock->mutex, loop = (sock->loop ? sock->loop : shared_EventLoop()));
+    d->isPosted[end] = iTrue;
+    post_EventLoop(loop, end == 0 ? notifyFirst_SocketLink_ : notifySecond_SocketLink_,
+                   ref_Object(d));
+}
+
+static size_t write_SocketLink_(iSocketLink *d, iSocket *sock, const void *data, size_t size,
+                                const iBlock *const *blocks, size_t count) {
+    /* Either `data` or `blocks` is written. */
+    const int end = sock->linkEnd;
+    size_t high, low;
+    iBool isLoopThread;
+    iGuardMutex(&sock->mutex, {
+        high = sock->highWaterMark;
+        low  = sock->lowWaterMark;
+        isLoopThread = isCurrent_EventLoop(sock->loop ? sock->loop : shared_EventLoop());
+    });
+    size_t total = 0;
+    lock_Mutex(&d->mutex);
+    if (high && d->data[end].size >= high && !isLoopThread) {
+        /* The writer waits until the reader has caught up. */
+        while (d->data[end].size > low && d->ends[end] == sock && !d->isClosed[end ^ 1]) {
+            wait_Condition(&d->changed, &d->mutex);
+        }
+    }
+    if (d->ends[end] == sock && !d->isClosed[end ^ 1]) {
+        if (blocks) {
+            for (size_t i = 0; i < count; i++) {
+                if (!isEmpty_Block(blocks[i])) {
+                    appendBlock_SocketQueue_(&d->data[end], blocks[i]);
+                    total += size_Block(blocks[i]);
+                }
+            }
+        }
+        else if (size) {
+            appendData_SocketQueue_(&d->data[end], data, size);
+            total = size;
+        }
+        if (total) {
+            d->isReadable[end ^ 1] = iTrue;
+            post_SocketLink_(d, end ^ 1);
+        }
+    }
+    unlock_Mutex(&d->mutex);
+    return total;
+}
+
+static void delivered_SocketLink_(iSocketLink *d, int end, size_t size) {
+    /* Note: The link is assumed to be locked already. */
+    if (size) {
+        d->delivered[end] += size;
+        signalAll_Condition(&d->changed);
+        post_SocketLink_(d, end);
+    }
+}
+
+static size_t read_SocketLink_(iSocketLink *d, int end, size_t size, void *data_out) {
+    size_t readSize;
+    iGuardMutex(&d->mutex, {
+        readSize = read_SocketQueue_(&d->data[end ^ 1], size, data_out);
+        delivered_SocketLink_(d, end ^ 1, readSize);
+    });
+    return readSize;
+}
+
+static iBlock *readAll_SocketLink_(iSocketLink *d, int end) {
+    iBlock *data;
+    iGuardMutex(&d->mutex, {
+        const size_t avail = d->data[end ^ 1].size;
+        data = takeAll_SocketQueue_(&d->data[end ^ 1]);
+        delivered_SocketLink_(d, end ^ 1, avail);
+    });
+    return data;
+}
+
+static void close_SocketLink_(iSocketLink *d, iSocket *sock) {
+    const int end = sock->linkEnd;
+    lock_Mutex(&d->mutex);
+    if (d->ends[end] == sock) {
+        d->ends[end] = NULL;
+        d->isClosed[end] = iTrue;
+        signalAll_Condition(&d->changed);
+        post_SocketLink_(d, end ^ 1); /* the other end gets disconnected */
+        /* Wait for notifications in other threads to finish. */
+        while (d->busy[end] && d->notifyThread[end] != current_Thread()) {
+            wait_Condition(&d->changed, &d->mutex);
+        }
+    }
+    unlock_Mutex(&d->mutex);
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+static void wakeSender_Socket_(iSocket *d) {
+    /* Note: The socket is assumed to be locked already. */
+    if (d->thread) {
+        writeByte_Pipe(&d->thread->wakeup, 0); /* wake up the I/O thread */
+    }
+    else if (d->ioWatcher) {
+        setEvents_EventLoop(d->loop, d->ioWatcher, read_EventLoopEvent | write_EventLoopEvent);
+    }
+}
+
+static iBool isSender_Socket_(const iSocket *d) {
+    /* Note: The socket is assumed to be locked already. */
+    return (d->thread && current_Thread() == &d->thread->thread) ||
+           (d->ioWatcher && isCurrent_EventLoop(d->loop));
+}
+
+static iBool isFull_Socket_(const iSocket *d) {
+    /* Note: The socket is assumed to be locked already. */
+    return d->highWaterMark && d->output.size >= d->highWaterMark && !isSender_Socket_(d);
+}
+
+static void waitForRoom_Socket_(iSocket *d) {
+    /* Note: The socket is assumed to be locked already. */
+    if (!isFull_Socket_(d)) {
+        return;
+    }
+    /* Producers are throttled until the output has drained to the low water mark. */
+    while (d->output.size > d->lowWaterMark &&
+           (d->status == connecting_SocketStatus || d->status == connected_SocketStatus)) {
+        wait_Condition(&d->drained, &d->mutex);
+    }
+}
+
+static void sendOutput_Socket_(iSocket *d) {
+    /* Called in the socket's I/O thread or in the event loop thread. Pending output blocks
+       are gathered into a single sendmsg() call. */
+    struct iovec vecs[maxVectors_Socket_];
+    size_t totalSent = 0;
+    iBool allSent = iFalse;
+    iBool isDropped = iFalse;
+    lock_Mutex(&d->mutex);
+    while (d->fd >= 0 && d->output.size > 0 && !d->isSendingFd) {
+        size_t count = 0;
+        size_t toSend = 0;
+        iConstForEach(PtrArray, i, &d->output.blocks) {
+            if (count == maxVectors_Socket_ || toSend == maxSendSize_Socket_) {
                 break;
             }
-            iDebug("[Socket] connecting async to %s (addrSize:%u index:%d)\n",
-                   cstrCollect_String(toString_SockAddr(addr)),
-                   addrSize, indexInFamily);
-            const iSocketParameters sp = socketParametersIndex_Address(d->address, addrIndex);
-            if (d->fd != -1) {
-                close(d->fd);
-                d->fd = -1;
+            const size_t offset = (count == 0 ? d->output.pos : 0);
+            vecs[count].iov_base = (char *) constData_Block(i.ptr) + offset;
+            vecs[count].iov_len  = iMin(size_Block(i.ptr) - offset, maxSendSize_Socket_ - toSend);
+            toSend += vecs[count].iov_len;
+            count++;
+        }
+        /* The gathered blocks must remain unchanged while the socket is unlocked. */
+        d->output.tail = NULL;
+        const int fd = d->fd;
+        unlock_Mutex(&d->mutex);
+        struct msghdr msg;
+        iZap(msg);
+        msg.msg_iov    = vecs;
+        msg.msg_iovlen = count;
+        const ssize_t sent = sendmsg(fd, &msg, iSendFlags);
+        const int err = errno;
+        lock_Mutex(&d->mutex);
+        if (sent == -1) {
+            if (err == EINTR) {
+                continue;
             }
-            iDebug("[Socket] family:%d type:%d protocol:%d\n", sp.family, sp.type, sp.protocol);
-            d->fd = socket(sp.family, sp.type, sp.protocol);
-            if (!setNonBlocking_Socket_(d, iTrue)) {
-                /* Wait indefinitely. */
-                rc = connect(d->fd, addr, addrSize);
+            if (err != EAGAIN && err != EWOULDBLOCK) {
+                /* Don't quit immediately because we need to see if something was received.
+                   The error will be noticed then. */
+                iWarning("[Socket] peer closed the connection while we were sending "
+                         "(errno:%d)\n", err);
+                /* The output can no longer be sent. If it remained queued, the sender
+                   would keep retrying without waiting. */
+                consume_SocketQueue_(&d->output, d->output.size);
+                isDropped = iTrue;
             }
-            else {
-                /* Give up after a timeout. */
-                rc = connect(d->fd, addr, addrSize);
-                if (rc && errno != EINPROGRESS) {
-                    iDebug("[Socket] result from connect: rc=%d errno=%d (%s)\n",
-                           rc,
-                           errno,
-                           strerror(errno));
-                    continue;
-                }
-                iAssert(d->stopConnect != NULL);
-                const int stopFd = output_Pipe(d->stopConnect);
-                fd_set stopSet;
-                fd_set connSet;
-                fd_set errSet;
-                FD_ZERO(&stopSet);
-                FD_ZERO(&connSet);
-                FD_ZERO(&errSet);
-                FD_SET(stopFd, &stopSet);
-                FD_SET(d->fd, &connSet);
-                FD_SET(d->fd, &errSet);
-                struct timeval timeout = { .tv_sec = connectionTimeoutSeconds_Socket_ };
-                rc = select(iMax(stopFd, d->fd) + 1, &stopSet, &connSet, &errSet, &timeout);
-                if (rc > 0) {
-                    if (FD_ISSET(stopFd, &stopSet)) {
-                        setError_Socket_(d, ECONNABORTED, "Connection aborted");
-                        return ECONNABORTED;
-                    }
-                    socklen_t argLen = sizeof(int);
-                    int sockError = 0;
-                    getsockopt(d->fd, SOL_SOCKET, SO_ERROR, &sockError, &argLen);
-                    if (sockError) {
-                        errno = sockError;
-                        iDebug("[Socket] socket error: errno=%d (%s)\n",
-                               errno,
-                               strerror(errno));
-                        continue;
+            break;
+        }
+        totalSent += sent;
+        consume_SocketQueue_(&d->output, sent);
+        if (!d->isOnLoop || (size_t) sent < toSend) {
+            /* The I/O thread checks for received data between sends. In the event loop,
+               sending continues until there is no more room. */
+            break;
+        }
+    }
+    if (d->output.size <= d->lowWaterMark) {
+        signalAll_Condition(&d->drained);
+    }
+    if (d->output.size == 0 || d->isSendingFd) {
+        /* After a descriptor has been sent, the sender is woken up again if needed. */
+        if (d->ioWatcher) {
+            setEvents_EventLoop(d->loop, d->ioWatcher, read_EventLoopEvent);
+        }
+    }
+    if (d->output.size == 0) {
+        signalAll_Condition(&d->allSent);
+        allSent = iTrue;
+    }
+    unlock_Mutex(&d->mutex);
+    if (totalSent) {
+        iNotifyAudienceArgs(d, bytesWritten, SocketBytesWritten, totalSent);
+        if (allSent && !isDropped && d->writeFinished) {
+            iNotifyAudience(d, writeFinished, SocketWriteFinished);
+        }
+    }
+}
+
+static void applyOptions_Socket_(iSocket *d) {
+    /* Note: The socket is assumed to be locked already. */
+    if (d->fd < 0 || d->isLocal) {
+        return; /* TCP options only */
+    }
+    const int noDelay = d->noDelay;
+    setsockopt(d->fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    const int cork = d->cork;
+#if defined (TCP_CORK)
+    setsockopt(d->fd, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+#elif defined (TCP_NOPUSH)
+    setsockopt(d->fd, IPPROTO_TCP, TCP_NOPUSH, &cork, sizeof(cork));
+#else
+    iUnused(cork);
+#endif
+}
+
+static void process_Socket_(iAny *context, int fd, int events) {
+    /* Called in the event loop thread. */
+    iSocket *d = context;
+    if (events & read_EventLoopEvent) {
+        char buf[0x8000];
+        const ssize_t readSize = receive_Socket_(d, fd, buf, sizeof(buf));
+        if (readSize == 0) {
+            iWarning("[Socket] peer closed the connection while we were receiving\n");
+            shutdown_Socket_(d);
+            return;
+        }
+        if (readSize == -1) {
+            const int err = errno;
+            if (err != EAGAIN && err != EWOULDBLOCK && err != EINTR) {
+                if (status_Socket(d) == connected_SocketStatus) {
+                    iWarning("[Socket] error when receiving: %s\n", strerror(err));
+                    if (err == ECONNREFUSED) {
+                        setError_Socket_(d, ECONNREFUSED, strerror(err));
                     }
-                    rc = 0; /* Success. */
-                    setNonBlocking_Socket_(d, iFalse);
-                }
-                else {
-                    rc = -1;
-                    errno = ETIMEDOUT;
                 }
+                shutdown_Socket_(d);
+                return;
             }
-            lock_Mutex(&d->mutex);
-            if (d->status == connecting_SocketStatus) {
-                if (rc == 0) {
-                    setStatus_Socket_(d, connected_SocketStatus);
-                    startThread_Socket_(d);
-                    unlock_Mutex(&d->mutex);
-                    if (d->connected) {
-                        iNotifyAudience(d, connected, SocketConnected);
-                    }
-                    break;
-                }
+        }
+        else {
+            iGuardMutex(&d->mutex, writeData_Buffer(d->input, buf, readSize));
+            iNotifyAudience(d, readyRead, SocketReadyRead);
+        }
+    }
+    if (events & write_EventLoopEvent) {
+        sendOutput_Socket_(d);
+    }
+}
+
+static void startIO_Socket_(iSocket *d) {
+    /* Note: The socket is assumed to be locked already. */
+    d->isLocal = isLocal_Address(d->address);
+    applyOptions_Socket_(d);
+    if (d->isOnLoop) {
+        iAssert(d->ioWatcher == 0);
+        setNonBlocking_(d->fd, iTrue);
+        const int events = read_EventLoopEvent | (d->output.size ? write_EventLoopEvent : 0);
+        d->ioWatcher = watch_EventLoop(d->loop, d->fd, events, process_Socket_, d);
+    }
+    else {
+        setNonBlocking_(d->fd, iFalse);
+        startThread_Socket_(d);
+    }
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+enum iSocketConnectResult {
+    pending_SocketConnectResult,
+    connected_SocketConnectResult,
+    failed_SocketConnectResult,
+};
+
+static void connectReady_Socket_(iAny *context, int fd, int events);
+static void connectNext_Socket_(iAny *context);
+
+static void orderAddresses_Socket_(iSocket *d) {
+    /* Note: The socket is assumed to be locked already. */
+    /* As recommended in RFC 8305, alternate between address families starting with the
+       family of the first (most preferred) address. */
+    iArray families[2];
+    init_Array(&families[0], sizeof(int));
+    init_Array(&families[1], sizeof(int));
+    int firstFamily = AF_UNSPEC;
+    for (int i = 0; i < count_Address(d->address); i++) {
+        const int family = socketParametersIndex_Address(d->address, i).family;
+        if (i == 0) {
+            firstFamily = family;
+        }
+        pushBack_Array(&families[family == firstFamily ? 0 : 1], &i);
+    }
+    clear_Array(&d->connOrder);
+    for (size_t i = 0; i < iMax(size_Array(&families[0]), size_Array(&families[1])); i++) {
+        iForIndices(f, families) {
+            if (i < size_Array(&families[f])) {
+                pushBack_Array(&d->connOrder, at_Array(&families[f], i));
             }
-            unlock_Mutex(&d->mutex);
         }
     }
-    if (rc) {
-        int errNum;
-        char *msg;
+    deinit_Array(&families[1]);
+    deinit_Array(&families[0]);
+    d->connNext = 0;
+    d->connError = 0;
+}
+
+static void closeAttempt_Socket_(iSocket *d, size_t index, iBool closeFd) {
+    /* Note: The socket is assumed to be locked already. Called in the event loop thread,
+       so there is no waiting for the watcher's function to return. */
+    const iSocketConnectAttempt *attempt = constAt_Array(&d->connAttempts, index);
+    unwatch_EventLoop(d->loop, attempt->watcher);
+    if (closeFd) {
+        close(attempt->fd);
+    }
+    remove_Array(&d->connAttempts, index);
+}
+
+static void stopConnecting_Socket_(iSocket *d) {
+    /* Note: The socket is assumed to be locked already. Called in the event loop thread. */
+    while (!isEmpty_Array(&d->connAttempts)) {
+        closeAttempt_Socket_(d, 0, iTrue);
+    }
+    cancelTimer_EventLoop(d->loop, d->connTimer);
+    cancelTimer_EventLoop(d->loop, d->connDeadline);
+    d->connTimer = 0;
+    d->connDeadline = 0;
+}
+
+static enum iSocketConnectResult startAttempt_Socket_(iSocket *d) {
+    /* Note: The socket is assumed to be locked already. */
+    /* Start connecting to the next address. Earlier attempts continue in parallel. */
+    while (d->connNext < size_Array(&d->connOrder)) {
+        const int index = *(const int *) constAt_Array(&d->connOrder, d->connNext++);
+        struct sockaddr *addr;
+        socklen_t addrSize = 0;
+        getSockAddr_Address(d->address, &addr, &addrSize, AF_UNSPEC, index);
+        if (!addrSize) {
+            continue;
+        }
+        iDebug("[Socket] connecting async to %s (addrSize:%u index:%d)\n",
+               cstrCollect_String(toString_SockAddr(addr)),
+               addrSize, index);
+        const iSocketParameters sp = socketParametersIndex_Address(d->address, index);
+        iDebug("[Socket] family:%d type:%d protocol:%d\n", sp.family, sp.type, sp.protocol);
+        const int fd = socket(sp.family, sp.type, sp.protocol);
+        if (fd < 0) {
+            d->connError = errno;
+            continue;
+        }
+        if (!setNonBlocking_(fd, iTrue)) {
+            d->connError = errno;
+            close(fd);
+            continue;
+        }
+        if (connect(fd, addr, addrSize) == 0) {
+            d->fd = fd;
+            return connected_SocketConnectResult;
+        }
+        if (errno != EINPROGRESS) {
+            d->connError = errno;
+            iDebug("[Socket] result from connect: errno=%d (%s)\n", errno, strerror(errno));
+            close(fd);
+            continue;
+        }
+        const iSocketConnectAttempt attempt = {
+            .fd = fd,
+            .watcher = watch_EventLoop(d->loop, fd, write_EventLoopEvent, connectReady_Socket_, d),
+        };
+        pushBack_Array(&d->connAttempts, &attempt);
+        /* The next address is tried if this one does not connect soon enough. */
+        if (d->connNext < size_Array(&d->connOrder)) {
+            d->connTimer = addTimer_EventLoop(d->loop, d->attemptDelay, 0.0,
+                                              connectNext_Socket_, d);
+        }
+        return pending_SocketConnectResult;
+    }
+    return isEmpty_Array(&d->connAttempts) ? failed_SocketConnectResult
+                                           : pending_SocketConnectResult;
+}
+
+static void finishConnect_Socket_(iSocket *d, enum iSocketConnectResult result, int errNum) {
+    /* Note: The socket is assumed to be locked already; it is unlocked here. */
+    if (result == connected_SocketConnectResult) {
+        setStatus_Socket_(d, connected_SocketStatus);
+        startIO_Socket_(d);
+        unlock_Mutex(&d->mutex);
+        if (d->connected) {
+            iNotifyAudience(d, connected, SocketConnected);
+        }
+    }
+    else if (result == failed_SocketConnectResult) {
+        if (d->fd >= 0) {
+            close(d->fd);
+            d->fd = -1;
+        }
+        unlock_Mutex(&d->mutex);
         if (isHostFound_Address(d->address)) {
-            errNum = errno;
-            msg = strerror(errNum);
+            if (!errNum) {
+                errNum = ECONNREFUSED;
+            }
+            setError_Socket_(d, errNum, strerror(errNum));
         }
         else {
-            errNum = -1;
-            msg = "Failed to look up hostname";
+            setError_Socket_(d, -1, "Failed to look up hostname");
         }
-        setError_Socket_(d, errNum, msg);
     }
-    return rc;
+    else {
+        unlock_Mutex(&d->mutex);
+    }
+}
+
+static void continueConnect_Socket_(iSocket *d, enum iSocketConnectResult result) {
+    /* Note: The socket is assumed to be locked already; it is unlocked here. */
+    if (result != pending_SocketConnectResult) {
+        /* The first connection wins. Other attempts are abandoned. */
+        stopConnecting_Socket_(d);
+    }
+    finishConnect_Socket_(d, result, d->connError);
+}
+
+static void connectReady_Socket_(iAny *context, int fd, int events) {
+    iSocket *d = context;
+    iUnused(events);
+    lock_Mutex(&d->mutex);
+    size_t index = iInvalidPos;
+    iConstForEach(Array, i, &d->connAttempts) {
+        if (((const iSocketConnectAttempt *) i.value)->fd == fd) {
+            index = index_ArrayConstIterator(&i);
+            break;
+        }
+    }
+    if (d->status != connecting_SocketStatus || index == iInvalidPos) {
+        unlock_Mutex(&d->mutex); /* being closed */
+        return;
+    }
+    socklen_t argLen = sizeof(int);
+    int sockError = 0;
+    getsockopt(fd, SOL_SOCKET, SO_ERROR, &sockError, &argLen);
+    if (!sockError) {
+        closeAttempt_Socket_(d, index, iFalse);
+        d->fd = fd;
+        continueConnect_Socket_(d, connected_SocketConnectResult);
+        return;
+    }
+    iDebug("[Socket] socket error: errno=%d (%s)\n", sockError, strerror(sockError));
+    d->connError = sockError;
+    closeAttempt_Socket_(d, index, iTrue);
+    /* Don't wait for the delay to try the next address. */
+    cancelTimer_EventLoop(d->loop, d->connTimer);
+    d->connTimer = 0;
+    continueConnect_Socket_(d, startAttempt_Socket_(d));
+}
+
+static void connectNext_Socket_(iAny *context) {
+    iSocket *d = context;
+    lock_Mutex(&d->mutex);
+    d->connTimer = 0; /* this was a single call */
+    if (d->status != connecting_SocketStatus) {
+        unlock_Mutex(&d->mutex);
+        return;
+    }
+    continueConnect_Socket_(d, startAttempt_Socket_(d));
+}
+
+static void connectTimeout_Socket_(iAny *context) {
+    iSocket *d = context;
+    lock_Mutex(&d->mutex);
+    d->connDeadline = 0;
+    if (d->status != connecting_SocketStatus) {
+        unlock_Mutex(&d->mutex);
+        return;
+    }
+    d->connError = ETIMEDOUT;
+    continueConnect_Socket_(d, failed_SocketConnectResult);
+}
+
+static void startConnect_Socket_(iAny *context) {
+    iSocket *d = context;
+    lock_Mutex(&d->mutex);
+    d->connTimer = 0; /* this was a single call */
+    if (d->status != connecting_SocketStatus) {
+        unlock_Mutex(&d->mutex);
+        return;
+    }
+    orderAddresses_Socket_(d);
+    if (d->connectTimeout > 0.0) {
+        d->connDeadline = addTimer_EventLoop(d->loop, d->connectTimeout, 0.0,
+                                             connectTimeout_Socket_, d);
+    }
+    continueConnect_Socket_(d, startAttempt_Socket_(d));
 }
 
 static iBool open_Socket_(iSocket *d) {
@@ -476,12 +1193,14 @@ static iBool open_Socket_(iSocket *d) {
     else if (!isValid_Address(d->address)) {
         return iFalse;
     }
-    else if (!d->connecting) {
+    else if (!d->connTimer && !d->connDeadline && isEmpty_Array(&d->connAttempts)) {
         iAssert(d->fd == -1);
         setStatus_Socket_(d, connecting_SocketStatus);
-        d->connecting = new_Thread(connectAsync_Socket_);
-        setUserData_Thread(d->connecting, d);
-        start_Thread(d->connecting);
+        if (!d->loop) {
+            d->loop = ref_Object(shared_EventLoop());
+        }
+        /* Connecting happens in the event loop. */
+        d->connTimer = addTimer_EventLoop(d->loop, 0.0, 0.0, startConnect_Socket_, d);
     }
     return iTrue; /* we're already connecting */
 }
@@ -509,16 +1228,58 @@ iSocket *newAddress_Socket(const iAddress *address) {
     return d;
 }
 
-iSocket *newExisting_Socket(int fd, const void *sockAddr, size_t sockAddrSize, enum iSocketType socketType) {
+iSocket *newLocal_Socket(const char *path) {
+    iAddress *addr = newLocal_Address(path, tcp_SocketType);
+    iSocket *d = newAddress_Socket(addr);
+    iRelease(addr);
+    return d;
+}
+
+iSocket *newPair_Socket(iSocket **other_out) {
+    iSocketLink *link = new_SocketLink();
+    iSocket *ends[2];
+    iForIndices(i, ends) {
+        iSocket *d = ends[i] = iNew(Socket);
+        init_Socket_(d);
+        d->address = new_Address();
+        d->link    = ref_Object(link);
+        d->linkEnd = (int) i;
+        link->ends[i] = d;
+        setStatus_Socket_(d, connected_SocketStatus);
+    }
+    iRelease(link);
+    *other_out = ends[1];
+    return ends[0];
+}
+
+iSocket *newExistingLoop_Socket_(int fd, const void *sockAddr, size_t sockAddrSize,
+                                 enum iSocketType socketType, iEventLoop *loop) {
     iSocket *d = iNew(Socket);
     init_Socket_(d);
     d->fd = fd;
+    struct sockaddr_storage peer;
+    if (!sockAddr) {
+        /* For example, a descriptor received from another process. */
+        socklen_t peerSize = sizeof(peer);
+        iZap(peer);
+        if (getpeername(fd, (struct sockaddr *) &peer, &peerSize)) {
+            peerSize = 0;
+        }
+        sockAddr     = &peer;
+        sockAddrSize = peerSize;
+    }
     d->address = newSockAddr_Address(sockAddr, sockAddrSize, socketType);
+    d->loop = ref_Object(loop);
+    d->isOnLoop = (loop != NULL);
     setStatus_Socket_(d, connected_SocketStatus);
-    startThread_Socket_(d);
+    iGuardMutex(&d->mutex, startIO_Socket_(d));
     return d;
 }
 
+iSocket *newExisting_Socket(int fd, const void *sockAddr, size_t sockAddrSize, enum iSocketType socketType) {
+    return newExistingLoop_Socket_(fd, sockAddr, sockAddrSize, socketType, NULL);
+}
+
 void init_Socket(iSocket *d, const char *hostName, uint16_t port, enum iSocketType socketType) {
     init_Socket_(d);
     d->address = new_Address();
@@ -527,6 +1288,33 @@ void init_Socket(iSocket *d, const char *hostName, uint16_t port, enum iSocketTy
     lookupCStr_Address(d->address, hostName, port, socketType);
 }
 
+void setEventLoop_Socket(iSocket *d, iEventLoop *loop) {
+    lock_Mutex(&d->mutex);
+    iAssert(d->status != connecting_SocketStatus);
+    const iBool isRunning = (d->status == connected_SocketStatus);
+    unlock_Mutex(&d->mutex);
+    /* Stop the current I/O; this needs the socket to be unlocked. */
+    if (isRunning) {
+        stopThread_Socket_(d);
+        stopLoop_Socket_(d);
+    }
+    iGuardMutex(&d->mutex, {
+        iRelease(d->loop);
+        d->loop = ref_Object(loop);
+        d->isOnLoop = (loop != NULL);
+        if (isRunning && d->status == connected_SocketStatus && d->fd >= 0) {
+            startIO_Socket_(d);
+        }
+    });
+}
+
+void setConnectTimeouts_Socket(iSocket *d, double attemptDelaySeconds, double timeoutSeconds) {
+    iGuardMutex(&d->mutex, {
+        d->attemptDelay   = iMax(0.0, attemptDelaySeconds);
+        d->connectTimeout = timeoutSeconds;
+    });
+}
+
 iBool open_Socket(iSocket *d) {
     iBool ok;
     iGuardMutex(&d->mutex, {
@@ -541,6 +1329,16 @@ iBool open_Socket(iSocket *d) {
 }
 
 void close_Socket(iSocket *d) {
+    if (d->link) {
+        /* Data already written remains readable by the other end. */
+        close_SocketLink_(d->link, d);
+        iBool notify;
+        iGuardMutex(&d->mutex, notify = setStatus_Socket_(d, disconnected_SocketStatus));
+        if (notify) {
+            iNotifyAudience(d, disconnected, SocketDisconnected);
+        }
+        return;
+    }
     iDisconnect(Address, d->address, lookupFinished, d, addressLookedUp_Socket_);
     lock_Mutex(&d->mutex);
     if (d->status == connected_SocketStatus) {
@@ -551,24 +1349,35 @@ void close_Socket(iSocket *d) {
         unlock_Mutex(&d->mutex);
     }
     stopThread_Socket_(d);
-    iGuardMutex(&d->mutex, {
-        if (d->status == disconnected_SocketStatus ||
-            d->status == disconnecting_SocketStatus) {
-            unlock_Mutex(&d->mutex);
-            join_Thread(d->connecting);
-            iReleasePtr(&d->connecting);
-            return;
-        }
-        if (d->status == connecting_SocketStatus) {
-            if (d->stopConnect) {
-                write_Pipe(d->stopConnect, "0", 1);
-            }
-            shutdown(d->fd, SHUT_WR);
+    stopLoop_Socket_(d);
+    lock_Mutex(&d->mutex);
+    if (d->status == disconnected_SocketStatus ||
+        d->status == disconnecting_SocketStatus) {
+        unlock_Mutex(&d->mutex);
+        return;
+    }
+    /* Stop connecting. The loop's functions lock the socket, so it is unlocked while
+       waiting for them. */
+    iArray *attempts = copy_Array(&d->connAttempts);
+    const iEventLoopId connTimer    = d->connTimer;
+    const iEventLoopId connDeadline = d->connDeadline;
+    const iBool isAborted = (connTimer || connDeadline || !isEmpty_Array(attempts));
+    clear_Array(&d->connAttempts);
+    d->connTimer    = 0;
+    d->connDeadline = 0;
+    setStatus_Socket_(d, disconnecting_SocketStatus);
+    unlock_Mutex(&d->mutex);
+    if (isAborted) {
+        iConstForEach(Array, i, attempts) {
+            const iSocketConnectAttempt *attempt = i.value;
+            unwatch_EventLoop(d->loop, attempt->watcher);
+            close(attempt->fd);
         }
-        setStatus_Socket_(d, disconnecting_SocketStatus);
-    });
-    join_Thread(d->connecting);
-    iReleasePtr(&d->connecting);
+        cancelTimer_EventLoop(d->loop, connTimer);
+        cancelTimer_EventLoop(d->loop, connDeadline);
+        setError_Socket_(d, ECONNABORTED, "Connection aborted");
+    }
+    delete_Array(attempts);
     shutdown_Socket_(d);
 }
 
@@ -589,12 +1398,21 @@ enum iSocketStatus status_Socket(const iSocket *d) {
 
 size_t bytesToSend_Socket(const iSocket *d) {
     size_t n;
-    iGuardMutex(&d->mutex, n = size_Buffer(d->output));
+    if (d->link) {
+        /* Not yet read by the other end. */
+        iGuardMutex(&d->link->mutex, n = d->link->data[d->linkEnd].size);
+        return n;
+    }
+    iGuardMutex(&d->mutex, n = d->output.size);
     return n;
 }
 
 size_t receivedBytes_Socket(const iSocket *d) {
     size_t n;
+    if (d->link) {
+        iGuardMutex(&d->link->mutex, n = d->link->data[d->linkEnd ^ 1].size);
+        return n;
+    }
     iGuardMutex(&d->mutex, n = size_Buffer(d->input));
     return n;
 }
@@ -611,25 +1429,188 @@ static size_t seek_Socket_(iStream *d, size_t pos) {
 
 static size_t read_Socket_(iSocket *d, size_t size, void *data_out) {
     size_t readSize = 0;
+    if (d->link) {
+        return read_SocketLink_(d->link, d->linkEnd, size, data_out);
+    }
     iGuardMutex(&d->mutex, {
         readSize = consume_Buffer(d->input, size, data_out);
     });
     return readSize;
 }
 
-static size_t write_Socket_(iSocket *d, const void *data, size_t size) {
+size_t writeBlocks_Socket(iSocket *d, const iBlock *const *blocks, size_t count) {
+    size_t total = 0;
+    if (d->link) {
+        return write_SocketLink_(d->link, d, NULL, 0, blocks, count);
+    }
+    iGuardMutex(&d->mutex, {
+        waitForRoom_Socket_(d);
+        for (size_t i = 0; i < count; i++) {
+            if (!isEmpty_Block(blocks[i])) {
+                appendBlock_SocketQueue_(&d->output, blocks[i]);
+                total += size_Block(blocks[i]);
+            }
+        }
+        if (total) {
+            wakeSender_Socket_(d);
+        }
+    });
+    return total;
+}
+
+void setNoDelay_Socket(iSocket *d, iBool noDelay) {
+    iGuardMutex(&d->mutex, {
+        d->noDelay = noDelay;
+        applyOptions_Socket_(d);
+    });
+}
+
+void setCork_Socket(iSocket *d, iBool cork) {
+    iGuardMutex(&d->mutex, {
+        d->cork = cork;
+        applyOptions_Socket_(d);
+    });
+}
+
+void setWaterMarks_Socket(iSocket *d, size_t high, size_t low) {
+    iAssert(high == 0 || low < high);
     iGuardMutex(&d->mutex, {
-        writeData_Stream(stream_Buffer(d->output), data, size);
-        if (d->thread) {
-            writeByte_Pipe(&d->thread->wakeup, 0); // wake up the I/O thread
+        d->highWaterMark = high;
+        d->lowWaterMark  = iMin(low, high);
+        signalAll_Condition(&d->drained);
+    });
+}
+
+iBool sendFd_Socket(iSocket *d, int fd, const void *data, size_t size) {
+    const char zero = 0;
+    if (!size) {
+        /* The descriptor is sent along with at least one byte. */
+        data = &zero;
+        size = 1;
+    }
+    flush_Socket(d); /* queued output is sent first */
+    union {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    iZap(control);
+    struct iovec vec = { .iov_base = (void *) data, .iov_len = size };
+    struct msghdr msg;
+    iZap(msg);
+    msg.msg_iov        = &vec;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    ssize_t sent = -1;
+    lock_Mutex(&d->mutex);
+    while (d->isSendingFd) {
+        wait_Condition(&d->fdSent, &d->mutex);
+    }
+    if (!d->isLocal || d->status != connected_SocketStatus || d->fd < 0) {
+        iWarning("[Socket] descriptors can only be sent over a connected local socket\n");
+    }
+    else if (d->output.size > 0) {
+        /* The sender cannot wait for its own output to be sent. */
+        iWarning("[Socket] descriptor not sent because output is still queued\n");
+    }
+    else {
+        /* The socket is not locked while sending, but other output is held back. */
+        d->isSendingFd = iTrue;
+        const int sockFd = d->fd;
+        unlock_Mutex(&d->mutex);
+        int err = 0;
+        for (;;) {
+            sent = sendmsg(sockFd, &msg, iSendFlags);
+            err = errno;
+            if (sent >= 0 || (err != EINTR && err != EAGAIN && err != EWOULDBLOCK)) {
+                break;
+            }
+            if (err != EINTR) {
+                struct pollfd pfd = { .fd = sockFd, .events = POLLOUT };
+                poll(&pfd, 1, -1);
+            }
+        }
+        lock_Mutex(&d->mutex);
+        d->isSendingFd = iFalse;
+        signalAll_Condition(&d->fdSent);
+        if (sent < 0) {
+            iWarning("[Socket] failed to send descriptor: %s\n", strerror(err));
+        }
+        else if ((size_t) sent < size) {
+            /* The descriptor went with the first byte. Output written in the meantime
+               comes after the rest of the data. */
+            prependData_SocketQueue_(&d->output, (const char *) data + sent, size - sent);
+        }
+        if (d->output.size > 0) {
+            wakeSender_Socket_(d);
+        }
+    }
+    unlock_Mutex(&d->mutex);
+    if (sent > 0) {
+        iNotifyAudienceArgs(d, bytesWritten, SocketBytesWritten, (size_t) sent);
+    }
+    return sent >= 0;
+}
+
+int takeFd_Socket(iSocket *d) {
+    int fd = -1;
+    iGuardMutex(&d->mutex, {
+        if (!isEmpty_Array(&d->receivedFds)) {
+            fd = *(const int *) front_Array(&d->receivedFds);
+            popFront_Array(&d->receivedFds);
         }
     });
+    return fd;
+}
+
+size_t writeData_Socket(iSocket *d, const void *data, size_t size) {
+    return writeData_Stream((iStream *) d, data, size);
+}
+
+size_t write_Socket(iSocket *d, const iBlock *data) {
+    if (d->link) {
+        return writeBlocks_Socket(d, &data, 1); /* not copied */
+    }
+    return writeData_Socket(d, constData_Block(data), size_Block(data));
+}
+
+iBlock *readAll_Socket(iSocket *d) {
+    if (d->link) {
+        return readAll_SocketLink_(d->link, d->linkEnd);
+    }
+    return readAll_Stream((iStream *) d);
+}
+
+static size_t write_Socket_(iSocket *d, const void *data, size_t size) {
+    if (d->link) {
+        return write_SocketLink_(d->link, d, data, size, NULL, 0);
+    }
+    lock_Mutex(&d->mutex);
+    if (isFull_Socket_(d)) {
+        /* Called with the stream locked. It is unlocked while waiting so that readers
+           are not blocked; the output may only drain after received data is read. */
+        unlock_Mutex(&d->mutex);
+        unlock_Mutex(d->stream.mtx);
+        iGuardMutex(&d->mutex, waitForRoom_Socket_(d));
+        lock_Mutex(d->stream.mtx);
+        lock_Mutex(&d->mutex);
+    }
+    appendData_SocketQueue_(&d->output, data, size);
+    wakeSender_Socket_(d);
+    unlock_Mutex(&d->mutex);
     return size;
 }
 
 static void flush_Socket_(iSocket *d) {
     iGuardMutex(&d->mutex, {
-        if (!isEmpty_Buffer(d->output)) {
+        /* The sender cannot wait for itself to send the data. */
+        while (d->output.size > 0 && d->status == connected_SocketStatus &&
+               !isSender_Socket_(d)) {
             wait_Condition(&d->allSent, &d->mutex);
         }
     });
@@ -45,7 +45,7 @@ struct Impl_Service {
     iAudience *incomingAccepted;
 };
 
-iDefineAudienceGetter(Service, incomingAccepted)
+iDefineDirectAudienceGetter(Service, incomingAccepted)
 
 iDefineObjectConstructionArgs(Service, (uint16_t port), port)
 
@@ -98,7 +98,7 @@ void init_Service(iService *d, uint16_t port) {
     //init_Pipe(&d->stop);
     d->fdEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
     d->stopEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-    d->incomingAccepted = new_Audience();
+    d->incomingAccepted = newDirect_Audience();
 }
 
 void deinit_Service(iService *d) {
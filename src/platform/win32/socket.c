@@ -76,9 +76,9 @@ static void shutdown_Socket_(iSocket *d);
 
 iDefineAudienceGetter(Socket, connected)
 iDefineAudienceGetter(Socket, disconnected)
-iDefineAudienceGetter(Socket, error)
+iDefineDirectAudienceGetter(Socket, error)
 iDefineAudienceGetter(Socket, readyRead)
-iDefineAudienceGetter(Socket, bytesWritten)
+iDefineDirectAudienceGetter(Socket, bytesWritten)
 iDefineAudienceGetter(Socket, writeFinished)
 
 /*-------------------------------------------------------------------------------------*/
@@ -265,6 +265,7 @@ static void init_Socket_(iSocket *d) {
     d->thread = NULL;
     init_Condition(&d->allSent);
     init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "Socket");
     d->connected = NULL;
     d->disconnected = NULL;
     d->error = NULL;
@@ -598,6 +599,18 @@ static size_t read_Socket_(iSocket *d, size_t size, void *data_out) {
     return readSize;
 }
 
+size_t writeData_Socket(iSocket *d, const void *data, size_t size) {
+    return writeData_Stream((iStream *) d, data, size);
+}
+
+size_t write_Socket(iSocket *d, const iBlock *data) {
+    return writeData_Socket(d, constData_Block(data), size_Block(data));
+}
+
+iBlock *readAll_Socket(iSocket *d) {
+    return readAll_Stream((iStream *) d);
+}
+
 static size_t write_Socket_(iSocket *d, const void *data, size_t size) {
     iGuardMutex(&d->mutex, {
         writeData_Stream(stream_Buffer(d->output), data, size);
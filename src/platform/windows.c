@@ -26,6 +26,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
 #include "the_Foundation/defs.h"
+#include "the_Foundation/thread.h"
 #include <stdio.h>
 
 #define WIN32_LEAN_AND_MEAN
@@ -46,6 +47,42 @@ int idealConcurrentCount_Thread(void) {
     return ncpu;
 }
 
+int currentCpu_Thread(void) {
+    return (int) GetCurrentProcessorNumber();
+}
+
+int numaNode_Thread(int cpu) {
+    iUnused(cpu);
+    return 0;
+}
+
+iBool isAllowedCpu_Thread(int cpu) {
+    DWORD_PTR mask, systemMask;
+    if (cpu < 0 || cpu >= (int) (8 * sizeof(mask)) ||
+        !GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask)) {
+        return iFalse;
+    }
+    return (mask & ((DWORD_PTR) 1 << cpu)) != 0;
+}
+
+iBool setAffinity_Thread(iThread *d, int cpu) {
+    /* Only the calling thread's handle is available. */
+    if (d && !isCurrent_Thread(d)) {
+        return iFalse;
+    }
+    DWORD_PTR mask, systemMask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask)) {
+        return iFalse;
+    }
+    if (cpu >= 0) {
+        if (cpu >= (int) (8 * sizeof(mask))) {
+            return iFalse;
+        }
+        mask = (DWORD_PTR) 1 << cpu;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
 #if !defined (iPlatformMsys) && !defined (iPlatformCygwin)
 void init_Locale(void) {
     char cpName[16];
@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 #include <stdarg.h>
 
 iDefineTypeConstruction(PtrArray)
+iDefineTypeCollectNew(PtrArray)
 
 iPtrArray *newPointers_PtrArray(void *ptr, ...) {
     iPtrArray *d = new_PtrArray();
@@ -35,6 +35,7 @@ static int cmp_PtrSet_(const void *a, const void *b) {
 }
 
 iDefineTypeConstruction(PtrSet)
+iDefineTypeCollectNew(PtrSet)
 
 iPtrSet *newCmp_PtrSet(iSortedArrayCompareElemFunc cmp) {
     iPtrSet *d = new_PtrSet();
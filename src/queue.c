@@ -26,18 +26,66 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
 #include "the_Foundation/queue.h"
+#include "the_Foundation/array.h"
 #include "the_Foundation/time.h"
 
+#include <stdlib.h>
+
+iDeclareType(QueueCounters)
+
+struct Impl_QueueCounters {
+    iAtomicUInt64 put;
+    iAtomicUInt64 taken;
+    iAtomicUInt64 depth;
+    iAtomicUInt64 maxDepth;
+    iArray putTimes; /* one per queued item; guarded by the queue mutex */
+    iHistogram wait;
+};
+
+static void itemPut_Queue_(iQueue *d) {
+    /* Called with the mutex locked. */
+    iQueueCounters *m = valueRelaxed_Atomic(&d->metrics);
+    if (m) {
+        const uint64_t depth = size_ObjectList(&d->items);
+        const uint64_t now   = monotonicNanoseconds_Time();
+        pushBack_Array(&m->putTimes, &now);
+        addRelaxed_Atomic(&m->put, 1);
+        setRelaxed_Atomic(&m->depth, depth);
+        raise_MetricsCounter(&m->maxDepth, depth);
+    }
+}
+
+static void itemTaken_Queue_(iQueue *d) {
+    /* Called with the mutex locked. */
+    iQueueCounters *m = valueRelaxed_Atomic(&d->metrics);
+    if (m) {
+        const uint64_t putAt = *(const uint64_t *) constFront_Array(&m->putTimes);
+        popFront_Array(&m->putTimes);
+        if (putAt) {
+            record_Histogram(&m->wait, monotonicNanoseconds_Time() - putAt);
+        }
+        addRelaxed_Atomic(&m->taken, 1);
+        setRelaxed_Atomic(&m->depth, size_ObjectList(&d->items));
+    }
+}
+
 iDefineSubclass(Queue, ObjectList)
 iDefineObjectConstruction(Queue)
 
 void init_Queue(iQueue *d) {
     init_ObjectList(&d->items);
     init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "Queue");
     init_Condition(&d->cond);
+    set_Atomic(&d->metrics, NULL);
 }
 
 void deinit_Queue(iQueue *d) {
+    iQueueCounters *m = value_Atomic(&d->metrics);
+    if (m) {
+        deinit_Array(&m->putTimes);
+        free(m);
+    }
     deinit_Condition(&d->cond);
     deinit_Mutex(&d->mutex);
 }
@@ -47,6 +95,7 @@ void put_Queue(iQueue *d, iQueueItem *item) {
     iAssertIsObject(item);
     iGuardMutex(&d->mutex, {
         pushBack_ObjectList(&d->items, item);
+        itemPut_Queue_(d);
         signal_Condition(&d->cond);
     });
 }
@@ -56,7 +105,10 @@ iQueueItem *take_Queue(iQueue *d) {
     iGuardMutex(&d->mutex, {
         for (;;) {
             item = takeFront_ObjectList(&d->items);
-            if (item) break;
+            if (item) {
+                itemTaken_Queue_(d);
+                break;
+            }
             wait_Condition(&d->cond, &d->mutex);
         }
     });
@@ -71,7 +123,11 @@ iQueueItem *takeTimeout_Queue(iQueue *d, double timeoutSeconds) {
     iGuardMutex(&d->mutex, {
         for (;;) {
             item = takeFront_ObjectList(&d->items);
-            if (item || waitTimeout_Condition(&d->cond, &d->mutex, &until) == thrd_timedout) {
+            if (item) {
+                itemTaken_Queue_(d);
+                break;
+            }
+            if (waitTimeout_Condition(&d->cond, &d->mutex, &until) == thrd_timedout) {
                 break;
             }
         }
@@ -89,7 +145,12 @@ void waitForItems_Queue(iQueue *d) {
 
 iQueueItem *tryTake_Queue(iQueue *d) {
     iQueueItem *item;
-    iGuardMutex(&d->mutex, item = takeFront_ObjectList(&d->items));
+    iGuardMutex(&d->mutex, {
+        item = takeFront_ObjectList(&d->items);
+        if (item) {
+            itemTaken_Queue_(d);
+        }
+    });
     return item;
 }
 
@@ -99,3 +160,62 @@ size_t size_Queue(const iQueue *d) {
     return size;
 }
 
+
+void enableMetrics_Queue(iQueue *d) {
+    iGuardMutex(&d->mutex, {
+        if (!valueRelaxed_Atomic(&d->metrics)) {
+            iQueueCounters *m = calloc(1, sizeof(iQueueCounters));
+            init_Array(&m->putTimes, sizeof(uint64_t));
+            init_Histogram(&m->wait);
+            /* Items already in the queue have an unknown wait time. */
+            resize_Array(&m->putTimes, size_ObjectList(&d->items));
+            setRelaxed_Atomic(&m->depth, size_ObjectList(&d->items));
+            setRelaxed_Atomic(&m->maxDepth, size_ObjectList(&d->items));
+            set_Atomic(&d->metrics, m);
+        }
+    });
+}
+
+void resetMetrics_Queue(iQueue *d) {
+    iQueueCounters *m = value_Atomic(&d->metrics);
+    if (m) {
+        setRelaxed_Atomic(&m->put, 0);
+        setRelaxed_Atomic(&m->taken, 0);
+        setRelaxed_Atomic(&m->maxDepth, valueRelaxed_Atomic(&m->depth));
+        reset_Histogram(&m->wait);
+    }
+}
+
+iBool metrics_Queue(const iQueue *d, iQueueMetrics *metrics_out) {
+    const iQueueCounters *m = value_Atomic(&iConstCast(iQueue *, d)->metrics);
+    if (!m) {
+        return iFalse;
+    }
+    metrics_out->put      = valueRelaxed_Atomic(&m->put);
+    metrics_out->taken    = valueRelaxed_Atomic(&m->taken);
+    metrics_out->depth    = (size_t) valueRelaxed_Atomic(&m->depth);
+    metrics_out->maxDepth = (size_t) valueRelaxed_Atomic(&m->maxDepth);
+    summarize_Histogram(&m->wait, &metrics_out->wait);
+    return iTrue;
+}
+
+void printMetrics_Queue(const iQueue *d, FILE *out, enum iMetricsFormat format) {
+    iQueueMetrics qm;
+    if (!metrics_Queue(d, &qm)) {
+        return;
+    }
+    if (format == json_MetricsFormat) {
+        fprintf(out, "{\"put\": %llu, \"taken\": %llu, \"depth\": %zu, \"maxDepth\": %zu, "
+                "\"wait\": ", (unsigned long long) qm.put, (unsigned long long) qm.taken,
+                qm.depth, qm.maxDepth);
+        print_HistogramSummary(&qm.wait, "wait", out, format);
+        fprintf(out, "}\n");
+    }
+    else {
+        fprintf(out, "Put %llu, taken %llu, depth %zu (max %zu)\n",
+                (unsigned long long) qm.put, (unsigned long long) qm.taken, qm.depth,
+                qm.maxDepth);
+        printHeader_HistogramSummary(out);
+        print_HistogramSummary(&qm.wait, "wait", out, format);
+    }
+}
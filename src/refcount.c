@@ -0,0 +1,127 @@
+/** @file refcount.c  Reference counter with a biased owner thread.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "the_Foundation/refcount.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined (iHaveThreadLocal)
+static iAtomicInt           nextThreadTag_;
+static iThreadLocal int     threadTag_;
+#endif
+
+int threadTag_RefCount(void) {
+#if defined (iHaveThreadLocal)
+    if (!threadTag_) {
+        threadTag_ = add_Atomic(&nextThreadTag_, 1) + 1;
+    }
+    return threadTag_;
+#else
+    return 0;
+#endif
+}
+
+void init_RefCount(iRefCount *d, int count) {
+    setRelaxed_Atomic(&d->count, count);
+    setRelaxed_Atomic(&d->biased, 0);
+    setRelaxed_Atomic(&d->owner, 0);
+}
+
+void confine_RefCount(iRefCount *d) {
+    const int tag = threadTag_RefCount();
+    if (tag && !isConfined_RefCount(d)) {
+        setRelaxed_Atomic(&d->biased, valueRelaxed_Atomic(&d->count));
+        setRelaxed_Atomic(&d->count, iRefCountBiasedFlag);
+        setRelaxed_Atomic(&d->owner, tag);
+    }
+}
+
+void unconfine_RefCount(iRefCount *d) {
+    if (isConfined_RefCount(d)) {
+        iAssert(valueRelaxed_Atomic(&d->owner) == threadTag_RefCount());
+        const int biased = valueRelaxed_Atomic(&d->biased);
+        setRelaxed_Atomic(&d->biased, 0);
+        setRelaxed_Atomic(&d->owner, 0);
+        addAcqRel_Atomic(&d->count, biased - iRefCountBiasedFlag);
+    }
+}
+
+iBool isConfined_RefCount(const iRefCount *d) {
+    return valueRelaxed_Atomic(&iConstCast(iRefCount *, d)->owner) != 0;
+}
+
+int value_RefCount(const iRefCount *d) {
+    iRefCount *m = iConstCast(iRefCount *, d);
+    int count = value_Atomic(&m->count);
+    if (count & iRefCountBiasedFlag) {
+        count += valueRelaxed_Atomic(&m->biased) - iRefCountBiasedFlag;
+    }
+    return count;
+}
+
+iLocalDef iBool isOwner_RefCount_(const iRefCount *d) {
+    const int owner = valueRelaxed_Atomic(&iConstCast(iRefCount *, d)->owner);
+    return owner && owner == threadTag_RefCount();
+}
+
+void add_RefCount(iRefCount *d) {
+    if (isOwner_RefCount_(d)) {
+        /* Only the owner modifies the biased count. */
+        setRelaxed_Atomic(&d->biased, valueRelaxed_Atomic(&d->biased) + 1);
+    }
+    else {
+        addRelaxed_Atomic(&d->count, 1);
+    }
+}
+
+iBool remove_RefCount(iRefCount *d) {
+    if (isOwner_RefCount_(d)) {
+        const int biased = valueRelaxed_Atomic(&d->biased) - 1;
+        setRelaxed_Atomic(&d->biased, biased);
+        if (biased > 0) {
+            return iFalse;
+        }
+        /* The owner has no more references. Remaining ones are shared. */
+        setRelaxed_Atomic(&d->owner, 0);
+        return addAcqRel_Atomic(&d->count, -iRefCountBiasedFlag) == iRefCountBiasedFlag;
+    }
+    const int countWas = addRelease_Atomic(&d->count, -1);
+    if (countWas == iRefCountBiasedFlag) {
+        /* More shared references were removed than added, so a reference of the owner
+           thread was removed in another thread. The owner's count is not atomic and
+           cannot be corrected. */
+        fprintf(stderr, "[RefCount] %p: reference of the owner thread removed in another "
+                        "thread (unconfine it first)\n", (void *) d);
+        abort();
+    }
+    if (countWas == 1) {
+        acquireFence_Atomic();
+        return iTrue;
+    }
+    return iFalse;
+}
@@ -139,6 +139,63 @@ iBool insertIf_SortedArray(iSortedArray *d, const void *value, iSortedArrayCompa
     return iTrue;
 }
 
+void insertN_SortedArray(iSortedArray *d, const void *values, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    const size_t elemSize = d->values.elementSize;
+    iArray added;
+    init_Array(&added, elemSize);
+    pushBackN_Array(&added, values, count);
+    sortStable_Array(&added, d->cmp);
+    /* Of equal values, keep the last one. */
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique > 0 && d->cmp(at_Array(&added, unique - 1), at_Array(&added, i)) == 0) {
+            unique--;
+        }
+        if (unique != i) {
+            set_Array(&added, unique, at_Array(&added, i));
+        }
+        unique++;
+    }
+    resize_Array(&added, unique);
+    if (isEmpty_Array(&d->values)) {
+        deinit_Array(&d->values);
+        d->values = added;
+        return;
+    }
+    /* Merge with the existing values. */
+    iArray merged;
+    init_Array(&merged, elemSize);
+    reserve_Array(&merged, size_Array(&d->values) + unique);
+    size_t i = 0, j = 0;
+    const size_t oldCount = size_Array(&d->values);
+    while (i < oldCount || j < unique) {
+        if (j == unique) {
+            pushBack_Array(&merged, at_Array(&d->values, i++));
+            continue;
+        }
+        if (i == oldCount) {
+            pushBack_Array(&merged, at_Array(&added, j++));
+            continue;
+        }
+        const int cmp = d->cmp(at_Array(&d->values, i), at_Array(&added, j));
+        if (cmp < 0) {
+            pushBack_Array(&merged, at_Array(&d->values, i++));
+        }
+        else {
+            if (cmp == 0) {
+                i++; /* replaced */
+            }
+            pushBack_Array(&merged, at_Array(&added, j++));
+        }
+    }
+    deinit_Array(&added);
+    deinit_Array(&d->values);
+    d->values = merged;
+}
+
 iBool remove_SortedArray(iSortedArray *d, const void *value) {
     size_t pos;
     if (locate_SortedArray(d, value, &pos)) {
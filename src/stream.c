@@ -87,6 +87,7 @@ void init_Stream(iStream *d) {
     d->pos = 0;
     d->flags = 0; // little-endian
     d->mtx = new_Mutex();
+    setName_Mutex(d->mtx, "Stream");
 }
 
 void deinit_Stream(iStream *d) {
@@ -111,6 +111,8 @@ iString *new_String(void) {
     return d;
 }
 
+iDefineTypeCollectNew(String)
+
 iString *newCStr_String(const char *cstr) {
     return newCStrN_String(cstr, strlen(cstr));
 }
@@ -171,6 +173,15 @@ iString *collectNewFormat_String(const char *format, ...) {
     return d;
 }
 
+iString *collectNewRange_String(const iRangecc range) {
+    iString *d = allocArena_Garbage(sizeof(iString));
+    if (!d) {
+        return collect_String(newRange_String(range));
+    }
+    initData_Block(&d->chars, range.start, size_Range(&range));
+    return iCollectDel(d, deinit_String);
+}
+
 const char *format_CStr(const char *format, ...) {
     iString *d = collectNew_String();
     va_list args;
@@ -48,10 +48,15 @@ void deinit_Windows_(void);
 #endif
 
 void deinitForThread_Garbage_(void); /* garbage.c */
+#if defined (iPlatformWindows)
 void deinit_DatagramThreads_(void);  /* datagram.c */
+#else
+void deinit_SharedEventLoop_(void);  /* eventloop.c */
+#endif
+void deinit_Fibers_(void);           /* fiber.c */
+void deinit_MainDispatch_(void);     /* dispatch.c */
 void deinit_Address_(void);          /* address.c */
 void deinit_Threads_(void);          /* thread.c */
-void init_DatagramThreads_(void);    /* datagram.c */
 void init_Locale(void);              /* locale */
 void init_Threads(void);             /* thread.c */
 
@@ -83,7 +88,13 @@ void init_Foundation(void) {
 void deinit_Foundation(void) {
     if (isInitialized_Foundation()) {
         hasBeenInitialized_ = iFalse;
+#if defined (iPlatformWindows)
         deinit_DatagramThreads_();
+#else
+        deinit_SharedEventLoop_();
+#endif
+        deinit_MainDispatch_();
+        deinit_Fibers_();
         deinit_Address_();
         deinitForThread_Garbage_();
         deinit_Threads_();
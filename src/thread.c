@@ -38,22 +38,30 @@ iDefinePlainKeyBlockHash(ThreadHash, ThreadId, Thread)
 
 iDefineLockableObject(ThreadHash)
 
-static iLockableThreadHash *runningThreads_;
+#if defined (iHaveThreadLocal)
+static iThreadLocal iThread *currentThread_;
+#else
+static tss_t currentThread_;
+#endif
 
-void deinit_Threads_(void) {
-    delete_LockableThreadHash(runningThreads_);
-    runningThreads_ = NULL;
+static void setCurrent_Thread_(iThread *d) {
+#if defined (iHaveThreadLocal)
+    currentThread_ = d;
+#else
+    tss_set(currentThread_, d);
+#endif
 }
 
-static iLockableThreadHash *init_Threads_(void) {
-    if (!runningThreads_) {
-        runningThreads_ = new_LockableThreadHash();
-    }
-    return runningThreads_;
+void deinit_Threads_(void) {
+#if !defined (iHaveThreadLocal)
+    tss_delete(currentThread_);
+#endif
 }
 
 void init_Threads(void) {
-    init_Threads_();
+#if !defined (iHaveThreadLocal)
+    tss_create(&currentThread_, NULL);
+#endif
 }
 
 void finish_Thread_(iThread *d) { /* called from threadpool.c as well */
@@ -66,8 +74,8 @@ void finish_Thread_(iThread *d) { /* called from threadpool.c as well */
 }
 
 static int run_Threads_(void *arg) {
-    iThread *d = (iThread *) arg;
-    ref_Object(d);
+    iThread *d = (iThread *) arg; /* reference added by start_Thread */
+    setCurrent_Thread_(d);
     if (!isEmpty_String(&d->name)) {
 #if defined (iPlatformApple)
         pthread_setname_np(cstr_String(&d->name));
@@ -82,10 +90,9 @@ static int run_Threads_(void *arg) {
 #endif
     }
     d->result = d->run(d);
-    /* Deregister the thread since it's stopping. */
-    iGuard(runningThreads_, remove_ThreadHash(runningThreads_->value, &d->id));
     /* Notify observers that the thread is done. */
     finish_Thread_(d);
+    setCurrent_Thread_(NULL);
     deref_Object(d);
     deinitForThread_Garbage_();
     thrd_exit(0); // thread-local data gets deleted
@@ -99,6 +106,7 @@ iDefineObjectConstructionArgs(Thread, (iThreadRunFunc run), run)
 
 void init_Thread(iThread *d, iThreadRunFunc run) {
     init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "Thread");
     init_Condition(&d->finishedCond);
     init_String(&d->name);
     d->result = 0;
@@ -122,15 +130,25 @@ void deinit_Thread(iThread *d) {
 }
 
 void start_Thread(iThread *d) {
-    iLockableThreadHash *threads = init_Threads_();
+    iBool failed = iFalse;
     iGuardMutex(&d->mutex, {
         iAssert(d->state == created_ThreadState);
         d->state = running_ThreadState;
-        thrd_create(&d->id, run_Threads_, d);
-        iDebug("[Thread] created thread ID %p (%s)\n", d->id, cstr_String(&d->name));
+        /* The thread must not be deleted before it has finished running. */
+        ref_Object(d);
+        if (thrd_create(&d->id, run_Threads_, d) == thrd_success) {
+            iDebug("[Thread] created thread ID %p (%s)\n", d->id, cstr_String(&d->name));
+        }
+        else {
+            iWarning("[Thread] failed to create thread (%s)\n", cstr_String(&d->name));
+            d->state = created_ThreadState;
+            d->id = 0;
+            failed = iTrue;
+        }
     });
-    /* Register this thread as a running thread. */
-    iGuard(threads, insert_ThreadHash(threads->value, &d->id, d));
+    if (failed) {
+        deref_Object(d);
+    }
 }
 
 void setName_Thread(iThread *d, const char *name) {
@@ -177,6 +195,11 @@ void join_Thread(iThread *d) {
     iAssert(d->id != thrd_current());
     if (d->id == thrd_current()) return;
     lock_Mutex(&d->mutex);
+    if (d->state == created_ThreadState) {
+        /* Never started, or starting failed. */
+        unlock_Mutex(&d->mutex);
+        return;
+    }
     if (d->state == running_ThreadState) {
         wait_Condition(&d->finishedCond, &d->mutex);
     }
@@ -198,14 +221,34 @@ void sleep_Thread(double seconds) {
 }
 
 iThread *current_Thread(void) {
-    iThread *d = NULL;
-    const iThreadId cur = thrd_current();
-    const iLockableThreadHash *threads = init_Threads_();
-    iGuard(threads, d = value_ThreadHash(threads->value, &cur));
-    return d;
+#if defined (iHaveThreadLocal)
+    return currentThread_;
+#else
+    return tss_get(currentThread_);
+#endif
 }
 
 iBool isCurrent_Thread(const iThread *d) {
     iAssert(d);
     return d->id == thrd_current();
 }
+
+/*-------------------------------------------------------------------------------------*/
+
+iDefineTypeConstructionArgs(ThreadStorage, (iDeleteFunc del), del)
+
+void init_ThreadStorage(iThreadStorage *d, iDeleteFunc del) {
+    tss_create(&d->key, (tss_dtor_t) del);
+}
+
+void deinit_ThreadStorage(iThreadStorage *d) {
+    tss_delete(d->key);
+}
+
+void *value_ThreadStorage(const iThreadStorage *d) {
+    return tss_get(d->key);
+}
+
+void setValue_ThreadStorage(iThreadStorage *d, void *value) {
+    tss_set(d->key, value);
+}
@@ -26,19 +26,34 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
 #include "the_Foundation/threadpool.h"
+#include "the_Foundation/mutex.h"
+
+#include <stdlib.h>
 
 void finish_Thread_(iThread *); // thread.c
 
+#define iDefaultGrowThreshold   0.1  /* seconds */
+#define iDefaultIdleTimeout     10.0 /* seconds */
+
 iDeclareClass(PooledThread)
 
 struct Impl_PooledThread {
     iThread thread;
     iThreadPool *pool;
+    iAtomicUInt64 jobs;      /* metrics */
+    iAtomicUInt64 busyNanos;
+    iAtomicUInt64 idleNanos;
 };
 
+static iThread *take_ThreadPool_(iThreadPool *d, iPooledThread *worker, double timeoutSeconds);
+static void     runJob_ThreadPool_(iThreadPool *d, iPooledThread *worker, iThread *job);
+
 static iThreadResult run_PooledThread_(iThread *thread) {
     iPooledThread *d = (iAny *) thread;
-    while (yield_ThreadPool(d->pool, 0.0)) { /* Keep going. */ }
+    iThread *job;
+    while ((job = take_ThreadPool_(d->pool, d, 0.0)) != NULL) {
+        runJob_ThreadPool_(d->pool, d, job);
+    }
     return 0;
 }
 
@@ -46,6 +61,9 @@ static void init_PooledThread(iPooledThread *d, iThreadPool *pool) {
     init_Thread(&d->thread, run_PooledThread_);
     setName_Thread(&d->thread, "PooledThread");
     d->pool = pool;
+    init_Atomic(&d->jobs, 0);
+    init_Atomic(&d->busyNanos, 0);
+    init_Atomic(&d->idleNanos, 0);
 }
 
 static void deinit_PooledThread(iPooledThread *d) {
@@ -63,24 +81,214 @@ iLocalDef void join_PooledThread (iPooledThread *d) { join_Thread(&d->thread); }
 iDefineClass(ThreadPool)
 iDefineObjectConstruction(ThreadPool)
 
-static void startThreads_ThreadPool_(iThreadPool *d, int minThreads, int reservedCores) {
-    const int count = iMaxi(iMaxi(1, minThreads), idealConcurrentCount_Thread() - reservedCores);
-    for (int i = 0; i < count; ++i) {
-        iPooledThread *pt = new_PooledThread(d);
-        pushBack_ObjectList(d->threads, pt);
-        start_PooledThread(pt);
-        iRelease(pt);
+iDeclareType(ThreadPoolCounters)
+
+struct Impl_ThreadPoolCounters {
+    iAtomicUInt64 submitted;
+    iAtomicUInt64 submittedHigh;
+    iAtomicUInt64 completed;
+    iAtomicUInt64 depth;
+    iAtomicUInt64 maxDepth;
+    iArray queuedAt[2]; /* per priority, one per queued job; guarded by the mutex */
+    iHistogram wait;
+    iHistogram run;
+    iHistogram idle;
+};
+
+static void delete_ThreadPoolCounters_(iThreadPoolCounters *d) {
+    if (d) {
+        iForIndices(i, d->queuedAt) {
+            deinit_Array(&d->queuedAt[i]);
+        }
+        free(d);
+    }
+}
+
+static iObjectList *lane_ThreadPool_(iThreadPool *d, enum iThreadPoolPriority priority) {
+    return priority == high_ThreadPoolPriority ? d->highPriority : &d->queue.items;
+}
+
+static size_t depth_ThreadPool_(const iThreadPool *d) {
+    return size_ObjectList(d->highPriority) + size_ObjectList(&d->queue.items);
+}
+
+static void push_ThreadPool_(iThreadPool *d, iAnyObject *job, enum iThreadPoolPriority priority) {
+    /* Called with the mutex locked. */
+    pushBack_ObjectList(lane_ThreadPool_(d, priority), job);
+    iThreadPoolCounters *m = valueRelaxed_Atomic(&d->metrics);
+    if (m) {
+        /* Termination requests are not counted as jobs. */
+        const iBool isJob = (job != (iAnyObject *) d);
+        const uint64_t now = (isJob ? monotonicNanoseconds_Time() : 0);
+        pushBack_Array(&m->queuedAt[priority], &now);
+        if (isJob) {
+            addRelaxed_Atomic(&m->submitted, 1);
+            if (priority == high_ThreadPoolPriority) {
+                addRelaxed_Atomic(&m->submittedHigh, 1);
+            }
+        }
+        setRelaxed_Atomic(&m->depth, depth_ThreadPool_(d));
+        raise_MetricsCounter(&m->maxDepth, depth_ThreadPool_(d));
+    }
+}
+
+static iThread *takeFront_ThreadPool_(iThreadPool *d) {
+    /* Called with the mutex locked. */
+    enum iThreadPoolPriority priority = high_ThreadPoolPriority;
+    iThread *job = takeFront_ObjectList(d->highPriority);
+    if (!job) {
+        priority = normal_ThreadPoolPriority;
+        job = takeFront_ObjectList(&d->queue.items);
+    }
+    iThreadPoolCounters *m = valueRelaxed_Atomic(&d->metrics);
+    if (job && m) {
+        iArray *queuedAt = &m->queuedAt[priority];
+        const uint64_t since = *(const uint64_t *) constFront_Array(queuedAt);
+        popFront_Array(queuedAt);
+        if (since) {
+            record_Histogram(&m->wait, monotonicNanoseconds_Time() - since);
+        }
+        setRelaxed_Atomic(&m->depth, depth_ThreadPool_(d));
+    }
+    return job;
+}
+
+iDeclareType(CpuNode)
+
+struct Impl_CpuNode {
+    int node;
+    int cpu;
+};
+
+static int cmp_CpuNode_(const void *a, const void *b) {
+    const iCpuNode *x = a, *y = b;
+    if (x->node != y->node) {
+        return iCmp(x->node, y->node);
+    }
+    return iCmp(x->cpu, y->cpu);
+}
+
+static int nextCpu_ThreadPool_(iThreadPool *d) {
+    if (!d->cpuOrder) {
+        /* Consecutive threads are placed on the same node. Only the cores that the
+           process is allowed to use are included. */
+        const int count = iMax(1, idealConcurrentCount_Thread());
+        d->cpuOrder = new_Array(sizeof(iCpuNode));
+        for (int cpu = 0; cpu < count; cpu++) {
+            if (isAllowedCpu_Thread(cpu)) {
+                pushBack_Array(d->cpuOrder, &(iCpuNode){ numaNode_Thread(cpu), cpu });
+            }
+        }
+        sort_Array(d->cpuOrder, cmp_CpuNode_);
+    }
+    if (isEmpty_Array(d->cpuOrder)) {
+        return -1; /* no pinning */
+    }
+    const iCpuNode *cn = constAt_Array(d->cpuOrder, d->nextCpu++ % size_Array(d->cpuOrder));
+    return cn->cpu;
+}
+
+static iBool hasPending_ThreadPool_(const iThreadPool *d) {
+    return depth_ThreadPool_(d) > 0;
+}
+
+static void addThread_ThreadPool_(iThreadPool *d) {
+    /* Called with the mutex locked. */
+    iPooledThread *pt = new_PooledThread(d);
+    pushBack_ObjectList(d->threads, pt);
+    start_PooledThread(pt);
+    if (d->isPinned) {
+        setAffinity_Thread(&pt->thread, nextCpu_ThreadPool_(d));
+    }
+    iRelease(pt);
+}
+
+static void retire_ThreadPool_(iThreadPool *d, iPooledThread *worker) {
+    /* Called with the mutex locked. The monitor joins retired threads. */
+    iForEach(ObjectList, i, d->threads) {
+        if (i.value->object == (iObject *) worker) {
+            pushBack_ObjectList(d->retired, worker);
+            remove_ObjectListIterator(&i);
+            break;
+        }
+    }
+    signal_Condition(&d->monitorCond);
+}
+
+static void joinRetired_ThreadPool_(iThreadPool *d) {
+    /* Called with the mutex locked. */
+    if (!isEmpty_ObjectList(d->retired)) {
+        iObjectList *retired = d->retired;
+        d->retired = new_ObjectList();
+        unlock_Mutex(&d->queue.mutex);
+        iForEach(ObjectList, i, retired) {
+            join_PooledThread((iPooledThread *) i.value->object);
+        }
+        iRelease(retired);
+        lock_Mutex(&d->queue.mutex);
     }
 }
 
+static iThreadResult runMonitor_ThreadPool_(iThread *thread) {
+    iThreadPool *d = userData_Thread(thread);
+    lock_Mutex(&d->queue.mutex);
+    while (!d->isStopping) {
+        joinRetired_ThreadPool_(d);
+        if (d->isStopping) {
+            break;
+        }
+        /* Grow if the front job has waited too long while every thread is busy. */
+        if (d->pendingSince && d->idleThreads == 0 &&
+            size_ObjectList(d->threads) < (size_t) d->maxThreads) {
+            const uint64_t now       = monotonicNanoseconds_Time();
+            const uint64_t threshold = (uint64_t) (d->growAfterSeconds * 1.0e9);
+            if (now - d->pendingSince >= threshold) {
+                addThread_ThreadPool_(d);
+                /* The new thread gets a full threshold to catch up before growing again. */
+                d->pendingSince = now;
+                continue;
+            }
+            iTime until;
+            initTimeout_Time(&until, (double) (threshold - (now - d->pendingSince)) / 1.0e9);
+            waitTimeout_Condition(&d->monitorCond, &d->queue.mutex, &until);
+        }
+        else {
+            /* Woken up when jobs are waiting while all threads are busy. */
+            wait_Condition(&d->monitorCond, &d->queue.mutex);
+        }
+    }
+    unlock_Mutex(&d->queue.mutex);
+    return 0;
+}
+
 static void stopThreads_ThreadPool_(iThreadPool *d) {
-    for (size_t count = size_ObjectList(d->threads); count; count--) {
-        put_Queue(&d->queue, d);
+    iThread *monitor;
+    iGuardMutex(&d->queue.mutex, {
+        d->isStopping = iTrue;
+        monitor = d->monitor;
+        d->monitor = NULL;
+        signal_Condition(&d->monitorCond);
+    });
+    if (monitor) {
+        join_Thread(monitor);
+        iRelease(monitor);
     }
+    /* Each thread exits after taking one of these. Idle threads cannot retire while
+       the queue is not empty, so the number of threads does not change any more. */
+    iGuardMutex(&d->queue.mutex, {
+        for (size_t count = size_ObjectList(d->threads); count; count--) {
+            push_ThreadPool_(d, d, normal_ThreadPoolPriority);
+        }
+        signalAll_Condition(&d->queue.cond);
+    });
     iForEach(ObjectList, i, d->threads) {
         join_PooledThread((iPooledThread *) i.value->object);
         remove_ObjectListIterator(&i);
     }
+    iForEach(ObjectList, j, d->retired) {
+        join_PooledThread((iPooledThread *) j.value->object);
+        remove_ObjectListIterator(&j);
+    }
 }
 
 iThreadPool *newLimits_ThreadPool(int minThreads, int reservedCores) {
@@ -89,46 +297,526 @@ iThreadPool *newLimits_ThreadPool(int minThreads, int reservedCores) {
     return d;
 }
 
+iThreadPool *newElastic_ThreadPool(int minThreads, int maxThreads) {
+    iThreadPool *d = iNew(ThreadPool);
+    initElastic_ThreadPool(d, minThreads, maxThreads);
+    return d;
+}
+
 void init_ThreadPool(iThreadPool *d) {
     initLimits_ThreadPool(d, 0, 0);
 }
 
 void initLimits_ThreadPool(iThreadPool *d, int minThreads, int reservedCores) {
+    const int count = iMaxi(iMaxi(1, minThreads), idealConcurrentCount_Thread() - reservedCores);
+    initElastic_ThreadPool(d, count, count);
+}
+
+void initElastic_ThreadPool(iThreadPool *d, int minThreads, int maxThreads) {
     init_Queue(&d->queue);
-    d->threads = new_ObjectList();
-    startThreads_ThreadPool_(d, minThreads, reservedCores);
+    d->highPriority       = new_ObjectList();
+    d->threads            = new_ObjectList();
+    d->retired            = new_ObjectList();
+    d->minThreads         = iMaxi(1, minThreads);
+    d->maxThreads         = iMaxi(d->minThreads, maxThreads);
+    d->idleThreads        = 0;
+    d->pendingSince       = 0;
+    d->growAfterSeconds   = iDefaultGrowThreshold;
+    d->idleTimeoutSeconds = iDefaultIdleTimeout;
+    d->monitor            = NULL;
+    init_Condition(&d->monitorCond);
+    d->isStopping         = iFalse;
+    d->isPinned           = iFalse;
+    d->nextCpu            = 0;
+    d->cpuOrder           = NULL;
+    set_Atomic(&d->metrics, NULL);
+    iGuardMutex(&d->queue.mutex, {
+        for (int i = 0; i < d->minThreads; ++i) {
+            addThread_ThreadPool_(d);
+        }
+    });
+    if (isElastic_ThreadPool(d)) {
+        d->monitor = new_Thread(runMonitor_ThreadPool_);
+        setName_Thread(d->monitor, "ThreadPoolMonitor");
+        setUserData_Thread(d->monitor, d);
+        start_Thread(d->monitor);
+    }
 }
 
 void deinit_ThreadPool(iThreadPool *d) {
     stopThreads_ThreadPool_(d);
+    iRelease(d->retired);
     iRelease(d->threads);
+    iRelease(d->highPriority);
+    delete_Array(d->cpuOrder);
+    delete_ThreadPoolCounters_(value_Atomic(&d->metrics));
+    deinit_Condition(&d->monitorCond);
     deinit_Queue(&d->queue);
 }
 
-iThread *run_ThreadPool(iThreadPool *d, iThread *thread) {
+void setGrowThreshold_ThreadPool(iThreadPool *d, double seconds) {
+    iGuardMutex(&d->queue.mutex, {
+        d->growAfterSeconds = iMax(0.0, seconds);
+        signal_Condition(&d->monitorCond);
+    });
+}
+
+void setIdleTimeout_ThreadPool(iThreadPool *d, double seconds) {
+    /* Waiting threads use the new timeout after their current wait. */
+    iGuardMutex(&d->queue.mutex, d->idleTimeoutSeconds = seconds);
+}
+
+void setPinned_ThreadPool(iThreadPool *d, iBool pinned) {
+    iGuardMutex(&d->queue.mutex, {
+        if (d->isPinned != pinned) {
+            d->isPinned = pinned;
+            d->nextCpu  = 0;
+            iConstForEach(ObjectList, i, d->threads) {
+                iPooledThread *pt = (iPooledThread *) i.value->object;
+                setAffinity_Thread(&pt->thread, pinned ? nextCpu_ThreadPool_(d) : -1);
+            }
+        }
+    });
+}
+
+size_t size_ThreadPool(const iThreadPool *d) {
+    size_t size;
+    iGuardMutex(&d->queue.mutex, size = size_ObjectList(d->threads));
+    return size;
+}
+
+iBool isElastic_ThreadPool(const iThreadPool *d) {
+    return d->maxThreads > d->minThreads;
+}
+
+iThread *runPriority_ThreadPool(iThreadPool *d, iThread *thread,
+                                enum iThreadPoolPriority priority) {
     if (thread) {
-        put_Queue(&d->queue, thread);
+        iAssertIsObject(thread);
+        lock_Mutex(&d->queue.mutex);
+        if (d->monitor && !hasPending_ThreadPool_(d)) {
+            d->pendingSince = monotonicNanoseconds_Time();
+            if (d->idleThreads == 0) {
+                signal_Condition(&d->monitorCond);
+            }
+        }
+        push_ThreadPool_(d, thread, priority);
+        signal_Condition(&d->queue.cond);
+        unlock_Mutex(&d->queue.mutex);
     }
     return thread;
 }
 
-iBool yield_ThreadPool(iThreadPool *d, double timeoutSeconds) {
+static iThread *take_ThreadPool_(iThreadPool *d, iPooledThread *worker, double timeoutSeconds) {
+    /* Only pooled threads of an elastic pool may retire. Others wait for `timeoutSeconds`,
+       or indefinitely if it is zero. */
     iThread *job = NULL;
-    if (timeoutSeconds <= 0.0) {
-        job = (iAny *) take_Queue(&d->queue);
+    lock_Mutex(&d->queue.mutex);
+    const iBool mayRetire = (worker && d->monitor);
+    if (mayRetire) {
+        timeoutSeconds = d->idleTimeoutSeconds;
     }
-    else {
-        job = (iAny *) takeTimeout_Queue(&d->queue, timeoutSeconds);
+    iTime until;
+    if (timeoutSeconds > 0.0) {
+        initTimeout_Time(&until, timeoutSeconds);
     }
-    if (job == NULL || job == (void *) d) {
-        /* Terminated. */
-        return iFalse;
+    const iThreadPoolCounters *m = valueRelaxed_Atomic(&d->metrics);
+    const uint64_t idleSince = (m ? monotonicNanoseconds_Time() : 0);
+    d->idleThreads++;
+    for (;;) {
+        job = takeFront_ThreadPool_(d);
+        if (job) {
+            break;
+        }
+        if (timeoutSeconds <= 0.0) {
+            wait_Condition(&d->queue.cond, &d->queue.mutex);
+        }
+        else if (waitTimeout_Condition(&d->queue.cond, &d->queue.mutex, &until) ==
+                 thrd_timedout) {
+            if (hasPending_ThreadPool_(d)) {
+                continue;
+            }
+            if (!mayRetire) {
+                break;
+            }
+            if (!d->isStopping && size_ObjectList(d->threads) > (size_t) d->minThreads) {
+                retire_ThreadPool_(d, worker);
+                break;
+            }
+            initTimeout_Time(&until, d->idleTimeoutSeconds);
+        }
+    }
+    d->idleThreads--;
+    if (m) {
+        const uint64_t idle = monotonicNanoseconds_Time() - idleSince;
+        record_Histogram(iConstCast(iHistogram *, &m->idle), idle);
+        if (worker) {
+            addRelaxed_Atomic(&worker->idleNanos, idle);
+        }
+    }
+    if (job && d->monitor) {
+        d->pendingSince = (hasPending_ThreadPool_(d) ? monotonicNanoseconds_Time() : 0);
+        if (d->pendingSince && d->idleThreads == 0) {
+            /* The last idle thread took a job, and the rest of the queue has to wait. */
+            signal_Condition(&d->monitorCond);
+        }
     }
+    unlock_Mutex(&d->queue.mutex);
+    if (job == (void *) d) {
+        /* Terminated. The pool is being destroyed, so its reference is not released. */
+        return NULL;
+    }
+    return job;
+}
+
+static void runJob_ThreadPool_(iThreadPool *d, iPooledThread *worker, iThread *job) {
     /* Run in the calling thread. */
     iAssert(job->state == created_ThreadState);
+    iThreadPoolCounters *m = valueRelaxed_Atomic(&d->metrics);
+    const uint64_t startedAt = (m ? monotonicNanoseconds_Time() : 0);
     iGuardMutex(&job->mutex, job->state = running_ThreadState);
     job->result = job->run(job);
     finish_Thread_(job);
     iRelease(job);
+    if (m) {
+        const uint64_t busy = monotonicNanoseconds_Time() - startedAt;
+        record_Histogram(&m->run, busy);
+        addRelaxed_Atomic(&m->completed, 1);
+        if (worker) {
+            addRelaxed_Atomic(&worker->jobs, 1);
+            addRelaxed_Atomic(&worker->busyNanos, busy);
+        }
+    }
+}
+
+iBool yield_ThreadPool(iThreadPool *d, double timeoutSeconds) {
+    iThread *job = take_ThreadPool_(d, NULL, timeoutSeconds);
+    if (!job) {
+        return iFalse;
+    }
+    runJob_ThreadPool_(d, NULL, job);
+    return iTrue;
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+iDefineTypeConstruction(ThreadPoolMetrics)
+
+void init_ThreadPoolMetrics(iThreadPoolMetrics *d) {
+    iZap(*d);
+    init_Array(&d->workers, sizeof(iThreadPoolWorkerMetrics));
+}
+
+void deinit_ThreadPoolMetrics(iThreadPoolMetrics *d) {
+    deinit_Array(&d->workers);
+}
+
+void enableMetrics_ThreadPool(iThreadPool *d) {
+    iGuardMutex(&d->queue.mutex, {
+        if (!valueRelaxed_Atomic(&d->metrics)) {
+            iThreadPoolCounters *m = calloc(1, sizeof(iThreadPoolCounters));
+            iForIndices(i, m->queuedAt) {
+                /* Jobs already queued have an unknown wait time. */
+                init_Array(&m->queuedAt[i], sizeof(uint64_t));
+                resize_Array(&m->queuedAt[i], size_ObjectList(lane_ThreadPool_(d, i)));
+            }
+            init_Histogram(&m->wait);
+            init_Histogram(&m->run);
+            init_Histogram(&m->idle);
+            setRelaxed_Atomic(&m->depth, depth_ThreadPool_(d));
+            setRelaxed_Atomic(&m->maxDepth, depth_ThreadPool_(d));
+            set_Atomic(&d->metrics, m);
+        }
+    });
+}
+
+void resetMetrics_ThreadPool(iThreadPool *d) {
+    iThreadPoolCounters *m = value_Atomic(&d->metrics);
+    if (m) {
+        setRelaxed_Atomic(&m->submitted, 0);
+        setRelaxed_Atomic(&m->submittedHigh, 0);
+        setRelaxed_Atomic(&m->completed, 0);
+        setRelaxed_Atomic(&m->maxDepth, valueRelaxed_Atomic(&m->depth));
+        reset_Histogram(&m->wait);
+        reset_Histogram(&m->run);
+        reset_Histogram(&m->idle);
+        iGuardMutex(&d->queue.mutex, {
+            iConstForEach(ObjectList, i, d->threads) {
+                iPooledThread *pt = (iPooledThread *) i.value->object;
+                setRelaxed_Atomic(&pt->jobs, 0);
+                setRelaxed_Atomic(&pt->busyNanos, 0);
+                setRelaxed_Atomic(&pt->idleNanos, 0);
+            }
+        });
+    }
+}
+
+iBool metrics_ThreadPool(const iThreadPool *d, iThreadPoolMetrics *metrics_out) {
+    const iThreadPoolCounters *m = value_Atomic(&iConstCast(iThreadPool *, d)->metrics);
+    if (!m) {
+        return iFalse;
+    }
+    metrics_out->submitted     = valueRelaxed_Atomic(&m->submitted);
+    metrics_out->submittedHigh = valueRelaxed_Atomic(&m->submittedHigh);
+    metrics_out->completed     = valueRelaxed_Atomic(&m->completed);
+    metrics_out->depth         = (size_t) valueRelaxed_Atomic(&m->depth);
+    metrics_out->maxDepth = (size_t) valueRelaxed_Atomic(&m->maxDepth);
+    summarize_Histogram(&m->wait, &metrics_out->wait);
+    summarize_Histogram(&m->run,  &metrics_out->run);
+    summarize_Histogram(&m->idle, &metrics_out->idle);
+    clear_Array(&metrics_out->workers);
+    lock_Mutex(iConstCast(iMutex *, &d->queue.mutex));
+    metrics_out->idleThreads = (size_t) d->idleThreads;
+    iConstForEach(ObjectList, i, d->threads) {
+        const iPooledThread *pt = (const iPooledThread *) i.value->object;
+        const iThreadPoolWorkerMetrics wm = {
+            valueRelaxed_Atomic(&pt->jobs),
+            valueRelaxed_Atomic(&pt->busyNanos),
+            valueRelaxed_Atomic(&pt->idleNanos)
+        };
+        pushBack_Array(&metrics_out->workers, &wm);
+    }
+    unlock_Mutex(iConstCast(iMutex *, &d->queue.mutex));
     return iTrue;
 }
+
+static double utilization_ThreadPoolWorkerMetrics_(const iThreadPoolWorkerMetrics *d) {
+    const uint64_t total = d->busyNanos + d->idleNanos;
+    return total ? 100.0 * d->busyNanos / total : 0.0;
+}
+
+void printMetrics_ThreadPool(const iThreadPool *d, FILE *out, enum iMetricsFormat format) {
+    iThreadPoolMetrics pm;
+    init_ThreadPoolMetrics(&pm);
+    if (metrics_ThreadPool(d, &pm)) {
+        if (format == json_MetricsFormat) {
+            fprintf(out, "{\"submitted\": %llu, \"submittedHigh\": %llu, \"completed\": %llu, "
+                    "\"depth\": %zu, \"maxDepth\": %zu, \"idleThreads\": %zu,\n",
+                    (unsigned long long) pm.submitted, (unsigned long long) pm.submittedHigh,
+                    (unsigned long long) pm.completed, pm.depth, pm.maxDepth, pm.idleThreads);
+            fprintf(out, " \"wait\": ");
+            print_HistogramSummary(&pm.wait, "wait", out, format);
+            fprintf(out, ",\n \"run\": ");
+            print_HistogramSummary(&pm.run, "run", out, format);
+            fprintf(out, ",\n \"idle\": ");
+            print_HistogramSummary(&pm.idle, "idle", out, format);
+            fprintf(out, ",\n \"workers\": [");
+            iConstForEach(Array, i, &pm.workers) {
+                const iThreadPoolWorkerMetrics *wm = i.value;
+                fprintf(out, "%s\n  {\"jobs\": %llu, \"busyNanos\": %llu, \"idleNanos\": %llu}",
+                        index_ArrayConstIterator(&i) > 0 ? "," : "", (unsigned long long) wm->jobs,
+                        (unsigned long long) wm->busyNanos, (unsigned long long) wm->idleNanos);
+            }
+            fprintf(out, "\n ]}\n");
+        }
+        else {
+            fprintf(out, "Threads %zu (%zu idle), submitted %llu (%llu high priority), "
+                    "completed %llu, depth %zu (max %zu)\n",
+                    size_Array(&pm.workers), pm.idleThreads,
+                    (unsigned long long) pm.submitted, (unsigned long long) pm.submittedHigh,
+                    (unsigned long long) pm.completed, pm.depth, pm.maxDepth);
+            printHeader_HistogramSummary(out);
+            print_HistogramSummary(&pm.wait, "wait", out, format);
+            print_HistogramSummary(&pm.run,  "run",  out, format);
+            print_HistogramSummary(&pm.idle, "idle", out, format);
+            fprintf(out, "%-12s %10s %10s %10s %7s\n", "Thread", "Jobs", "Busy ms", "Idle ms", "Util %");
+            iConstForEach(Array, i, &pm.workers) {
+                const iThreadPoolWorkerMetrics *wm = i.value;
+                fprintf(out, "%-12zu %10llu %10.3f %10.3f %7.2f\n", index_ArrayConstIterator(&i),
+                        (unsigned long long) wm->jobs, wm->busyNanos / 1.0e6,
+                        wm->idleNanos / 1.0e6, utilization_ThreadPoolWorkerMetrics_(wm));
+            }
+        }
+    }
+    deinit_ThreadPoolMetrics(&pm);
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+#define iParallelMinAutoGrain   256
+#define iParallelMaxAccumSize   64  /* bytes kept on the stack */
+
+iDeclareType(ParallelTask)
+
+struct Impl_ParallelTask {
+    iAtomicInt refs;
+    iRanges range;
+    size_t grain;
+    size_t workers;
+    iAtomicInt64 next;        /* offset from range.start of the next unclaimed index */
+    iAtomicInt64 done;        /* number of indices processed and combined */
+    iSemaphore finished;
+    iParallelForFunc forFunc;
+    iParallelReduceFunc reduceFunc;
+    iParallelCombineFunc combine;
+    void *context;
+    void *result;
+    const void *identity;     /* initial value of `result`; copied before distributing */
+    size_t resultSize;
+    iSpinMutex resultMutex;
+};
+
+static void deref_ParallelTask_(iParallelTask *d) {
+    if (add_Atomic(&d->refs, -1) == 1) {
+        deinit_Semaphore(&d->finished);
+        free(iConstCast(void *, d->identity));
+        free(d);
+    }
+}
+
+static iBool claim_ParallelTask_(iParallelTask *d, iRanges *chunk) {
+    /* Guided self-scheduling: claim a share of what remains, but at least the grain. */
+    const size_t total = size_Range(&d->range);
+    size_t offset = (size_t) value_Atomic(&d->next);
+    for (;;) {
+        if (offset >= total) {
+            return iFalse;
+        }
+        const size_t count = iMin(total - offset,
+                                  iMax(d->grain, (total - offset) / (2 * d->workers)));
+        int64_t expected = (int64_t) offset;
+        if (compareExchange_Atomic(&d->next, &expected, (int64_t) (offset + count))) {
+            chunk->start = d->range.start + offset;
+            chunk->end   = chunk->start + count;
+            return iTrue;
+        }
+        offset = (size_t) expected;
+    }
+}
+
+static void participate_ParallelTask_(iParallelTask *d) {
+    uint8_t localAccum[iParallelMaxAccumSize];
+    void *accum = NULL;
+    size_t processed = 0;
+    iRanges chunk;
+    while (claim_ParallelTask_(d, &chunk)) {
+        if (d->reduceFunc) {
+            if (!accum) {
+                /* Each accumulator begins from the identity value. The result may already
+                   include values combined by other workers. */
+                accum = (d->resultSize <= sizeof(localAccum) ? localAccum : malloc(d->resultSize));
+                memcpy(accum, d->identity, d->resultSize);
+            }
+            d->reduceFunc(d->context, chunk, accum);
+        }
+        else {
+            d->forFunc(d->context, chunk);
+        }
+        processed += size_Range(&chunk);
+    }
+    if (accum) {
+        iGuardSpinMutex(&d->resultMutex, d->combine(d->context, d->result, accum));
+        if (accum != localAccum) {
+            free(accum);
+        }
+    }
+    if (processed &&
+        (size_t) add_Atomic(&d->done, (int64_t) processed) + processed == size_Range(&d->range)) {
+        release_Semaphore(&d->finished, 1);
+    }
+}
+
+static iThreadResult run_ParallelTask_(iThread *thread) {
+    iParallelTask *d = userData_Thread(thread);
+    participate_ParallelTask_(d);
+    deref_ParallelTask_(d);
+    return 0;
+}
+
+static void run_ParallelTask_ThreadPool_(iThreadPool *d, iParallelTask *task) {
+    const size_t total = size_Range(&task->range);
+    const size_t poolSize = (d ? size_ThreadPool(d) : 0);
+    task->workers = poolSize + 1;
+    if (task->grain == 0) {
+        task->grain = iMax(iParallelMinAutoGrain, total / (8 * task->workers));
+    }
+    if (total <= task->grain || !d) {
+        /* Not worth distributing. */
+        if (task->reduceFunc) {
+            task->reduceFunc(task->context, task->range, task->result);
+        }
+        else if (total) {
+            task->forFunc(task->context, task->range);
+        }
+        return;
+    }
+    iParallelTask *shared = malloc(sizeof(iParallelTask));
+    *shared = *task;
+    if (task->reduceFunc) {
+        void *identity = malloc(task->resultSize);
+        memcpy(identity, task->result, task->resultSize);
+        shared->identity = identity;
+    }
+    set_Atomic(&shared->next, 0);
+    set_Atomic(&shared->done, 0);
+    init_Semaphore(&shared->finished, 0);
+    init_SpinMutex(&shared->resultMutex);
+    /* Helpers that start after everything has been claimed will return immediately. */
+    const size_t helpers = iMin(poolSize, (total + task->grain - 1) / task->grain - 1);
+    set_Atomic(&shared->refs, (int) helpers + 1);
+    for (size_t i = 0; i < helpers; i++) {
+        iThread *job = new_Thread(run_ParallelTask_);
+        setUserData_Thread(job, shared);
+        iRelease(run_ThreadPool(d, job));
+    }
+    participate_ParallelTask_(shared);
+    /* Remaining indices have been claimed by threads that are already running them. */
+    acquire_Semaphore(&shared->finished);
+    deref_ParallelTask_(shared);
+}
+
+void parallelFor_ThreadPool(iThreadPool *d, iRanges range, size_t grain,
+                            iParallelForFunc func, void *context) {
+    iParallelTask task = { .range = range, .grain = grain, .forFunc = func, .context = context };
+    run_ParallelTask_ThreadPool_(d, &task);
+}
+
+void parallelReduce_ThreadPool(iThreadPool *d, iRanges range, size_t grain,
+                               void *result, size_t resultSize,
+                               iParallelReduceFunc func, iParallelCombineFunc combine,
+                               void *context) {
+    iParallelTask task = { .range      = range,
+                           .grain      = grain,
+                           .reduceFunc = func,
+                           .combine    = combine,
+                           .context    = context,
+                           .result     = result,
+                           .resultSize = resultSize };
+    run_ParallelTask_ThreadPool_(d, &task);
+}
+
+iDeclareType(ParallelElements)
+
+struct Impl_ParallelElements {
+    iArray *array;
+    iParallelElementFunc func;
+    void *context;
+};
+
+static void forArrayRange_ParallelElements_(void *context, iRanges range) {
+    const iParallelElements *d = context;
+    for (size_t i = range.start; i < range.end; i++) {
+        d->func(d->context, at_Array(d->array, i), i);
+    }
+}
+
+static void forPtrArrayRange_ParallelElements_(void *context, iRanges range) {
+    const iParallelElements *d = context;
+    for (size_t i = range.start; i < range.end; i++) {
+        d->func(d->context, at_PtrArray(d->array, i), i);
+    }
+}
+
+void parallelForArray_ThreadPool(iThreadPool *d, iArray *array, size_t grain,
+                                 iParallelElementFunc func, void *context) {
+    iParallelElements elems = { array, func, context };
+    parallelFor_ThreadPool(d, (iRanges){ 0, size_Array(array) }, grain,
+                           forArrayRange_ParallelElements_, &elems);
+}
+
+void parallelForPtrArray_ThreadPool(iThreadPool *d, iPtrArray *array, size_t grain,
+                                    iParallelElementFunc func, void *context) {
+    iParallelElements elems = { array, func, context };
+    parallelFor_ThreadPool(d, (iRanges){ 0, size_PtrArray(array) }, grain,
+                           forPtrArrayRange_ParallelElements_, &elems);
+}
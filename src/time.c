@@ -56,6 +56,12 @@ iTime now_Time(void) {
     return time;
 }
 
+uint64_t monotonicNanoseconds_Time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
 void initCurrent_Time(iTime *d) {
     clock_gettime(CLOCK_REALTIME, &d->ts);
 }
@@ -0,0 +1,481 @@
+/** @file timerservice.c  Delayed and periodic calls.
+
+@authors Copyright (c) 2026 Jaakko Keränen <jaakko.keranen@iki.fi>
+
+@par License
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+<small>THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
+*/
+
+#include "the_Foundation/timerservice.h"
+#include "the_Foundation/array.h"
+#include "the_Foundation/dispatch.h"
+#include "the_Foundation/hash.h"
+#include "the_Foundation/list.h"
+#include "the_Foundation/mutex.h"
+#include "the_Foundation/thread.h"
+#include "the_Foundation/threadpool.h"
+#include "the_Foundation/time.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#if defined (iHaveTimerFd)
+#   include <poll.h>
+#   include <sys/eventfd.h>
+#   include <sys/timerfd.h>
+#   include <unistd.h>
+#endif
+
+/* The wheel has four levels of 64 slots. One tick of the lowest level is a millisecond,
+   and each slot of a higher level covers all the slots of the level below it. Timers
+   due further than the highest level reaches are placed in its last slot and placed
+   again when they get there. */
+enum iTimerWheelParams {
+    slotBits_TimerWheel   = 6,
+    slotCount_TimerWheel  = 1 << slotBits_TimerWheel,
+    slotMask_TimerWheel   = slotCount_TimerWheel - 1,
+    levelCount_TimerWheel = 4,
+};
+
+#define maxDelta_TimerWheel_    ((UINT64_C(1) << (slotBits_TimerWheel * levelCount_TimerWheel)) - 1)
+#define idle_TimerWheel_        UINT64_MAX
+
+static const uint64_t nsPerTick_TimerWheel_ = 1000000;
+
+iDeclareType(Timer)
+
+struct Impl_Timer {
+    iListNode  node; /* in a wheel slot */
+    iHashNode  idNode;
+    uint64_t   expires;  /* tick */
+    uint64_t   interval; /* ticks; zero if the timer is not periodic */
+    int        level;
+    int        slot;
+    iTimerFunc func;
+    iAny *     context;
+};
+
+iLocalDef iTimer *fromIdNode_Timer_(iHashNode *node) {
+    return node ? (iTimer *) ((char *) node - offsetof(iTimer, idNode)) : NULL;
+}
+
+iDeclareType(TimerCall)
+
+struct Impl_TimerCall {
+    iTimerFunc func;
+    iAny *     context;
+};
+
+static iThreadResult run_TimerCall_(iThread *job) {
+    iTimerCall *call = userData_Thread(job);
+    call->func(call->context);
+    free(call);
+    return 0;
+}
+
+static int lowestBit_(uint64_t bits) {
+    iAssert(bits);
+#if defined (__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int index = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+static uint64_t rotateRight_(uint64_t bits, int count) {
+    return count ? (bits >> count) | (bits << (64 - count)) : bits;
+}
+
+/*-------------------------------------------------------------------------------------*/
+
+struct Impl_TimerService {
+    iObject object;
+    iMutex mutex;
+    iList wheel[levelCount_TimerWheel][slotCount_TimerWheel];
+    uint64_t occupied[levelCount_TimerWheel]; /* one bit for each non-empty slot */
+    uint64_t tick;      /* next tick to process */
+    uint64_t startTime; /* monotonic nanoseconds at tick zero */
+    uint64_t wakeTick;  /* when the thread will next wake up */
+    iHash timers;       /* by ID */
+    iTimerId lastId;
+    iBool isStopping;
+    iThread *thread;
+    iThreadPool *pool;
+    iDispatch *dispatch;
+#if defined (iHaveTimerFd)
+    int timerFd;
+    int wakeFd;
+#else
+    iCondition changed;
+#endif
+};
+
+iDefineClass(TimerService)
+iDefineObjectConstruction(TimerService)
+
+static uint64_t currentTick_TimerService_(const iTimerService *d) {
+    return (monotonicNanoseconds_Time() - d->startTime) / nsPerTick_TimerWheel_;
+}
+
+static void place_TimerService_(iTimerService *d, iTimer *timer) {
+    /* Note: The service is assumed to be locked already. */
+    uint64_t expires = iMax(timer->expires, d->tick);
+    uint64_t delta   = expires - d->tick;
+    if (delta > maxDelta_TimerWheel_) {
+        delta   = maxDelta_TimerWheel_;
+        expires = d->tick + delta;
+    }
+    int level = 0;
+    while (level < levelCount_TimerWheel - 1 &&
+           delta >= UINT64_C(1) << (slotBits_TimerWheel * (level + 1))) {
+        level++;
+    }
+    timer->level = level;
+    timer->slot  = (int) (expires >> (slotBits_TimerWheel * level)) & slotMask_TimerWheel;
+    pushBack_List(&d->wheel[level][timer->slot], timer);
+    d->occupied[level] |= UINT64_C(1) << timer->slot;
+}
+
+static void unlink_TimerService_(iTimerService *d, iTimer *timer) {
+    iList *slot = &d->wheel[timer->level][timer->slot];
+    remove_List(slot, timer);
+    if (isEmpty_List(slot)) {
+        d->occupied[timer->level] &= ~(UINT64_C(1) << timer->slot);
+    }
+}
+
+static void takeSlot_TimerService_(iTimerService *d, int level, int slot, iList *taken) {
+    iList *list = &d->wheel[level][slot];
+    iTimer *timer;
+    while ((timer = popFront_List(list)) != NULL) {
+        pushBack_List(taken, timer);
+    }
+    d->occupied[level] &= ~(UINT64_C(1) << slot);
+}
+
+static uint64_t nextEvent_TimerService_(const iTimerService *d) {
+    /* The next tick when a timer expires or a higher-level slot needs to be cascaded
+       down to lower levels. */
+    uint64_t next = idle_TimerWheel_;
+    for (int level = 0; level < levelCount_TimerWheel; level++) {
+        if (!d->occupied[level]) {
+            continue;
+        }
+        const int      shift    = slotBits_TimerWheel * level;
+        const uint64_t position = d->tick >> shift;
+        const uint64_t bits =
+            rotateRight_(d->occupied[level], (int) (position & slotMask_TimerWheel));
+        uint64_t offset;
+        if (level == 0 || (d->tick & ((UINT64_C(1) << shift) - 1)) == 0) {
+            offset = lowestBit_(bits);
+        }
+        else {
+            /* The current slot was cascaded already; it will come around again. */
+            offset = (bits & ~UINT64_C(1)) ? lowestBit_(bits & ~UINT64_C(1)) : slotCount_TimerWheel;
+        }
+        next = iMin(next, (position + offset) << shift);
+    }
+    return next;
+}
+
+static void processTick_TimerService_(iTimerService *d, iArray *calls) {
+    /* Note: The service is assumed to be locked already. */
+    const uint64_t tick = d->tick;
+    iList due;
+    init_List(&due);
+    if ((tick & slotMask_TimerWheel) == 0) {
+        /* Move timers down from the higher levels. */
+        for (int level = 1; level < levelCount_TimerWheel; level++) {
+            const int slot = (int) (tick >> (slotBits_TimerWheel * level)) & slotMask_TimerWheel;
+            takeSlot_TimerService_(d, level, slot, &due);
+            if (slot != 0) {
+                break;
+            }
+        }
+        iTimer *timer;
+        while ((timer = popFront_List(&due)) != NULL) {
+            place_TimerService_(d, timer);
+        }
+    }
+    takeSlot_TimerService_(d, 0, (int) (tick & slotMask_TimerWheel), &due);
+    d->tick = tick + 1;
+    iTimer *timer;
+    while ((timer = popFront_List(&due)) != NULL) {
+        pushBack_Array(calls, &(iTimerCall){ timer->func, timer->context });
+        if (timer->interval) {
+            /* Missed calls are skipped if the service has fallen behind. */
+            timer->expires = iMax(timer->expires + timer->interval, d->tick);
+            place_TimerService_(d, timer);
+        }
+        else {
+            remove_Hash(&d->timers, timer->idNode.key);
+            free(timer);
+        }
+    }
+    deinit_List(&due);
+}
+
+static void advance_TimerService_(iTimerService *d, uint64_t now, iArray *calls) {
+    /* Note: The service is assumed to be locked already. */
+    while (d->tick <= now) {
+        const uint64_t next = nextEvent_TimerService_(d);
+        if (next > now) {
+            d->tick = now + 1; /* nothing happens until then */
+            break;
+        }
+        d->tick = next;
+        processTick_TimerService_(d, calls);
+    }
+}
+
+static void wake_TimerService_(iTimerService *d) {
+    /* Note: The service is assumed to be locked already. */
+#if defined (iHaveTimerFd)
+    const uint64_t one = 1;
+    const ssize_t written = write(d->wakeFd, &one, sizeof(one));
+    iAssert(written == sizeof(one));
+    iUnused(written);
+#else
+    signal_Condition(&d->changed);
+#endif
+}
+
+static void call_TimerService_(iTimerService *d, const iTimerCall *call) {
+    if (d->pool) {
+        iTimerCall *queued = malloc(sizeof(iTimerCall));
+        *queued = *call;
+        iThread *job = new_Thread(run_TimerCall_);
+        setUserData_Thread(job, queued);
+        iRelease(run_ThreadPool(d->pool, job));
+    }
+    else if (d->dispatch) {
+        post_Dispatch(d->dispatch, call->func, call->context);
+    }
+    else {
+        call->func(call->context);
+    }
+}
+
+static void sleep_TimerService_(iTimerService *d, uint64_t wakeTick) {
+#if defined (iHaveTimerFd)
+    struct itimerspec spec;
+    iZap(spec); /* disarmed */
+    if (wakeTick != idle_TimerWheel_) {
+        const uint64_t ns = d->startTime + wakeTick * nsPerTick_TimerWheel_;
+        spec.it_value.tv_sec  = (time_t) (ns / 1000000000);
+        spec.it_value.tv_nsec = (long) (ns % 1000000000);
+    }
+    timerfd_settime(d->timerFd, TFD_TIMER_ABSTIME, &spec, NULL);
+    struct pollfd fds[2] = { { d->timerFd, POLLIN, 0 }, { d->wakeFd, POLLIN, 0 } };
+    if (poll(fds, 2, -1) > 0) {
+        for (size_t i = 0; i < iElemCount(fds); i++) {
+            if (fds[i].revents & POLLIN) {
+                uint64_t count;
+                const ssize_t got = read(fds[i].fd, &count, sizeof(count));
+                iUnused(got); /* only the wakeup matters */
+            }
+        }
+    }
+#else
+    iGuardMutex(&d->mutex, {
+        while (!d->isStopping && d->wakeTick == wakeTick) {
+            if (wakeTick == idle_TimerWheel_) {
+                wait_Condition(&d->changed, &d->mutex);
+                continue;
+            }
+            const uint64_t now = currentTick_TimerService_(d);
+            if (now >= wakeTick) {
+                break;
+            }
+            /* The deadline of the wait is in real time, which may jump. Ticks are checked
+               against the monotonic clock at least once a second. */
+            iTime until;
+            initTimeout_Time(&until, iMin((double) (wakeTick - now) / 1000.0, 1.0));
+            waitTimeout_Condition(&d->changed, &d->mutex, &until);
+        }
+    });
+#endif
+}
+
+static iThreadResult run_TimerService_(iThread *thd) {
+    iTimerService *d = userData_Thread(thd);
+    iArray calls;
+    init_Array(&calls, sizeof(iTimerCall));
+    for (;;) {
+        uint64_t wakeTick;
+        lock_Mutex(&d->mutex);
+        if (d->isStopping) {
+            unlock_Mutex(&d->mutex);
+            break;
+        }
+        advance_TimerService_(d, currentTick_TimerService_(d), &calls);
+        wakeTick = d->wakeTick = nextEvent_TimerService_(d);
+        unlock_Mutex(&d->mutex);
+        iConstForEach(Array, i, &calls) {
+            call_TimerService_(d, i.value);
+        }
+        clear_Array(&calls);
+        sleep_TimerService_(d, wakeTick);
+    }
+    deinit_Array(&calls);
+    return 0;
+}
+
+iTimerService *newPool_TimerService(iThreadPool *pool) {
+    iTimerService *d = iNew(TimerService);
+    initPool_TimerService(d, pool);
+    return d;
+}
+
+iTimerService *newDispatch_TimerService(iDispatch *dispatch) {
+    iTimerService *d = iNew(TimerService);
+    initDispatch_TimerService(d, dispatch);
+    return d;
+}
+
+static void init_TimerService_(iTimerService *d, iThreadPool *pool, iDispatch *dispatch) {
+    init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "TimerService");
+    for (int level = 0; level < levelCount_TimerWheel; level++) {
+        for (int slot = 0; slot < slotCount_TimerWheel; slot++) {
+            init_List(&d->wheel[level][slot]);
+        }
+        d->occupied[level] = 0;
+    }
+    d->startTime  = monotonicNanoseconds_Time();
+    d->tick       = 0;
+    d->wakeTick   = idle_TimerWheel_;
+    init_Hash(&d->timers);
+    d->lastId     = 0;
+    d->isStopping = iFalse;
+    d->pool       = ref_Object(pool);
+    d->dispatch   = ref_Object(dispatch);
+#if defined (iHaveTimerFd)
+    d->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    d->wakeFd  = eventfd(0, EFD_CLOEXEC);
+    iAssert(d->timerFd >= 0 && d->wakeFd >= 0);
+#else
+    init_Condition(&d->changed);
+#endif
+    d->thread = new_Thread(run_TimerService_);
+    setName_Thread(d->thread, "TimerService");
+    setUserData_Thread(d->thread, d);
+    start_Thread(d->thread);
+}
+
+void init_TimerService(iTimerService *d) {
+    init_TimerService_(d, NULL, NULL);
+}
+
+void initPool_TimerService(iTimerService *d, iThreadPool *pool) {
+    init_TimerService_(d, pool, NULL);
+}
+
+void initDispatch_TimerService(iTimerService *d, iDispatch *dispatch) {
+    init_TimerService_(d, NULL, dispatch);
+}
+
+void deinit_TimerService(iTimerService *d) {
+    iGuardMutex(&d->mutex, {
+        d->isStopping = iTrue;
+        wake_TimerService_(d);
+    });
+    join_Thread(d->thread);
+    iRelease(d->thread);
+    for (int level = 0; level < levelCount_TimerWheel; level++) {
+        for (int slot = 0; slot < slotCount_TimerWheel; slot++) {
+            iTimer *timer;
+            while ((timer = popFront_List(&d->wheel[level][slot])) != NULL) {
+                free(timer);
+            }
+            deinit_List(&d->wheel[level][slot]);
+        }
+    }
+    deinit_Hash(&d->timers);
+#if defined (iHaveTimerFd)
+    close(d->wakeFd);
+    close(d->timerFd);
+#else
+    deinit_Condition(&d->changed);
+#endif
+    iRelease(d->dispatch);
+    iRelease(d->pool);
+    deinit_Mutex(&d->mutex);
+}
+
+static uint64_t ticks_TimerService_(double seconds) {
+    return seconds > 0.0 ? (uint64_t) ceil(seconds * 1000.0) : 0;
+}
+
+iTimerId addPeriodic_TimerService(iTimerService *d, double delaySeconds, double intervalSeconds,
+                                  iTimerFunc func, iAny *context) {
+    iAssert(func);
+    iTimer *timer = iMalloc(Timer);
+    timer->func     = func;
+    timer->context  = context;
+    timer->interval = intervalSeconds > 0.0 ? iMax(1, ticks_TimerService_(intervalSeconds)) : 0;
+    iTimerId id;
+    lock_Mutex(&d->mutex);
+    const uint64_t now = currentTick_TimerService_(d);
+    if (isEmpty_Hash(&d->timers)) {
+        d->tick = iMax(d->tick, now); /* nothing to process in between */
+    }
+    do {
+        id = ++d->lastId;
+    } while (id == 0 || contains_Hash(&d->timers, id));
+    timer->idNode.key = id;
+    timer->expires    = now + ticks_TimerService_(delaySeconds);
+    insert_Hash(&d->timers, &timer->idNode);
+    place_TimerService_(d, timer);
+    if (timer->expires < d->wakeTick) {
+        d->wakeTick = timer->expires;
+        wake_TimerService_(d);
+    }
+    unlock_Mutex(&d->mutex);
+    return id;
+}
+
+iBool cancel_TimerService(iTimerService *d, iTimerId id) {
+    iTimer *timer;
+    iGuardMutex(&d->mutex, {
+        timer = fromIdNode_Timer_(remove_Hash(&d->timers, id));
+        if (timer) {
+            unlink_TimerService_(d, timer);
+        }
+    });
+    if (timer) {
+        free(timer);
+        return iTrue;
+    }
+    return iFalse;
+}
+
+size_t size_TimerService(const iTimerService *d) {
+    size_t size;
+    iGuardMutex(&d->mutex, size = size_Hash(&d->timers));
+    return size;
+}
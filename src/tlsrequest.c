@@ -26,7 +26,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
 #include "the_Foundation/tlsrequest.h"
+#include "the_Foundation/eventloop.h"
 #include "the_Foundation/buffer.h"
+#include "the_Foundation/file.h"
 #include "the_Foundation/socket.h"
 #include "the_Foundation/stringhash.h"
 #include "the_Foundation/thread.h"
@@ -41,7 +43,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 #include <openssl/sha.h>
 #include <openssl/ssl.h>
 #include <openssl/x509v3.h>
+#include <errno.h>
 #include <time.h>
+#if !defined (iPlatformWindows)
+#   include <fcntl.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
 
 iDeclareType(Context)
 
@@ -73,31 +81,49 @@ static iBool readAllFromBIO_(BIO *bio, iBlock *out) {
 
 iDeclareClass(CachedSession)
 
-static const int maxSessionAge_CachedSession_ = 10 * 60; /* seconds */
+static const size_t defaultMaxSessions_Context_ = 128;
+static const double defaultMaxSessionAge_Context_ = 24 * 60 * 60; /* seconds */
+static const char   sessionCacheMagic_[4] = { 'T', 'L', 'S', 'C' };
+static const int    sessionCacheVersion_ = 1;
 
 struct Impl_CachedSession {
     iObject          object;
-    iBlock           pemSession;
-    iTime            timestamp;
+    iString          key;
+    SSL_SESSION *    session;
+    int64_t          expiresAt; /* seconds since the epoch, as set by the server */
     iTlsCertificate *cert; /* not sent if session reused */
     iBlock           clientHash;
+    iAtomicUInt64    lastUsed;
 };
 
-static void init_CachedSession(iCachedSession *d, SSL_SESSION *sess, const iTlsCertificate *cert) {
-    BIO *buf = BIO_new(BIO_s_mem());
-    PEM_write_bio_SSL_SESSION(buf, sess);
-    init_Block(&d->pemSession, 0);
-    readAllFromBIO_(buf, &d->pemSession);
-    BIO_free(buf);
-    initCurrent_Time(&d->timestamp);
+static int64_t expiresAt_CachedSession_(const SSL_SESSION *sess) {
+    /* The server tells how long the session or ticket may be resumed. */
+    double lifetime = (double) SSL_SESSION_get_timeout(sess);
+    if (SSL_SESSION_has_ticket(sess)) {
+        const unsigned long hint = SSL_SESSION_get_ticket_lifetime_hint(sess);
+        if (hint > 0) {
+            lifetime = iMin(lifetime, (double) hint);
+        }
+    }
+    return (int64_t) SSL_SESSION_get_time(sess) + (int64_t) lifetime;
+}
+
+static void init_CachedSession(iCachedSession *d, const iString *key, SSL_SESSION *sess,
+                               const iTlsCertificate *cert) {
+    initCopy_String(&d->key, key);
+    SSL_SESSION_up_ref(sess);
+    d->session = sess;
+    d->expiresAt = expiresAt_CachedSession_(sess);
     d->cert = copy_TlsCertificate(cert);
     init_Block(&d->clientHash, 0);
+    init_Atomic(&d->lastUsed, 0);
 }
 
 static void deinit_CachedSession(iCachedSession *d) {
     deinit_Block(&d->clientHash);
-    deinit_Block(&d->pemSession);
+    SSL_SESSION_free(d->session);
     delete_TlsCertificate(d->cert);
+    deinit_String(&d->key);
 }
 
 static void setClientCertificate_CachedSession_(iCachedSession *d, const iTlsCertificate *clientCert) {
@@ -106,31 +132,38 @@ static void setClientCertificate_CachedSession_(iCachedSession *d, const iTlsCer
     delete_Block(fp);
 }
 
+static iBool isExpired_CachedSession_(const iCachedSession *d, double maxAge) {
+    if (!d) return iTrue;
+    const int64_t now = (int64_t) time(NULL);
+    return now >= d->expiresAt ||
+           (double) (now - (int64_t) SSL_SESSION_get_time(d->session)) >= maxAge;
+}
+
+iDeclareType(CachedSessionUse)
+
+struct Impl_CachedSessionUse {
+    uint64_t        lastUsed;
+    iCachedSession *session;
+};
+
 iDefineClass(CachedSession)
 iDefineObjectConstructionArgs(CachedSession,
-                              (SSL_SESSION *sess, const iTlsCertificate *cert),
-                              sess, cert)
-
-static void reuse_CachedSession(const iCachedSession *d, SSL *ssl) {
-    BIO *buf = BIO_new_mem_buf(constData_Block(&d->pemSession), (int) size_Block(&d->pemSession));
-    SSL_SESSION *sess = NULL;
-    PEM_read_bio_SSL_SESSION(buf, &sess, NULL, NULL);
-    if (sess) {
-        SSL_SESSION_up_ref(sess);
-        SSL_set_session(ssl, sess);
-        SSL_SESSION_free(sess);
-    }
-    BIO_free(buf);
-}
+                              (const iString *key, SSL_SESSION *sess, const iTlsCertificate *cert),
+                              key, sess, cert)
 
 struct Impl_Context {
     iString               libraryName;
     SSL_CTX *             ctx;
     X509_STORE *          certStore;
     iTlsRequestVerifyFunc userVerifyFunc;
-    tss_t                 tssKeyCurrentRequest;
-    iMutex                cacheMutex;
-    iStringHash *         cache; /* key is "address:port"; these could be saved persistently */
+#if !defined (iPlatformWindows)
+    iEventLoop *          loop; /* all requests are processed here */
+#endif
+    iRWLock               cacheLock;  /* guards the members below */
+    iStringHash *         cache;      /* CachedSession objects; key is "address:port" */
+    size_t                maxSessions;
+    double                maxSessionAge;
+    iAtomicUInt64         useCounter; /* for finding the least recently used sessions */
 };
 
 static iString *cacheKey_(const iString *host, uint16_t port) {
@@ -139,9 +172,8 @@ static iString *cacheKey_(const iString *host, uint16_t port) {
     return key;
 }
 
-static iBool isExpired_CachedSession_(const iCachedSession *d) {
-    if (!d) return iTrue;
-    return elapsedSeconds_Time(&d->timestamp) > maxSessionAge_CachedSession_;
+static void touch_CachedSession_(iCachedSession *d, iContext *context) {
+    set_Atomic(&d->lastUsed, add_Atomic(&context->useCounter, 1) + 1);
 }
 
 static iTlsCertificate *maybeReuseSession_Context_(iContext *d, SSL *ssl, const iString *host,
@@ -149,52 +181,78 @@ static iTlsCertificate *maybeReuseSession_Context_(iContext *d, SSL *ssl, const
     iTlsCertificate *cert = NULL;
     iBlock *clientHash = (clientCert ? fingerprint_TlsCertificate(clientCert) : new_Block(0));
     iString *key = cacheKey_(host, port);
-    lock_Mutex(&d->cacheMutex);
-    /* Remove old entries from the session cache. */
-    iForEach(StringHash, i, d->cache) {
-        iCachedSession *cs = i.value->object;
-        if (isExpired_CachedSession_(cs)) {
-            iDebug("[TlsRequest] session for `%s` has expired\n", cstr_Block(&i.value->keyBlock));
-            remove_StringHashIterator(&i);
-        }
-    }
+    /* Lookups only need shared access; expired entries are removed when saving. */
+    lockRead_RWLock(&d->cacheLock);
     iCachedSession *cs = value_StringHash(d->cache, key);
-    if (cs && (size_Block(&cs->clientHash) == size_Block(clientHash) &&
+    if (cs && !isExpired_CachedSession_(cs, d->maxSessionAge) && (size_Block(&cs->clientHash) == size_Block(clientHash) &&
                cmp_Block(&cs->clientHash, clientHash) == 0)) {
-        reuse_CachedSession(cs, ssl);
+        SSL_set_session(ssl, cs->session); /* takes a reference */
         cert = copy_TlsCertificate(cs->cert);
+        touch_CachedSession_(cs, d);
         iDebug("[TlsRequest] reusing session for `%s`\n", cstr_String(key));
     }
-    unlock_Mutex(&d->cacheMutex);
+    unlockRead_RWLock(&d->cacheLock);
     delete_String(key);
     delete_Block(clientHash);
     return cert; /* caller gets ownership */
 }
 
+static void trim_Context_(iContext *d, size_t maxSessions) {
+    /* Note: Locked for writing. */
+    /* Remove expired entries and then the least recently used ones. */
+    iForEach(StringHash, i, d->cache) {
+        if (isExpired_CachedSession_(i.value->object, d->maxSessionAge)) {
+            iDebug("[TlsRequest] session for `%s` has expired\n", cstr_Block(&i.value->keyBlock));
+            remove_StringHashIterator(&i);
+        }
+    }
+    while (size_StringHash(d->cache) > maxSessions) {
+        const iString *oldest = NULL;
+        uint64_t oldestUse = UINT64_MAX;
+        iConstForEach(StringHash, i, d->cache) {
+            const iCachedSession *entry = i.value->object;
+            const uint64_t used = value_Atomic(&iConstCast(iCachedSession *, entry)->lastUsed);
+            if (used < oldestUse) {
+                oldest    = &entry->key;
+                oldestUse = used;
+            }
+        }
+        iString *removed = copy_String(oldest);
+        remove_StringHash(d->cache, removed);
+        delete_String(removed);
+    }
+}
+
+static void insertSession_Context_(iContext *d, iCachedSession *cs) {
+    /* Note: Locked for writing. */
+    if (d->maxSessions == 0 || isExpired_CachedSession_(cs, d->maxSessionAge)) {
+        return;
+    }
+    remove_StringHash(d->cache, &cs->key);
+    trim_Context_(d, d->maxSessions - 1);
+    touch_CachedSession_(cs, d);
+    insert_StringHash(d->cache, &cs->key, cs);
+}
+
 static void saveSession_Context_(iContext *d, const iString *host, uint16_t port,
                                  SSL_SESSION *sess, const iTlsCertificate *serverCert,
                                  const iTlsCertificate *clientCert) {
     if (sess && serverCert) {
         iString *key = cacheKey_(host, port);
-        lock_Mutex(&d->cacheMutex);
-        iCachedSession *cs = new_CachedSession(sess, serverCert);
+        lockWrite_RWLock(&d->cacheLock);
+        iCachedSession *cs = new_CachedSession(key, sess, serverCert);
         if (clientCert) {
             setClientCertificate_CachedSession_(cs, clientCert);
         }
-        insert_StringHash(d->cache, key, cs);
-        unlock_Mutex(&d->cacheMutex);
+        insertSession_Context_(d, cs);
+        iRelease(cs);
         iDebug("[TlsRequest] saved session for `%s`\n", cstr_String(key));
+        unlockWrite_RWLock(&d->cacheLock);
         delete_String(key);
     }
 }
 
-static iTlsRequest *currentRequestForThread_Context_(iContext *d) {
-    return tss_get(context_->tssKeyCurrentRequest);
-}
-
-static void setCurrentRequestForThread_Context_(iContext *d, iTlsRequest *request) {
-    tss_set(context_->tssKeyCurrentRequest, request);
-}
+static int newSession_Context_(SSL *ssl, SSL_SESSION *sess);
 
 static int verifyCallback_Context_(int preverifyOk, X509_STORE_CTX *storeCtx) {
     if (preverifyOk) {
@@ -219,7 +277,8 @@ static int verifyCallback_Context_(int preverifyOk, X509_STORE_CTX *storeCtx) {
 #endif
     int result = 1; /* accept everything by default */
     if (d->userVerifyFunc) {
-        iTlsRequest *request = currentRequestForThread_Context_(d);
+        SSL *ssl = X509_STORE_CTX_get_ex_data(storeCtx, SSL_get_ex_data_X509_STORE_CTX_idx());
+        iTlsRequest *request = SSL_get_app_data(ssl);
         iAssert(request != NULL);
         result = d->userVerifyFunc(request, cert, depth) ? 1 : 0;
         if (!result) {
@@ -237,8 +296,6 @@ void init_Context(iContext *d) {
 #else
     setCStr_String(&d->libraryName, "OpenSSL");
 #endif
-    d->tssKeyCurrentRequest = 0;
-    tss_create(&d->tssKeyCurrentRequest, NULL);
 #if OPENSSL_API_COMPAT >= 0x10100000L
     OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS | OPENSSL_INIT_LOAD_CRYPTO_STRINGS, NULL);
     OPENSSL_init_crypto(OPENSSL_INIT_ADD_ALL_CIPHERS | OPENSSL_INIT_ADD_ALL_DIGESTS, NULL);
@@ -257,20 +314,32 @@ void init_Context(iContext *d) {
     }
     d->certStore = NULL;
     d->userVerifyFunc = NULL;
+#if !defined (iPlatformWindows)
+    d->loop = new_EventLoop();
+    start_EventLoop(d->loop);
+#endif
     SSL_CTX_set_verify(d->ctx, SSL_VERIFY_PEER, verifyCallback_Context_);
     /* Bug workarounds: https://www.openssl.org/docs/manmaster/man3/SSL_CTX_set_options.html */
     SSL_CTX_set_options(d->ctx, SSL_OP_ALL);
     SSL_CTX_set_min_proto_version(d->ctx, TLS1_2_VERSION);
-    init_Mutex(&d->cacheMutex);
+    init_RWLock(&d->cacheLock);
     d->cache = new_StringHash();
+    d->maxSessions = defaultMaxSessions_Context_;
+    d->maxSessionAge = defaultMaxSessionAge_Context_;
+    init_Atomic(&d->useCounter, 0);
+    /* New sessions are cached when OpenSSL reports them. With TLS 1.3, this happens when
+       the server sends a session ticket after the handshake. */
     SSL_CTX_set_session_cache_mode(d->ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(d->ctx, newSession_Context_);
 }
 
 void deinit_Context(iContext *d) {
     iRelease(d->cache);
-    deinit_Mutex(&d->cacheMutex);
+    deinit_RWLock(&d->cacheLock);
+#if !defined (iPlatformWindows)
+    iRelease(d->loop);
+#endif
     SSL_CTX_free(d->ctx);
-    tss_delete(d->tssKeyCurrentRequest);
     deinit_String(&d->libraryName);
 }
 
@@ -716,6 +785,207 @@ iString *privateKeyPem_TlsCertificate(const iTlsCertificate *d) {
 
 /*----------------------------------------------------------------------------------------------*/
 
+void setSessionCacheLimits_TlsRequest(size_t maxSessions, double maxAgeSeconds) {
+    initContext_();
+    iContext *d = context_;
+    lockWrite_RWLock(&d->cacheLock);
+    d->maxSessions   = maxSessions;
+    d->maxSessionAge = maxAgeSeconds;
+    trim_Context_(d, maxSessions);
+    unlockWrite_RWLock(&d->cacheLock);
+}
+
+void clearSessionCache_TlsRequest(void) {
+    initContext_();
+    iContext *d = context_;
+    lockWrite_RWLock(&d->cacheLock);
+    clear_StringHash(d->cache);
+    unlockWrite_RWLock(&d->cacheLock);
+}
+
+static void writeDer_(iStream *outs, int size, unsigned char **der) {
+    /* OpenSSL allocated `der`; it is freed here. */
+    iBlock *block = newData_Block(*der, size > 0 ? (size_t) size : 0);
+    serialize_Block(block, outs);
+    delete_Block(block);
+    OPENSSL_free(*der);
+    *der = NULL;
+}
+
+static void serialize_CachedSession_(const iCachedSession *d, iStream *outs) {
+    unsigned char *der = NULL;
+    int size;
+    serialize_String(&d->key, outs);
+    size = i2d_SSL_SESSION(d->session, &der);
+    writeDer_(outs, size, &der);
+    serialize_Block(&d->clientHash, outs);
+    size = d->cert->cert ? i2d_X509(d->cert->cert, &der) : 0;
+    writeDer_(outs, size, &der);
+    const int chainSize = d->cert->chain ? sk_X509_num(d->cert->chain) : 0;
+    writeU32_Stream(outs, (uint32_t) chainSize);
+    for (int i = 0; i < chainSize; i++) {
+        size = i2d_X509(sk_X509_value(d->cert->chain, i), &der);
+        writeDer_(outs, size, &der);
+    }
+}
+
+static X509 *readX509_(iStream *ins) {
+    iBlock der;
+    init_Block(&der, 0);
+    deserialize_Block(&der, ins);
+    const unsigned char *ptr = constData_Block(&der);
+    X509 *cert = isEmpty_Block(&der) ? NULL : d2i_X509(NULL, &ptr, (long) size_Block(&der));
+    deinit_Block(&der);
+    return cert;
+}
+
+static iCachedSession *newDeserialize_CachedSession_(iStream *ins) {
+    iCachedSession *d = NULL;
+    iString key;
+    iBlock der, clientHash;
+    init_String(&key);
+    init_Block(&der, 0);
+    init_Block(&clientHash, 0);
+    deserialize_String(&key, ins);
+    deserialize_Block(&der, ins);
+    deserialize_Block(&clientHash, ins);
+    X509 *cert = readX509_(ins);
+    STACK_OF(X509) *chain = sk_X509_new_null();
+    for (uint32_t i = readU32_Stream(ins); i > 0 && !atEnd_Stream(ins); i--) {
+        X509 *member = readX509_(ins);
+        if (member) {
+            sk_X509_push(chain, member);
+        }
+    }
+    const unsigned char *ptr = constData_Block(&der);
+    SSL_SESSION *sess = d2i_SSL_SESSION(NULL, &ptr, (long) size_Block(&der));
+    if (sess && cert) {
+        iTlsCertificate *serverCert = newX509Chain_TlsCertificate_(cert, chain);
+        d = new_CachedSession(&key, sess, serverCert);
+        set_Block(&d->clientHash, &clientHash);
+        delete_TlsCertificate(serverCert);
+    }
+    else {
+        if (cert) {
+            X509_free(cert);
+        }
+        freeX509Chain_(chain);
+    }
+    SSL_SESSION_free(sess); /* the cached session has its own reference */
+    deinit_Block(&clientHash);
+    deinit_Block(&der);
+    deinit_String(&key);
+    return d;
+}
+
+static iBool writePrivateFile_(const iString *path, const iBlock *data) {
+#if !defined (iPlatformWindows)
+    /* The file is created readable only by the owner, so the secrets are never exposed. */
+    const int fd = open(cstr_String(path), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return iFalse;
+    }
+    iBool ok = (fchmod(fd, S_IRUSR | S_IWUSR) == 0); /* an existing file keeps its mode */
+    const char *ptr = constData_Block(data);
+    size_t remaining = size_Block(data);
+    while (ok && remaining > 0) {
+        const ssize_t n = write(fd, ptr, remaining);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        ok = (n > 0);
+        if (ok) {
+            ptr += n;
+            remaining -= (size_t) n;
+        }
+    }
+    ok &= (close(fd) == 0);
+    return ok;
+#else
+    iFile *f = new_File(path);
+    iBool ok = open_File(f, writeOnly_FileMode);
+    if (ok) {
+        ok = (write_File(f, data) == size_Block(data));
+    }
+    iRelease(f);
+    return ok;
+#endif
+}
+
+iBool saveSessionCache_TlsRequest(const iString *path) {
+    initContext_();
+    iContext *d = context_;
+    /* Write the sessions in the order they were last used. */
+    iArray sessions;
+    init_Array(&sessions, sizeof(iCachedSessionUse));
+    lockRead_RWLock(&d->cacheLock);
+    iConstForEach(StringHash, i, d->cache) {
+        iCachedSession *cs = i.value->object;
+        if (!isExpired_CachedSession_(cs, d->maxSessionAge)) {
+            const iCachedSessionUse use = { value_Atomic(&cs->lastUsed), ref_Object(cs) };
+            pushBack_Array(&sessions, &use);
+        }
+    }
+    unlockRead_RWLock(&d->cacheLock);
+    sortKey_Array(&sessions, offsetof(iCachedSessionUse, lastUsed), uint64_SortKeyType);
+    /* The file contains secrets needed for resuming sessions. */
+    iBuffer *buf = new_Buffer();
+    openEmpty_Buffer(buf); {
+        iStream *outs = stream_Buffer(buf);
+        writeData_Stream(outs, sessionCacheMagic_, sizeof(sessionCacheMagic_));
+        writeU32_Stream(outs, sessionCacheVersion_);
+        writeU32_Stream(outs, (uint32_t) size_Array(&sessions));
+        iConstForEach(Array, i, &sessions) {
+            serialize_CachedSession_(((const iCachedSessionUse *) i.value)->session, outs);
+        }
+    }
+    const iBool ok = writePrivateFile_(path, data_Buffer(buf));
+    iRelease(buf);
+    iConstForEach(Array, j, &sessions) {
+        iRelease(((const iCachedSessionUse *) j.value)->session);
+    }
+    deinit_Array(&sessions);
+    return ok;
+}
+
+iBool loadSessionCache_TlsRequest(const iString *path) {
+    initContext_();
+    iContext *d = context_;
+    iFile *f = new_File(path);
+    if (!open_File(f, readOnly_FileMode)) {
+        iRelease(f);
+        return iFalse;
+    }
+    char magic[sizeof(sessionCacheMagic_)];
+    iBool ok = readData_File(f, sizeof(magic), magic) == sizeof(magic) &&
+               memcmp(magic, sessionCacheMagic_, sizeof(magic)) == 0 &&
+               readU32_File(f) == (uint32_t) sessionCacheVersion_;
+    if (ok) {
+        const uint32_t count = readU32_File(f);
+        for (uint32_t i = 0; i < count && !atEnd_File(f); i++) {
+            iCachedSession *cs = newDeserialize_CachedSession_(stream_File(f));
+            if (cs) {
+                lockWrite_RWLock(&d->cacheLock);
+                /* Sessions saved earlier in this process are newer. */
+                if (!contains_StringHash(d->cache, &cs->key)) {
+                    insertSession_Context_(d, cs);
+                }
+                unlockWrite_RWLock(&d->cacheLock);
+                iRelease(cs);
+            }
+        }
+    }
+    iRelease(f);
+    return ok;
+}
+
+/*----------------------------------------------------------------------------------------------*/
+
+/* Requests have no threads of their own. The TLS state machine is run in the socket's
+   notifications, which are made in the context's event loop (on Windows, in the socket's
+   I/O thread). The request is locked while OpenSSL is being used, and unlocked when
+   notifying the request's audiences. */
+
 struct Impl_TlsRequest {
     iObject          object;
     iMutex           mtx;
@@ -726,20 +996,17 @@ struct Impl_TlsRequest {
     const iTlsCertificate *clientCert;
     /* Payload and result. */
     iBlock           content;
-    iBuffer *        result;
+    iBlock           result; /* decrypted but not yet read */
     iTlsCertificate *cert; /* server certificate */
     iBool            certVerifyFailed;
     /* Internal state. */
     volatile enum iTlsRequestStatus status;
     iString *        errorMsg;
-    iThread *        thread;
     iBool            sessionCacheEnabled;
     iBool            notifyReady;
+    iBool            isFinishNotified;
     size_t           totalBytesToSend;
     size_t           totalBytesSent;
-    iBlock  *        incoming;
-    iCondition       gotIncoming;
-    iMutex           incomingMtx;
     iCondition       requestDone;
     iAudience *      readyRead;
     iAudience *      sent;
@@ -753,7 +1020,7 @@ struct Impl_TlsRequest {
 
 iDefineObjectConstruction(TlsRequest)
 iDefineAudienceGetter(TlsRequest, readyRead)
-iDefineAudienceGetter(TlsRequest, sent)
+iDefineDirectAudienceGetter(TlsRequest, sent)
 iDefineAudienceGetter(TlsRequest, finished)
 
 static void setError_TlsRequest_(iTlsRequest *d, const char *msg);
@@ -785,14 +1052,8 @@ static void setStatus_TlsRequest_(iTlsRequest *d, enum iTlsRequestStatus st) {
         if (st == finished_TlsRequestStatus || st == error_TlsRequestStatus) {
             signalAll_Condition(&d->requestDone);
         }
-        unlock_Mutex(&d->mtx);
-        lock_Mutex(&d->incomingMtx);
-        signal_Condition(&d->gotIncoming); /* wake up if sleeping */
-        unlock_Mutex(&d->incomingMtx);
-    }
-    else {
-        unlock_Mutex(&d->mtx);
     }
+    unlock_Mutex(&d->mtx);
 }
 
 static void flushToSocket_TlsRequest_(iTlsRequest *d) {
@@ -857,29 +1118,27 @@ const char *libraryName_TlsRequest(void) {
 void init_TlsRequest(iTlsRequest *d) {
     initContext_();
     init_Mutex(&d->mtx);
+    setName_Mutex(&d->mtx, "TlsRequest");
     d->hostName = new_String();
     d->port = 0;
     d->socket = NULL;
     d->clientCert = NULL;
     init_Block(&d->content, 0);
-    d->result = new_Buffer();
-    openEmpty_Buffer(d->result);
+    init_Block(&d->result, 0);
     d->cert = NULL;
     d->errorMsg = new_String();
     d->status = initialized_TlsRequestStatus;
     d->sessionCacheEnabled = iTrue;
-    d->thread = NULL;
     d->notifyReady = iFalse;
+    d->isFinishNotified = iFalse;
     d->totalBytesToSend = 0;
     d->totalBytesSent = 0;
-    d->incoming = new_Block(0);
-    init_Mutex(&d->incomingMtx);
-    init_Condition(&d->gotIncoming);
     init_Condition(&d->requestDone);
     d->readyRead = NULL;
     d->sent = NULL;
     d->finished = NULL;
     d->ssl = SSL_new(context_->ctx);
+    SSL_set_app_data(d->ssl, d); /* for the verify callback */
     /* We could also try BIO_s_socket() but all BSD socket related code should be encapsulated
        into the Socket class. */
     d->rbio = BIO_new(BIO_s_mem());
@@ -889,27 +1148,68 @@ void init_TlsRequest(iTlsRequest *d) {
     init_Block(&d->sending, 0);
 }
 
-void deinit_TlsRequest(iTlsRequest *d) {
-    iGuardMutex(&d->incomingMtx, signal_Condition(&d->gotIncoming));
-    iGuardMutex(&d->mtx, d->status = finished_TlsRequestStatus);
-    if (d->thread) {
-        join_Thread(d->thread);
-        iRelease(d->thread);
+iDeclareType(LoopBarrier)
+
+struct Impl_LoopBarrier {
+    iMutex     mtx;
+    iCondition passed;
+    iBool      isPassed;
+};
+
+static void pass_LoopBarrier_(iAny *context) {
+    iLoopBarrier *d = context;
+    iGuardMutex(&d->mtx, {
+        d->isPassed = iTrue;
+        signal_Condition(&d->passed);
+    });
+}
+
+static void waitForNotifications_TlsRequest_(iTlsRequest *d) {
+    /* Notifications already started in the event loop are finished when the loop gets
+       to a call posted after them. */
+#if !defined (iPlatformWindows)
+    if (!isCurrent_EventLoop(context_->loop)) {
+        iLoopBarrier barrier;
+        init_Mutex(&barrier.mtx);
+        init_Condition(&barrier.passed);
+        barrier.isPassed = iFalse;
+        lock_Mutex(&barrier.mtx);
+        post_EventLoop(context_->loop, pass_LoopBarrier_, &barrier);
+        while (!barrier.isPassed) {
+            wait_Condition(&barrier.passed, &barrier.mtx);
+        }
+        unlock_Mutex(&barrier.mtx);
+        deinit_Condition(&barrier.passed);
+        deinit_Mutex(&barrier.mtx);
+    }
+#endif
+    iUnused(d);
+}
+
+static void releaseSocket_TlsRequest_(iTlsRequest *d) {
+    if (d->socket) {
+        iDisconnectObject(Socket, d->socket, connected, d);
+        iDisconnectObject(Socket, d->socket, disconnected, d);
+        iDisconnectObject(Socket, d->socket, readyRead, d);
+        iDisconnectObject(Socket, d->socket, bytesWritten, d);
+        iDisconnectObject(Socket, d->socket, error, d);
+        waitForNotifications_TlsRequest_(d);
+        iReleasePtr(&d->socket);
     }
+}
+
+void deinit_TlsRequest(iTlsRequest *d) {
+    releaseSocket_TlsRequest_(d);
     deinit_Block(&d->sending);
     SSL_free(d->ssl);
     deinit_Condition(&d->requestDone);
-    deinit_Condition(&d->gotIncoming);
-    deinit_Mutex(&d->incomingMtx);
-    delete_Block(d->incoming);
     delete_Audience(d->finished);
     delete_Audience(d->sent);
     delete_Audience(d->readyRead);
     delete_String(d->errorMsg);
     delete_TlsCertificate(d->cert);
-    iRelease(d->result);
+    deinit_Block(&d->result);
     deinit_Block(&d->content);
-    iRelease(d->socket);
     delete_String(d->hostName);
     deinit_Mutex(&d->mtx);
 }
@@ -931,168 +1231,166 @@ void setSessionCacheEnabled_TlsRequest(iTlsRequest *d, iBool enabled) {
     d->sessionCacheEnabled = enabled;
 }
 
-static void appendReceived_TlsRequest_(iTlsRequest *d, const char *buf, size_t len) {
-    if (len > 0) {
-        iGuardMutex(&d->mtx, {
-            writeData_Buffer(d->result, buf, len);
-        });
-        d->notifyReady = iTrue;
+static void updateCertificate_TlsRequest_(iTlsRequest *d) {
+    if (!d->cert) {
+        STACK_OF(X509) *chain = SSL_get_peer_cert_chain(d->ssl);
+        X509 *cert = sk_X509_value(chain, 0);
+        if (cert) {
+            X509_up_ref(cert);
+            d->cert = newX509Chain_TlsCertificate_(cert, X509_chain_up_ref(chain));
+        }
     }
 }
 
-static int processIncoming_TlsRequest_(iTlsRequest *d, const char *src, size_t len) {
-    /* Note: Runs in the socket thread. */
-    char buf[DEFAULT_BUF_SIZE];
-    enum iSSLResult status;
+static int newSession_Context_(SSL *ssl, SSL_SESSION *sess) {
+    /* Called by OpenSSL when the server has given us a session to resume. The request is
+       locked already since OpenSSL is being used. */
+    iTlsRequest *d = SSL_get_app_data(ssl);
+    if (d && d->status == submitted_TlsRequestStatus) {
+        updateCertificate_TlsRequest_(d);
+        saveSession_Context_(context_, d->hostName, d->port, sess, d->cert, d->clientCert);
+    }
+    return 0; /* the cache keeps a reference of its own */
+}
+
+static enum iSSLResult decrypt_TlsRequest_(iTlsRequest *d) {
+    /* Decrypted data is appended directly to the result. */
     int n;
-    do {
-        if (len > 0) {
-            n = BIO_write(d->rbio, src, (int) len);
-            if (n <= 0) {
-                return -1; /* assume bio write failure is unrecoverable */
-            }
-            src += n;
-            len -= n;
-        }
-        if (!SSL_is_init_finished(d->ssl)) {
-            if (doHandshake_TlsRequest_(d) == fail_SSLResult) {
-                iDebug("[TlsRequest] handshake failure\n");
-                setError_TlsRequest_(d, "TLS/SSL handshake failed");
-                return -1;
-            }
-            if (!SSL_is_init_finished(d->ssl)) {
-                return 0; /* continue later */
-            }
-        }
-        if (!d->cert) {
-            STACK_OF(X509) *chain = SSL_get_peer_cert_chain(d->ssl);
-            X509 *cert = sk_X509_value(chain, 0);
-            X509_up_ref(cert);
-            d->cert = newX509Chain_TlsCertificate_(cert, X509_chain_up_ref(chain));
+    for (;;) {
+        const size_t oldSize = size_Block(&d->result);
+        resize_Block(&d->result, oldSize + DEFAULT_BUF_SIZE);
+        n = SSL_read(d->ssl, (char *) data_Block(&d->result) + oldSize, DEFAULT_BUF_SIZE);
+        truncate_Block(&d->result, oldSize + iMax(n, 0));
+        if (n <= 0) {
+            break;
         }
-        /* The encrypted data is now in the input bio so now we can perform actual
-           read of unencrypted data. */
-        do {
-            n = SSL_read(d->ssl, buf, sizeof(buf));
-            if (n > 0) {
-                appendReceived_TlsRequest_(d, buf, (size_t) n);
-            }
-        } while (n > 0);
+        d->notifyReady = iTrue;
+    }
+    return sslResult_TlsRequest_(d, n);
+}
 
-        status = sslResult_TlsRequest_(d, n);
-        /* Did SSL request to write bytes? This can happen if peer has requested SSL
-           renegotiation. */
-        if (status == wantIO_SSLResult) {
-            flushToSocket_TlsRequest_(d);
+static void process_TlsRequest_(iTlsRequest *d) {
+    /* Note: The request is assumed to be locked already. */
+    if (d->status != submitted_TlsRequestStatus) {
+        return;
+    }
+    /* Pass the received encrypted bytes to OpenSSL. */ {
+        char buf[DEFAULT_BUF_SIZE];
+        size_t len;
+        while ((len = readData_Stream((iStream *) d->socket, sizeof(buf), buf)) > 0) {
+            if (BIO_write(d->rbio, buf, (int) len) <= 0) {
+                setError_TlsRequest_(d, "failed to process incoming data");
+                return; /* assume bio write failure is unrecoverable */
+            }
         }
-        if (status == fail_SSLResult) {
-            setError_TlsRequest_(d, "error while decrypting incoming data");
-            return -1;
+    }
+    if (!SSL_is_init_finished(d->ssl)) {
+        if (doHandshake_TlsRequest_(d) == fail_SSLResult) {
+            iDebug("[TlsRequest] handshake failure\n");
+            setError_TlsRequest_(d, "TLS/SSL handshake failed");
+            return;
         }
-        if (status == closed_SSLResult && len == 0) {
-            setStatus_TlsRequest_(d, finished_TlsRequestStatus); /* even if socket remains open */
+        if (!SSL_is_init_finished(d->ssl)) {
+            return; /* continue later */
         }
-    } while (len > 0);
-    return 0;
+    }
+    updateCertificate_TlsRequest_(d);
+    /* The request content is sent once the handshake is complete. */
+    encrypt_TlsRequest_(d);
+    if (d->status != submitted_TlsRequestStatus) {
+        return;
+    }
+    const enum iSSLResult status = decrypt_TlsRequest_(d);
+    /* Did SSL request to write bytes? This can happen if peer has requested SSL
+       renegotiation. */
+    if (status == wantIO_SSLResult) {
+        flushToSocket_TlsRequest_(d);
+    }
+    if (status == fail_SSLResult) {
+        setError_TlsRequest_(d, "error while decrypting incoming data");
+    }
+    else if (status == closed_SSLResult) {
+        /* Reply to the server's close_notify. */
+        SSL_shutdown(d->ssl);
+        flushToSocket_TlsRequest_(d);
+        setStatus_TlsRequest_(d, finished_TlsRequestStatus); /* even if socket remains open */
+    }
 }
 
-static void checkReadyRead_TlsRequest_(iTlsRequest *d) {
-    /* All notifications are done from the TlsRequest thread. */
-    if (d->notifyReady) {
-        d->notifyReady = iFalse;
+static void notify_TlsRequest_(iTlsRequest *d) {
+    /* Observers are called with the request unlocked. */
+    lock_Mutex(&d->mtx);
+    const iBool notifyReady    = d->notifyReady;
+    const iBool notifyFinished = !d->isFinishNotified &&
+                                 (d->status == finished_TlsRequestStatus ||
+                                  d->status == error_TlsRequestStatus);
+    d->notifyReady = iFalse;
+    if (notifyFinished) {
+        d->isFinishNotified = iTrue;
+    }
+    unlock_Mutex(&d->mtx);
+    if (notifyReady) {
         iNotifyAudience(d, readyRead, TlsRequestReadyRead);
     }
+    if (notifyFinished) {
+        iNotifyAudience(d, finished, TlsRequestFinished);
+        iDebug("[TlsRequest] finished\n");
+    }
 }
 
-static void gotIncoming_TlsRequest_(iTlsRequest *d, iSocket *socket) {
-    iUnused(socket);
-    iBlock *data = readAll_Socket(socket);
-    lock_Mutex(&d->incomingMtx);
-    appendData_Block(d->incoming, constData_Block(data), size_Block(data));
-    signal_Condition(&d->gotIncoming);
-    unlock_Mutex(&d->incomingMtx);
-    delete_Block(data);
-}
-
-static iBool readIncoming_TlsRequest_(iTlsRequest *d) {
-    lock_Mutex(&d->incomingMtx);
-    const iBool didRead = !isEmpty_Block(d->incoming);
-    processIncoming_TlsRequest_(d, data_Block(d->incoming), size_Block(d->incoming));
-    clear_Block(d->incoming);
-    unlock_Mutex(&d->incomingMtx);
-    checkReadyRead_TlsRequest_(d);
-    return didRead;
-}
-
-static iThreadResult run_TlsRequest_(iThread *thread) {
-    iTlsRequest *d = userData_Thread(thread);
-    /* Thread-local pointer to the current request so it can be accessed in the
-       verify callback. */
-    iDebug("[TlsRequest] run_TlsRequest_: %zu bytes to send\n", size_Block(&d->sending));
-    setCurrentRequestForThread_Context_(context_, d);
-    doHandshake_TlsRequest_(d);
-    for (;;) {
-        encrypt_TlsRequest_(d);
-        if (!readIncoming_TlsRequest_(d)) {
-            lock_Mutex(&d->mtx);
-            if (d->status == submitted_TlsRequestStatus) {
-                unlock_Mutex(&d->mtx);
-                /* Wait for incoming data if there isn't some available. */
-                lock_Mutex(&d->incomingMtx);
-                if (isEmpty_Block(d->incoming)) {
-                    wait_Condition(&d->gotIncoming, &d->incomingMtx);
-                }
-                unlock_Mutex(&d->incomingMtx);
-            }
-            else {
-                //fprintf(stderr, "[TlsRequest] run loop exiting, status %d\n", d->status);
-                unlock_Mutex(&d->mtx);
-                break;
-            }
-        }
-    }
-    if (!SSL_session_reused(d->ssl) && d->status != error_TlsRequestStatus) {
-        saveSession_Context_(
-            context_, d->hostName, d->port, SSL_get0_session(d->ssl), d->cert, d->clientCert);
+static void connected_TlsRequest_(iTlsRequest *d, iSocket *sock) {
+    iUnused(sock);
+    iDebug("[TlsRequest] connected: %zu bytes to send\n", size_Block(&d->sending));
+    lock_Mutex(&d->mtx);
+    if (d->status == submitted_TlsRequestStatus &&
+        doHandshake_TlsRequest_(d) == fail_SSLResult) {
+        setError_TlsRequest_(d, "TLS/SSL handshake failed");
     }
-    readIncoming_TlsRequest_(d);
-    iNotifyAudience(d, finished, TlsRequestFinished);
-    iDebug("[TlsRequest] finished\n");
-    return 0;
+    unlock_Mutex(&d->mtx);
+    notify_TlsRequest_(d);
 }
 
-static void connected_TlsRequest_(iTlsRequest *d, iSocket *sock) {
-    /* The socket has been connected. During this notification the socket remains locked
-       so we must start a different thread for carrying out the I/O. */
+static void readyRead_TlsRequest_(iTlsRequest *d, iSocket *sock) {
     iUnused(sock);
-    iAssert(!d->thread);
-    d->thread = new_Thread(run_TlsRequest_);
-    setName_Thread(d->thread, "TlsRequest");
-    setUserData_Thread(d->thread, d);
-    start_Thread(d->thread);
+    iGuardMutex(&d->mtx, process_TlsRequest_(d));
+    notify_TlsRequest_(d);
 }
 
 static void disconnected_TlsRequest_(iTlsRequest *d, iSocket *sock) {
     iUnused(sock);
-    setStatus_TlsRequest_(d, finished_TlsRequestStatus);
+    lock_Mutex(&d->mtx);
+    process_TlsRequest_(d); /* anything received before the connection was closed */
+    if (d->status == submitted_TlsRequestStatus) {
+        /* Many servers just close the connection. OpenSSL would not resume the session
+           if it was freed without a shutdown. */
+        SSL_set_shutdown(d->ssl, SSL_get_shutdown(d->ssl) | SSL_SENT_SHUTDOWN);
+        setStatus_TlsRequest_(d, finished_TlsRequestStatus);
+    }
+    unlock_Mutex(&d->mtx);
+    notify_TlsRequest_(d);
 }
 
 static void bytesWritten_TlsRequest_(iTlsRequest *d, iSocket *sock, size_t num) {
+    iUnused(sock);
     d->totalBytesSent += num;
     iNotifyAudienceArgs(d, sent, TlsRequestSent, d->totalBytesSent, d->totalBytesToSend);
 }
 
 static void setError_TlsRequest_(iTlsRequest *d, const char *msg) {
+    lock_Mutex(&d->mtx);
     setCStr_String(d->errorMsg, msg);
     setStatus_TlsRequest_(d, error_TlsRequestStatus);
+    unlock_Mutex(&d->mtx);
 }
 
 static void handleError_TlsRequest_(iTlsRequest *d, iSocket *sock, int error, const char *msg) {
     iUnused(sock, error);
-    setError_TlsRequest_(d, msg);
-    if (!d->thread) {
-        iNotifyAudience(d, finished, TlsRequestFinished);
+    lock_Mutex(&d->mtx);
+    if (d->status == submitted_TlsRequestStatus) {
+        setError_TlsRequest_(d, msg);
     }
+    unlock_Mutex(&d->mtx);
+    notify_TlsRequest_(d);
 }
 
 void submit_TlsRequest(iTlsRequest *d) {
@@ -1100,11 +1398,13 @@ void submit_TlsRequest(iTlsRequest *d) {
         iDebug("[TlsRequest] request already ongoing\n");
         return;
     }
-    clear_Buffer(d->result);
+    releaseSocket_TlsRequest_(d);
+    clear_Block(&d->result);
     clear_String(d->errorMsg);
     set_Block(&d->sending, &d->content);
-    iRelease(d->socket);
     d->certVerifyFailed = iFalse;
+    d->notifyReady = iFalse;
+    d->isFinishNotified = iFalse;
     SSL_set1_host(d->ssl, cstr_String(d->hostName));
     /* Server Name Indication for the handshake. */
     if (!contains_String(d->hostName, ':')) { /* Domain names only (not literal IPv6 addresses). */
@@ -1119,9 +1419,12 @@ void submit_TlsRequest(iTlsRequest *d) {
         d->cert = maybeReuseSession_Context_(context_, d->ssl, d->hostName, d->port, d->clientCert);
     }
     d->socket = new_Socket(cstr_String(d->hostName), d->port, tcp_SocketType);
+#if !defined (iPlatformWindows)
+    setEventLoop_Socket(d->socket, context_->loop);
+#endif
     iConnect(Socket, d->socket, connected, d, connected_TlsRequest_);
     iConnect(Socket, d->socket, disconnected, d, disconnected_TlsRequest_);
-    iConnect(Socket, d->socket, readyRead, d, gotIncoming_TlsRequest_);
+    iConnect(Socket, d->socket, readyRead, d, readyRead_TlsRequest_);
     iConnect(Socket, d->socket, bytesWritten, d, bytesWritten_TlsRequest_);
     iConnect(Socket, d->socket, error, d, handleError_TlsRequest_);
     d->status = submitted_TlsRequestStatus;
@@ -1133,21 +1436,19 @@ void submit_TlsRequest(iTlsRequest *d) {
 void cancel_TlsRequest(iTlsRequest *d) {
     lock_Mutex(&d->mtx);
     if (d->status == submitted_TlsRequestStatus) {
-        d->status = error_TlsRequestStatus;
+        setStatus_TlsRequest_(d, error_TlsRequestStatus);
         unlock_Mutex(&d->mtx);
         close_Socket(d->socket);
+        notify_TlsRequest_(d);
     }
     else {
         unlock_Mutex(&d->mtx);
     }
-    signal_Condition(&d->gotIncoming);
-    join_Thread(d->thread);
-    iReleasePtr(&d->thread);
 }
 
 void waitForFinished_TlsRequest(iTlsRequest *d) {
     lock_Mutex(&d->mtx);
-    if (d->status == submitted_TlsRequestStatus) {
+    while (d->status == submitted_TlsRequestStatus) {
         wait_Condition(&d->requestDone, &d->mtx);
     }
     unlock_Mutex(&d->mtx);
@@ -1180,14 +1481,18 @@ const iTlsCertificate *serverCertificate_TlsRequest(const iTlsRequest *d) {
 }
 
 iBlock *readAll_TlsRequest(iTlsRequest *d) {
+    /* The received data is handed over without copying. */
     iBlock *rd;
-    iGuardMutex(&d->mtx, rd = consumeAll_Buffer(d->result));
+    iGuardMutex(&d->mtx, {
+        rd = copy_Block(&d->result);
+        clear_Block(&d->result);
+    });
     return rd;
 }
 
 size_t receivedBytes_TlsRequest(const iTlsRequest *d) {
     size_t len;
-    iGuardMutex(&d->mtx, len = size_Buffer(d->result));
+    iGuardMutex(&d->mtx, len = size_Block(&d->result));
     return len;
 }
 
@@ -28,6 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 #include "the_Foundation/webrequest.h"
 #include "the_Foundation/stringarray.h"
 #include "the_Foundation/buffer.h"
+#include "the_Foundation/fiber.h"
 #include "the_Foundation/mutex.h"
 
 #include <curl/curl.h>
@@ -94,6 +95,7 @@ void configure_WebRequest_(iWebRequest *d) {
 void init_WebRequest(iWebRequest *d) {
     iAssertIsObject(d);
     init_Mutex(&d->mutex);
+    setName_Mutex(&d->mutex, "WebRequest");
     d->curl = curl_easy_init();
     init_Block(&d->postData, 0);
     init_String(&d->postContentType);
@@ -139,6 +141,11 @@ void setPostData_WebRequest(iWebRequest *d, const char *contentType, const iBloc
     format_String(&d->postContentType, "Content-Type: %s", contentType);
 }
 
+static iThreadResult perform_WebRequest_(iThread *thread) {
+    iWebRequest *d = userData_Thread(thread);
+    return curl_easy_perform(d->curl);
+}
+
 static iBool execute_WebRequest_(iWebRequest *d) {
     char errorMsg[CURL_ERROR_SIZE];
     d->contentLength = 0;
@@ -148,7 +155,8 @@ static iBool execute_WebRequest_(iWebRequest *d) {
     clear_Buffer(d->result);
     clear_StringArray(d->headers);
     curl_easy_setopt(d->curl, CURLOPT_ERRORBUFFER, errorMsg);
-    const iBool ok = (curl_easy_perform(d->curl) == CURLE_OK);
+    /* In a fiber, the transfer is done in another thread so the pool thread is not blocked. */
+    const iBool ok = (offload_Fiber(perform_WebRequest_, d) == CURLE_OK);
     if (!ok) {
         setCStr_String(&d->errorMessage, errorMsg);
         iWarning("[WebRequest] %s\n", errorMsg);
@@ -210,5 +218,5 @@ iBlock *read_WebRequest(iWebRequest *d) {
 
 iDefineClass(WebRequest)
 iDefineObjectConstruction(WebRequest)
-iDefineAudienceGetter(WebRequest, progress)
+iDefineDirectAudienceGetter(WebRequest, progress)
 iDefineAudienceGetter(WebRequest, readyRead)
@@ -25,18 +25,32 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
 #include <the_Foundation/address.h>
+#include <the_Foundation/atomic.h>
 #include <the_Foundation/audience.h>
 #include <the_Foundation/commandline.h>
+#include <the_Foundation/datagram.h>
+#include <the_Foundation/objectpool.h>
 #include <the_Foundation/string.h>
 #include <the_Foundation/objectlist.h>
 #include <the_Foundation/service.h>
 #include <the_Foundation/socket.h>
 #include <the_Foundation/thread.h>
+#include <the_Foundation/time.h>
+#if !defined (iPlatformWindows)
+#  include <fcntl.h>
+#  include <netinet/in.h>
+#  include <netinet/tcp.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
 #if defined (iHaveWebRequest)
 #  include <the_Foundation/webrequest.h>
 #endif
 #if defined (iHaveTlsRequest)
 #  include <the_Foundation/tlsrequest.h>
+#  if !defined (iPlatformWindows)
+#    include <sys/stat.h>
+#  endif
 #endif
 
 static void logConnected_(iAny *d, iSocket *sock) {
@@ -122,8 +136,7 @@ static void communicate_(iAny *d, iService *sv, iSocket *sock) {
     iRelease(receiver);
 }
 
-static iBool connectTo_(const char *address) {
-    iSocket *sock = iClob(new_Socket(address, 14666));
+static iBool connectTo_(iSocket *sock) {
     observeSocket_(sock);
     if (!open_Socket(sock)) {
         puts("Failed to connect");
@@ -142,7 +155,335 @@ static iBool connectTo_(const char *address) {
     return iTrue;
 }
 
+#if !defined (iPlatformWindows)
+static int openBlackhole_(uint16_t port) {
+    /* Stand-in for an unroutable address: a listener whose queue is full, so new
+       connection attempts get no reply. */
+    const int fd = socket(AF_INET6, SOCK_STREAM, 0);
+    const int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &one, sizeof(one));
+    struct sockaddr_in6 addr = { .sin6_family = AF_INET6,
+                                 .sin6_port   = htons(port),
+                                 .sin6_addr   = IN6ADDR_LOOPBACK_INIT };
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, 0)) {
+        close(fd);
+        return -1;
+    }
+    for (int i = 0; i < 4; i++) {
+        const int client = socket(AF_INET6, SOCK_STREAM, 0);
+        fcntl(client, F_SETFL, O_NONBLOCK);
+        connect(client, (struct sockaddr *) &addr, sizeof(addr)); /* remains pending */
+    }
+    return fd;
+}
+
+static void keepAccepted_(iAny *accepted, iService *sv, iSocket *sock) {
+    iUnused(sv);
+    pushBack_ObjectList(accepted, sock);
+}
+
+static void connectParallel_(void) {
+    /* The host has an IPv6 address that never answers, and an IPv4 address where a
+       service is running. The IPv4 attempt is started after a short delay. */
+    const uint16_t port = (uint16_t) (20000 + getpid() % 10000); /* avoid lingering ports */
+    iService *sv = iClob(new_Service(port));
+    iObjectList *accepted = iClob(new_ObjectList());
+    iConnect(Service, sv, incomingAccepted, accepted, keepAccepted_);
+    const int blackhole = openBlackhole_(port);
+    if (blackhole < 0 || !open_Service(sv)) {
+        puts("Failed to start service");
+        return;
+    }
+    const char *hostsPath = "t_network_hosts.txt";
+    FILE *hosts = fopen(hostsPath, "w");
+    fprintf(hosts, "::1 eyeballs.test\n127.0.0.1 eyeballs.test\n");
+    fclose(hosts);
+    setHostsFile_Address(hostsPath);
+    const double delays[] = { 0.25, 10.0 };
+    iForIndices(i, delays) {
+        iSocket *sock = new_Socket("eyeballs.test", port, tcp_SocketType);
+        observeSocket_(sock);
+        setConnectTimeouts_Socket(sock, delays[i], 6.0);
+        iTime start;
+        initCurrent_Time(&start);
+        open_Socket(sock);
+        while (status_Socket(sock) == addressLookup_SocketStatus ||
+               status_Socket(sock) == connecting_SocketStatus) {
+            sleep_Thread(0.01);
+        }
+        printf("Attempt delay %.2f s: %s after %.2f seconds\n",
+               delays[i],
+               status_Socket(sock) == connected_SocketStatus ? "connected" : "failed",
+               elapsedSeconds_Time(&start));
+        iRelease(sock);
+    }
+    setHostsFile_Address(NULL);
+    remove(hostsPath);
+    close_Service(sv);
+    close(blackhole);
+}
+
+static void echoPair_(iAny *d, iSocket *sock) {
+    iUnused(d);
+    iBlock *data = readAll_Socket(sock);
+    write_Socket(sock, data); /* the same block is passed back */
+    delete_Block(data);
+}
+
+static iAtomicInt pairCount_;
+
+static void countPair_(iAny *d, iSocket *sock) {
+    iUnused(d);
+    iBlock *data = readAll_Socket(sock);
+    if (add_Atomic(&pairCount_, 1) + 1 < 10000) {
+        write_Socket(sock, data);
+    }
+    delete_Block(data);
+}
+
+static void exchangePair_(void) {
+    /* Messages go back and forth between two sockets in the same process. */
+    iSocket *other;
+    iSocket *sock = newPair_Socket(&other);
+    iConnect(Socket, other, readyRead, other, echoPair_);
+    iConnect(Socket, sock, readyRead, sock, countPair_);
+    iTime start;
+    initCurrent_Time(&start);
+    write_Socket(sock, collect_Block(newCStr_Block("Hello")));
+    while (value_Atomic(&pairCount_) < 10000 && elapsedSeconds_Time(&start) < 10.0) {
+        sleep_Thread(0.01);
+    }
+    printf("%d messages exchanged in %.3f seconds\n", value_Atomic(&pairCount_),
+           elapsedSeconds_Time(&start));
+    iRelease(sock);
+    iRelease(other);
+}
+#endif
+
+#if !defined (iPlatformWindows)
+static int connectLoopback_(struct sockaddr_in *addr_out, int *peer_out) {
+    /* Small buffers make the sender run out of room quickly. */
+    const int bufSize = 4096;
+    const int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t size = sizeof(addr);
+    setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize));
+    if (bind(listener, (struct sockaddr *) &addr, size) || listen(listener, 1) ||
+        getsockname(listener, (struct sockaddr *) &addr, &size)) {
+        close(listener);
+        return -1;
+    }
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufSize, sizeof(bufSize));
+    if (connect(fd, (struct sockaddr *) &addr, size)) {
+        close(fd);
+        close(listener);
+        return -1;
+    }
+    *peer_out = accept(listener, NULL, NULL);
+    *addr_out = addr;
+    close(listener);
+    return fd;
+}
+
+static size_t receiveRaw_(int fd, char *buf, size_t bufSize, size_t total) {
+    /* If the buffer is too small, the received data is only counted. */
+    const iBool keep = (total <= bufSize);
+    size_t received = 0;
+    while (received < total) {
+        const ssize_t n = recv(fd, buf + (keep ? received : 0),
+                               keep ? total - received : bufSize, 0);
+        if (n <= 0) break;
+        received += (size_t) n;
+    }
+    return received;
+}
+
+static iThreadResult run_StreamWriter_(iThread *thd) {
+    iSocket *sock = userData_Thread(thd);
+    char chunk[16384];
+    memset(chunk, 'x', sizeof(chunk));
+    for (int i = 0; i < 32; i++) {
+        writeData_Stream((iStream *) sock, chunk, sizeof(chunk));
+    }
+    return 0;
+}
+
+static void checkTcpSocket_(void) {
+    struct sockaddr_in addr;
+    int peer;
+    const int fd = connectLoopback_(&addr, &peer);
+    if (fd < 0) {
+        puts("Failed to connect over loopback");
+        return;
+    }
+    iSocket *sock = newExisting_Socket(fd, &addr, sizeof(addr), tcp_SocketType);
+    int value = 0;
+    socklen_t len = sizeof(value);
+    setNoDelay_Socket(sock, iTrue);
+    getsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, &len);
+    printf("TCP_NODELAY set: %s\n", value ? "yes" : "no");
+    iAssert(value);
+#if defined (TCP_CORK)
+    setCork_Socket(sock, iTrue);
+    getsockopt(fd, IPPROTO_TCP, TCP_CORK, &value, &len);
+    iBool corked = (value != 0);
+    setCork_Socket(sock, iFalse);
+    getsockopt(fd, IPPROTO_TCP, TCP_CORK, &value, &len);
+    corked &= (value == 0);
+    printf("TCP_CORK set and cleared: %s\n", corked ? "yes" : "no");
+    iAssert(corked);
+#endif
+    /* Gathered blocks are sent in order; empty ones are skipped. */ {
+        const iBlock *blocks[] = { collect_Block(newCStr_Block("Hello")),
+                                   collect_Block(new_Block(0)),
+                                   collect_Block(newCStr_Block(" world")) };
+        const size_t queued = writeBlocks_Socket(sock, blocks, iElemCount(blocks));
+        char buf[32];
+        const size_t received = receiveRaw_(peer, buf, sizeof(buf), queued);
+        printf("Gathered write: \"%.*s\"\n", (int) received, buf);
+        iAssert(queued == 11 && received == 11 && !memcmp(buf, "Hello world", 11));
+    }
+    /* Writes via the Stream interface wait for room when the peer is not reading. */ {
+        setWaterMarks_Socket(sock, 65536, 16384);
+        iThread *writer = new_Thread(run_StreamWriter_);
+        setUserData_Thread(writer, sock);
+        start_Thread(writer);
+        sleep_Thread(0.3);
+        const size_t queued = bytesToSend_Socket(sock);
+        printf("Output queued for a stalled peer: %s\n",
+               queued <= 65536 + 16384 ? "limited" : "unlimited");
+        iAssert(queued <= 65536 + 16384);
+        char buf[16384];
+        const size_t received = receiveRaw_(peer, buf, sizeof(buf), 32 * 16384);
+        join_Thread(writer);
+        iRelease(writer);
+        printf("Received %zu bytes after draining\n", received);
+        iAssert(received == 32 * 16384);
+    }
+    iRelease(sock);
+    close(peer);
+}
+
+static void checkFdPassing_(void) {
+    /* A descriptor is passed in order with the data written before and after it. */
+    int pair[2], pipeFds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) || pipe(pipeFds)) {
+        puts("Failed to create a socket pair");
+        return;
+    }
+    iSocket *sender   = newExisting_Socket(pair[0], NULL, 0, tcp_SocketType);
+    iSocket *receiver = newExisting_Socket(pair[1], NULL, 0, tcp_SocketType);
+    writeData_Socket(sender, "<", 1);
+    const iBool sent = sendFd_Socket(sender, pipeFds[0], "fd", 2);
+    close(pipeFds[0]);
+    writeData_Socket(sender, ">", 1);
+    iTime start;
+    initCurrent_Time(&start);
+    while (receivedBytes_Socket(receiver) < 4 && elapsedSeconds_Time(&start) < 5.0) {
+        sleep_Thread(0.01);
+    }
+    iBlock *data = readAll_Socket(receiver);
+    const int fd = takeFd_Socket(receiver);
+    char buf[4] = "";
+    if (fd >= 0) {
+        if (write(pipeFds[1], "ping", 4) != 4 || read(fd, buf, 4) != 4) {
+            iZap(buf);
+        }
+        close(fd);
+    }
+    const iBool ok = sent && fd >= 0 && !memcmp(buf, "ping", 4) &&
+                     !iCmpStr(cstr_Block(data), "<fd>") && takeFd_Socket(receiver) < 0;
+    printf("Descriptor passed over a socket pair: %s\n", ok ? "yes" : "no");
+    iAssert(ok);
+    delete_Block(data);
+    close(pipeFds[1]);
+    iRelease(receiver);
+    iRelease(sender);
+}
+#endif
+
+static iAtomicInt datagramsReceived_;
+
+static void takeDatagrams_(iAny *d, iDatagram *dgm) {
+    iUnused(d);
+    iBlock *data;
+    while ((data = receive_Datagram(dgm, NULL)) != NULL) {
+        delete_Block(data);
+        add_Atomic(&datagramsReceived_, 1);
+    }
+}
+
+static double receiveDatagrams_(int count) {
+    /* Each received message allocates a Message and an Address object. */
+    iDatagram *dgm = new_Datagram();
+    iAddress *to = new_Address();
+    double seconds = -1.0;
+    if (open_Datagram(dgm, 14667)) {
+        lookupCStr_Address(to, "localhost", 14667, udp_SocketType);
+        waitForFinished_Address(to);
+        iConnect(Datagram, dgm, message, dgm, takeDatagrams_);
+        set_Atomic(&datagramsReceived_, 0);
+        const iTime start = now_Time();
+        for (int i = 0; i < count; i++) {
+            sendData_Datagram(dgm, "ping", 4, to);
+            while (i - value_Atomic(&datagramsReceived_) >= 64 &&
+                   elapsedSeconds_Time(&start) < 10.0) {
+                sleep_Thread(0.0001); /* don't overflow the receive buffer */
+            }
+        }
+        while (value_Atomic(&datagramsReceived_) < count && elapsedSeconds_Time(&start) < 10.0) {
+            sleep_Thread(0.0001);
+        }
+        if (value_Atomic(&datagramsReceived_) == count) {
+            seconds = elapsedSeconds_Time(&start);
+        }
+        close_Datagram(dgm);
+    }
+    iRelease(to);
+    iRelease(dgm);
+    return seconds;
+}
+
+static void compareDatagramPools_(void) {
+    /* Pools are created when a class is next instantiated, so the unpooled run goes first. */
+    const int count = 20000;
+    const double unpooled = receiveDatagrams_(count);
+    setEnabledForAll_ObjectPool(iTrue);
+    const double pooled = receiveDatagrams_(count);
+    setEnabledForAll_ObjectPool(iFalse);
+    if (unpooled < 0 || pooled < 0) {
+        puts("Datagrams were lost; pooled receiving not compared");
+        return;
+    }
+    printf("Received %d datagrams: %.3f seconds unpooled, %.3f seconds pooled\n", count,
+           unpooled, pooled);
+}
+
 #if defined (iHaveTlsRequest)
+static void checkSessionCacheFile_(void) {
+    const iString *path = collectNewCStr_String("t_network_sessions.bin");
+    FILE *old = fopen(cstr_String(path), "w");
+    fputs("not a session cache", old);
+    fclose(old);
+    iBool ok = !loadSessionCache_TlsRequest(path);
+#if !defined (iPlatformWindows)
+    chmod(cstr_String(path), 0644);
+#endif
+    /* An empty cache is saved over the old file and loaded back. */
+    clearSessionCache_TlsRequest();
+    ok &= saveSessionCache_TlsRequest(path);
+#if !defined (iPlatformWindows)
+    struct stat st;
+    ok &= (stat(cstr_String(path), &st) == 0 && (st.st_mode & 0777) == 0600);
+#endif
+    ok &= loadSessionCache_TlsRequest(path);
+    remove(cstr_String(path));
+    printf("Session cache file saved and loaded: %s\n", ok ? "yes" : "no");
+    iAssert(ok);
+}
+
 void printTlsRequestProgress_(iAnyObject *obj) {
     iTlsRequest *d = obj;
     printf("TlsRequest progress: %zu bytes received so far\n", receivedBytes_TlsRequest(d));
@@ -258,9 +599,20 @@ int main(int argc, char *argv[]) {
             return 0;
         }
     }
+#endif
+#if !defined (iPlatformWindows)
+    /* With --unix, the server and client use a local socket instead of TCP. */
+    iCommandLineArg *unixPath = iClob(checkArgumentValues_CommandLine(cmdline, "u;unix", 1));
+#else
+    iCommandLineArg *unixPath = NULL;
 #endif
     if (contains_CommandLine(cmdline, "s;server")) {
         iService *sv = iClob(new_Service(14666));
+#if !defined (iPlatformWindows)
+        if (unixPath) {
+            sv = iClob(newLocal_Service(cstr_String(value_CommandLineArg(unixPath, 0))));
+        }
+#endif
         iConnect(Service, sv, incomingAccepted, sv, communicate_);
         if (!open_Service(sv)) {
             puts("Failed to start service");
@@ -276,24 +628,71 @@ int main(int argc, char *argv[]) {
         close_Service(sv);
     }
     else if (contains_CommandLine(cmdline, "c;client")) {
-        connectTo_("localhost");
+        iSocket *sock = iClob(new_Socket("localhost", 14666, tcp_SocketType));
+#if !defined (iPlatformWindows)
+        if (unixPath) {
+            sock = iClob(newLocal_Socket(cstr_String(value_CommandLineArg(unixPath, 0))));
+        }
+#endif
+        connectTo_(sock);
+    }
+#if !defined (iPlatformWindows)
+    else if (contains_CommandLine(cmdline, "e;eyeballs")) {
+        connectParallel_();
     }
+    else if (contains_CommandLine(cmdline, "p;pair")) {
+        exchangePair_();
+    }
+#endif
     else {
+#if !defined (iPlatformWindows)
+        checkTcpSocket_();
+        checkFdPassing_();
+#endif
+        compareDatagramPools_();
+#if defined (iHaveTlsRequest)
+        checkSessionCacheFile_();
+#endif
         iCommandLineArg *arg = checkArgumentValuesN_CommandLine(cmdline, "h;host", 1, 1);
         if (arg) {
-            connectTo_(cstr_String(value_CommandLineArg(arg, 0)));
+            connectTo_(iClob(new_Socket(cstr_String(value_CommandLineArg(arg, 0)), 14666,
+                                        tcp_SocketType)));
             iRelease(arg);
         }
+        iCommandLineArg *hosts = checkArgumentValuesN_CommandLine(cmdline, "hosts", 1, 1);
+        if (hosts) {
+            /* Names are looked up in the file instead of DNS. */
+            setHostsFile_Address(cstr_String(value_CommandLineArg(hosts, 0)));
+            iRelease(hosts);
+        }
+        /* Each name is looked up twice at the same time; the second lookup waits for the
+           first one. A third lookup afterwards uses the cached result. */
         iConstForEach(CommandLine, i, cmdline) {
             if (i.argType == value_CommandLineArgType) {
                 printf("\nLooking up \"%s\"...\n", cstr_String(value_CommandLineConstIterator(&i)));
-                iAddress *addr = new_Address();
-                iConnect(Address, addr, lookupFinished, addr, hostLookedUp);
-                lookupTcp_Address(addr, value_CommandLineConstIterator(&i), 0);
-                waitForFinished_Address(addr);
-                iRelease(addr);
+                iAddress *addrs[3];
+                iForIndices(j, addrs) {
+                    addrs[j] = new_Address();
+                    iConnect(Address, addrs[j], lookupFinished, addrs[j], hostLookedUp);
+                    if (j == 2) {
+                        waitForFinished_Address(addrs[0]);
+                        waitForFinished_Address(addrs[1]);
+                    }
+                    lookupTcp_Address(addrs[j], value_CommandLineConstIterator(&i), 0);
+                }
+                iForIndices(j, addrs) {
+                    waitForFinished_Address(addrs[j]);
+                    iRelease(addrs[j]);
+                }
             }
         }
+        iAddressCacheStats stats;
+        cacheStats_Address(&stats);
+        printf("\nAddress cache: %zu entries, %llu hits, %llu misses, %llu joined\n",
+               stats.entries,
+               (unsigned long long) stats.hits,
+               (unsigned long long) stats.misses,
+               (unsigned long long) stats.joined);
     }
     deinit_Foundation();
     return 0;
@@ -144,5 +144,34 @@ int main(int argc, char *argv[]) {
             delete_String(s);
         }
     }
+    /* Temporary strings allocated from an arena. */ {
+        iBeginCollectArena();
+        const iString *first = collectNewCStr_String("first");
+        for (int i = 0; i < 10000; ++i) {
+            iBeginCollectArena();
+            iString *s = collectNewFormat_String("%d:%s", i, cstr_String(first));
+            iArray *a = collectNew_Array(sizeof(int));
+            pushBack_Array(a, &i);
+            iAssert(size_String(s) > 6);
+            iUnused(s);
+            iEndCollect();
+        }
+        printf("Arena string: %s\n", cstr_String(first));
+        iEndCollect();
+    }
+    /* Recycling keeps the memory of open arena scopes. */ {
+        iBeginCollectArena();
+        char *kept = allocArena_Garbage(16);
+        strcpy(kept, "kept");
+        collectNewCStr_String("recycled");
+        iRecycle();
+        printf("Arena memory after recycling: %s\n", kept);
+        const void *inScope = allocArena_Garbage(16);
+        iAssert(inScope != NULL);
+        iEndCollect();
+        const void *outOfScope = allocArena_Garbage(16);
+        iAssert(outOfScope == NULL);
+        iUnused(inScope, outOfScope);
+    }
     deinit_Foundation();
 }
@@ -47,6 +47,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 #include <the_Foundation/stringarray.h>
 #include <the_Foundation/stringlist.h>
 #include <the_Foundation/stringhash.h>
+#include <the_Foundation/threadpool.h>
 #include <the_Foundation/time.h>
 #include <the_Foundation/thread.h>
 #include <the_Foundation/xml.h>
@@ -54,6 +55,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 #include <stdio.h>
 #include <stdlib.h>
 #include <locale.h>
+#include <math.h>
 #include <time.h>
 
 /*-------------------------------------------------------------------------------------*/
@@ -132,6 +134,23 @@ static int compareIntPairElements(const void *a, const void *b) {
     return iCmp(x[1], y[1]);
 }
 
+static int compareBytes12(const void *a, const void *b) {
+    return memcmp(a, b, 12);
+}
+
+static int compareBytes8(const void *a, const void *b) {
+    return memcmp(a, b, 8);
+}
+
+static iBool isSorted(const iArray *d, int (*cmp)(const void *, const void *)) {
+    for (size_t i = 1; i < size_Array(d); i++) {
+        if (cmp(constAt_Array(d, i - 1), constAt_Array(d, i)) > 0) {
+            return iFalse;
+        }
+    }
+    return iTrue;
+}
+
 static int compareIntegers(iMapKey a, iMapKey b) {
     return iCmp(a, b);
 }
@@ -310,6 +329,123 @@ int main(int argc, char *argv[]) {
                 compareIntElements);
         printf("Major 1s are located at [%zu, %zu)\n", ones.start, ones.end);
         delete_SortedArray(pairs);
+
+        /* Bulk insertion gives the same result as inserting one by one. */
+        iSortedArray *one = new_SortedArray(sizeof(int[2]), compareIntElements);
+        iSortedArray *bulk = new_SortedArray(sizeof(int[2]), compareIntElements);
+        iArray *values = new_Array(sizeof(int[2]));
+        for (int round = 0; round < 2; round++) {
+            clear_Array(values);
+            for (int i = 0; i < 1000; ++i) {
+                const int pair[2] = { iRandom(0, 500), i };
+                pushBack_Array(values, pair);
+                insert_SortedArray(one, pair);
+            }
+            insertN_SortedArray(bulk, constData_Array(values), size_Array(values));
+        }
+        iAssert(equal_Array(&one->values, &bulk->values));
+        delete_Array(values);
+        delete_SortedArray(bulk);
+        delete_SortedArray(one);
+    }
+    /* Test sorting. */ {
+        const size_t count = 1000000;
+        iArray *pairs = new_Array(sizeof(int[2]));
+        resize_Array(pairs, count);
+        for (size_t i = 0; i < count; i++) {
+            int *pair = at_Array(pairs, i);
+            pair[0] = iRandom(-1000, 1000);
+            pair[1] = (int) i;
+        }
+        iArray *copy = copy_Array(pairs);
+        /* Radix sort is stable. */
+        iTime start = now_Time();
+        sortKey_Array(copy, 0, int32_SortKeyType);
+        printf("Radix sorted 1M int pairs in %.3f seconds\n", elapsedSeconds_Time(&start));
+        iAssert(isSorted(copy, compareIntPairElements));
+        setCopy_Array(copy, pairs);
+        start = now_Time();
+        sortStable_Array(copy, compareIntElements);
+        printf("Merge sorted 1M int pairs in %.3f seconds\n", elapsedSeconds_Time(&start));
+        iAssert(isSorted(copy, compareIntPairElements));
+        setCopy_Array(copy, pairs);
+        iThreadPool *pool = new_ThreadPool();
+        start = now_Time();
+        sortPool_Array(copy, compareIntElements, pool);
+        printf("Parallel merge sorted 1M int pairs in %.3f seconds\n", elapsedSeconds_Time(&start));
+        iAssert(isSorted(copy, compareIntPairElements));
+        iRelease(pool);
+        /* Many threads on a small array: more runs than there are elements to fill them. */ {
+            iArray *small = new_Array(sizeof(int) * 2);
+            for (size_t i = 0; i < 16385; i++) {
+                pushBack_Array(small, constAt_Array(pairs, i));
+            }
+            pool = newLimits_ThreadPool(130, 0);
+            sortPool_Array(small, compareIntElements, pool);
+            iRelease(pool);
+            iAssert(isSorted(small, compareIntPairElements));
+            printf("Parallel merge sorted %zu pairs with 130 threads\n", size_Array(small));
+            delete_Array(small);
+        }
+        /* Byte-wise sorting. */
+        setCopy_Array(copy, pairs);
+        start = now_Time();
+        sortBytes_Array(copy);
+        printf("Byte-sorted 1M 8-byte elements in %.3f seconds\n", elapsedSeconds_Time(&start));
+        iAssert(isSorted(copy, compareBytes8));
+        setCopy_Array(copy, pairs);
+        start = now_Time();
+        sort_Array(copy, compareBytes8);
+        printf("qsort of the same: %.3f seconds\n", elapsedSeconds_Time(&start));
+        iArray *triples = new_Array(12);
+        for (int i = 0; i < 100000; i++) {
+            const int triple[3] = { iRandom(0, 3), iRandom(0, 100), i % 7 };
+            pushBack_Array(triples, triple);
+        }
+        sortBytes_Array(triples);
+        printf("Byte-sorted 12-byte elements are in order: %s\n",
+               isSorted(triples, compareBytes12) ? "yes" : "no");
+        delete_Array(triples);
+        /* Floating-point keys, including negative ones. */
+        iArray *reals = new_Array(sizeof(double));
+        for (int i = 0; i < 1000; i++) {
+            pushBack_Array(reals, &(double){ iRandomf() * 200.0 - 100.0 });
+        }
+        pushBack_Array(reals, &(double){ -0.0 });
+        /* NaNs go last, also ones with the sign bit set (like 0.0/0.0 on x86). */
+        const uint64_t nanBits[2] = { 0xfff8000000000000ull, 0x7ff8000000000000ull };
+        for (int i = 0; i < 2; i++) {
+            double nan;
+            memcpy(&nan, &nanBits[i], sizeof(nan));
+            insert_Array(reals, 500 * i, &nan);
+        }
+        sortKey_Array(reals, 0, double_SortKeyType);
+        const size_t numReals = size_Array(reals);
+        for (size_t i = 1; i < numReals - 2; i++) {
+            iAssert(constValue_Array(reals, i - 1, double) <= constValue_Array(reals, i, double));
+        }
+        iAssert(isnan(constValue_Array(reals, numReals - 2, double)));
+        iAssert(isnan(constValue_Array(reals, numReals - 1, double)));
+        printf("NaNs sorted last: %s\n",
+               isnan(constValue_Array(reals, numReals - 2, double)) &&
+               !isnan(constValue_Array(reals, numReals - 3, double)) ? "yes" : "no");
+        delete_Array(reals);
+        /* Same for single precision. */ {
+            const uint32_t bits[5] = { 0x3f800000u, 0xffc00000u, 0xbf800000u,
+                                       0x7f800000u, 0xff800000u }; /* 1, NaN, -1, inf, -inf */
+            iArray *floats = new_Array(sizeof(float));
+            for (int i = 0; i < 5; i++) {
+                pushBack_Array(floats, &bits[i]);
+            }
+            sortKey_Array(floats, 0, float_SortKeyType);
+            iAssert(constValue_Array(floats, 0, float) == -INFINITY);
+            iAssert(constValue_Array(floats, 1, float) == -1.0f);
+            iAssert(constValue_Array(floats, 3, float) == INFINITY);
+            iAssert(isnan(constValue_Array(floats, 4, float)));
+            delete_Array(floats);
+        }
+        delete_Array(copy);
+        delete_Array(pairs);
     }
     /* Test an array of pointers. */ {
         iPtrArray *par = newPointers_PtrArray("Entry One", "Entry Two", NULL);
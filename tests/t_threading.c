@@ -24,12 +24,353 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.</small>
 */
 
+#include <the_Foundation/atomicstack.h>
+#include <the_Foundation/fiber.h>
 #include <the_Foundation/future.h>
 #include <the_Foundation/threadpool.h>
+#include <the_Foundation/dispatch.h>
+#include <the_Foundation/eventloop.h>
+#include <the_Foundation/objectpool.h>
+#include <the_Foundation/pipeline.h>
+#include <the_Foundation/ptrarray.h>
+#include <the_Foundation/queue.h>
+#include <the_Foundation/time.h>
+#include <the_Foundation/timerservice.h>
 #include <the_Foundation/math.h>
 
+#if !defined (iPlatformWindows)
+#   include <unistd.h>
+#endif
+
 static atomic_int thrCounter;
 
+/*-------------------------------------------------------------------------------------*/
+
+iDeclareType(Notifier)
+iDeclareStaticClass(Notifier)
+iDeclareNotifyFunc(Notifier, Pinged)
+
+struct Impl_Notifier {
+    iObject object;
+    iAudience *pinged;
+};
+
+static void deinit_Notifier(iNotifier *d) {
+    delete_Audience(d->pinged);
+}
+
+static iDefineClass(Notifier)
+static iDefineAudienceGetter(Notifier, pinged)
+
+static iAtomicInt pingCount_;
+
+static void pinged_Listener_(iAnyObject *listener, iNotifier *src) {
+    iUnused(listener, src);
+    add_Atomic(&pingCount_, 1);
+}
+
+static iThreadResult run_Pinger_(iThread *thd) {
+    iNotifier *d = userData_Thread(thd);
+    for (int i = 0; i < 100000; ++i) {
+        iNotifyAudience(d, pinged, NotifierPinged);
+    }
+    return 0;
+}
+
+iDeclareType(Remover)
+
+struct Impl_Remover {
+    iNotifier *notifier;
+    iNotifier *peer;
+    iBarrier  *barrier;
+};
+
+static void removePeer_Listener_(iAnyObject *listener, iNotifier *src) {
+    /* Both threads are notifying when they remove an observer. */
+    const iRemover *d = userData_Thread(current_Thread());
+    iUnused(listener);
+    wait_Barrier(d->barrier);
+    iDisconnect(Notifier, src, pinged, d->peer, pinged_Listener_);
+}
+
+static iThreadResult run_Remover_(iThread *thd) {
+    const iRemover *d = userData_Thread(thd);
+    iNotifyAudience(d->notifier, pinged, NotifierPinged);
+    return 0;
+}
+
+static iThreadResult run_Releaser_(iThread *thd) {
+    iPtrArray *objs = userData_Thread(thd);
+    iForEach(PtrArray, i, objs) {
+        iRelease(i.ptr);
+    }
+    return 0;
+}
+
+static iThreadResult run_Sharer_(iThread *thd) {
+    iAnyObject *obj = userData_Thread(thd);
+    for (int i = 0; i < 100000; ++i) {
+        iRelease(ref_Object(obj));
+    }
+    return 0;
+}
+
+static iAtomicInt storageDeleted_;
+
+static void deleteStorage_(void *value) {
+    free(value);
+    add_Atomic(&storageDeleted_, 1);
+}
+
+static iThreadResult run_StorageUser_(iThread *thd) {
+    iThreadStorage *storage = userData_Thread(thd);
+    iAssert(current_Thread() == thd);
+    iAssert(value_ThreadStorage(storage) == NULL);
+    setValue_ThreadStorage(storage, malloc(16));
+    return value_ThreadStorage(storage) != NULL;
+}
+
+iDeclareType(Locks)
+
+struct Impl_Locks {
+    iSpinMutex spin;
+    iRWLock    rw;
+    iSemaphore sema;
+    iBarrier   barrier;
+    int        counter;
+    int        pair[2]; /* both halves are always equal outside the write lock */
+    iAtomicInt inside;
+    iAtomicInt leaders;
+};
+
+static iThreadResult run_Locker_(iThread *thd) {
+    iLocks *d = userData_Thread(thd);
+    for (int i = 0; i < 100000; ++i) {
+        iGuardSpinMutex(&d->spin, d->counter++);
+        if (i % 100 == 0) {
+            lockWrite_RWLock(&d->rw);
+            d->pair[0]++;
+            d->pair[1]++;
+            unlockWrite_RWLock(&d->rw);
+        }
+        else {
+            lockRead_RWLock(&d->rw);
+            iAssert(d->pair[0] == d->pair[1]);
+            unlockRead_RWLock(&d->rw);
+        }
+        if (i % 1000 == 0) {
+            acquire_Semaphore(&d->sema);
+            const int inside = add_Atomic(&d->inside, 1);
+            iAssert(inside < 2);
+            iUnused(inside);
+            add_Atomic(&d->inside, -1);
+            release_Semaphore(&d->sema, 1);
+            if (wait_Barrier(&d->barrier)) {
+                add_Atomic(&d->leaders, 1);
+            }
+        }
+    }
+    return 0;
+}
+
+iDeclareType(StackItem)
+
+struct Impl_StackItem {
+    iAtomicStackNode node;
+    iAtomicInt owners; /* must never exceed one */
+};
+
+static iThreadResult run_StackUser_(iThread *thd) {
+    iAtomicStack *d = userData_Thread(thd);
+    iStackItem *held[4];
+    for (int i = 0; i < 100000; ++i) {
+        /* Pop a few and push them back in a different order. */
+        int count = 0;
+        while (count < 4) {
+            iStackItem *item = (iStackItem *) pop_AtomicStack(d);
+            if (!item) break;
+            const int owners = add_Atomic(&item->owners, 1);
+            iAssert(owners == 0);
+            iUnused(owners);
+            held[count++] = item;
+        }
+        for (int j = 0; j < count; j++) {
+            add_Atomic(&held[j]->owners, -1);
+            push_AtomicStack(d, &held[j]->node);
+        }
+    }
+    return 0;
+}
+
+static iThreadResult run_MutexUser_(iThread *thd) {
+    iMutex *mtx = userData_Thread(thd);
+    for (int i = 0; i < 10000; ++i) {
+        iGuardMutex(mtx, iRandom(0, 100));
+    }
+    return 0;
+}
+
+static void square_(void *context, void *element, size_t index) {
+    iUnused(context, index);
+    int *value = element;
+    *value = (int) ((int64_t) *value * *value % 1000);
+}
+
+static void sum_(void *context, iRanges range, void *accum) {
+    const iArray *values = context;
+    int64_t sum = 0;
+    for (size_t i = range.start; i < range.end; i++) {
+        sum += constValue_Array(values, i, int);
+    }
+    *(int64_t *) accum += sum;
+}
+
+static void combineSums_(void *context, void *accum, const void *other) {
+    iUnused(context);
+    *(int64_t *) accum += *(const int64_t *) other;
+}
+
+static void countNested_(void *context, iRanges range) {
+    add_Atomic((iAtomicInt *) context, (int) size_Range(&range));
+}
+
+static void nest_(void *context, iRanges range) {
+    iThreadPool *pool = context;
+    for (size_t i = range.start; i < range.end; i++) {
+        parallelFor_ThreadPool(pool, (iRanges){ 0, 1000 }, 1, countNested_, &pingCount_);
+    }
+}
+
+static iThreadResult run_Nester_(iThread *thd) {
+    parallelFor_ThreadPool(userData_Thread(thd), (iRanges){ 0, 100 }, 1, nest_,
+                           userData_Thread(thd));
+    return 0;
+}
+
+static iAtomicInt laneOrder_;
+
+static iThreadResult run_Blocker_(iThread *thd) {
+    acquire_Semaphore(userData_Thread(thd));
+    return 0;
+}
+
+static iThreadResult run_Laned_(iThread *thd) {
+    iUnused(thd);
+    return add_Atomic(&laneOrder_, 1);
+}
+
+static iThreadResult run_Sleeper_(iThread *thd) {
+    iUnused(thd);
+    sleep_Thread(0.1);
+    return currentCpu_Thread();
+}
+
+iDeclareType(Number)
+iDeclareStaticClass(Number)
+
+struct Impl_Number {
+    iObject object;
+    int value;
+};
+
+static void deinit_Number(iNumber *d) {
+    iUnused(d);
+}
+
+static iDefineClass(Number)
+
+static iNumber *newValue_Number_(int value) {
+    iNumber *d = iNew(Number);
+    d->value = value;
+    return d;
+}
+
+static iAnyObject *produce_(void *context) {
+    return newValue_Number_((int) (intptr_t) context);
+}
+
+static iAnyObject *multiply_(iAnyObject *value, void *context) {
+    return newValue_Number_(((iNumber *) value)->value * (int) (intptr_t) context);
+}
+
+static iAnyObject *increment_(iAnyObject *value, void *context) {
+    iUnused(context);
+    add_Atomic(&pingCount_, 1);
+    return newValue_Number_(((iNumber *) value)->value + 1);
+}
+
+static void timerExpired_(iAny *context) {
+    add_Atomic((iAtomicInt *) context, 1);
+}
+
+static iThreadResult run_Blocking_(iThread *thd) {
+    sleep_Thread(0.01);
+    return (iThreadResult) userData_Thread(thd);
+}
+
+static iThreadResult run_Flow_(iFiber *fiber) {
+    iQueue **queues = userData_Fiber(fiber);
+    /* Each step suspends the fiber instead of blocking a pool thread. */
+    iNumber *item = take_Queue(queues[0]);
+    sleep_Fiber(0.001);
+    yield_Fiber();
+    const iAnyObject *none = takeTimeout_Queue(queues[1], 0.01);
+    iAssert(none == NULL);
+    iUnused(none);
+    const int value = item->value;
+    iRelease(item);
+    add_Atomic(&pingCount_, value);
+    return value + (int) offload_Fiber(run_Blocking_, (void *) 1);
+}
+
+static void *decode_(void *context, void *item) {
+    iUnused(context);
+    const intptr_t value = (intptr_t) item;
+    sleep_Thread(0.0001 * (value % 5));
+    return value % 7 == 0 ? NULL : item; /* drop some */
+}
+
+static void *index_(void *context, void *item) {
+    add_Atomic((iAtomicInt *) context, 1);
+    return (void *) ((intptr_t) item * 2);
+}
+
+static void *stall_(void *context, void *item) {
+    iUnused(context);
+    if ((intptr_t) item == 1) {
+        sleep_Thread(0.3);
+    }
+    return item;
+}
+
+static iThreadResult run_Producer_(iThread *thd) {
+    iPipeline *pipe = userData_Thread(thd);
+    for (intptr_t i = 1; i <= 500; ++i) {
+        put_Pipeline(pipe, (void *) i);
+    }
+    close_Pipeline(pipe);
+    return 0;
+}
+
+#if !defined (iPlatformWindows)
+static void countCall_(iAny *context) {
+    add_Atomic((iAtomicInt *) context, 1);
+}
+
+static void readPipe_(iAny *context, int fd, int events) {
+    iUnused(events);
+    char buf[16];
+    const ssize_t count = read(fd, buf, sizeof(buf));
+    if (count > 0) {
+        add_Atomic((iAtomicInt *) context, (int) count);
+    }
+}
+
+static void quitLoop_(iAny *context) {
+    quit_EventLoop(context);
+}
+#endif
+
 static iThreadResult run_Worker_(iThread *d) {
     iBeginCollect();
     int value = 0;
@@ -64,6 +405,651 @@ int main(int argc, char *argv[]) {
         iRelease(future);
         iRelease(pool);
     }
+    /* Data-parallel loops. */ {
+        iThreadPool *pool = new_ThreadPool();
+        iArray *values = new_Array(sizeof(int));
+        resize_Array(values, 10000000);
+        for (size_t i = 0; i < size_Array(values); i++) {
+            *(int *) at_Array(values, i) = (int) i;
+        }
+        iTime start = now_Time();
+        parallelForArray_ThreadPool(pool, values, 0, square_, NULL);
+        int64_t sum = 0;
+        parallelReduce_ThreadPool(pool, (iRanges){ 0, size_Array(values) }, 0, &sum, sizeof(sum),
+                                  sum_, combineSums_, values);
+        printf("Parallel square and sum of 10M ints: %lld (%.3f seconds)\n", (long long) sum,
+               elapsedSeconds_Time(&start));
+        int64_t expected = 0;
+        for (int64_t i = 0; i < 10000000; i++) {
+            expected += i * i % 1000;
+        }
+        iAssert(sum == expected);
+        delete_Array(values);
+        /* Nested loops inside pooled jobs run inline when the pool is busy. */
+        set_Atomic(&pingCount_, 0);
+        iFuture *future = new_Future();
+        for (int i = 0; i < 8; ++i) {
+            iThread *nester = new_Thread(run_Nester_);
+            setUserData_Thread(nester, pool);
+            iRelease(runPool_Future(future, nester, pool));
+        }
+        wait_Future(future);
+        iRelease(future);
+        printf("Nested parallel iterations: %d\n", value_Atomic(&pingCount_));
+        iAssert(value_Atomic(&pingCount_) == 8 * 100 * 1000);
+        set_Atomic(&pingCount_, 0);
+        iRelease(pool);
+    }
+    /* Priority lanes: high priority jobs overtake queued bulk work. */ {
+        iThreadPool *pool = newLimits_ThreadPool(1, idealConcurrentCount_Thread());
+        iSemaphore gate;
+        init_Semaphore(&gate, 0);
+        iThread *blocker = new_Thread(run_Blocker_);
+        setUserData_Thread(blocker, &gate);
+        iRelease(run_ThreadPool(pool, blocker));
+        iFuture *future = new_Future();
+        for (int i = 0; i < 10; ++i) {
+            iRelease(runPool_Future(future, new_Thread(run_Laned_), pool));
+        }
+        iThread *urgent = new_Thread(run_Laned_);
+        add_Future(future, urgent);
+        runPriority_ThreadPool(pool, urgent, high_ThreadPoolPriority);
+        release_Semaphore(&gate, 1);
+        wait_Future(future);
+        const iThreadResult urgentOrder = result_Thread(urgent);
+        printf("High priority job ran at position %ld of 11\n", (long) urgentOrder);
+        iAssert(urgentOrder == 0);
+        iUnused(urgentOrder);
+        iRelease(urgent);
+        iRelease(future);
+        iRelease(pool);
+        deinit_Semaphore(&gate);
+    }
+    /* Elastic pool grows when a burst of jobs arrives while its thread is idle. */ {
+        size_t minSize = 4;
+        for (int round = 0; round < 3; ++round) {
+            iThreadPool *pool = newElastic_ThreadPool(1, 4);
+            setGrowThreshold_ThreadPool(pool, 0.02);
+            setIdleTimeout_ThreadPool(pool, 0.2);
+            sleep_Thread(0.05);
+            for (int i = 0; i < 8; ++i) {
+                iRelease(run_ThreadPool(pool, new_Thread(run_Sleeper_)));
+            }
+            sleep_Thread(0.15);
+            minSize = iMin(minSize, size_ThreadPool(pool));
+            iRelease(pool);
+        }
+        printf("Elastic pool has at least %zu threads during a burst\n", minSize);
+        iAssert(minSize > 1);
+    }
+    /* Elastic pool grows under load and shrinks when idle. */ {
+        iThreadPool *pool = newElastic_ThreadPool(1, 4);
+        setGrowThreshold_ThreadPool(pool, 0.02);
+        setIdleTimeout_ThreadPool(pool, 0.2);
+        setPinned_ThreadPool(pool, iTrue);
+        iFuture *future = new_Future();
+        for (int i = 0; i < 16; ++i) {
+            iRelease(runPool_Future(future, new_Thread(run_Sleeper_), pool));
+        }
+        sleep_Thread(0.3);
+        const size_t grown = size_ThreadPool(pool);
+        printf("Pinned jobs ran on CPUs:");
+        while (!isEmpty_Future(future)) {
+            iThread *result = nextResult_Future(future);
+            const int cpu = (int) result_Thread(result);
+            printf(" %d", cpu);
+            iAssert(cpu < 0 || isAllowedCpu_Thread(cpu));
+            iUnused(cpu);
+            iRelease(result);
+        }
+        puts("");
+        sleep_Thread(0.8);
+        const size_t shrunk = size_ThreadPool(pool);
+        printf("Elastic pool grew to %zu threads and shrank to %zu\n", grown, shrunk);
+        iAssert(grown > 1);
+        iAssert(shrunk == 1);
+        iUnused(grown, shrunk);
+        iRelease(future);
+        iRelease(pool);
+    }
+    /* Queue and pool metrics. */ {
+        iHistogram *hist = new_Histogram();
+        for (uint64_t v = 1; v <= 100000; v++) {
+            record_Histogram(hist, v * 1000);
+        }
+        const uint64_t median = percentile_Histogram(hist, 50.0);
+        printf("Histogram median: %llu (expected about 50000000)\n", (unsigned long long) median);
+        iAssert(median >= 50000000 && median <= 50000000 + 50000000 / 16);
+        iUnused(median);
+        delete_Histogram(hist);
+        iThreadPool *pool = new_ThreadPool();
+        enableMetrics_ThreadPool(pool);
+        iQueue *queue = new_Queue();
+        enableMetrics_Queue(queue);
+        iFuture *future = new_Future();
+        for (int i = 0; i < 1000; ++i) {
+            iThread *job = new_Thread(run_Laned_);
+            put_Queue(queue, job);
+            iRelease(runPool_Future(future, job, pool));
+        }
+        wait_Future(future);
+        iRelease(future);
+        while (!isEmpty_Queue(queue)) {
+            iRelease(take_Queue(queue));
+        }
+        iThreadPoolMetrics pm;
+        init_ThreadPoolMetrics(&pm);
+        metrics_ThreadPool(pool, &pm);
+        iQueueMetrics qm;
+        metrics_Queue(queue, &qm);
+        iAssert(pm.submitted == 1000 && pm.wait.count == 1000);
+        iAssert(qm.put == 1000 && qm.taken == 1000 && qm.depth == 0 && qm.maxDepth == 1000);
+        deinit_ThreadPoolMetrics(&pm);
+        printMetrics_ThreadPool(pool, stdout, table_MetricsFormat);
+        printMetrics_Queue(queue, stdout, json_MetricsFormat);
+        iRelease(queue);
+        iRelease(pool);
+    }
+    /* Pipeline with bounded queues. */ {
+        iAtomicInt indexed;
+        init_Atomic(&indexed, 0);
+        iThreadPool *pool = new_ThreadPool();
+        iPipeline *pipe = new_Pipeline(pool);
+        setCapacity_Pipeline(pipe, 8);
+        addStage_Pipeline(pipe, decode_, NULL, 4, unordered_PipelineOrder);
+        addStage_Pipeline(pipe, index_, &indexed, 2, ordered_PipelineOrder);
+        iThread *producer = new_Thread(run_Producer_);
+        setUserData_Thread(producer, pipe);
+        start_Thread(producer);
+        intptr_t prev = 0;
+        iBool inOrder = iTrue;
+        int count = 0;
+        void *item;
+        while ((item = take_Pipeline(pipe)) != NULL) {
+            inOrder &= ((intptr_t) item > prev);
+            prev = (intptr_t) item;
+            count++;
+        }
+        join_Thread(producer);
+        iRelease(producer);
+        iAssert(isFinished_Pipeline(pipe));
+        for (size_t i = 0; i < numStages_Pipeline(pipe); ++i) {
+            iPipelineStageStats st;
+            stats_Pipeline(pipe, i, &st);
+            printf("Stage %zu: received %llu, emitted %llu, dropped %llu, max queued %zu, "
+                   "busy %.3f ms\n",
+                   i,
+                   (unsigned long long) st.received,
+                   (unsigned long long) st.emitted,
+                   (unsigned long long) st.dropped,
+                   st.maxQueued,
+                   st.busyNanos / 1.0e6);
+            iAssert(st.maxQueued <= 8);
+        }
+        printf("Pipeline output: %d items %s\n", count, inOrder ? "in order" : "out of order");
+        iAssert(inOrder);
+        iAssert(count == 500 - 500 / 7);
+        iAssert(value_Atomic(&indexed) == count);
+        iRelease(pipe);
+        iRelease(pool);
+    }
+    /* Ordered stage waiting for a slow item. */ {
+        iThreadPool *pool = newLimits_ThreadPool(2, 0);
+        iPipeline *pipe = new_Pipeline(pool);
+        setCapacity_Pipeline(pipe, 4);
+        addStage_Pipeline(pipe, stall_, NULL, 2, ordered_PipelineOrder);
+        const uint64_t startedAt = monotonicNanoseconds_Time();
+        intptr_t accepted = 0;
+        while (monotonicNanoseconds_Time() - startedAt < 150000000) {
+            if (tryPut_Pipeline(pipe, (void *) (accepted + 1))) {
+                accepted++;
+            }
+            else {
+                sleep_Thread(0.001);
+            }
+        }
+        close_Pipeline(pipe);
+        intptr_t taken = 0;
+        iBool inOrder = iTrue;
+        void *item;
+        while ((item = take_Pipeline(pipe)) != NULL) {
+            inOrder &= ((intptr_t) item == ++taken);
+        }
+        printf("Items accepted while an ordered stage waits: %s\n",
+               accepted <= 12 ? "bounded" : "unbounded");
+        iAssert(accepted <= 12);
+        iAssert(taken == accepted);
+        iAssert(inOrder);
+        iRelease(pipe);
+        iRelease(pool);
+    }
+#if !defined (iPlatformWindows)
+    /* Event loop with timers, watchers, and posted calls. */ {
+        iAtomicInt fired, ticks, received, posted;
+        init_Atomic(&fired, 0);
+        init_Atomic(&ticks, 0);
+        init_Atomic(&received, 0);
+        init_Atomic(&posted, 0);
+        iEventLoop *loop = new_EventLoop();
+        start_EventLoop(loop);
+        int fds[2];
+        if (pipe(fds) == 0) {
+            const iEventLoopId watcher =
+                watch_EventLoop(loop, fds[0], read_EventLoopEvent, readPipe_, &received);
+            addTimer_EventLoop(loop, 0.02, 0.0, countCall_, &fired);
+            const iEventLoopId periodic = addTimer_EventLoop(loop, 0.01, 0.01, countCall_, &ticks);
+            const iEventLoopId cancelled = addTimer_EventLoop(loop, 0.03, 0.0, countCall_, &fired);
+            const iBool wasPending = cancelTimer_EventLoop(loop, cancelled);
+            for (int i = 0; i < 100; ++i) {
+                post_EventLoop(loop, countCall_, &posted);
+            }
+            const ssize_t written = write(fds[1], "hello", 5);
+            sleep_Thread(0.1);
+            cancelTimer_EventLoop(loop, periodic);
+            unwatch_EventLoop(loop, watcher);
+            printf("Event loop: %d timer, %d periodic, %d bytes read, %d posted\n",
+                   value_Atomic(&fired), value_Atomic(&ticks), value_Atomic(&received),
+                   value_Atomic(&posted));
+            iAssert(wasPending && written == 5);
+            iAssert(value_Atomic(&fired) == 1 && value_Atomic(&ticks) >= 3);
+            iAssert(value_Atomic(&received) == 5 && value_Atomic(&posted) == 100);
+            iUnused(wasPending, written);
+            close(fds[0]);
+            close(fds[1]);
+        }
+        iRelease(loop);
+        /* Run a loop in this thread. */
+        loop = new_EventLoop();
+        addTimer_EventLoop(loop, 0.01, 0.0, quitLoop_, loop);
+        run_EventLoop(loop);
+        iRelease(loop);
+    }
+#endif
+    /* Continuations and combinators. */ {
+        iThreadPool *pool = new_ThreadPool();
+        iFuture *produced = async_Future(pool, produce_, (void *) 20);
+        iFuture *doubled = then_Future(produced, multiply_, (void *) 2, pool);
+        iFuture *chain = then_Future(doubled, increment_, NULL, NULL);
+        wait_Future(chain);
+        printf("Continuation chain: %d\n", ((iNumber *) value_Future(chain))->value);
+        iAssert(((iNumber *) value_Future(chain))->value == 41);
+        iRelease(chain);
+        iRelease(doubled);
+        iRelease(produced);
+        /* Wait for a group of futures. */
+        iFuture *group[8];
+        iForIndices(i, group) {
+            group[i] = async_Future(pool, produce_, (void *) (intptr_t) i);
+        }
+        iFuture *all = whenAll_Future(group, iElemCount(group));
+        wait_Future(all);
+        int sum = 0;
+        iForIndices(i, group) {
+            iAssert(isReady_Future(group[i]));
+            sum += ((iNumber *) value_Future(group[i]))->value;
+            iRelease(group[i]);
+        }
+        iAssert(sum == 28 && !isCancelled_Future(all));
+        iRelease(all);
+        /* The first resolved value wins. */
+        iFuture *never = newPending_Future();
+        iFuture *either[2] = { never, async_Future(pool, produce_, (void *) 7) };
+        iFuture *any = whenAny_Future(either, 2);
+        wait_Future(any);
+        iAssert(((iNumber *) value_Future(any))->value == 7);
+        iRelease(any);
+        iRelease(either[1]);
+        /* Cancelling propagates through the continuations. */
+        iCancelToken *token = new_CancelToken();
+        setCancelToken_Future(never, token);
+        set_Atomic(&pingCount_, 0);
+        iFuture *cancelled = then_Future(never, increment_, NULL, pool);
+        cancel_CancelToken(token);
+        wait_Future(cancelled);
+        iAssert(isCancelled_Future(never) && isCancelled_Future(cancelled));
+        iAssert(value_Future(cancelled) == NULL && value_Atomic(&pingCount_) == 0);
+        const iBool resolved = resolve_Future(never, NULL);
+        iAssert(!resolved);
+        iUnused(resolved);
+        iRelease(cancelled);
+        iRelease(never);
+        iRelease(token);
+        iRelease(pool);
+        iUnused(sum);
+    }
+    /* Timers. */ {
+        iThreadPool *pool = new_ThreadPool();
+        iTimerService *timers = newPool_TimerService(pool);
+        iAtomicInt expired;
+        iAtomicInt ticks;
+        set_Atomic(&expired, 0);
+        set_Atomic(&ticks, 0);
+        const iTimerId periodic = addPeriodic_TimerService(timers, 0.005, 0.005, timerExpired_, &ticks);
+        /* Most connection timeouts get cancelled. */
+        const iTime start = now_Time();
+        int cancelled = 0;
+        for (int i = 0; i < 10000; ++i) {
+            const iTimerId id = add_TimerService(timers, 0.01 + i * 0.00001, timerExpired_, &expired);
+            if (i % 2 && cancel_TimerService(timers, id)) {
+                cancelled++;
+            }
+        }
+        iAssert(cancelled == 5000);
+        /* One far in the future. */
+        const iTimerId distant = add_TimerService(timers, 24 * 3600.0, timerExpired_, &expired);
+        while (value_Atomic(&expired) < 5000 && elapsedSeconds_Time(&start) < 10.0) {
+            sleep_Thread(0.01);
+        }
+        printf("Timers: %d expired in %.3f seconds, %d periodic calls\n",
+               value_Atomic(&expired), elapsedSeconds_Time(&start), value_Atomic(&ticks));
+        iAssert(value_Atomic(&expired) == 5000);
+        iAssert(value_Atomic(&ticks) >= 2);
+        iAssert(size_TimerService(timers) == 2);
+        const iBool cancelledPeriodic = cancel_TimerService(timers, periodic);
+        const iBool cancelledDistant  = cancel_TimerService(timers, distant);
+        const iBool cancelledTwice    = cancel_TimerService(timers, distant);
+        iAssert(cancelledPeriodic && cancelledDistant && !cancelledTwice);
+        iUnused(cancelledPeriodic, cancelledDistant, cancelledTwice);
+        iAssert(isEmpty_TimerService(timers));
+        iRelease(timers);
+        iRelease(pool);
+        /* Calls made in the thread that processes a dispatch. */
+        iDispatch *dispatch = new_Dispatch();
+        timers = newDispatch_TimerService(dispatch);
+        set_Atomic(&expired, 0);
+        add_TimerService(timers, 0.02, timerExpired_, &expired);
+        const size_t calls = processTimeout_Dispatch(dispatch, 5.0);
+        iAssert(calls == 1 && value_Atomic(&expired) == 1);
+        iUnused(calls, periodic, distant, cancelled);
+        iRelease(timers);
+        iRelease(dispatch);
+    }
+    /* Many fibers waiting concurrently on a few threads. */ {
+        iThreadPool *pool = new_ThreadPool();
+        iQueue *queues[2] = { new_Queue(), new_Queue() };
+        set_Atomic(&pingCount_, 0);
+        const iTime start = now_Time();
+        iFiber *flows[2000];
+        iForIndices(i, flows) {
+            flows[i] = new_Fiber(run_Flow_);
+            setUserData_Fiber(flows[i], queues);
+            start_Fiber(flows[i], pool);
+        }
+        iForIndices(i, flows) {
+            iNumber *item = newValue_Number_((int) i);
+            put_Queue(queues[0], item);
+            iRelease(item);
+        }
+        int64_t sum = 0;
+        iForIndices(i, flows) {
+            sum += result_Fiber(flows[i]);
+            iAssert(isFinished_Fiber(flows[i]));
+            iRelease(flows[i]);
+        }
+        printf("Fibers: %zu flows finished in %.3f seconds\n", iElemCount(flows),
+               elapsedSeconds_Time(&start));
+        iAssert(value_Atomic(&pingCount_) == 1999 * 2000 / 2);
+        iAssert(sum == 1999 * 2000 / 2 + 2000);
+        iUnused(sum);
+        iRelease(queues[1]);
+        iRelease(queues[0]);
+        iRelease(pool);
+        set_Atomic(&pingCount_, 0);
+    }
+    /* Notify an audience from several threads while observers come and go. */ {
+        iNotifier *notifier = iNew(Notifier);
+        notifier->pinged = NULL;
+        iNotifier *listener = iNew(Notifier);
+        listener->pinged = NULL;
+        iConnect(Notifier, notifier, pinged, listener, pinged_Listener_);
+        iThread *pingers[4];
+        iForIndices(i, pingers) {
+            pingers[i] = new_Thread(run_Pinger_);
+            setUserData_Thread(pingers[i], notifier);
+            start_Thread(pingers[i]);
+        }
+        for (int i = 0; i < 1000; ++i) {
+            iNotifier *temp = iNew(Notifier);
+            temp->pinged = NULL;
+            iConnect(Notifier, notifier, pinged, temp, pinged_Listener_);
+            iRelease(temp); /* disconnects */
+        }
+        iForIndices(i, pingers) {
+            join_Thread(pingers[i]);
+            iRelease(pingers[i]);
+        }
+        printf("Pings received: %i\n", value_Atomic(&pingCount_));
+        iAssert(value_Atomic(&pingCount_) >= 400000);
+        iRelease(listener);
+        iRelease(notifier);
+    }
+    /* Observers removed concurrently by notifying threads. */ {
+        iBarrier barrier;
+        init_Barrier(&barrier, 2);
+        for (int round = 0; round < 100; ++round) {
+            iNotifier *notifier = iNew(Notifier);
+            notifier->pinged = NULL;
+            iNotifier *listener = iNew(Notifier);
+            listener->pinged = NULL;
+            iConnect(Notifier, notifier, pinged, listener, removePeer_Listener_);
+            iRemover removers[2];
+            iThread *threads[2];
+            iForIndices(i, removers) {
+                removers[i].notifier = notifier;
+                removers[i].peer = iNew(Notifier);
+                removers[i].peer->pinged = NULL;
+                removers[i].barrier = &barrier;
+                iConnect(Notifier, notifier, pinged, removers[i].peer, pinged_Listener_);
+            }
+            iForIndices(i, threads) {
+                threads[i] = new_Thread(run_Remover_);
+                setUserData_Thread(threads[i], &removers[i]);
+                start_Thread(threads[i]);
+            }
+            iForIndices(i, threads) {
+                join_Thread(threads[i]);
+                iRelease(threads[i]);
+                iRelease(removers[i].peer);
+            }
+            iRelease(listener);
+            iRelease(notifier);
+        }
+        deinit_Barrier(&barrier);
+        puts("Concurrent removals finished");
+    }
+    /* Queued notifications are delivered in the thread that processes the dispatch. */ {
+        iDispatch *dispatch = new_Dispatch();
+        iNotifier *notifier = iNew(Notifier);
+        notifier->pinged = NULL;
+        iNotifier *listener = iNew(Notifier);
+        listener->pinged = NULL;
+        iConnectQueued(Notifier, notifier, pinged, listener, pinged_Listener_, dispatch);
+        set_Atomic(&pingCount_, 0);
+        iThread *pinger = new_Thread(run_Pinger_);
+        setUserData_Thread(pinger, notifier);
+        start_Thread(pinger);
+        size_t calls = 0;
+        while (isRunning_Thread(pinger)) {
+            calls += processTimeout_Dispatch(dispatch, 0.01);
+        }
+        join_Thread(pinger);
+        iRelease(pinger);
+        calls += process_Dispatch(dispatch);
+        /* Pending duplicates are coalesced. */
+        printf("Queued pings: 100000 notified, %zu delivered\n", calls);
+        iAssert(calls >= 1 && calls == (size_t) value_Atomic(&pingCount_));
+        iAssert(isEmpty_Dispatch(dispatch));
+        iRelease(listener);
+        iRelease(notifier);
+        iRelease(dispatch);
+    }
+    /* Pooled objects may be deleted in another thread. */ {
+        iTime start = now_Time();
+        for (int i = 0; i < 1000000; ++i) {
+            iNotifier *obj = iNew(Notifier);
+            obj->pinged = NULL;
+            iRelease(obj);
+        }
+        const double unpooled = elapsedSeconds_Time(&start);
+        enable_ObjectPool(&Class_Notifier);
+        iPtrArray *objs = new_PtrArray();
+        for (int i = 0; i < 1000; ++i) {
+            iNotifier *obj = iNew(Notifier);
+            obj->pinged = NULL;
+            pushBack_PtrArray(objs, obj);
+        }
+        iThread *releaser = new_Thread(run_Releaser_);
+        setUserData_Thread(releaser, objs);
+        start_Thread(releaser);
+        join_Thread(releaser);
+        iRelease(releaser);
+        delete_PtrArray(objs);
+        start = now_Time();
+        for (int i = 0; i < 1000000; ++i) {
+            iNotifier *obj = iNew(Notifier);
+            obj->pinged = NULL;
+            iRelease(obj);
+        }
+        printf("1M objects: %.3f seconds unpooled, %.3f seconds pooled\n", unpooled,
+               elapsedSeconds_Time(&start));
+        iObjectPoolStats stats;
+        stats_ObjectPool(&Class_Notifier, &stats);
+        printStats_ObjectPool(stdout);
+        iAssert(stats.allocated >= 1001000);
+    }
+    /* Thread-confined reference counting, while also shared with another thread. */ {
+        const int objCount = totalCount_Object();
+        iNotifier *obj = iNew(Notifier);
+        obj->pinged = NULL;
+        confine_Object(obj);
+        iAssert(isConfined_Object(obj));
+        iThread *sharer = new_Thread(run_Sharer_);
+        setUserData_Thread(sharer, obj);
+        start_Thread(sharer);
+        for (int i = 0; i < 100000; ++i) {
+            iRelease(ref_Object(obj));
+        }
+        join_Thread(sharer);
+        iRelease(sharer);
+        /* Now another thread can take over. */
+        unconfine_Object(obj);
+        iAssert(!isConfined_Object(obj));
+        iRelease(obj);
+        iAssert(totalCount_Object() == objCount);
+        iUnused(objCount);
+    }
+    /* Per-thread storage. */ {
+        iThreadStorage *storage = new_ThreadStorage(deleteStorage_);
+        iAssert(current_Thread() == NULL); /* main thread */
+        setValue_ThreadStorage(storage, storage);
+        iThread *users[4];
+        iForIndices(i, users) {
+            users[i] = new_Thread(run_StorageUser_);
+            setUserData_Thread(users[i], storage);
+            start_Thread(users[i]);
+        }
+        iForIndices(i, users) {
+            const iThreadResult result = result_Thread(users[i]);
+            iAssert(result == 1);
+            iUnused(result);
+            iRelease(users[i]);
+        }
+        iAssert(value_ThreadStorage(storage) == storage);
+        iAssert(value_Atomic(&storageDeleted_) == 4);
+        delete_ThreadStorage(storage);
+    }
+    /* Lightweight locks. */ {
+        iLocks locks;
+        iZap(locks);
+        init_SpinMutex(&locks.spin);
+        initPreference_RWLock(&locks.rw, writers_RWLockPreference);
+        init_Semaphore(&locks.sema, 2);
+        init_Barrier(&locks.barrier, 4);
+        iThread *lockers[4];
+        const iTime start = now_Time();
+        iForIndices(i, lockers) {
+            lockers[i] = new_Thread(run_Locker_);
+            setUserData_Thread(lockers[i], &locks);
+            start_Thread(lockers[i]);
+        }
+        iForIndices(i, lockers) {
+            join_Thread(lockers[i]);
+            iRelease(lockers[i]);
+        }
+        printf("Locks: counter %i, pair %i/%i, %i barrier leaders, %.3f seconds\n",
+               locks.counter, locks.pair[0], locks.pair[1], value_Atomic(&locks.leaders),
+               elapsedSeconds_Time(&start));
+        iAssert(locks.counter == 400000);
+        iAssert(locks.pair[0] == 4000 && locks.pair[1] == 4000);
+        iAssert(value_Atomic(&locks.leaders) == 100);
+        deinit_Barrier(&locks.barrier);
+        deinit_Semaphore(&locks.sema);
+        deinit_RWLock(&locks.rw);
+        deinit_SpinMutex(&locks.spin);
+    }
+    /* Atomic operations and a lock-free stack. */ {
+        iAtomicInt64 big;
+        init_Atomic(&big, INT64_C(1) << 40);
+        int64_t expected = INT64_C(1) << 40;
+        const iBool swapped = compareExchange_Atomic(&big, &expected, expected + 1);
+        const iBool swappedAgain = compareExchangeAcqRel_Atomic(&big, &expected, 0);
+        const int64_t previous = sub_Atomic(&big, 1);
+        iAssert(swapped && !swappedAgain);
+        iAssert(expected == (INT64_C(1) << 40) + 1 && previous == expected);
+        iAssert(valueAcquire_Atomic(&big) == INT64_C(1) << 40);
+        iUnused(swapped, swappedAgain, previous);
+        iAtomicStack stack;
+        init_AtomicStack(&stack);
+        iStackItem items[64];
+        iForIndices(i, items) {
+            set_Atomic(&items[i].owners, 0);
+            push_AtomicStack(&stack, &items[i].node);
+        }
+        const iTime start = now_Time();
+        iThread *users[4];
+        iForIndices(i, users) {
+            users[i] = new_Thread(run_StackUser_);
+            setUserData_Thread(users[i], &stack);
+            start_Thread(users[i]);
+        }
+        iForIndices(i, users) {
+            join_Thread(users[i]);
+            iRelease(users[i]);
+        }
+        size_t count = 0;
+        for (iAtomicStackNode *n = takeAll_AtomicStack(&stack); n; n = next_AtomicStackNode(n)) {
+            count++;
+        }
+        printf("Lock-free stack: %zu items after 4x100000 rounds, %.3f seconds\n", count,
+               elapsedSeconds_Time(&start));
+        iAssert(count == iElemCount(items));
+        iAssert(isEmpty_AtomicStack(&stack));
+        deinit_AtomicStack(&stack);
+    }
+    /* Lock contention statistics. */ {
+        iMutex mtx;
+        init_Mutex(&mtx);
+        setName_Mutex(&mtx, "t_threading");
+        iThread *users[4];
+        iForIndices(i, users) {
+            users[i] = new_Thread(run_MutexUser_);
+            setUserData_Thread(users[i], &mtx);
+            start_Thread(users[i]);
+        }
+        iForIndices(i, users) {
+            join_Thread(users[i]);
+            iRelease(users[i]);
+        }
+        deinit_Mutex(&mtx);
+#if defined (iHaveLockProfiler)
+        iLockProfileStats stats;
+        const iBool found = stats_LockProfile("t_threading", &stats);
+        iAssert(found && stats.acquired == 40000);
+        iUnused(found);
+        print_LockProfile(stdout, table_LockProfileFormat);
+        print_LockProfile(stdout, json_LockProfileFormat);
+#endif
+    }
     deinit_Foundation();
     return 0;
 }